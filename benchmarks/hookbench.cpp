@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver hookbench.cpp
+//
+// Measures what firing a plugin hook costs per event, the way the server used to
+// (hook looked up by name, arguments passed through va_list) against the way it
+// does now (hook ID resolved once, typed call over the contiguous callback array).
+//
+// Usage: hookbench [events] [callbacks]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "tr1.h"
+#include TR1INCLUDE(unordered_map)
+
+#include "hook.h"
+
+typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t> BlockPlaceHook;
+
+static volatile int32_t sink = 0;
+
+static bool blockPlacePre(const char* user, int32_t x, int16_t y, int32_t z, int16_t block, int8_t direction)
+{
+  sink += x + y + z + block + direction + user[0];
+  return true;
+}
+
+// Same lookup the plugin API does for hook_doUntilFalse("BlockPlacePre", ...)
+static std::tr1::unordered_map<std::string, Hook*> hooksByName;
+
+static bool doUntilFalseByName(const char* hookID, ...)
+{
+  bool result = false;
+  va_list argList;
+  va_start(argList, hookID);
+  result = hooksByName.find(hookID)->second->doUntilFalseVA(argList);
+  va_end(argList);
+  return result;
+}
+
+static double nsPerEvent(clock_t start, clock_t end, long events)
+{
+  return (double(end - start) / CLOCKS_PER_SEC) * 1e9 / events;
+}
+
+int main(int argc, const char* argv[])
+{
+  const long events    = argc > 1 ? atol(argv[1]) : 10000000;
+  const int  callbacks = argc > 2 ? atoi(argv[2]) : 3;
+
+  if (events <= 0 || callbacks < 0)
+  {
+    printf("Usage: %s [events] [callbacks]\n", argv[0]);
+    return 1;
+  }
+
+  // A few hooks next to the one being fired, like the server has
+  std::vector<Hook*> hooksByID;
+  const char* names[] = { "Timer200", "PlayerDigging", "PlayerChatPre", "BlockBreakPre", "BlockPlacePre", "BlockPlacePost" };
+  int blockPlacePreID = -1;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+  {
+    Hook* hook = new BlockPlaceHook;
+    hooksByName[names[i]] = hook;
+    if (std::string(names[i]) == "BlockPlacePre")
+    {
+      blockPlacePreID = int(hooksByID.size());
+    }
+    hooksByID.push_back(hook);
+  }
+
+  for (int i = 0; i < callbacks; i++)
+  {
+    hooksByID[blockPlacePreID]->addCallback(&blockPlacePre);
+  }
+
+  printf("%ld events, %d callbacks\n", events, callbacks);
+
+  clock_t start = clock();
+  for (long i = 0; i < events; i++)
+  {
+    doUntilFalseByName("BlockPlacePre", "player", int32_t(i), int16_t(64), int32_t(-i), int16_t(1), int8_t(2));
+  }
+  clock_t end = clock();
+  const double byName = nsPerEvent(start, end, events);
+  printf("name lookup + va_list: %8.1f ns/event\n", byName);
+
+  start = clock();
+  for (long i = 0; i < events; i++)
+  {
+    static_cast<BlockPlaceHook*>(hooksByID[blockPlacePreID])->doUntilFalse("player", int32_t(i), int16_t(64), int32_t(-i), int16_t(1), int8_t(2));
+  }
+  end = clock();
+  const double byID = nsPerEvent(start, end, events);
+  printf("hook ID + typed call:  %8.1f ns/event\n", byID);
+
+  if (byID > 0)
+  {
+    printf("speedup: %.2fx\n", byName / byID);
+  }
+
+  for (size_t i = 0; i < hooksByID.size(); i++)
+  {
+    delete hooksByID[i];
+  }
+
+  return 0;
+}
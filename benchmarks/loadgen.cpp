@@ -0,0 +1,1263 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver loadgen.cpp
+//
+// Headless load generator. Connects scripted bots to a running server and
+// reports login latency, chunk streaming rate and traffic per player, and,
+// when the server writes system.stats_file, its tick time percentiles, CPU
+// time and memory over the run.
+//
+// Bots speak the server's protocol: handshake, encryption when the server
+// asks for it, client info and status, then they walk about the spawn sending
+// positions, dig the block under them now and then, place a block back once
+// they hold one, and chat. All of it follows from the seed, so runs against
+// the same world are comparable.
+//
+// Run the server offline on a fixed world, for example
+//   mineserver +system.user_validation=false +system.user_limit=1000
+//              +map.seed=1234 '+system.stats_file="mineserver.stats"'
+// (validation must be off, bots have no session) and then
+//   loadgen -n 300 -t 60 -s mineserver.stats
+//
+// Usage: loadgen [-h host] [-p port] [-n bots] [-r bots connecting per second]
+//                [-t seconds after the last connect] [-s server stats file]
+//                [-S seed] [-m positions per second] [-w walk radius]
+//                [-d seconds between digs] [-c seconds between chats]
+//                [-v view distance 0-3, far to tiny]
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "packets.h"
+
+using namespace PacketLayout;
+
+// PROTOCOL_VERSION in constants.cpp
+static const int8_t PROTOCOL = 39;
+
+//
+// Server to client packets, as this server writes them
+//
+
+// Byte count followed by that many units
+template <int Unit>
+struct Array8
+{
+  enum { size = -1 };
+
+  static int skip(const uint8_t* data, size_t len, size_t& pos)
+  {
+    if (len - pos < 1)
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    const size_t count = data[pos];
+    if (len - pos - 1 < count * Unit)
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    pos += 1 + count * Unit;
+    return 0;
+  }
+};
+
+// Int length followed by that many bytes
+struct IntBytes
+{
+  enum { size = -1 };
+
+  static int skip(const uint8_t* data, size_t len, size_t& pos)
+  {
+    if (len - pos < 4)
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    const int32_t count = int32_t(get32(data + pos));
+    if (count < 0)
+    {
+      return PACKET_MALFORMED;
+    }
+    if (len - pos - 4 < size_t(count))
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    pos += 4 + size_t(count);
+    return 0;
+  }
+};
+
+// Entity metadata: typed entries up to a 0x7f
+struct Metadata
+{
+  enum { size = -1 };
+
+  static int skip(const uint8_t* data, size_t len, size_t& pos)
+  {
+    for (;;)
+    {
+      if (len - pos < 1)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      const uint8_t header = data[pos];
+      if (header == 0x7f)
+      {
+        pos++;
+        return 0;
+      }
+
+      size_t next = pos + 1;
+      int ret;
+      switch (header >> 5)
+      {
+      case 0: ret = Byte::skip(data, len, next);      break;
+      case 1: ret = Short::skip(data, len, next);     break;
+      case 2: ret = Int::skip(data, len, next);       break;
+      case 3: ret = Float::skip(data, len, next);     break;
+      case 4: ret = String16::skip(data, len, next);  break;
+      case 5: ret = Slot::skip(data, len, next);      break;
+      case 6: ret = Fixed<12>::skip(data, len, next); break;
+      default: return PACKET_MALFORMED;
+      }
+      if (ret < 0)
+      {
+        return ret;
+      }
+      pos = next;
+    }
+  }
+};
+
+// Add object: object data, followed by a speed unless it is 0
+struct ObjectData
+{
+  enum { size = -1 };
+
+  static int skip(const uint8_t* data, size_t len, size_t& pos)
+  {
+    if (len - pos < 4)
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    const size_t total = get32(data + pos) != 0 ? 10 : 4;
+    if (len - pos < total)
+    {
+      return PACKET_NEED_MORE_DATA;
+    }
+    pos += total;
+    return 0;
+  }
+};
+
+typedef int (*frame_function)(const uint8_t*, size_t);
+static frame_function serverPackets[256];
+
+static void initServerPackets()
+{
+  serverPackets[PACKET_KEEP_ALIVE]                = &Layout<Int>::frame;
+  serverPackets[PACKET_LOGIN_RESPONSE]            = &Layout<Int, String16, Fixed<5> >::frame;
+  serverPackets[PACKET_CHAT_MESSAGE]              = &Layout<String16>::frame;
+  serverPackets[PACKET_TIME_UPDATE]               = &Layout<Long>::frame;
+  serverPackets[PACKET_ENTITY_EQUIPMENT]          = &Layout<Int, Short, Slot>::frame;
+  serverPackets[PACKET_SPAWN_POSITION]            = &Layout<Int, Int, Int>::frame;
+  serverPackets[PACKET_UPDATE_HEALTH]             = &Layout<Short, Short, Float>::frame;
+  serverPackets[PACKET_RESPAWN]                   = &Layout<Int, Byte, Byte, Short, String16>::frame;
+  serverPackets[PACKET_PLAYER_POSITION_AND_LOOK]  = &Layout<Double, Double, Double, Double, Float, Float, Byte>::frame;
+  serverPackets[PACKET_ANIMATION]                 = &Layout<Int, Byte>::frame;
+  serverPackets[PACKET_NAMED_ENTITY_SPAWN]        = &Layout<Int, String16, Fixed<16>, Metadata>::frame;
+  serverPackets[PACKET_PICKUP_SPAWN]              = &Layout<Fixed<24> >::frame;
+  serverPackets[PACKET_COLLECT_ITEM]              = &Layout<Int, Int>::frame;
+  serverPackets[PACKET_ADD_OBJECT]                = &Layout<Fixed<17>, ObjectData>::frame;
+  serverPackets[PACKET_MOB_SPAWN]                 = &Layout<Fixed<26>, Metadata>::frame;
+  serverPackets[PACKET_ENTITY_VELOCITY]           = &Layout<Int, Short, Short, Short>::frame;
+  serverPackets[PACKET_DESTROY_ENTITY]            = &Layout<Array8<4> >::frame;
+  serverPackets[PACKET_ENTITY]                    = &Layout<Int>::frame;
+  serverPackets[PACKET_ENTITY_RELATIVE_MOVE]      = &Layout<Int, Fixed<3> >::frame;
+  serverPackets[PACKET_ENTITY_LOOK]               = &Layout<Int, Fixed<2> >::frame;
+  serverPackets[PACKET_ENTITY_LOOK_RELATIVE_MOVE] = &Layout<Int, Fixed<5> >::frame;
+  serverPackets[PACKET_ENTITY_TELEPORT]           = &Layout<Int, Int, Int, Int, Byte, Byte>::frame;
+  serverPackets[PACKET_ENTITY_HEAD_LOOK]          = &Layout<Int, Byte>::frame;
+  serverPackets[PACKET_ENTITY_STATUS]             = &Layout<Int, Byte>::frame;
+  serverPackets[PACKET_ATTACH_ENTITY]             = &Layout<Int, Int>::frame;
+  serverPackets[PACKET_ENTITY_METADATA]           = &Layout<Int, Metadata>::frame;
+  serverPackets[PACKET_MAP_CHUNK]                 = &Layout<Int, Int, Byte, Short, Short, IntBytes>::frame;
+  // Coordinates, types and metas, 4 bytes a block
+  serverPackets[PACKET_MULTI_BLOCK_CHANGE]        = &Layout<Int, Int, Array16<4> >::frame;
+  serverPackets[PACKET_BLOCK_CHANGE]              = &Layout<Int, Byte, Int, Short, Byte>::frame;
+  serverPackets[PACKET_PLAY_NOTE]                 = &Layout<Int, Short, Int, Byte, Byte>::frame;
+  serverPackets[PACKET_OPEN_WINDOW]               = &Layout<Byte, Byte, String16, Byte>::frame;
+  serverPackets[PACKET_SET_SLOT]                  = &Layout<Byte, Short, Slot>::frame;
+  serverPackets[PACKET_PROGRESS_BAR]              = &Layout<Byte, Short, Short>::frame;
+  serverPackets[PACKET_TRANSACTION]               = &Layout<Byte, Short, Byte>::frame;
+  serverPackets[PACKET_SIGN]                      = &Layout<Int, Short, Int, String16, String16, String16, String16>::frame;
+  serverPackets[PACKET_PLAYER_LIST_ITEM]          = &Layout<String16, Byte, Short>::frame;
+  serverPackets[PACKET_TAB_COMPLETE]              = &Layout<String16>::frame;
+  serverPackets[PACKET_ENCRYPTION_RESPONSE]       = &Layout<ShortBytes, ShortBytes>::frame;
+  serverPackets[PACKET_ENCRYPTION_REQUEST]        = &Layout<String16, ShortBytes, ShortBytes>::frame;
+  serverPackets[PACKET_KICK]                      = &Layout<String16>::frame;
+}
+
+//
+// Client to server packets
+//
+
+class Out
+{
+public:
+  Out& operator<<(int8_t val)
+  {
+    data += char(val);
+    return *this;
+  }
+
+  Out& operator<<(int16_t val)
+  {
+    data += char(val >> 8);
+    data += char(val);
+    return *this;
+  }
+
+  Out& operator<<(int32_t val)
+  {
+    return *this << int16_t(val >> 16) << int16_t(val);
+  }
+
+  Out& operator<<(int64_t val)
+  {
+    return *this << int32_t(val >> 32) << int32_t(val);
+  }
+
+  Out& operator<<(float val)
+  {
+    int32_t ival;
+    memcpy(&ival, &val, 4);
+    return *this << ival;
+  }
+
+  Out& operator<<(double val)
+  {
+    int64_t ival;
+    memcpy(&ival, &val, 8);
+    return *this << ival;
+  }
+
+  // UCS-2, the bots only say ASCII
+  Out& operator<<(const std::string& str)
+  {
+    *this << int16_t(str.size());
+    for (size_t i = 0; i < str.size(); i++)
+    {
+      *this << int16_t(uint8_t(str[i]));
+    }
+    return *this;
+  }
+
+  Out& bytes(const std::string& str)
+  {
+    *this << int16_t(str.size());
+    data += str;
+    return *this;
+  }
+
+  std::string data;
+};
+
+static std::string readString(Span& span)
+{
+  std::vector<uint16_t> str;
+  span.readString16(str);
+  return std::string(str.begin(), str.end());
+}
+
+static std::string readBytes(Span& span)
+{
+  int16_t len;
+  span >> len;
+  std::string bytes;
+  for (int16_t i = 0; i < len && span; i++)
+  {
+    int8_t b;
+    span >> b;
+    bytes += char(b);
+  }
+  return bytes;
+}
+
+//
+// Bots
+//
+
+struct Options
+{
+  std::string host;
+  int port;
+  int bots;
+  double connectRate;
+  int seconds;
+  std::string statsFile;
+  uint32_t seed;
+  double moveRate;
+  double walkRadius;
+  int digEvery;
+  int chatEvery;
+  int viewDistance;
+
+  Options()
+    : host("127.0.0.1"), port(25565), bots(100), connectRate(50), seconds(60), seed(1),
+      moveRate(20), walkRadius(48), digEvery(10), chatEvery(30), viewDistance(1)
+  {
+  }
+};
+
+static Options options;
+
+struct Totals
+{
+  uint64_t connected;
+  uint64_t logged;
+  uint64_t failed;
+  uint64_t kicked;
+  uint64_t chunks;
+  uint64_t chunkBytes;
+  uint64_t received;
+  uint64_t sent;
+  uint64_t positions;
+  uint64_t digs;
+  uint64_t places;
+  uint64_t chats;
+  std::vector<uint64_t> loginUs;
+  std::map<std::string, int> reasons;
+
+  Totals()
+    : connected(0), logged(0), failed(0), kicked(0), chunks(0), chunkBytes(0), received(0), sent(0),
+      positions(0), digs(0), places(0), chats(0)
+  {
+  }
+};
+
+static Totals totals;
+
+static uint64_t nowUs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+class Bot
+{
+public:
+  enum State
+  {
+    CONNECTING,
+    HANDSHAKE,   // waiting for the encryption request, or the login when there is none
+    ENCRYPTING,  // waiting for the encryption response
+    LOGGING_IN,
+    PLAYING,
+    CLOSED
+  };
+
+  Bot(int id)
+    : id(id), fd(-1), state(CLOSED), en(NULL), de(NULL), crypted(false), inStart(0), outPos(0),
+      connectStart(0), spawned(false), x(0), y(0), stance(0), z(0), heading(0), homeX(0), homeZ(0),
+      nextMove(0), nextDig(0), nextChat(0), digging(false), digX(0), digY(0), digZ(0), held(0), said(0)
+  {
+    char name[16];
+    sprintf(name, "bot%d", id);
+    nick = name;
+    // xorshift wants a non-zero state
+    rng = (options.seed * 2654435761u) ^ (uint32_t(id) * 40503u) ^ 0x9e3779b9u;
+    if (rng == 0)
+    {
+      rng = 1;
+    }
+    for (int i = 0; i < 9; i++)
+    {
+      hotbar[i] = -1;
+    }
+  }
+
+  ~Bot()
+  {
+    close(NULL);
+  }
+
+  bool connect(const sockaddr_in& addr)
+  {
+    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+      return fail("socket() failed");
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    connectStart = nowUs();
+    state = CONNECTING;
+    if (::connect(fd, (const sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+      return fail("connect() failed");
+    }
+    return true;
+  }
+
+  short events() const
+  {
+    if (state == CLOSED)
+    {
+      return 0;
+    }
+    return state == CONNECTING || outPos < out.size() ? POLLIN | POLLOUT : POLLIN;
+  }
+
+  void ready(short revents)
+  {
+    if (state == CONNECTING && (revents & (POLLOUT | POLLERR | POLLHUP)))
+    {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len);
+      if (error != 0)
+      {
+        fail("cannot connect");
+        return;
+      }
+      totals.connected++;
+      state = HANDSHAKE;
+      Out handshake;
+      handshake << int8_t(PACKET_HANDSHAKE) << PROTOCOL << nick << options.host << int32_t(options.port);
+      send(handshake);
+    }
+
+    if (revents & (POLLIN | POLLERR | POLLHUP))
+    {
+      receive();
+    }
+    if (state != CLOSED && (revents & POLLOUT))
+    {
+      flush();
+    }
+  }
+
+  // The scripted part, called every round
+  void update(uint64_t now)
+  {
+    if (state != PLAYING || !spawned)
+    {
+      return;
+    }
+
+    if (now >= nextMove)
+    {
+      move();
+      nextMove = std::max(nextMove + uint64_t(1e6 / options.moveRate), now);
+    }
+
+    if (options.digEvery > 0 && now >= nextDig)
+    {
+      dig();
+      // Finishing takes a second, the next dig comes around the interval
+      nextDig = now + (digging ? 1000000 : uint64_t(options.digEvery) * 500000 + random() % (uint32_t(options.digEvery) * 1000000));
+    }
+
+    if (options.chatEvery > 0 && now >= nextChat)
+    {
+      char msg[64];
+      sprintf(msg, "%s says hello #%d", nick.c_str(), ++said);
+      Out chat;
+      chat << int8_t(PACKET_CHAT_MESSAGE) << std::string(msg);
+      send(chat);
+      totals.chats++;
+      nextChat = now + uint64_t(options.chatEvery) * 500000 + random() % (uint32_t(options.chatEvery) * 1000000);
+    }
+
+    flush();
+  }
+
+  State status() const
+  {
+    return state;
+  }
+
+  int socket() const
+  {
+    return fd;
+  }
+
+  void close(const char* reason)
+  {
+    if (fd >= 0)
+    {
+      ::close(fd);
+      fd = -1;
+    }
+    if (en != NULL)
+    {
+      EVP_CIPHER_CTX_free(en);
+      EVP_CIPHER_CTX_free(de);
+      en = de = NULL;
+    }
+    if (reason != NULL && state != CLOSED)
+    {
+      totals.reasons[reason]++;
+    }
+    state = CLOSED;
+  }
+
+private:
+  uint32_t random()
+  {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  }
+
+  bool fail(const char* reason)
+  {
+    totals.failed++;
+    close(reason);
+    return false;
+  }
+
+  void send(Out& packet)
+  {
+    if (state == CLOSED)
+    {
+      return;
+    }
+    if (crypted)
+    {
+      int len = int(packet.data.size());
+      EVP_EncryptUpdate(en, (uint8_t*)&packet.data[0], &len, (const uint8_t*)packet.data.data(), len);
+    }
+    totals.sent += packet.data.size();
+    out += packet.data;
+  }
+
+  void flush()
+  {
+    while (state != CLOSED && state != CONNECTING && outPos < out.size())
+    {
+      const ssize_t sent = ::send(fd, out.data() + outPos, out.size() - outPos, MSG_NOSIGNAL);
+      if (sent <= 0)
+      {
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+          break;
+        }
+        fail("send() failed");
+        return;
+      }
+      outPos += sent;
+    }
+    if (outPos == out.size())
+    {
+      out.clear();
+      outPos = 0;
+    }
+  }
+
+  void receive()
+  {
+    for (;;)
+    {
+      const size_t old = in.size();
+      in.resize(old + 65536);
+      const ssize_t got = recv(fd, &in[old], 65536, 0);
+      in.resize(old + (got > 0 ? got : 0));
+      if (got == 0)
+      {
+        fail("server closed the connection");
+        return;
+      }
+      if (got < 0)
+      {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+          fail("recv() failed");
+          return;
+        }
+        break;
+      }
+
+      totals.received += got;
+      if (crypted)
+      {
+        int len = int(got);
+        EVP_DecryptUpdate(de, &in[old], &len, &in[old], len);
+      }
+      if (size_t(got) < 65536)
+      {
+        break;
+      }
+    }
+
+    while (state != CLOSED && inStart < in.size())
+    {
+      const uint8_t id = in[inStart];
+      if (serverPackets[id] == NULL)
+      {
+        char reason[48];
+        sprintf(reason, "unknown packet 0x%02x", id);
+        fail(reason);
+        return;
+      }
+      const int len = serverPackets[id](&in[inStart + 1], in.size() - inStart - 1);
+      if (len == PACKET_NEED_MORE_DATA)
+      {
+        break;
+      }
+      if (len < 0)
+      {
+        fail("malformed packet");
+        return;
+      }
+
+      Span span(&in[inStart + 1], len);
+      inStart += 1 + len;
+      handle(id, span);
+    }
+
+    if (inStart == in.size())
+    {
+      in.clear();
+      inStart = 0;
+    }
+    else if (inStart > 65536)
+    {
+      in.erase(in.begin(), in.begin() + inStart);
+      inStart = 0;
+    }
+  }
+
+  void handle(uint8_t id, Span& span)
+  {
+    switch (id)
+    {
+    case PACKET_ENCRYPTION_REQUEST:
+    {
+      readString(span);
+      const std::string key = readBytes(span);
+      const std::string token = readBytes(span);
+      startEncryption(key, token);
+      break;
+    }
+
+    case PACKET_ENCRYPTION_RESPONSE:
+    {
+      // Everything from here on is encrypted, both ways
+      crypted = true;
+      int len = int(in.size() - inStart);
+      if (len > 0)
+      {
+        EVP_DecryptUpdate(de, &in[inStart], &len, &in[inStart], len);
+      }
+
+      Out info;
+      info << int8_t(PACKET_CLIENT_INFO) << std::string("en_US") << int8_t(options.viewDistance)
+           << int8_t(0) << int8_t(1);
+      info << int8_t(PACKET_CLIENT_STATUS) << int8_t(0);
+      send(info);
+      flush();
+      state = LOGGING_IN;
+      break;
+    }
+
+    case PACKET_LOGIN_RESPONSE:
+      totals.logged++;
+      totals.loginUs.push_back(nowUs() - connectStart);
+      state = PLAYING;
+      break;
+
+    case PACKET_PLAYER_POSITION_AND_LOOK:
+      span >> x >> y >> stance >> z;
+      if (!spawned)
+      {
+        spawned = true;
+        homeX = x;
+        homeZ = z;
+        heading = random() % 6283 / 1000.0;
+      }
+      break;
+
+    case PACKET_KEEP_ALIVE:
+    {
+      int32_t ping;
+      span >> ping;
+      Out pong;
+      pong << int8_t(PACKET_KEEP_ALIVE) << ping;
+      send(pong);
+      break;
+    }
+
+    case PACKET_MAP_CHUNK:
+      totals.chunks++;
+      totals.chunkBytes += span.left();
+      break;
+
+    case PACKET_SET_SLOT:
+    {
+      int8_t window;
+      int16_t slot, item;
+      span >> window >> slot >> item;
+      if (window == 0 && slot >= 36 && slot <= 44)
+      {
+        hotbar[slot - 36] = item;
+      }
+      break;
+    }
+
+    case PACKET_KICK:
+    {
+      totals.kicked++;
+      const std::string reason = "kicked: " + readString(span);
+      close(reason.c_str());
+      break;
+    }
+    }
+  }
+
+  void startEncryption(const std::string& key, const std::string& token)
+  {
+    const uint8_t* keyData = (const uint8_t*)key.data();
+    EVP_PKEY* pkey = d2i_PUBKEY(NULL, &keyData, long(key.size()));
+    if (pkey == NULL)
+    {
+      fail("cannot read the server key");
+      return;
+    }
+
+    std::string secret;
+    for (int i = 0; i < 16; i++)
+    {
+      secret += char(random());
+    }
+
+    std::string encryptedSecret, encryptedToken;
+    const bool ok = encrypt(pkey, secret, encryptedSecret) && encrypt(pkey, token, encryptedToken);
+    EVP_PKEY_free(pkey);
+    if (!ok)
+    {
+      fail("cannot encrypt the secret");
+      return;
+    }
+
+    en = EVP_CIPHER_CTX_new();
+    de = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(en, EVP_aes_128_cfb8(), NULL, (const uint8_t*)secret.data(), (const uint8_t*)secret.data());
+    EVP_DecryptInit_ex(de, EVP_aes_128_cfb8(), NULL, (const uint8_t*)secret.data(), (const uint8_t*)secret.data());
+
+    Out response;
+    response << int8_t(PACKET_ENCRYPTION_RESPONSE);
+    response.bytes(encryptedSecret).bytes(encryptedToken);
+    send(response);
+    flush();
+    state = ENCRYPTING;
+  }
+
+  static bool encrypt(EVP_PKEY* pkey, const std::string& in, std::string& out)
+  {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    size_t len = 0;
+    bool ok = ctx != NULL && EVP_PKEY_encrypt_init(ctx) > 0 &&
+              EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) > 0 &&
+              EVP_PKEY_encrypt(ctx, NULL, &len, (const uint8_t*)in.data(), in.size()) > 0;
+    if (ok)
+    {
+      out.resize(len);
+      ok = EVP_PKEY_encrypt(ctx, (uint8_t*)&out[0], &len, (const uint8_t*)in.data(), in.size()) > 0;
+      out.resize(len);
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+  }
+
+  // Walk straight on at walking speed, turning back towards the spawn at the edge
+  void move()
+  {
+    const double step = 4.3 / options.moveRate;
+    if (random() % 20 == 0)
+    {
+      heading += (int(random() % 1000) - 500) / 1000.0;
+    }
+    double nx = x + cos(heading) * step;
+    double nz = z + sin(heading) * step;
+    if ((nx - homeX) * (nx - homeX) + (nz - homeZ) * (nz - homeZ) > options.walkRadius * options.walkRadius)
+    {
+      heading = atan2(homeZ - z, homeX - x) + (int(random() % 1000) - 500) / 1000.0;
+      nx = x + cos(heading) * step;
+      nz = z + sin(heading) * step;
+    }
+    x = nx;
+    z = nz;
+
+    Out position;
+    position << int8_t(PACKET_PLAYER_POSITION) << x << y << stance << z << int8_t(1);
+    send(position);
+    totals.positions++;
+  }
+
+  // Start digging the block underfoot, finish it next time, then put a block back
+  void dig()
+  {
+    Out packet;
+    if (!digging)
+    {
+      digX = int32_t(floor(x));
+      digY = int8_t(floor(y) - 1);
+      digZ = int32_t(floor(z));
+      packet << int8_t(PACKET_PLAYER_DIGGING) << int8_t(0) << digX << digY << digZ << int8_t(1);
+      digging = true;
+    }
+    else
+    {
+      packet << int8_t(PACKET_PLAYER_DIGGING) << int8_t(2) << digX << digY << digZ << int8_t(1);
+      digging = false;
+      totals.digs++;
+
+      // Anything placeable in the hotbar goes back into the hole
+      for (int i = 0; i < 9; i++)
+      {
+        if (hotbar[i] > 0 && hotbar[i] < 256)
+        {
+          if (held != i)
+          {
+            packet << int8_t(PACKET_HOLDING_CHANGE) << int16_t(i);
+            held = i;
+          }
+          packet << int8_t(PACKET_PLAYER_BLOCK_PLACEMENT) << digX << int8_t(digY - 1) << digZ << int8_t(1)
+                 << hotbar[i] << int8_t(1) << int16_t(0) << int16_t(-1)
+                 << int8_t(8) << int8_t(16) << int8_t(8);
+          totals.places++;
+          break;
+        }
+      }
+    }
+    send(packet);
+  }
+
+  int id;
+  std::string nick;
+  int fd;
+  State state;
+  uint32_t rng;
+
+  EVP_CIPHER_CTX* en;
+  EVP_CIPHER_CTX* de;
+  bool crypted;
+
+  std::vector<uint8_t> in;
+  size_t inStart;
+  std::string out;
+  size_t outPos;
+
+  uint64_t connectStart;
+
+  bool spawned;
+  double x, y, stance, z;
+  double heading;
+  double homeX, homeZ;
+  uint64_t nextMove, nextDig, nextChat;
+  bool digging;
+  int32_t digX;
+  int8_t digY;
+  int32_t digZ;
+  int16_t hotbar[9];
+  int held;
+  int said;
+};
+
+//
+// The server's side, from system.stats_file and /proc
+//
+
+struct ServerStats
+{
+  bool valid;
+  int pid;
+  uint64_t users;
+  uint64_t chunks;
+  // Largest per-connection output queue, moves skipped and connections dropped by backpressure
+  uint64_t outputMax;
+  uint64_t outputDropped;
+  uint64_t outputOverflows;
+  // Tick time step start in us -> ticks
+  std::map<uint64_t, uint64_t> ticks;
+  double cpuSeconds;
+  uint64_t rssKiB;
+  uint64_t peakRssKiB;
+
+  ServerStats() : valid(false), pid(0), users(0), chunks(0), outputMax(0), outputDropped(0), outputOverflows(0),
+                  cpuSeconds(0), rssKiB(0), peakRssKiB(0) {}
+};
+
+static ServerStats readServerStats(const std::string& file)
+{
+  ServerStats stats;
+  std::ifstream in(file.c_str());
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string name;
+    fields >> name;
+    if (name == "pid")
+    {
+      fields >> stats.pid;
+    }
+    else if (name == "users")
+    {
+      fields >> stats.users;
+    }
+    else if (name == "chunks")
+    {
+      fields >> stats.chunks;
+    }
+    else if (name == "output_queued_max")
+    {
+      fields >> stats.outputMax;
+    }
+    else if (name == "output_dropped")
+    {
+      fields >> stats.outputDropped;
+    }
+    else if (name == "output_overflows")
+    {
+      fields >> stats.outputOverflows;
+    }
+    else if (name == "tick")
+    {
+      uint64_t step, count;
+      fields >> step >> count;
+      stats.ticks[step] = count;
+    }
+  }
+  if (stats.pid == 0)
+  {
+    return stats;
+  }
+  stats.valid = true;
+
+  char path[64];
+  sprintf(path, "/proc/%d/stat", stats.pid);
+  std::ifstream stat(path);
+  std::getline(stat, line);
+  // Fields after the command name, which may have spaces: utime and stime are 14 and 15
+  const size_t paren = line.rfind(')');
+  if (paren != std::string::npos)
+  {
+    std::istringstream fields(line.substr(paren + 2));
+    std::string skip;
+    for (int i = 3; i < 14; i++)
+    {
+      fields >> skip;
+    }
+    uint64_t utime = 0, stime = 0;
+    fields >> utime >> stime;
+    stats.cpuSeconds = double(utime + stime) / sysconf(_SC_CLK_TCK);
+  }
+
+  sprintf(path, "/proc/%d/status", stats.pid);
+  std::ifstream status(path);
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+    {
+      stats.rssKiB = strtoull(line.c_str() + 6, NULL, 10);
+    }
+    else if (line.compare(0, 6, "VmHWM:") == 0)
+    {
+      stats.peakRssKiB = strtoull(line.c_str() + 6, NULL, 10);
+    }
+  }
+  return stats;
+}
+
+// Tick time percentile over the ticks in after but not in before
+static double tickPercentile(const ServerStats& before, const ServerStats& after, double p)
+{
+  std::vector<std::pair<uint64_t, uint64_t> > diff;
+  uint64_t total = 0;
+  for (std::map<uint64_t, uint64_t>::const_iterator it = after.ticks.begin(); it != after.ticks.end(); ++it)
+  {
+    const std::map<uint64_t, uint64_t>::const_iterator old = before.ticks.find(it->first);
+    const uint64_t count = it->second - (old != before.ticks.end() ? old->second : 0);
+    if (count != 0)
+    {
+      diff.push_back(std::make_pair(it->first, count));
+      total += count;
+    }
+  }
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < diff.size(); i++)
+  {
+    seen += diff[i].second;
+    if (seen >= total * p)
+    {
+      return diff[i].first / 1000.0;
+    }
+  }
+  return diff.empty() ? 0 : diff.back().first / 1000.0;
+}
+
+static double percentile(std::vector<uint64_t> values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, size_t(values.size() * p))] / 1000.0;
+}
+
+static void usage(const char* name)
+{
+  printf("Usage: %s [-h host] [-p port] [-n bots] [-r bots connecting per second]\n"
+         "       [-t seconds after the last connect] [-s server stats file] [-S seed]\n"
+         "       [-m positions per second] [-w walk radius] [-d seconds between digs]\n"
+         "       [-c seconds between chats] [-v view distance 0-3, far to tiny]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:n:r:t:s:S:m:w:d:c:v:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'h': options.host = optarg;                   break;
+    case 'p': options.port = atoi(optarg);             break;
+    case 'n': options.bots = atoi(optarg);             break;
+    case 'r': options.connectRate = atof(optarg);      break;
+    case 't': options.seconds = atoi(optarg);          break;
+    case 's': options.statsFile = optarg;              break;
+    case 'S': options.seed = strtoul(optarg, NULL, 10); break;
+    case 'm': options.moveRate = atof(optarg);         break;
+    case 'w': options.walkRadius = atof(optarg);       break;
+    case 'd': options.digEvery = atoi(optarg);         break;
+    case 'c': options.chatEvery = atoi(optarg);        break;
+    case 'v': options.viewDistance = atoi(optarg) & 3; break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (options.bots <= 0 || options.connectRate <= 0 || options.moveRate <= 0 || options.seconds < 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* resolved = NULL;
+  if (getaddrinfo(options.host.c_str(), NULL, &hints, &resolved) != 0 || resolved == NULL)
+  {
+    printf("cannot resolve %s\n", options.host.c_str());
+    return 1;
+  }
+  sockaddr_in addr = *(sockaddr_in*)resolved->ai_addr;
+  addr.sin_port = htons(options.port);
+  freeaddrinfo(resolved);
+
+  initServerPackets();
+
+  ServerStats serverBefore;
+  if (!options.statsFile.empty())
+  {
+    serverBefore = readServerStats(options.statsFile);
+    if (!serverBefore.valid)
+    {
+      printf("cannot read %s, is system.stats_file set?\n", options.statsFile.c_str());
+      return 1;
+    }
+  }
+
+  printf("%d bots against %s:%d, %.0f connecting per second, seed %u\n",
+         options.bots, options.host.c_str(), options.port, options.connectRate, options.seed);
+
+  std::vector<Bot*> bots;
+  std::vector<pollfd> fds;
+  std::vector<Bot*> polled;
+
+  const uint64_t start = nowUs();
+  uint64_t end = 0;
+  uint64_t nextReport = start + 5000000;
+  uint64_t lastChunks = 0, lastReport = start;
+
+  for (;;)
+  {
+    uint64_t now = nowUs();
+
+    // Ramp up at the connect rate
+    while (int(bots.size()) < options.bots &&
+           now - start >= uint64_t(bots.size() * 1e6 / options.connectRate))
+    {
+      Bot* bot = new Bot(int(bots.size()));
+      bots.push_back(bot);
+      bot->connect(addr);
+    }
+    if (end == 0 && int(bots.size()) == options.bots)
+    {
+      end = now + uint64_t(options.seconds) * 1000000;
+    }
+    if (end != 0 && now >= end)
+    {
+      break;
+    }
+
+    fds.clear();
+    polled.clear();
+    for (size_t i = 0; i < bots.size(); i++)
+    {
+      if (bots[i]->status() != Bot::CLOSED)
+      {
+        pollfd pfd;
+        pfd.fd = bots[i]->socket();
+        pfd.events = bots[i]->events();
+        pfd.revents = 0;
+        fds.push_back(pfd);
+        polled.push_back(bots[i]);
+      }
+    }
+
+    if (!fds.empty())
+    {
+      poll(&fds[0], fds.size(), 5);
+    }
+    else
+    {
+      usleep(5000);
+    }
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+      if (fds[i].revents != 0)
+      {
+        polled[i]->ready(fds[i].revents);
+      }
+    }
+
+    now = nowUs();
+    for (size_t i = 0; i < bots.size(); i++)
+    {
+      bots[i]->update(now);
+    }
+
+    if (now >= nextReport)
+    {
+      size_t playing = 0;
+      for (size_t i = 0; i < bots.size(); i++)
+      {
+        playing += bots[i]->status() == Bot::PLAYING;
+      }
+      printf("%5.0fs: %d/%d bots playing, %lu failed, %.1f chunks/s\n",
+             (now - start) / 1e6, int(playing), options.bots, (unsigned long)totals.failed,
+             (totals.chunks - lastChunks) * 1e6 / (now - lastReport));
+      fflush(stdout);
+      lastChunks = totals.chunks;
+      lastReport = now;
+      nextReport += 5000000;
+    }
+  }
+
+  const double elapsed = (nowUs() - start) / 1e6;
+  const uint64_t players = std::max<uint64_t>(totals.logged, 1);
+
+  printf("\n%.1f s, %lu connected, %lu logged in, %lu failed (%lu kicked)\n", elapsed,
+         (unsigned long)totals.connected, (unsigned long)totals.logged,
+         (unsigned long)totals.failed, (unsigned long)totals.kicked);
+  for (std::map<std::string, int>::const_iterator it = totals.reasons.begin(); it != totals.reasons.end(); ++it)
+  {
+    printf("  %5d %s\n", it->second, it->first.c_str());
+  }
+  printf("login latency: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+         percentile(totals.loginUs, 0.5), percentile(totals.loginUs, 0.9),
+         percentile(totals.loginUs, 0.99), percentile(totals.loginUs, 1.0));
+  printf("chunks: %lu, %.1f/s, %.1f KiB each\n", (unsigned long)totals.chunks,
+         totals.chunks / elapsed, totals.chunkBytes / 1024.0 / std::max<uint64_t>(totals.chunks, 1));
+  printf("per player: %.1f KiB/s received (%.1f KiB in all), %.1f KiB/s sent\n",
+         totals.received / 1024.0 / elapsed / players, totals.received / 1024.0 / players,
+         totals.sent / 1024.0 / elapsed / players);
+  printf("sent: %lu positions, %lu digs, %lu placements, %lu chat messages\n",
+         (unsigned long)totals.positions, (unsigned long)totals.digs,
+         (unsigned long)totals.places, (unsigned long)totals.chats);
+
+  if (serverBefore.valid)
+  {
+    // The server rewrites the file every second
+    sleep(1);
+    const ServerStats serverAfter = readServerStats(options.statsFile);
+    printf("server: tick p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           tickPercentile(serverBefore, serverAfter, 0.5), tickPercentile(serverBefore, serverAfter, 0.9),
+           tickPercentile(serverBefore, serverAfter, 0.99), tickPercentile(serverBefore, serverAfter, 1.0));
+    printf("server: %.1f%% CPU, RSS %.1f MiB (peak %.1f MiB), %lu users, %lu chunks loaded\n",
+           (serverAfter.cpuSeconds - serverBefore.cpuSeconds) * 100 / (elapsed + 1),
+           serverAfter.rssKiB / 1024.0, serverAfter.peakRssKiB / 1024.0,
+           (unsigned long)serverAfter.users, (unsigned long)serverAfter.chunks);
+    printf("server: largest output queue %.1f KiB, %lu moves skipped, %lu slow clients dropped\n",
+           serverAfter.outputMax / 1024.0,
+           (unsigned long)(serverAfter.outputDropped - serverBefore.outputDropped),
+           (unsigned long)(serverAfter.outputOverflows - serverBefore.outputOverflows));
+  }
+
+  for (size_t i = 0; i < bots.size(); i++)
+  {
+    delete bots[i];
+  }
+  return totals.logged == uint64_t(options.bots) ? 0 : 1;
+}
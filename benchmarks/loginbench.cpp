@@ -0,0 +1,286 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver loginbench.cpp
+//
+// Pushes a crowd of logins through the expensive parts of a login: the RSA
+// handshake, reading the player file and deflating the first five chunks.
+// Once all on one thread, the way the main loop used to do it, and once
+// through the LoginPipeline, with the main thread only doing its share
+// (copying the chunks out of the map) between polls. Reports logins per
+// second and the main thread's CPU time per login.
+//
+// Player files and chunks are made up, player files go to loginbench.tmp/.
+//
+// Usage: loginbench [logins] [workers]
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/rsa.h>
+
+#include "loginpipeline.h"
+#include "nbt.h"
+#include "tools.h"
+
+static const int LOGIN_CHUNKS = 5;
+static const size_t CHUNK_DATA_SIZE = 98304 * 2 + 256;
+
+struct Login
+{
+  std::string secret;  // encrypted, as the client sends them
+  std::string verify;
+  std::string file;
+};
+
+static uint64_t nowUs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint64_t threadUs()
+{
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+static std::string encrypt(RSA* rsa, const std::string& data)
+{
+  std::vector<uint8_t> out(RSA_size(rsa));
+  const int len = RSA_public_encrypt(int(data.size()), (const uint8_t*)data.data(), &out[0], rsa, RSA_PKCS1_PADDING);
+  return std::string((char*)&out[0], len > 0 ? len : 0);
+}
+
+// A player file like User::saveData() writes, with a full inventory
+static void writePlayer(const std::string& file, int n)
+{
+  NBT_Value val(NBT_Value::TAG_COMPOUND);
+  val.Insert("Health", new NBT_Value((int16_t)20));
+
+  NBT_Value* nbtInv = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_COMPOUND);
+  for (int slot = 0; slot < 36; slot++)
+  {
+    NBT_Value* item = new NBT_Value(NBT_Value::TAG_COMPOUND);
+    item->Insert("Count", new NBT_Value((int8_t)(1 + (n + slot) % 64)));
+    item->Insert("Slot", new NBT_Value((int8_t)slot));
+    item->Insert("Damage", new NBT_Value((int16_t)0));
+    item->Insert("id", new NBT_Value((int16_t)(1 + slot)));
+    nbtInv->GetList()->push_back(item);
+  }
+  val.Insert("Inventory", nbtInv);
+
+  NBT_Value* nbtPos = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_DOUBLE);
+  nbtPos->GetList()->push_back(new NBT_Value((double)n));
+  nbtPos->GetList()->push_back(new NBT_Value((double)64));
+  nbtPos->GetList()->push_back(new NBT_Value((double)-n));
+  val.Insert("Pos", nbtPos);
+
+  NBT_Value* nbtRot = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_FLOAT);
+  nbtRot->GetList()->push_back(new NBT_Value((float)0));
+  nbtRot->GetList()->push_back(new NBT_Value((float)0));
+  val.Insert("Rotation", nbtRot);
+
+  val.SaveToFile(file);
+}
+
+// Stone below 60, air above, ores and light thrown in so it deflates like terrain
+static void makeChunk(std::vector<uint8_t>& raw, int n)
+{
+  raw.assign(CHUNK_DATA_SIZE, 0);
+  srand(n);
+  for (int x = 0; x < 16; x++)
+  {
+    for (int z = 0; z < 16; z++)
+    {
+      for (int y = 0; y < 60; y++)
+      {
+        raw[y * 256 + z * 16 + x] = (rand() % 20 == 0) ? uint8_t(14 + rand() % 3) : 1;
+      }
+    }
+  }
+  // Sky light over the air
+  memset(&raw[(32768 + 16384 + 16384) * 2 + 60 * 128], 0xff, (256 - 60) * 128);
+}
+
+// The main thread's share per login, Map::copyChunk()
+static void copyChunks(const std::vector<std::vector<uint8_t> >& chunks, std::vector<LoginPipeline::Chunk>& copies)
+{
+  copies.resize(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    copies[i].x = int32_t(i);
+    copies[i].z = 0;
+    copies[i].data = chunks[i];
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const int count = argc > 1 ? atoi(argv[1]) : 500;
+  const int workers = argc > 2 ? atoi(argv[2]) : 4;
+  if (count <= 0 || workers <= 0)
+  {
+    printf("Usage: %s [logins] [workers]\n", argv[0]);
+    return 1;
+  }
+
+  printf("Generating the key and %d logins\n", count);
+  RSA* rsa = RSA_generate_key(1024, 17, 0, 0);
+  const std::string token = "t0kn";
+
+  mkdir("loginbench.tmp", 0755);
+  std::vector<Login> logins(count);
+  for (int i = 0; i < count; i++)
+  {
+    char name[64];
+    sprintf(name, "loginbench.tmp/player%d.dat", i);
+    logins[i].file   = name;
+    logins[i].verify = encrypt(rsa, token);
+    logins[i].secret = encrypt(rsa, std::string("0123456789abcdef"));
+    writePlayer(logins[i].file, i);
+  }
+
+  std::vector<std::vector<uint8_t> > chunks(LOGIN_CHUNKS);
+  for (int i = 0; i < LOGIN_CHUNKS; i++)
+  {
+    makeChunk(chunks[i], i);
+  }
+
+  // All of it on the main thread
+  {
+    const uint64_t start = nowUs();
+    const uint64_t cpuStart = threadUs();
+    size_t compressed = 0;
+    int ok = 0;
+    for (int i = 0; i < count; i++)
+    {
+      std::string secret;
+      LoginPipeline::PlayerData player;
+      std::vector<LoginPipeline::Chunk> copies;
+      if (!LoginPipeline::decrypt(rsa, token, logins[i].secret, logins[i].verify, secret) ||
+          !LoginPipeline::readPlayerData(logins[i].file, player))
+      {
+        continue;
+      }
+      copyChunks(chunks, copies);
+      for (size_t c = 0; c < copies.size(); c++)
+      {
+        LoginPipeline::compressChunk(copies[c]);
+        compressed += copies[c].data.size();
+      }
+      ok++;
+    }
+    const uint64_t usec = std::max<uint64_t>(nowUs() - start, 1);
+    const uint64_t cpu = threadUs() - cpuStart;
+    printf("main thread: %d logins in %.1f ms, %.1f logins/s, main thread %.3f ms/login (%.1f KiB of chunks each)\n",
+           ok, usec / 1000.0, ok * 1e6 / usec, cpu / 1000.0 / count, compressed / 1024.0 / std::max(ok, 1));
+  }
+
+  // Through the pipeline
+  {
+    LoginPipeline pipeline(rsa, token, workers, count);
+    pipeline.start();
+
+    const uint64_t start = nowUs();
+    const uint64_t cpuStart = threadUs();
+    uint64_t longestPoll = 0;
+    int done = 0, failed = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+      pipeline.submitHandshake(i, logins[i].secret, logins[i].verify);
+    }
+
+    std::vector<LoginPipeline::Result> results;
+    while (done + failed < count)
+    {
+      const uint64_t pollStart = threadUs();
+      results.clear();
+      pipeline.poll(results);
+      for (size_t i = 0; i < results.size(); i++)
+      {
+        LoginPipeline::Result& result = results[i];
+        if (!result.ok)
+        {
+          failed++;
+          continue;
+        }
+        switch (result.stage)
+        {
+        case LoginPipeline::HANDSHAKE:
+          pipeline.submitPlayerData(result.UID, logins[result.UID].file);
+          break;
+        case LoginPipeline::PLAYER_DATA:
+        {
+          std::vector<LoginPipeline::Chunk> copies;
+          copyChunks(chunks, copies);
+          pipeline.submitChunks(result.UID, copies);
+          break;
+        }
+        case LoginPipeline::CHUNKS:
+          pipeline.loggedIn();
+          done++;
+          break;
+        }
+      }
+      longestPoll = std::max(longestPoll, threadUs() - pollStart);
+      // A tick is 200 ms on the server, poll more often to measure the pipeline itself
+      usleep(1000);
+    }
+
+    const uint64_t usec = std::max<uint64_t>(nowUs() - start, 1);
+    const uint64_t cpu = threadUs() - cpuStart;
+    const LoginPipeline::Stats stats = pipeline.stats();
+    printf("pipeline, %d workers: %d logins in %.1f ms, %.1f logins/s, main thread %.3f ms/login, longest poll %.1f ms CPU\n",
+           workers, done, usec / 1000.0, done * 1e6 / usec, cpu / 1000.0 / count, longestPoll / 1000.0);
+    printf("  handshakes %llu (%llu bad), player files %llu, chunks %llu, failed %d\n",
+           (unsigned long long)stats.handshakes, (unsigned long long)stats.badHandshakes,
+           (unsigned long long)stats.playerFiles, (unsigned long long)stats.chunks, failed);
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    unlink(logins[i].file.c_str());
+  }
+  rmdir("loginbench.tmp");
+  RSA_free(rsa);
+
+  return 0;
+}
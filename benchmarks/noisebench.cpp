@@ -0,0 +1,166 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Measures how long the cave pass takes per chunk with the noise evaluated
+// per block (the reference) against sampling it on the NoiseGrid lattice and
+// interpolating, and checks the interpolated caves stay within tolerance of
+// the reference.
+//
+// Usage: noisebench [chunks per side] [seed] [max mismatch %]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+#ifdef LIBNOISE
+#include <libnoise/noise.h>
+#else
+#include <noise/noise.h>
+#endif
+
+#include "worldgen/noisegrid.h"
+
+// Same setup as CaveGen with the default config
+static const int    caveSize     = 15;
+static const double caveTreshold = 0.05;
+static const int    caveHeight   = 128;
+
+static double msPerChunk(clock_t start, clock_t end, int chunks)
+{
+  return (double(end - start) / CLOCKS_PER_SEC) * 1e3 / chunks;
+}
+
+int main(int argc, const char* argv[])
+{
+  const int    side        = argc > 1 ? atoi(argv[1]) : 8;
+  const int    seed        = argc > 2 ? atoi(argv[2]) : 1234;
+  const double maxMismatch = argc > 3 ? atof(argv[3]) : 5.0;
+
+  if (side <= 0)
+  {
+    printf("Usage: %s [chunks per side] [seed] [max mismatch %%]\n", argv[0]);
+    return 1;
+  }
+
+  noise::module::RidgedMulti caveNoise;
+  caveNoise.SetSeed(seed + 22);
+  caveNoise.SetFrequency(1.0 / caveSize);
+  caveNoise.SetOctaveCount(4);
+
+  const int chunks = side * side;
+  const int blocksPerChunk = 16 * 16 * caveHeight;
+  std::vector<double> reference(size_t(chunks) * blocksPerChunk);
+  std::vector<double> interpolated(reference.size());
+
+  printf("%d chunks, seed %d\n", chunks, seed);
+
+  clock_t start = clock();
+  double* out = &reference[0];
+  for (int cx = 0; cx < side; cx++)
+  {
+    for (int cz = 0; cz < side; cz++)
+    {
+      for (int x = 0; x < 16; x++)
+      {
+        for (int z = 0; z < 16; z++)
+        {
+          for (int y = 0; y < caveHeight; y++)
+          {
+            *out++ = caveNoise.GetValue(((cx << 4) + x) / 4.0, y / 1.5, ((cz << 4) + z) / 4.0);
+          }
+        }
+      }
+    }
+  }
+  clock_t end = clock();
+  const double exact = msPerChunk(start, end, chunks);
+  printf("per block noise:      %8.3f ms/chunk\n", exact);
+
+  NoiseGrid grid;
+  start = clock();
+  out = &interpolated[0];
+  for (int cx = 0; cx < side; cx++)
+  {
+    for (int cz = 0; cz < side; cz++)
+    {
+      grid.fill(caveNoise, cx << 4, cz << 4, caveHeight - 1, 4.0, 1.5, 4.0, 4, 2);
+      for (int x = 0; x < 16; x++)
+      {
+        for (int z = 0; z < 16; z++)
+        {
+          for (int y = 0; y < caveHeight; y++)
+          {
+            *out++ = grid.value(x, y, z);
+          }
+        }
+      }
+    }
+  }
+  end = clock();
+  const double lattice = msPerChunk(start, end, chunks);
+  printf("lattice + trilinear:  %8.3f ms/chunk (%d samples/chunk)\n", lattice, grid.samples());
+
+  if (lattice > 0)
+  {
+    printf("speedup: %.2fx\n", exact / lattice);
+  }
+
+  // Compare against the reference, both the raw noise and what ends up carved
+  double maxError = 0;
+  double sumError = 0;
+  long mismatches = 0;
+  long caveBlocks = 0;
+  for (size_t i = 0; i < reference.size(); i++)
+  {
+    const double error = fabs(reference[i] - interpolated[i]);
+    sumError += error;
+    if (error > maxError)
+    {
+      maxError = error;
+    }
+    const bool isCave = reference[i] > caveTreshold;
+    caveBlocks += isCave;
+    mismatches += (isCave != (interpolated[i] > caveTreshold));
+  }
+
+  const double mismatchPct = 100.0 * mismatches / reference.size();
+  printf("noise error: max %.4f, mean %.4f\n", maxError, sumError / reference.size());
+  printf("cave blocks: %ld reference, %ld differ (%.2f%% of all blocks, limit %.2f%%)\n",
+         caveBlocks, mismatches, mismatchPct, maxMismatch);
+
+  if (mismatchPct > maxMismatch)
+  {
+    printf("FAILED: interpolated caves are outside tolerance\n");
+    return 1;
+  }
+
+  return 0;
+}
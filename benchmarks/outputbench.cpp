@@ -0,0 +1,207 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver outputbench.cpp
+//
+// Measures bytes per CPU second through the encrypt and send path. The old
+// path copied the serialized deque into a vector, encrypted into a malloc'd
+// buffer, appended that to a second deque and copied it out again to send().
+// The OutputQueue encrypts straight into pooled blocks and sends them with
+// writev(). Both write to a socket pair drained by a reader thread.
+//
+// Usage: outputbench [megabytes] [packet size]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <openssl/evp.h>
+
+#include "outputqueue.h"
+
+static void* drain(void* arg)
+{
+  const int fd = *static_cast<int*>(arg);
+  char buf[65536];
+  while (read(fd, buf, sizeof(buf)) > 0)
+  {
+  }
+  return NULL;
+}
+
+static void initCipher(EVP_CIPHER_CTX* ctx)
+{
+  unsigned char key[16], iv[16];
+  for (int i = 0; i < 16; i++)
+  {
+    key[i] = uint8_t(i * 7 + 1);
+    iv[i]  = uint8_t(i * 13 + 5);
+  }
+  EVP_EncryptInit_ex(ctx, EVP_aes_128_cfb8(), NULL, key, iv);
+}
+
+// CPU time of the sending thread only, the reader has its own core
+static double threadSeconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double mbPerCpuSecond(double start, double end, uint64_t bytes)
+{
+  const double seconds = end - start;
+  return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+}
+
+// Each flush takes a tick's worth of packets
+static const int PACKETS_PER_FLUSH = 32;
+
+static double runOld(int fd, EVP_CIPHER_CTX* cipher, const std::vector<uint8_t>& packet, uint64_t total)
+{
+  std::deque<uint8_t> buffer, bufferCrypted;
+  uint64_t done = 0;
+
+  const double start = threadSeconds();
+  while (done < total)
+  {
+    for (int i = 0; i < PACKETS_PER_FLUSH; i++)
+    {
+      buffer.insert(buffer.end(), packet.begin(), packet.end());
+    }
+    done += packet.size() * PACKETS_PER_FLUSH;
+
+    std::vector<char> buf(buffer.begin(), buffer.end());
+    int len = int(buf.size());
+    uint8_t* out = (uint8_t*)malloc(len + 1);
+    EVP_EncryptUpdate(cipher, out, &len, (const uint8_t*)&buf[0], int(buf.size()));
+    bufferCrypted.insert(bufferCrypted.end(), out, out + len);
+    free(out);
+    buffer.clear();
+
+    while (!bufferCrypted.empty())
+    {
+      std::vector<char> send(bufferCrypted.begin(), bufferCrypted.end());
+      const ssize_t written = write(fd, &send[0], send.size());
+      if (written > 0)
+      {
+        bufferCrypted.erase(bufferCrypted.begin(), bufferCrypted.begin() + written);
+      }
+    }
+  }
+  return mbPerCpuSecond(start, threadSeconds(), done);
+}
+
+static double runQueue(int fd, EVP_CIPHER_CTX* cipher, const std::vector<uint8_t>& packet, uint64_t total)
+{
+  std::vector<uint8_t> buffer;
+  OutputQueue output;
+  uint64_t done = 0;
+
+  const double start = threadSeconds();
+  while (done < total)
+  {
+    for (int i = 0; i < PACKETS_PER_FLUSH; i++)
+    {
+      buffer.insert(buffer.end(), packet.begin(), packet.end());
+    }
+    done += packet.size() * PACKETS_PER_FLUSH;
+
+    output.append(&buffer[0], buffer.size(), cipher);
+    buffer.clear();
+
+    while (!output.empty())
+    {
+      output.flush(fd);
+    }
+  }
+  return mbPerCpuSecond(start, threadSeconds(), done);
+}
+
+int main(int argc, const char* argv[])
+{
+  const long megabytes  = argc > 1 ? atol(argv[1]) : 256;
+  const int  packetSize = argc > 2 ? atoi(argv[2]) : 512;
+
+  if (megabytes <= 0 || packetSize <= 0)
+  {
+    printf("Usage: %s [megabytes] [packet size]\n", argv[0]);
+    return 1;
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+  {
+    perror("socketpair");
+    return 1;
+  }
+  pthread_t reader;
+  pthread_create(&reader, NULL, drain, &fds[1]);
+
+  std::vector<uint8_t> packet(packetSize);
+  for (int i = 0; i < packetSize; i++)
+  {
+    packet[i] = uint8_t(i * 31);
+  }
+
+  const uint64_t total = uint64_t(megabytes) * 1024 * 1024;
+  EVP_CIPHER_CTX* cipher = EVP_CIPHER_CTX_new();
+
+  printf("%ld MB in %d byte packets, %d packets per flush\n", megabytes, packetSize, PACKETS_PER_FLUSH);
+
+  initCipher(cipher);
+  const double oldPath = runOld(fds[0], cipher, packet, total);
+  printf("deque + malloc + send: %8.1f MB/s per core\n", oldPath);
+
+  initCipher(cipher);
+  const double queue = runQueue(fds[0], cipher, packet, total);
+  printf("OutputQueue + writev:  %8.1f MB/s per core\n", queue);
+  printf("  %llu writes, %llu blocks allocated\n",
+         (unsigned long long)OutputQueue::stats.writes, (unsigned long long)OutputQueue::stats.blocks);
+
+  if (oldPath > 0)
+  {
+    printf("speedup: %.2fx\n", queue / oldPath);
+  }
+
+  close(fds[0]);
+  pthread_join(reader, NULL);
+  close(fds[1]);
+  EVP_CIPHER_CTX_free(cipher);
+
+  return 0;
+}
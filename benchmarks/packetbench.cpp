@@ -0,0 +1,332 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver packetbench.cpp
+//
+// Measures decode throughput per client packet type, reading fields byte by
+// byte out of a std::deque the way Packet used to against framing the packet
+// with its PacketLayout and decoding it from contiguous memory with a Span.
+//
+// Usage: packetbench [packets per type]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include "packetlayout.h"
+
+using namespace PacketLayout;
+
+static volatile int64_t sink = 0;
+
+// Big-endian encoder for the sample packets
+class Writer
+{
+public:
+  std::vector<uint8_t> data;
+
+  Writer& operator<<(int8_t val)  { data.push_back(uint8_t(val)); return *this; }
+  Writer& operator<<(int16_t val) { return put(uint16_t(val), 2); }
+  Writer& operator<<(int32_t val) { return put(uint32_t(val), 4); }
+  Writer& operator<<(int64_t val) { return put(uint64_t(val), 8); }
+  Writer& operator<<(float val)   { uint32_t i; memcpy(&i, &val, 4); return put(i, 4); }
+  Writer& operator<<(double val)  { uint64_t i; memcpy(&i, &val, 8); return put(i, 8); }
+
+  Writer& operator<<(const char* str)
+  {
+    const int16_t len = int16_t(strlen(str));
+    *this << len;
+    for (int16_t i = 0; i < len; i++)
+    {
+      *this << int16_t(str[i]);
+    }
+    return *this;
+  }
+
+private:
+  Writer& put(uint64_t val, int bytes)
+  {
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+      data.push_back(uint8_t(val >> (8 * i)));
+    }
+    return *this;
+  }
+};
+
+// What Packet::operator>> used to do: a bounds check and a copy per byte
+class DequeReader
+{
+public:
+  DequeReader(const std::deque<uint8_t>& data) : m_data(data), m_pos(0), m_valid(true) {}
+
+  bool have(size_t count) { return m_valid = m_valid && m_pos + count <= m_data.size(); }
+  operator bool() const { return m_valid; }
+
+  DequeReader& skip(size_t count)
+  {
+    if (have(count))
+    {
+      m_pos += count;
+    }
+    return *this;
+  }
+
+  DequeReader& operator>>(int8_t& val)  { val = have(1) ? int8_t(m_data[m_pos++]) : 0; return *this; }
+  DequeReader& operator>>(int16_t& val) { val = int16_t(get(2)); return *this; }
+  DequeReader& operator>>(int32_t& val) { val = int32_t(get(4)); return *this; }
+  DequeReader& operator>>(int64_t& val) { val = int64_t(get(8)); return *this; }
+  DequeReader& operator>>(float& val)   { uint32_t i = uint32_t(get(4)); memcpy(&val, &i, 4); return *this; }
+  DequeReader& operator>>(double& val)  { uint64_t i = get(8); memcpy(&val, &i, 8); return *this; }
+
+private:
+  uint64_t get(int bytes)
+  {
+    uint64_t val = 0;
+    if (have(bytes))
+    {
+      for (int i = 0; i < bytes; i++)
+      {
+        val = (val << 8) | m_data[m_pos++];
+      }
+    }
+    return val;
+  }
+
+  const std::deque<uint8_t>& m_data;
+  size_t m_pos;
+  bool m_valid;
+};
+
+// Field by field decoders, shared by both readers
+
+template <class R> static void skipString(R& r)
+{
+  int16_t len;
+  r >> len;
+  r.skip(len > 0 ? len * 2 : 0);
+}
+
+template <class R> static void skipSlot(R& r)
+{
+  int16_t id, damage, nbtLen;
+  int8_t count;
+  r >> id;
+  if (id != -1)
+  {
+    r >> count >> damage >> nbtLen;
+    r.skip(nbtLen > 0 ? nbtLen : 0);
+  }
+  sink += id;
+}
+
+template <class R> static void decodeChat(R& r)
+{
+  skipString(r);
+}
+
+template <class R> static void decodePosition(R& r)
+{
+  double x, y, stance, z;
+  int8_t onGround;
+  r >> x >> y >> stance >> z >> onGround;
+  sink += int64_t(x + y + stance + z) + onGround;
+}
+
+template <class R> static void decodePositionAndLook(R& r)
+{
+  double x, y, stance, z;
+  float yaw, pitch;
+  int8_t onGround;
+  r >> x >> y >> stance >> z >> yaw >> pitch >> onGround;
+  sink += int64_t(x + y + stance + z + yaw + pitch) + onGround;
+}
+
+template <class R> static void decodeDigging(R& r)
+{
+  int8_t status, y, face;
+  int32_t x, z;
+  r >> status >> x >> y >> z >> face;
+  sink += status + x + y + z + face;
+}
+
+template <class R> static void decodeBlockPlacement(R& r)
+{
+  int32_t x, z;
+  int8_t y, direction, cx, cy, cz;
+  r >> x >> y >> z >> direction;
+  skipSlot(r);
+  r >> cx >> cy >> cz;
+  sink += x + y + z + direction + cx + cy + cz;
+}
+
+template <class R> static void decodeInventoryChange(R& r)
+{
+  int8_t window, rightClick, shift;
+  int16_t slot, action;
+  r >> window >> slot >> rightClick >> action >> shift;
+  skipSlot(r);
+  sink += window + slot + rightClick + action + shift;
+}
+
+template <class R> static void decodeSign(R& r)
+{
+  int32_t x, z;
+  int16_t y;
+  r >> x >> y >> z;
+  for (int i = 0; i < 4; i++)
+  {
+    skipString(r);
+  }
+  sink += x + y + z;
+}
+
+template <class R> static void decodeHandshake(R& r)
+{
+  int8_t version;
+  int32_t port;
+  r >> version;
+  skipString(r);
+  skipString(r);
+  r >> port;
+  sink += version + port;
+}
+
+struct Sample
+{
+  const char* name;
+  uint8_t id;
+  std::vector<uint8_t> body;
+  int (*frame)(const uint8_t*, size_t);
+  void (*decodeSpan)(Span&);
+  void (*decodeDeque)(DequeReader&);
+};
+
+#define SAMPLE(name, id, writer, layout, decoder) \
+  { Sample s = { name, id, writer.data, &layout::frame, &decoder<Span>, &decoder<DequeReader> }; samples.push_back(s); }
+
+static double nsPerPacket(clock_t start, clock_t end, long packets)
+{
+  return (double(end - start) / CLOCKS_PER_SEC) * 1e9 / packets;
+}
+
+int main(int argc, const char* argv[])
+{
+  const long count = argc > 1 ? atol(argv[1]) : 1000000;
+
+  if (count <= 0)
+  {
+    printf("Usage: %s [packets per type]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<Sample> samples;
+  Writer chat, position, posLook, digging, placement, window, sign, handshake;
+
+  chat << "The quick brown fox jumps over the lazy dog";
+  position << 128.5 << 65.0 << 66.62 << -311.25 << int8_t(1);
+  posLook << 128.5 << 65.0 << 66.62 << -311.25 << 90.0f << 12.5f << int8_t(1);
+  digging << int8_t(0) << int32_t(128) << int8_t(64) << int32_t(-312) << int8_t(1);
+  placement << int32_t(128) << int8_t(64) << int32_t(-312) << int8_t(1)
+            << int16_t(4) << int8_t(64) << int16_t(0) << int16_t(-1)
+            << int8_t(8) << int8_t(16) << int8_t(8);
+  window << int8_t(0) << int16_t(36) << int8_t(0) << int16_t(12) << int8_t(0)
+         << int16_t(276) << int8_t(1) << int16_t(3) << int16_t(6) << int32_t(0) << int16_t(0);
+  sign << int32_t(128) << int16_t(64) << int32_t(-312) << "Welcome to" << "the server" << "" << "have fun";
+  handshake << int8_t(39) << "Player" << "localhost" << int32_t(25565);
+
+  SAMPLE("chat",           0x03, chat,      ChatMessage,           decodeChat);
+  SAMPLE("position",       0x0b, position,  PlayerPosition,        decodePosition);
+  SAMPLE("position+look",  0x0d, posLook,   PlayerPositionAndLook, decodePositionAndLook);
+  SAMPLE("digging",        0x0e, digging,   PlayerDigging,         decodeDigging);
+  SAMPLE("block placement",0x0f, placement, PlayerBlockPlacement,  decodeBlockPlacement);
+  SAMPLE("window click",   0x66, window,    InventoryChange,       decodeInventoryChange);
+  SAMPLE("sign",           0x82, sign,      Sign,                  decodeSign);
+  SAMPLE("handshake",      0x02, handshake, Handshake,             decodeHandshake);
+
+  printf("%ld packets per type\n", count);
+  printf("%-16s %6s %12s %12s %8s\n", "packet", "bytes", "deque ns", "span ns", "speedup");
+
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    const Sample& sample = samples[i];
+
+    // The same stream of back to back packets for both readers
+    std::vector<uint8_t> stream;
+    stream.reserve(count * (sample.body.size() + 1));
+    for (long p = 0; p < count; p++)
+    {
+      stream.push_back(sample.id);
+      stream.insert(stream.end(), sample.body.begin(), sample.body.end());
+    }
+    const std::deque<uint8_t> queue(stream.begin(), stream.end());
+
+    clock_t start = clock();
+    DequeReader reader(queue);
+    int8_t id;
+    while (reader >> id)
+    {
+      sample.decodeDeque(reader);
+    }
+    clock_t end = clock();
+    const double deque = nsPerPacket(start, end, count);
+
+    start = clock();
+    const uint8_t* data = &stream[0];
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+      const int len = sample.frame(data + pos + 1, stream.size() - pos - 1);
+      if (len < 0)
+      {
+        printf("%s: framing failed (%d)\n", sample.name, len);
+        return 1;
+      }
+      Span span(data + pos + 1, len);
+      sample.decodeSpan(span);
+      if (!span || span.left())
+      {
+        printf("%s: layout and decoder disagree\n", sample.name);
+        return 1;
+      }
+      pos += 1 + len;
+    }
+    end = clock();
+    const double span = nsPerPacket(start, end, count);
+
+    printf("%-16s %6d %12.1f %12.1f %7.2fx\n", sample.name, int(sample.body.size() + 1),
+           deque, span, span > 0 ? deque / span : 0.0);
+  }
+
+  return 0;
+}
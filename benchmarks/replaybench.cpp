@@ -0,0 +1,477 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver replaybench.cpp
+//
+// Replays a packet capture (system.capture.file) through the server's packet
+// handlers and main loop, as fast as it goes, and reports the time per tick.
+// The same capture replayed by two builds tells whether a change made ticks
+// slower or faster.
+//
+// Time is virtual: the capture's timestamps decide which tick each packet
+// arrives before, ticks are 200ms of capture time apart, and the 1s and 10s
+// timers and the user timeouts go by the capture's clock. Packets go through
+// client_dispatch(), the framing and handlers the sockets use, and what the
+// server sends goes to /dev/null. The random number generators are seeded and
+// the login stages run in order on the main loop, so a replay does the same
+// work every time. A few things still read the wall clock (leaf decay, chat
+// flood limits, pickup delays). Pregeneration does not run, it is left out of
+// the server's tick times too.
+//
+// The worlds in the config are copied to replay-<name> first, the replay
+// plays on the copies. They should be the worlds as they were when the
+// capture started. Encryption is left off, the capture's handshakes were for
+// another key, and so is session validation.
+//
+// Usage: replaybench [-o ticks file] [-b baseline ticks file] [-S seed]
+//                    capture [config file] [+override]...
+// -o writes "<tick us> <handler us>" per tick, -b compares with such a file
+// from an earlier run.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mineserver.h"
+#include "config.h"
+#include "config/node.h"
+#include "constants.h"
+#include "logger.h"
+#include "packetcapture.h"
+#include "packets.h"
+#include "random.h"
+#include "sockets.h"
+#include "tools.h"
+#include "user.h"
+
+static const uint64_t TICK_US = 200000;
+
+struct TickTime
+{
+  uint32_t tick;      // Mineserver::tick()
+  uint32_t handlers;  // packets handled since the previous tick
+};
+
+static bool removeTree(const std::string& path)
+{
+  struct stat info;
+  if (lstat(path.c_str(), &info) != 0)
+  {
+    return errno == ENOENT;
+  }
+  if (S_ISDIR(info.st_mode))
+  {
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+    {
+      return false;
+    }
+    dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+      const std::string name = entry->d_name;
+      if (name != "." && name != "..")
+      {
+        removeTree(path + "/" + name);
+      }
+    }
+    closedir(dir);
+    return rmdir(path.c_str()) == 0;
+  }
+  return unlink(path.c_str()) == 0;
+}
+
+static bool copyTree(const std::string& from, const std::string& to)
+{
+  struct stat info;
+  if (stat(from.c_str(), &info) != 0)
+  {
+    return false;
+  }
+
+  if (S_ISDIR(info.st_mode))
+  {
+    if (mkdir(to.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+      return false;
+    }
+    DIR* dir = opendir(from.c_str());
+    if (dir == NULL)
+    {
+      return false;
+    }
+    bool ok = true;
+    dirent* entry;
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+      const std::string name = entry->d_name;
+      if (name != "." && name != "..")
+      {
+        ok = copyTree(from + "/" + name, to + "/" + name);
+      }
+    }
+    closedir(dir);
+    return ok;
+  }
+
+  FILE* in = fopen(from.c_str(), "rb");
+  FILE* out = in != NULL ? fopen(to.c_str(), "wb") : NULL;
+  bool ok = out != NULL;
+  char buffer[65536];
+  size_t len;
+  while (ok && (len = fread(buffer, 1, sizeof(buffer), in)) > 0)
+  {
+    ok = fwrite(buffer, 1, len, out) == len;
+  }
+  if (in != NULL)
+  {
+    fclose(in);
+  }
+  if (out != NULL)
+  {
+    ok = fclose(out) == 0 && ok;
+  }
+  return ok;
+}
+
+// Points the config's worlds at fresh copies of them, before Map::init() reads it
+static bool copyWorlds()
+{
+  const std::string key = "map.storage.nbt.directories";
+  ConfigNode::Ptr dirs = ServerInstance->config()->mData(key);
+  if (!dirs)
+  {
+    printf("no worlds in the config\n");
+    return false;
+  }
+
+  const std::list<std::string> names = dirs->keys();
+  std::vector<int> generators;
+  for (std::list<std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+  {
+    generators.push_back(dirs->get(*it, false)->iData());
+  }
+
+  dirs->clear();
+  dirs->setType(CONFIG_NODE_LIST);
+  size_t n = 0;
+  for (std::list<std::string>::const_iterator it = names.begin(); it != names.end(); ++it, ++n)
+  {
+    const size_t slash = it->find_last_of("/\\");
+    const std::string copy = "replay-" + (slash == std::string::npos ? *it : it->substr(slash + 1));
+    if (!removeTree(copy) || (fileExists(*it) && !copyTree(*it, copy)))
+    {
+      printf("cannot copy %s to %s\n", it->c_str(), copy.c_str());
+      return false;
+    }
+    printf("world %s copied to %s\n", it->c_str(), copy.c_str());
+
+    ConfigNode::Ptr generator(new ConfigNode);
+    generator->setData(generators[n]);
+    dirs->set(copy, generator, true);
+  }
+  return true;
+}
+
+static void runTick(time_t start, uint64_t& nextTick, uint64_t& handlers, std::vector<TickTime>& ticks)
+{
+  TickTime tick;
+  tick.handlers = uint32_t(handlers);
+  tick.tick     = uint32_t(ServerInstance->tick(start + time_t(nextTick / 1000000)));
+  ticks.push_back(tick);
+  handlers = 0;
+  nextTick += TICK_US;
+}
+
+static User* newUser(time_t now)
+{
+  // Everything sent to the player is thrown away
+  const int fd = open("/dev/null", O_WRONLY);
+  User* user = new User(fd, Mineserver::generateEID());
+  event_set(user->GetEvent(), fd, EV_READ | EV_PERSIST, client_callback, user);
+  event_set(user->GetWriteEvent(), fd, EV_WRITE, client_callback, user);
+  user->lastData = now;
+  return user;
+}
+
+static double percentile(std::vector<uint32_t> values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, size_t(values.size() * p))] / 1000.0;
+}
+
+static void printTimes(const char* name, const std::vector<uint32_t>& times)
+{
+  printf("%-9s p50 %7.2f ms, p90 %7.2f ms, p99 %7.2f ms, max %7.2f ms\n", name,
+         percentile(times, 0.5), percentile(times, 0.9), percentile(times, 0.99), percentile(times, 1.0));
+}
+
+static bool readTicks(const std::string& file, std::vector<uint32_t>& totals)
+{
+  std::ifstream in(file.c_str());
+  uint32_t tick, handlers;
+  while (in >> tick >> handlers)
+  {
+    totals.push_back(tick + handlers);
+  }
+  return !totals.empty();
+}
+
+static void usage(const char* name)
+{
+  printf("Usage: %s [-o ticks file] [-b baseline ticks file] [-S seed] capture [config file] [+override]...\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+  std::string ticksFile, baselineFile;
+  unsigned long seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "+o:b:S:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'o': ticksFile = optarg;                 break;
+    case 'b': baselineFile = optarg;              break;
+    case 'S': seed = strtoul(optarg, NULL, 10);   break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  PacketCapture::Reader capture;
+  if (!capture.open(argv[optind]))
+  {
+    printf("cannot read the capture %s\n", argv[optind]);
+    return 1;
+  }
+
+  // The config and overrides as for the server, then what a replay needs
+  std::vector<std::string> args(argv + optind, argv + argc);
+  args.push_back("+system.protocol_encryption=false");
+  args.push_back("+system.user_validation=false");
+  args.push_back("+system.login.workers=0");
+  args.push_back("+system.capture.file=\"\"");
+  args.push_back("+system.stats_file=\"\"");
+  args.push_back("+system.pid_file=\"replaybench.pid\"");
+  args.push_back("+system.interface.use_cli=false");
+  args.push_back("+map.generate_spawn.enabled=false");
+  std::vector<char*> serverArgv;
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    serverArgv.push_back(&args[i][0]);
+  }
+  serverArgv.push_back(NULL);
+
+  try
+  {
+    new Mineserver(int(serverArgv.size() - 1), &serverArgv[0]);
+  }
+  catch (const CoreException& e)
+  {
+    printf("%s\n", e.GetReason());
+    return 1;
+  }
+
+  if (capture.protocol() != PROTOCOL_VERSION)
+  {
+    printf("the capture is for protocol %d, this server speaks %d\n", capture.protocol(), PROTOCOL_VERSION);
+    delete ServerInstance;
+    return 1;
+  }
+  if (!copyWorlds())
+  {
+    delete ServerInstance;
+    return 1;
+  }
+
+  std::srand(seed);
+  prng.seed(seed);
+
+  // Users' events are set up, never added, so they need a base
+  event_init();
+  ServerInstance->prepare();
+  ServerInstance->logger()->start();
+
+  // Capture time 0 is now, so times saved in the world line up
+  const time_t start = time(NULL);
+  std::map<uint32_t, uint32_t> connections; // captured UID -> replay UID
+  std::vector<TickTime> ticks;
+  uint64_t nextTick = TICK_US;
+  uint64_t handlers = 0;
+  uint64_t packets = 0, skipped = 0, logins = 0;
+  const uint64_t replayStart = microTime();
+
+  PacketCapture::Record record;
+  while (capture.next(record))
+  {
+    while (record.time >= nextTick)
+    {
+      runTick(start, nextTick, handlers, ticks);
+    }
+
+    const time_t now = start + time_t(record.time / 1000000);
+    const uint64_t handlerStart = microTime();
+
+    switch (record.kind)
+    {
+    case PacketCapture::CONNECT:
+      connections[record.connection] = newUser(now)->UID;
+      logins++;
+      break;
+
+    case PacketCapture::PACKET:
+    {
+      std::map<uint32_t, uint32_t>::const_iterator it = connections.find(record.connection);
+      User* user = it != connections.end() ? ServerInstance->userByUID(it->second) : NULL;
+      // Gone already, or the encryption response, which was for another key
+      if (user == NULL || record.id == PACKET_ENCRYPTION_RESPONSE)
+      {
+        skipped++;
+        break;
+      }
+      user->buffer.addToRead(&record.id, 1);
+      if (!record.data.empty())
+      {
+        user->buffer.addToRead(&record.data[0], record.data.size());
+      }
+      user->lastData = now;
+      if (client_dispatch(user))
+      {
+        client_write(user);
+      }
+      packets++;
+      break;
+    }
+
+    case PacketCapture::DISCONNECT:
+    {
+      std::map<uint32_t, uint32_t>::iterator it = connections.find(record.connection);
+      if (it != connections.end())
+      {
+        delete ServerInstance->userByUID(it->second);
+        connections.erase(it);
+      }
+      break;
+    }
+    }
+
+    handlers += microTime() - handlerStart;
+  }
+
+  // One more second for whatever the last packets started
+  const uint64_t end = nextTick + 1000000;
+  while (nextTick < end)
+  {
+    runTick(start, nextTick, handlers, ticks);
+  }
+
+  const double elapsed = (microTime() - replayStart) / 1e6;
+
+  // Whoever is left logs out, their player files go to the copies
+  while (!ServerInstance->users().empty())
+  {
+    delete *ServerInstance->users().begin();
+  }
+
+  std::vector<uint32_t> tickTimes, handlerTimes, totals;
+  uint64_t busy = 0;
+  for (size_t i = 0; i < ticks.size(); i++)
+  {
+    tickTimes.push_back(ticks[i].tick);
+    handlerTimes.push_back(ticks[i].handlers);
+    totals.push_back(ticks[i].tick + ticks[i].handlers);
+    busy += ticks[i].tick + ticks[i].handlers;
+  }
+
+  printf("\n%u connections, %llu packets (%llu skipped), %u ticks (%.1f s of capture) replayed in %.1f s\n",
+         unsigned(logins), (unsigned long long)packets, (unsigned long long)skipped, unsigned(ticks.size()),
+         ticks.size() * TICK_US / 1e6, elapsed);
+  printTimes("tick", tickTimes);
+  printTimes("handlers", handlerTimes);
+  printTimes("total", totals);
+  printf("busy %.1f%% of the capture's time\n", busy * 100.0 / std::max<uint64_t>(ticks.size() * TICK_US, 1));
+
+  if (!ticksFile.empty())
+  {
+    std::ofstream out(ticksFile.c_str());
+    for (size_t i = 0; i < ticks.size(); i++)
+    {
+      out << ticks[i].tick << " " << ticks[i].handlers << "\n";
+    }
+  }
+
+  if (!baselineFile.empty())
+  {
+    std::vector<uint32_t> baseline;
+    if (!readTicks(baselineFile, baseline))
+    {
+      printf("cannot read %s\n", baselineFile.c_str());
+    }
+    else
+    {
+      printTimes("baseline", baseline);
+      const double p[] = { 0.5, 0.9, 0.99, 1.0 };
+      const char* names[] = { "p50", "p90", "p99", "max" };
+      printf("this run vs baseline:");
+      for (int i = 0; i < 4; i++)
+      {
+        const double before = percentile(baseline, p[i]);
+        printf(" %s %+.1f%%", names[i], before > 0 ? (percentile(totals, p[i]) / before - 1) * 100 : 0.0);
+      }
+      printf("\n");
+    }
+  }
+
+  delete ServerInstance;
+  return 0;
+}
@@ -0,0 +1,297 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Mineserver validationbench.cpp
+//
+// Runs a stub session server on localhost and pushes a login storm through
+// session validation, once the way the server used to (a thread and a new
+// connection per login) and once through the SessionValidator worker pool
+// with kept-alive connections. Reports logins per second and the latency
+// from submitting a login to the main loop seeing its answer.
+//
+// The stub answers YES unless the nick starts with "bad", after a delay.
+//
+// Usage: validationbench [logins] [workers] [stub delay ms]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "sessionvalidator.h"
+
+static int stubDelay = 0;
+
+static uint64_t nowUs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// One connection to the stub, answers requests until the client closes
+static void* stubConnection(void* arg)
+{
+  const int fd = int(intptr_t(arg));
+  std::string buffer;
+  char buf[4096];
+
+  for (;;)
+  {
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+    {
+      const ssize_t received = recv(fd, buf, sizeof(buf), 0);
+      if (received <= 0)
+      {
+        close(fd);
+        return NULL;
+      }
+      buffer.append(buf, received);
+    }
+    const std::string request = buffer.substr(0, end);
+    buffer.erase(0, end + 4);
+
+    if (stubDelay)
+    {
+      usleep(stubDelay * 1000);
+    }
+
+    const bool valid = request.find("user=bad") == std::string::npos;
+    const bool close = request.find("Connection: close") != std::string::npos;
+    const std::string body = valid ? "YES" : "NO";
+    char response[256];
+    snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n%s\r\n%s",
+             int(body.size()), close ? "Connection: close\r\n" : "", body.c_str());
+    send(fd, response, strlen(response), MSG_NOSIGNAL);
+
+    if (close)
+    {
+      break;
+    }
+  }
+  close(fd);
+  return NULL;
+}
+
+static void* stubServer(void* arg)
+{
+  const int listener = *static_cast<int*>(arg);
+  for (;;)
+  {
+    const int fd = accept(listener, NULL, NULL);
+    if (fd < 0)
+    {
+      return NULL;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, stubConnection, (void*)intptr_t(fd));
+    pthread_detach(thread);
+  }
+}
+
+// The old way: a thread per login, each connecting and asking with Connection: close
+struct OldLogin
+{
+  int port;
+  std::string nick;
+  uint64_t started;
+  uint64_t finished;
+  bool valid;
+};
+
+static void* oldValidation(void* arg)
+{
+  OldLogin* login = static_cast<OldLogin*>(arg);
+  login->valid = false;
+
+  const int fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(login->port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+  {
+    const std::string request = "GET /game/checkserver.jsp?user=" + login->nick + "&serverId=0 HTTP/1.1\r\n"
+                                "Host: localhost\r\nConnection: close\r\n\r\n";
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string response;
+    char buf[1024];
+    ssize_t received;
+    while ((received = recv(fd, buf, sizeof(buf), 0)) > 0)
+    {
+      response.append(buf, received);
+    }
+    login->valid = response.find("\r\n\r\nYES") != std::string::npos;
+  }
+  close(fd);
+  login->finished = nowUs();
+  return NULL;
+}
+
+static std::string nickFor(int i)
+{
+  char nick[32];
+  snprintf(nick, sizeof(nick), "%s%d", i % 10 == 0 ? "bad" : "player", i);
+  return nick;
+}
+
+static void report(const char* name, uint64_t start, uint64_t end, std::vector<uint64_t>& latencies, int valid)
+{
+  std::sort(latencies.begin(), latencies.end());
+  const double seconds = (end - start) / 1e6;
+  printf("%-22s %8.0f logins/s  latency p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms  valid %d\n", name,
+         seconds > 0 ? latencies.size() / seconds : 0.0,
+         latencies[latencies.size() / 2] / 1000.0,
+         latencies[latencies.size() * 99 / 100] / 1000.0,
+         latencies.back() / 1000.0, valid);
+}
+
+int main(int argc, const char* argv[])
+{
+  const int logins  = argc > 1 ? atoi(argv[1]) : 500;
+  const int workers = argc > 2 ? atoi(argv[2]) : 4;
+  stubDelay         = argc > 3 ? atoi(argv[3]) : 2;
+
+  if (logins <= 0 || workers <= 0 || stubDelay < 0)
+  {
+    printf("Usage: %s [logins] [workers] [stub delay ms]\n", argv[0]);
+    return 1;
+  }
+
+  int listener = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int on = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1024) != 0 ||
+      getsockname(listener, (sockaddr*)&addr, &len) != 0)
+  {
+    perror("stub session server");
+    return 1;
+  }
+  const int port = ntohs(addr.sin_port);
+  pthread_t server;
+  pthread_create(&server, NULL, stubServer, &listener);
+
+  printf("%d logins, %d workers, stub answers after %d ms\n", logins, workers, stubDelay);
+
+  // Thread per login
+  {
+    std::vector<OldLogin> state(logins);
+    std::vector<pthread_t> threads(logins);
+    const uint64_t start = nowUs();
+    for (int i = 0; i < logins; i++)
+    {
+      state[i].port = port;
+      state[i].nick = nickFor(i);
+      state[i].started = nowUs();
+      pthread_create(&threads[i], NULL, oldValidation, &state[i]);
+    }
+    for (int i = 0; i < logins; i++)
+    {
+      pthread_join(threads[i], NULL);
+    }
+    const uint64_t end = nowUs();
+
+    // The main loop used to look at the results once a second
+    std::vector<uint64_t> latencies;
+    int valid = 0;
+    for (int i = 0; i < logins; i++)
+    {
+      const uint64_t seen = state[i].finished + (1000000 - (state[i].finished - start) % 1000000);
+      latencies.push_back(seen - state[i].started);
+      valid += state[i].valid;
+    }
+    report("thread per login", start, end, latencies, valid);
+  }
+
+  // Worker pool, polled every 200 ms tick
+  {
+    SessionValidator validator("127.0.0.1", port, workers, logins, 30000, 0);
+    validator.start();
+
+    std::vector<uint64_t> started(logins);
+    std::vector<uint64_t> latencies;
+    int valid = 0;
+    const uint64_t start = nowUs();
+    for (int i = 0; i < logins; i++)
+    {
+      started[i] = nowUs();
+      validator.submit(i, nickFor(i), "0");
+    }
+
+    std::vector<SessionValidator::Result> results;
+    uint64_t tick = start;
+    while (int(latencies.size()) < logins)
+    {
+      tick += 200000;
+      const uint64_t now = nowUs();
+      if (tick > now)
+      {
+        usleep(useconds_t(tick - now));
+      }
+      results.clear();
+      validator.poll(results);
+      for (size_t i = 0; i < results.size(); i++)
+      {
+        latencies.push_back(nowUs() - started[results[i].UID]);
+        valid += results[i].valid;
+      }
+    }
+    const uint64_t end = nowUs();
+
+    const SessionValidator::Stats stats = validator.stats();
+    report("SessionValidator", start, end, latencies, valid);
+    printf("  %llu connections, %llu timeouts, %llu failures\n", (unsigned long long)stats.connects,
+           (unsigned long long)stats.timeouts, (unsigned long long)stats.failures);
+  }
+
+  shutdown(listener, SHUT_RDWR);
+  close(listener);
+  pthread_join(server, NULL);
+  return 0;
+}
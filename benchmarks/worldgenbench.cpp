@@ -0,0 +1,249 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Runs the world generators headless over a square of chunks and reports
+// chunks/s, time per generation stage and heap allocations. The block, meta
+// and light arrays of the square are hashed, so a generator change can be
+// checked to produce bit-identical worlds for a seed.
+//
+// Needs a config.cfg like the server (next to the binary by default). The
+// ring of chunks around the square only gets terrain, nothing is saved and
+// map files go to worldgenbench.tmp/.
+//
+// Usage: worldgenbench [chunks per side] [seed] [generator|all] [config file]
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "mineserver.h"
+#include "map.h"
+#include "tools.h"
+#include "worldgen/mapgen.h"
+
+// Count heap allocations, the generators allocate per chunk
+static uint64_t allocations = 0;
+static uint64_t allocatedBytes = 0;
+
+void* operator new(size_t size)
+{
+  allocations++;
+  allocatedBytes += size;
+  void* p = malloc(size ? size : 1);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) throw()
+{
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) throw()
+{
+  operator delete[](p);
+}
+
+// In the order of Mineserver::mapGenTypes()
+static const char* generatorNames[] = { "mapgen", "nethergen", "heavengen", "biomegen", "eximgen" };
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool ensureDirectory(const std::string& path)
+{
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 || makeDirectory(path);
+}
+
+static bool runGenerator(size_t type, int side, int seed)
+{
+  MapGen* gen = ServerInstance->mapGenTypes()[type];
+  Map* map = ServerInstance->map(0);
+  const char* name = type < sizeof(generatorNames) / sizeof(generatorNames[0]) ? generatorNames[type] : "?";
+
+  map->m_number = 0;
+  map->mapSeed = seed;
+  map->mapDirectory = std::string("worldgenbench.tmp") + PATH_SEPARATOR + name;
+  if (!ensureDirectory("worldgenbench.tmp") || !ensureDirectory(map->mapDirectory))
+  {
+    printf("cannot create %s\n", map->mapDirectory.c_str());
+    return false;
+  }
+  ServerInstance->setMapGen(0, gen);
+
+  MapGen::stats.reset();
+  MapGen::stats.enabled = true;
+  const uint64_t allocStart = allocations;
+  const uint64_t bytesStart = allocatedBytes;
+  const uint64_t start = microTime();
+
+  // Terrain for the square and the ring around it, then populate the square,
+  // the way Map::loadMap() does it one chunk at a time
+  const int first = -side / 2;
+  for (int cx = first - 1; cx <= first + side; cx++)
+  {
+    for (int cz = first - 1; cz <= first + side; cz++)
+    {
+      gen->init(seed);
+      gen->generateChunk(cx, cz, 0);
+    }
+  }
+  for (int cx = first; cx < first + side; cx++)
+  {
+    for (int cz = first; cz < first + side; cz++)
+    {
+      map->populateMap(map->getChunk(cx, cz));
+    }
+  }
+
+  const uint64_t usec = std::max<uint64_t>(microTime() - start, 1);
+  MapGen::stats.enabled = false;
+  const uint64_t allocs = allocations - allocStart;
+  const uint64_t bytes = allocatedBytes - bytesStart;
+  const size_t generated = map->chunks.size();
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (int cx = first; cx < first + side; cx++)
+  {
+    for (int cz = first; cz < first + side; cz++)
+    {
+      const sChunk* chunk = map->getChunk(cx, cz);
+      hash = hashBytes(hash, chunk->blocks, 16 * 16 * 256);
+      hash = hashBytes(hash, chunk->data, 16 * 16 * 256 / 2);
+      hash = hashBytes(hash, chunk->blocklight, 16 * 16 * 256 / 2);
+      hash = hashBytes(hash, chunk->skylight, 16 * 16 * 256 / 2);
+    }
+  }
+
+  printf("%s (%d): %d chunks + %d outside the square in %.1f ms, %.1f chunks/s\n",
+         name, int(type), side * side, int(generated) - side * side, usec / 1000.0, generated * 1e6 / usec);
+
+  uint64_t staged = 0;
+  for (int i = 0; i < MapGenStats::STAGE_COUNT; i++)
+  {
+    staged += MapGen::stats.usec[i];
+    printf("  %-9s %8.3f ms/chunk\n", MapGenStats::stageName(i), MapGen::stats.usec[i] / 1000.0 / generated);
+  }
+  printf("  %-9s %8.3f ms/chunk\n", "other", (usec > staged ? usec - staged : 0) / 1000.0 / generated);
+  printf("  allocations: %llu (%.1f per chunk, %.1f KiB per chunk)\n",
+         (unsigned long long)allocs, double(allocs) / generated, bytes / 1024.0 / generated);
+  printf("  hash: %016llx\n", (unsigned long long)hash);
+
+  // Throw the chunks away, nothing is saved
+  for (ChunkMap::iterator it = map->chunks.begin(); it != map->chunks.end(); ++it)
+  {
+    delete it->second;
+  }
+  map->chunks.clear();
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  const int side = argc > 1 ? atoi(argv[1]) : 8;
+  const int seed = argc > 2 ? atoi(argv[2]) : 1234;
+  const std::string which = argc > 3 ? argv[3] : "all";
+
+  if (side <= 0)
+  {
+    printf("Usage: %s [chunks per side] [seed] [generator|all] [config file]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<char*> serverArgs;
+  serverArgs.push_back(argv[0]);
+  if (argc > 4)
+  {
+    serverArgs.push_back(argv[4]);
+  }
+  char noCli[] = "+system.interface.use_cli=false";
+  serverArgs.push_back(noCli);
+
+  try
+  {
+    new Mineserver(int(serverArgs.size()), &serverArgs[0]);
+  }
+  catch (const CoreException& e)
+  {
+    printf("cannot set up the server: %s\n", e.GetReason());
+    return 1;
+  }
+
+  printf("%dx%d chunks, seed %d\n", side, side, seed);
+
+  const size_t types = ServerInstance->mapGenTypes().size();
+  bool ok = true;
+  for (size_t type = 0; type < types; type++)
+  {
+    const bool byNumber = atoi(which.c_str()) == int(type) && which != "all";
+    const bool byName = type < sizeof(generatorNames) / sizeof(generatorNames[0]) && which == generatorNames[type];
+    if (which == "all" || byNumber || byName)
+    {
+      ok = runGenerator(type, side, seed) && ok;
+    }
+  }
+
+  delete ServerInstance;
+
+  return ok ? 0 : 1;
+}
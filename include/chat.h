@@ -28,8 +28,10 @@
 #ifndef _CHAT_H
 #define _CHAT_H
 
+#include <stdint.h>
 #include <deque>
 #include <string>
+#include <vector>
 
 class User;
 
@@ -49,20 +51,43 @@ public:
   Chat();
   ~Chat();
 
+  // Chat packets only queue the message, update() handles them once per tick
+  // within system.chat.budget ms. Users over their rate are told and dropped.
+  bool queueMsg(User* user, const std::string& msg);
+  void update();
+  // Drop the queued messages of a user that is going away
+  void removeUser(User* user);
+
   bool handleMsg(User* user, std::string msg);
   void handleServerMsg(User* user, std::string msg, const std::string& timeStamp);
   void handleAdminChatMsg(User* user, std::string msg, const std::string& timeStamp);
   void handleChatMsg(User* user, std::string msg, const std::string& timeStamp);
 
+  // Messages to ALL are collected and go out as one block per user on flushBroadcast()
   bool sendMsg(User* user, std::string msg, MessageTarget action = ALL);
+  void flushBroadcast();
   bool sendUserlist(User* user);
   void sendHelp(User* user, std::deque<std::string> args);
 
   void handleCommand(User* user, std::string msg, const std::string& timeStamp);
 
 private:
+  struct QueuedMsg
+  {
+    User* user;
+    std::string msg;
+  };
+
+  bool takeToken(User* user);
   std::deque<std::string> parseCmd(std::string cmd);
   std::string adminPassword;
+
+  std::deque<QueuedMsg> m_queue;
+  std::vector<uint8_t> m_broadcast;
+  // Token bucket: messages per second and bucket size, rate 0 disables it
+  double m_rate;
+  double m_burst;
+  uint32_t m_budget;
 };
 
 #endif
@@ -32,6 +32,7 @@
 #include <list>
 #include <vector>
 #include <ctime>
+#include <algorithm>
 
 #include "tr1.h"
 #include TR1INCLUDE(unordered_map)
@@ -58,6 +59,83 @@ struct spawnedItem
   }
 };
 
+/** dropped items of one chunk, bucketed by 4x4 block columns so that
+ * pickups and block updates only look at the items right next to them
+ */
+class ItemBuckets
+{
+public:
+  enum { CELL_BITS = 2, CELLS = 16 >> CELL_BITS };
+
+  ItemBuckets() : m_count(0)
+  {
+  }
+
+  void add(spawnedItem* item)
+  {
+    cell(item->pos.x() >> 5, item->pos.z() >> 5).push_back(item);
+    m_count++;
+  }
+
+  bool remove(spawnedItem* item)
+  {
+    std::vector<spawnedItem*>& items = cell(item->pos.x() >> 5, item->pos.z() >> 5);
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      if (items[i] == item)
+      {
+        // Order doesn't matter, so avoid shifting the rest of the cell
+        items[i] = items.back();
+        items.pop_back();
+        m_count--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Collect the items from every cell touching the chunk local block area [x1..x2] x [z1..z2]
+  void find(int x1, int z1, int x2, int z2, std::vector<spawnedItem*>& found) const
+  {
+    for (int cx = (std::max(x1, 0) >> CELL_BITS); cx <= (std::min(x2, 15) >> CELL_BITS); cx++)
+    {
+      for (int cz = (std::max(z1, 0) >> CELL_BITS); cz <= (std::min(z2, 15) >> CELL_BITS); cz++)
+      {
+        const std::vector<spawnedItem*>& items = m_cells[cx * CELLS + cz];
+        found.insert(found.end(), items.begin(), items.end());
+      }
+    }
+  }
+
+  void getAll(std::vector<spawnedItem*>& found) const
+  {
+    for (int i = 0; i < CELLS * CELLS; i++)
+    {
+      found.insert(found.end(), m_cells[i].begin(), m_cells[i].end());
+    }
+  }
+
+  inline size_t size() const
+  {
+    return m_count;
+  }
+
+  inline bool empty() const
+  {
+    return m_count == 0;
+  }
+
+private:
+  // Block coordinates
+  inline std::vector<spawnedItem*>& cell(int x, int z)
+  {
+    return m_cells[((x & 15) >> CELL_BITS) * CELLS + ((z & 15) >> CELL_BITS)];
+  }
+
+  std::vector<spawnedItem*> m_cells[CELLS * CELLS];
+  size_t m_count;
+};
+
 typedef std::tr1::shared_ptr<std::vector<ItemPtr> > ItemVectorPtr;
 
 /** holds items and coordinates for small and large chests
@@ -192,19 +270,24 @@ struct sChunk
   int refCount;
   bool lightRegen;
   bool changed;
+  // False while the chunk only has terrain, see Map::populateMap()
+  bool populated;
+  // Block data version per 16x16x16 section, 0 until asked for, see Map::sectionVersion()
+  uint32_t versions[16];
   time_t lastused;
 
   NBT_Value* nbt;
 
   std::set<User*>           users;
-  std::vector<spawnedItem*> items;
+  ItemBuckets               items;
 
   std::vector<chestDataPtr>   chests;
   std::vector<signDataPtr>    signs;
   std::vector<furnaceDataPtr> furnaces;
 
-  sChunk() : blocks(NULL), addblocks(NULL), data(NULL), blocklight(NULL), skylight(NULL), chunks_present(0), addblocks_present(0), refCount(0), lightRegen(false), changed(false), lastused(0), nbt(NULL)
+  sChunk() : blocks(NULL), addblocks(NULL), data(NULL), blocklight(NULL), skylight(NULL), chunks_present(0), addblocks_present(0), refCount(0), lightRegen(false), changed(false), populated(false), lastused(0), nbt(NULL)
   {
+    std::fill(versions, versions + 16, 0);
   }
 
   ~sChunk()
@@ -238,7 +321,7 @@ struct sChunk
     {
       if ((*it) != nosend && (*it)->logged)
       {
-        (*it)->buffer.addToWrite(packet);
+        (*it)->send(packet);
       }
     }
   }
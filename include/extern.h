@@ -54,6 +54,12 @@ class MapGen;
 class Logger;
 class Inventory;
 class Mobs;
+class Pregen;
+class TaskQueue;
+class SessionValidator;
+class LoginPipeline;
+class PacketCapture;
+class PlayerStore;
 class Mob;
 
 E Mineserver *ServerInstance;
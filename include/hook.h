@@ -1,7 +1,7 @@
 #ifndef _HOOK_H
 #define _HOOK_H
 
-#include <list> // We could use std::set if you don't care about the order of callbacks
+#include <vector>
 #include <algorithm>
 #include <utility>
 #include <cstdarg>
@@ -49,8 +49,9 @@ typedef std::pair<void*, voidF> callbackType;
 
 class Hook
 {
-  /// Define this to whatever suits best. std::list is good for maintaining the order.
-  typedef std::list<callbackType> CallbackStore;
+  /// Callbacks are kept contiguous and in order, hooks fire far more often than they change.
+  /// Dispatch loops index the vector, so callbacks may add callbacks while the hook runs.
+  typedef std::vector<callbackType> CallbackStore;
 
   /// A helper class to find callbacks by their second component (the function pointer).
   struct CallbackFinder
@@ -139,15 +140,15 @@ public:
 
   void doAll()
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))();
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))();
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first);
       }
     }
   }
@@ -161,18 +162,18 @@ public:
 
   bool doUntilTrue()
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))())
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))())
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first))
         {
           return true;
         }
@@ -191,18 +192,18 @@ public:
 
   bool doUntilFalse()
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))())
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))())
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first))
         {
           return true;
         }
@@ -229,15 +230,15 @@ public:
 
   void doAll(A1 a1)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1);
       }
     }
   }
@@ -251,18 +252,18 @@ public:
 
   bool doUntilTrue(A1 a1)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1))
         {
           return true;
         }
@@ -281,18 +282,18 @@ public:
 
   bool doUntilFalse(A1 a1)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1))
         {
           return true;
         }
@@ -319,15 +320,15 @@ public:
 
   void doAll(A1 a1, A2 a2)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2);
       }
     }
   }
@@ -342,18 +343,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2))
         {
           return true;
         }
@@ -373,18 +374,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2))
         {
           return true;
         }
@@ -412,15 +413,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3);
       }
     }
   }
@@ -436,18 +437,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3))
         {
           return true;
         }
@@ -468,18 +469,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3))
         {
           return true;
         }
@@ -508,15 +509,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4);
       }
     }
   }
@@ -533,18 +534,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4))
         {
           return true;
         }
@@ -566,18 +567,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4))
         {
           return true;
         }
@@ -607,15 +608,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5);
       }
     }
   }
@@ -633,18 +634,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5))
         {
           return true;
         }
@@ -667,18 +668,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5))
         {
           return true;
         }
@@ -709,15 +710,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6);
       }
     }
   }
@@ -736,18 +737,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6))
         {
           return true;
         }
@@ -771,18 +772,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6))
         {
           return true;
         }
@@ -814,15 +815,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7);
       }
     }
   }
@@ -842,18 +843,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7))
         {
           return true;
         }
@@ -878,18 +879,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7))
         {
           return true;
         }
@@ -922,15 +923,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8);
       }
     }
   }
@@ -951,18 +952,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8))
         {
           return true;
         }
@@ -988,18 +989,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8))
         {
           return true;
         }
@@ -1033,15 +1034,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9);
       }
     }
   }
@@ -1063,18 +1064,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9))
         {
           return true;
         }
@@ -1101,18 +1102,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9))
         {
           return true;
         }
@@ -1147,15 +1148,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
       }
     }
   }
@@ -1178,18 +1179,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
         {
           return true;
         }
@@ -1217,18 +1218,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
         {
           return true;
         }
@@ -1264,15 +1265,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
       }
     }
   }
@@ -1296,18 +1297,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
         {
           return true;
         }
@@ -1336,18 +1337,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11))
         {
           return true;
         }
@@ -1384,15 +1385,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
       }
     }
   }
@@ -1417,18 +1418,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
         {
           return true;
         }
@@ -1458,18 +1459,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12))
         {
           return true;
         }
@@ -1507,15 +1508,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13);
       }
     }
   }
@@ -1541,18 +1542,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
         {
           return true;
         }
@@ -1583,18 +1584,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13))
         {
           return true;
         }
@@ -1633,15 +1634,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14);
       }
     }
   }
@@ -1668,18 +1669,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
         {
           return true;
         }
@@ -1711,18 +1712,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14))
         {
           return true;
         }
@@ -1762,15 +1763,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
       }
     }
   }
@@ -1798,18 +1799,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
         {
           return true;
         }
@@ -1842,18 +1843,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15))
         {
           return true;
         }
@@ -1894,15 +1895,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16);
       }
     }
   }
@@ -1931,18 +1932,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
         {
           return true;
         }
@@ -1976,18 +1977,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16))
         {
           return true;
         }
@@ -2029,15 +2030,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17);
       }
     }
   }
@@ -2067,18 +2068,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
         {
           return true;
         }
@@ -2113,18 +2114,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17))
         {
           return true;
         }
@@ -2167,15 +2168,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18);
       }
     }
   }
@@ -2206,18 +2207,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
         {
           return true;
         }
@@ -2253,18 +2254,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18))
         {
           return true;
         }
@@ -2308,15 +2309,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19);
       }
     }
   }
@@ -2348,18 +2349,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
         {
           return true;
         }
@@ -2396,18 +2397,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
         {
           return true;
         }
@@ -2452,15 +2453,15 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        (reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20);
+        (reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20);
       }
       else
       {
-        (reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20);
+        (reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20);
       }
     }
   }
@@ -2493,18 +2494,18 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if ((reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
+        if ((reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
         {
           return true;
         }
       }
       else
       {
-        if ((reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
+        if ((reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
         {
           return true;
         }
@@ -2542,18 +2543,18 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
-    for (CallbackStore::iterator ia = m_callbacks.begin(); ia != m_callbacks.end(); ++ia)
+    for (size_t i = 0; i < m_callbacks.size(); ++i)
     {
-      if (ia->first == NULL)
+      if (m_callbacks[i].first == NULL)
       {
-        if (!(reinterpret_cast<fatype_t>(ia->second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
+        if (!(reinterpret_cast<fatype_t>(m_callbacks[i].second))(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
         {
           return true;
         }
       }
       else
       {
-        if (!(reinterpret_cast<fitype_t>(ia->second))(ia->first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
+        if (!(reinterpret_cast<fitype_t>(m_callbacks[i].second))(m_callbacks[i].first, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20))
         {
           return true;
         }
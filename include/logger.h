@@ -32,33 +32,93 @@
 // Mineserver logger.h
 //
 #include <string>
+#include <pthread.h>
 
 #include "logtype.h"
 #include "tools.h"
 
-#define LOGLF(msg) ServerInstance->logger()->log(msg, std::string(__FILE__), __LINE__)
+// The macros check the level first, a filtered message is never built
+#define LOGLF(msg) do { if (ServerInstance->logger()->enabled(LogType::LOG_INFO)) ServerInstance->logger()->log(LogType::LOG_INFO, __FILE__, __LINE__, NULL, msg); } while (0)
 
-#define LOG(type, source, msg) ServerInstance->logger()->log(LogType::LOG_##type, source, msg)
+#define LOG(type, source, msg) do { if (ServerInstance->logger()->enabled(LogType::LOG_##type)) ServerInstance->logger()->log(LogType::LOG_##type, source, msg); } while (0)
 
-
-// TODO: winex: log(type, file, line, msg) might be better than this
-#define LOG_FILENAME std::string(__FILE__).substr(std::string(__FILE__).rfind(PATH_SEPARATOR) + 1)
+// File, line and function are turned into the source by the writer
 #ifdef DEBUG
-#define LOG_FORMAT   LOG_FILENAME + ":" + dtos(__LINE__) + "::" + std::string(__FUNCTION__) + "()"
+#define LOG2(type, msg) do { if (ServerInstance->logger()->enabled(LogType::LOG_##type)) ServerInstance->logger()->log(LogType::LOG_##type, __FILE__, __LINE__, __FUNCTION__, msg); } while (0)
 #else
-#define LOG_FORMAT   LOG_FILENAME + "::" + std::string(__FUNCTION__) + "()"
+#define LOG2(type, msg) do { if (ServerInstance->logger()->enabled(LogType::LOG_##type)) ServerInstance->logger()->log(LogType::LOG_##type, __FILE__, 0, __FUNCTION__, msg); } while (0)
 #endif
 
-#define LOG2(type, msg) ServerInstance->logger()->log(LogType::LOG_##type, LOG_FORMAT, msg)
-
 
+//
+// Messages go into a fixed ring that any thread can add to without locking.
+// A writer thread empties it in batches, calling the LogPost hook (or
+// writing to the console) and flushing once per batch. Before start() and
+// after stop() messages are written right away by the caller.
+//
 class Logger
 {
 public:
+  enum Overflow
+  {
+    // Drop messages below WARNING while the ring is full, the rest wait
+    OVERFLOW_DROP,
+    // Wait for the writer, nothing is lost
+    OVERFLOW_BLOCK
+  };
+
+  Logger();
+  ~Logger();
+
+  inline bool enabled(LogType::LogType type) const
+  {
+    return type <= m_level;
+  }
+
+  // Read system.log.*, before start()
+  void configure();
+  void start();
+  // Write what is queued and stop the writer, LogPost callbacks may go away after this
+  void stop();
+
   void log(const std::string& message, const std::string& file, int line);
   void log(LogType::LogType type, const std::string& source, const std::string& message);
   void log(LogType::LogType type, const std::string& source, const char* message, ...);
+  // file and function must be string literals, line 0 leaves it out
+  void log(LogType::LogType type, const char* file, int line, const char* function, const std::string& message);
+
+private:
+  struct Entry
+  {
+    // Slot n is free for the push of ticket n, holds it once it is n + 1
+    volatile uint32_t sequence;
+    LogType::LogType type;
+    const char* file;
+    int line;
+    const char* function;
+    std::string source;
+    std::string message;
+  };
+
+  LogType::LogType m_level;
+  Overflow m_overflow;
+
+  Entry* m_ring;
+  uint32_t m_capacity;
+  volatile uint32_t m_head;
+  uint32_t m_tail;
+  volatile uint32_t m_dropped;
+
+  volatile bool m_running;
+  pthread_t m_thread;
+
+  void push(LogType::LogType type, const char* file, int line, const char* function, const std::string& source, const std::string& message);
+  size_t drain(size_t max);
+  void write(LogType::LogType type, const std::string& source, const std::string& message);
+  void flush();
 
+  static std::string formatSource(const char* file, int line, const char* function);
+  static void* run(void* arg);
 };
 
 #endif
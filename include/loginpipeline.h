@@ -0,0 +1,191 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _LOGINPIPELINE_H
+#define _LOGINPIPELINE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <openssl/rsa.h>
+
+class PlayerStore;
+
+//
+// Does the expensive parts of a login on a pool of worker threads, so that a
+// crowd reconnecting after a restart does not stall the main loop.
+//
+// A login goes through three stages, each submitted by the main thread once
+// the previous one has come back through poll():
+//  HANDSHAKE    decrypts the verify token and the shared secret with the
+//               server's RSA key
+//  PLAYER_DATA  reads and parses the player's .dat file, through the
+//               PlayerStore when there is one
+//  CHUNKS       deflates the first chunks sent to the player, copied out of
+//               the map by the main thread
+// Results only carry the user's UID, the user may be gone by the time they
+// are picked up. Only new logins (handshakes) are refused when the queue is
+// full, the later stages of logins already under way always get through.
+//
+// With no workers the stages run inline as they are submitted, in order,
+// which is slow but deterministic (benchmarks/replaybench).
+//
+class LoginPipeline
+{
+public:
+  enum Stage
+  {
+    HANDSHAKE,
+    PLAYER_DATA,
+    CHUNKS
+  };
+
+  struct Slot
+  {
+    int16_t type;
+    int8_t count;
+    int16_t health;
+  };
+
+  // What User::loadData() reads from a player file
+  struct PlayerData
+  {
+    bool found;
+    double x, y, z;
+    float yaw, pitch;
+    int16_t health;
+    // Inventory by window slot, type -1 for slots the file does not mention
+    Slot inv[45];
+
+    PlayerData();
+  };
+
+  struct Chunk
+  {
+    int32_t x;
+    int32_t z;
+    // Section versions when copied, to tell whether the copy is still current
+    uint32_t versions[16];
+    // The chunk packet's data: raw before the CHUNKS stage, deflated after it
+    std::vector<uint8_t> data;
+  };
+
+  struct Result
+  {
+    Stage stage;
+    uint32_t UID;
+    bool ok;
+    std::string secret;        // HANDSHAKE
+    PlayerData player;         // PLAYER_DATA
+    std::vector<Chunk> chunks; // CHUNKS
+  };
+
+  struct Stats
+  {
+    uint64_t handshakes;
+    uint64_t badHandshakes;
+    uint64_t playerFiles;
+    uint64_t chunks;
+    uint64_t logins;   // counted by loggedIn()
+    uint64_t refused;  // queue was full
+
+    Stats() : handshakes(0), badHandshakes(0), playerFiles(0), chunks(0), logins(0), refused(0) {}
+  };
+
+  // verifyToken is what the clients are asked to encrypt, see Protocol::encryptionRequest()
+  LoginPipeline(RSA* rsa, const std::string& verifyToken, int workers, size_t queueLimit,
+                PlayerStore* store = NULL);
+  ~LoginPipeline();
+
+  bool start();
+  // Waits for the workers, work still queued is dropped
+  void stop();
+
+  // Returns false if the queue is full
+  bool submitHandshake(uint32_t UID, const std::string& secret, const std::string& verify);
+  void submitPlayerData(uint32_t UID, const std::string& file);
+  // Takes the chunks, leaving the vector empty
+  void submitChunks(uint32_t UID, std::vector<Chunk>& chunks);
+  // Appends the stages finished since the last call
+  void poll(std::vector<Result>& results);
+
+  // The main thread has sent a player everything, counts towards loginRate()
+  void loggedIn();
+  // Logins per second since the previous call
+  double loginRate();
+
+  size_t queued();
+  Stats stats();
+
+  // The stages' work, also usable without the pipeline
+  static bool decrypt(RSA* rsa, const std::string& verifyToken, const std::string& secret,
+                      const std::string& verify, std::string& decrypted);
+  static bool readPlayerData(const std::string& file, PlayerData& player);
+  static void compressChunk(Chunk& chunk);
+
+private:
+  struct Job
+  {
+    Stage stage;
+    uint32_t UID;
+    std::string first;   // secret, or the player file
+    std::string second;  // verify token
+    std::vector<Chunk> chunks;
+  };
+
+  static void* run(void* arg);
+  void work();
+  void runInline();
+  void takeJob(Job& job);
+  void process(Job& job);
+
+  static uint64_t nowMs();
+
+  RSA* m_rsa;
+  std::string m_verifyToken;
+  PlayerStore* m_store;
+  int m_workerCount;
+  size_t m_queueLimit;
+
+  std::vector<pthread_t> m_workers;
+  bool m_running;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_wakeup;
+  std::deque<Job> m_queue;
+  size_t m_handshakesQueued;
+  std::deque<Result> m_done;
+  Stats m_stats;
+
+  uint64_t m_rateLogins;
+  uint64_t m_rateTime;
+};
+
+#endif
@@ -30,6 +30,8 @@
 
 #include <map>
 #include <list>
+#include <deque>
+#include <vector>
 #include <ctime>
 
 #include "vec.h"
@@ -92,6 +94,12 @@ public:
   // Store chunks here (remove maps)
   ChunkMap chunks;
 
+  // Chunk populateMap() is decorating, no chunk is loaded or generated meanwhile
+  sChunk* populating;
+
+  // Last section version handed out
+  uint32_t blockVersion;
+
   // Store the time map chunk has been last used
   std::map<uint32_t, int> mapLastused;
 
@@ -105,14 +113,30 @@ public:
   //std::map<uint32, std::vector<spawnedItem *> > mapItems;
   std::vector<MinecartData> minecarts;
 
-  //All spawned items on map
-  std::map<uint32_t, spawnedItem*> items;
+  //All spawned items on map, by EID
+  typedef std::tr1::unordered_map<uint32_t, spawnedItem*> ItemMap;
+  ItemMap items;
+
+  // (spawn time, EID) of items in spawn order, for despawning. A merge into a
+  // stack queues it again, the entry with an older time is then skipped
+  std::deque<std::pair<time_t, uint32_t> > itemDespawnQueue;
+
+  // Seconds until a dropped item despawns, 0 to keep them forever
+  int itemDespawnTime;
+
+  // Merge equal dropped items lying next to each other into one stack
+  bool itemMerge;
 
   //  void posToId(int x, int z, uint32_t *id);
   //  void idToPos(uint32_t id, int *x, int *z);
 
   void init(int number);
   void sendToUser(User* user, int x, int z, bool login = false);
+  // sendToUser() in two halves, so the deflating in between can run elsewhere:
+  // copy the data of chunk x, z into raw (relighting it first if needed), and
+  // write the chunk packet for the deflated data followed by the chunk's signs
+  sChunk* copyChunk(int x, int z, std::vector<uint8_t>& raw);
+  void writeChunk(Packet& p, sChunk* chunk, const uint8_t* compressed, size_t len);
 
   //Time in the map
   int64_t mapTime;
@@ -123,9 +147,17 @@ public:
   // Get pointer to struct
   sChunk* getMapData(int x, int z, bool generate = true);
 
-  // Load map chunk
+  // Load map chunk, populating it if it only has terrain
   sChunk* loadMap(int x, int z, bool generate = true);
 
+  // Load map chunk or generate its terrain, never populates
+  sChunk* loadProtoMap(int x, int z, bool generate = true);
+
+  // Add ore, trees etc. to a chunk that only has terrain. The eight neighbours
+  // are loaded or generated as terrain first so features can cross into them,
+  // no chunk further away is touched.
+  bool populateMap(sChunk* chunk);
+
   // Save map chunk to disc
   bool saveMap(int x, int z);
   inline bool saveMap(const Coords& c) { return saveMap(c.first, c.second); }
@@ -167,6 +199,43 @@ public:
     return setBlock(pos.x(), pos.y(), pos.z(), type, meta);
   }
 
+  // Set the blocks of the box x1..x2, y1..y2, z1..z2 that lie in chunk chunk_x, chunk_z
+  // to type/meta, or only those of type from when from is not -1. Writes straight into
+  // the chunk, section by section, and sends the chunk's users one update for the lot.
+  // Returns the number of blocks changed.
+  int fillChunk(int chunk_x, int chunk_z, int x1, int y1, int z1, int x2, int y2, int z2, int from, uint8_t type, uint8_t meta);
+  // fillChunk() over every chunk of the box
+  int fill(int x1, int y1, int z1, int x2, int y2, int z2, int from, uint8_t type, uint8_t meta);
+
+  // Copy the box's block types and metas into types and metas (either may be NULL), y
+  // running fastest, then z, then x. Chunks that are not loaded read as air. Returns the
+  // number of blocks read from loaded chunks.
+  int getBlocks(int x1, int y1, int z1, int x2, int y2, int z2, uint8_t* types, uint8_t* metas);
+  // Write a box laid out as for getBlocks(), metas may be NULL for 0. Every chunk gets
+  // one update, as with fillChunk(). Returns the number of blocks changed.
+  int setBlocks(int x1, int y1, int z1, int x2, int y2, int z2, const uint8_t* types, const uint8_t* metas);
+  // Height of the highest non-air block of column x, z, -1 if there is none or the chunk is not loaded
+  int getTopBlock(int x, int z, uint8_t* type, uint8_t* meta);
+
+  // Every block write gives the section a new version, so code scanning the arrays
+  // directly can tell whether they changed in between
+  inline void touchSection(sChunk* chunk, int section)
+  {
+    chunk->versions[section] = ++blockVersion;
+  }
+  inline uint32_t sectionVersion(sChunk* chunk, int section)
+  {
+    if (chunk->versions[section] == 0)
+    {
+      touchSection(chunk, section);
+    }
+    return chunk->versions[section];
+  }
+
+  // Tell the users of an edited chunk about changed blocks, changedBlocks holds them
+  // unless there are more than FILL_RESEND_LIMIT, then the chunk is relit and resent
+  void sendChunkChanges(sChunk* chunk, std::set<vec>& changedBlocks, int changed);
+
   bool sendBlockChange(int x, int y, int z, int16_t type, char meta);
   bool sendBlockChange(vec pos, int16_t type, char meta)
   {
@@ -181,6 +250,15 @@ public:
   bool sendPickupSpawn(spawnedItem item);
   void createPickupSpawn(int x, int y, int z, int type, int count, int health, User* user);
 
+  // Get the items at most radius blocks away from x,y,z (block coordinates)
+  void getItemsNear(int x, int y, int z, int radius, std::vector<spawnedItem*>& found);
+
+  // Remove a dropped item from the map, tell the clients and free it
+  void removeItem(spawnedItem* item);
+
+  // Despawn items older than itemDespawnTime, called every second
+  void checkItemDespawn();
+
   bool sendProjectileSpawn(User* user, int8_t projID);
 
   bool sendMultiBlocks(std::set<vec>& blocks);
@@ -34,6 +34,7 @@
 
 #include "tr1.h"
 #include TR1INCLUDE(memory)
+#include TR1INCLUDE(unordered_map)
 
 
 //Enable protocol encryption
@@ -78,10 +79,25 @@ public:
   bool m_pvp_enabled;
   bool m_damage_enabled;
   bool m_only_helmets;
+
+  // View distance in chunks: default for new players and the allowed range
+  int m_viewDistance;
+  int m_viewDistanceMin;
+  int m_viewDistanceMax;
+  // Loaded chunk count and tick time (ms) above which view distances shrink, 0 = no limit
+  size_t m_chunkBudget;
+  uint32_t m_tickBudget;
+
+  // Output queued per connection (bytes): above high chunk streaming pauses and
+  // moves are dropped until it is back under low, over cap for capSeconds disconnects
+  size_t m_outputHigh;
+  size_t m_outputLow;
+  size_t m_outputCap;
+  int m_outputCapSeconds;
+  // How far output may run ahead of the socket with data from the lanes, see OutputLanes
+  size_t m_outputWindow;
+
   struct event m_listenEvent;
-  pthread_mutex_t m_validation_mutex;
-  struct userValidation { User* user; bool valid; uint32_t UID; };
-  std::vector<userValidation> validatedUsers;
 
   #ifdef PROTOCOL_ENCRYPTION
   //Protocol encryption
@@ -100,12 +116,17 @@ public:
   // Non-inline functions
   bool run();
   bool stop();
+  // run() is prepare(), then listening and tick() every 200ms
+  void prepare();
+  uint64_t tick(time_t timeNow);
   
   event_base* getEventBase();
   Map* map(size_t n) const;
   void saveAllPlayers();
   void saveAll();
   size_t getLoggedUsersCount();
+  size_t getLoadedChunksCount();
+  void updateViewDistanceBudget();
   bool configDirectoryPrepare(const std::string& path);
   
   static uint32_t generateEID()
@@ -126,6 +147,26 @@ public:
     return m_users;
   }
 
+  // User registry, User keeps it up to date. Nick lookups are not case-sensitive.
+  void addUser(User* user);
+  void removeUser(User* user);
+  void setUserNick(User* user, const std::string& nick);
+  User* userByNick(const std::string& nick) const;
+  User* userByUID(uint32_t uid) const;
+  User* userByFd(int fd) const;
+
+  // The same users as users(), indexable for the plugin API
+  inline User* userNumbered(size_t n) const
+  {
+    return n < m_userList.size() ? m_userList[n] : NULL;
+  }
+
+  // Current upper bound for every player's view distance
+  inline int viewDistanceCap() const
+  {
+    return m_viewDistanceCap;
+  }
+
   inline void setMap(Map* map, size_t n = 0)
   {
     m_map[n] = map;
@@ -151,6 +192,38 @@ public:
     return m_mobs;
   }
   
+  inline Pregen* pregen() const
+  {
+    return m_pregen;
+  }
+
+  inline TaskQueue* tasks() const
+  {
+    return m_tasks;
+  }
+
+  // NULL when system.user_validation is off
+  inline SessionValidator* validator() const
+  {
+    return m_validator;
+  }
+
+  inline LoginPipeline* loginPipeline() const
+  {
+    return m_loginPipeline;
+  }
+
+  inline PlayerStore* playerStore() const
+  {
+    return m_playerStore;
+  }
+
+  // NULL unless system.capture.file is set
+  inline PacketCapture* capture() const
+  {
+    return m_capture;
+  }
+
   inline Plugin* plugin() const
   {
     return m_plugin;
@@ -217,6 +290,18 @@ public:
   {
     return m_mapGen[n];
   }
+
+  // Replace the generator of map n
+  inline void setMapGen(size_t n, MapGen* gen)
+  {
+    m_mapGen[n] = gen;
+  }
+
+  // One instance of every generator, by the number used in map.storage.nbt.directories
+  inline const std::vector<MapGen*>& mapGenTypes() const
+  {
+    return m_mapGenNames;
+  }
   
   inline std::tr1::shared_ptr<Logger> logger() const
   {
@@ -246,8 +331,22 @@ private:
 
   event_base* m_eventBase;
 
+  // Lowered from m_viewDistanceMax while the server is over budget
+  int m_viewDistanceCap;
+  // Longest tick since the last budget check, in ms
+  uint32_t m_tickTimeMax;
+  // When the 10s and 1s timers last ran
+  time_t m_lastTenSeconds;
+  time_t m_lastSecond;
+
   // holds all connected users
   std::set<User*>    m_users;
+  std::vector<User*> m_userList;
+  std::tr1::unordered_map<User*, size_t> m_userListIndex;
+  // Every user using a nick, in the order they took it
+  std::tr1::unordered_map<std::string, std::vector<User*> > m_usersByNick;
+  std::tr1::unordered_map<uint32_t, User*>    m_usersByUID;
+  std::tr1::unordered_map<int, User*>         m_usersByFd;
 
   std::vector<Map*>                m_map;
   std::vector<Physics*>            m_physics;
@@ -266,6 +365,24 @@ private:
   PacketHandler*  m_packetHandler;
   Inventory*      m_inventory;
   Mobs*           m_mobs;
+  Pregen*         m_pregen;
+  TaskQueue*      m_tasks;
+  SessionValidator* m_validator;
+  LoginPipeline*  m_loginPipeline;
+  PlayerStore*    m_playerStore;
+  PacketCapture*  m_capture;
+
+  // system.stats_file, rewritten every second for tools like benchmarks/loadgen
+  std::string m_statsFile;
+  // Tick times since the start in TICK_HISTOGRAM_STEP us steps, the last step takes the rest
+  enum { TICK_HISTOGRAM_STEP = 100, TICK_HISTOGRAM_SIZE = 10000 };
+  std::vector<uint32_t> m_tickHistogram;
+
+  void indexNick(User* user);
+  void unindexNick(User* user);
+  void finishValidations();
+  void finishLogins();
+  void writeStats();
 };
 
 #endif
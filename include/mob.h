@@ -34,6 +34,7 @@
 
 #include "tr1.h"
 #include TR1INCLUDE(memory)
+#include TR1INCLUDE(unordered_map)
 
 #include "user.h"
 #include "constants.h"
@@ -82,28 +83,31 @@ typedef std::tr1::shared_ptr<Mob> MobPtr;
 class Mobs
 {
 public:
+  // A mob ID is the mob's slot in the low SLOT_BITS bits and the slot's
+  // generation above them. Removing a mob bumps the generation, so an ID kept
+  // after that finds nothing instead of the next mob given the slot.
+  enum { SLOT_BITS = 20, SLOT_MASK = (1 << SLOT_BITS) - 1, GENERATION_MASK = 0x7ff };
+
+  // Empty if there is no such mob (any more)
   inline MobPtr getMobByID(size_t id) const
   {
-    return id < m_moblist.size() ? m_moblist[id] : MobPtr();
+    const size_t slot = slotOf(id);
+    return slot != size_t(-1) ? m_moblist[slot] : MobPtr();
   }
 
+  // Mob ID of the mob with entity ID mobID, -1 if there is none
   inline size_t getMobByTarget(uint32_t mobID) const
   {
-    for (size_t i = 0; i < m_moblist.size(); ++i)
-    {
-      if (mobID == m_moblist[i]->UID)
-      {
-        return i;
-      }
-    }
-    return -1; // louisdx: This should be checked; at least it should cause a crash if used unchecked.
+    const std::tr1::unordered_map<uint32_t, size_t>::const_iterator it = m_slotByEID.find(mobID);
+    return it == m_slotByEID.end() ? size_t(-1) : idOf(it->second);
   }
 
   inline size_t getMobCount()
   {
-    return m_moblist.size();
+    return m_moblist.size() - m_freeSlots.size();
   }
 
+  // Indexed by slot, removed mobs leave an empty MobPtr behind
   inline std::vector<MobPtr>& getAll()
   {
     return m_moblist;
@@ -114,19 +118,64 @@ public:
     return m_moblist;
   }
 
-  inline void addMob(MobPtr mob)
+  size_t addMob(MobPtr mob);
+  MobPtr createMob();
+
+  // Forget a mob, its ID may be given to a new mob
+  void removeMob(size_t id);
+
+  // Run the batched "MobTick" hook over all mobs, every 200ms
+  void tick();
+
+  // Nearest user on map within maxDistance blocks of x,y,z, NULL if none.
+  // Only valid during tick(), users are indexed when it starts.
+  User* getNearestUser(int map, double x, double y, double z, double maxDistance, double* distance = NULL) const;
+
+private:
+  typedef std::pair<int, std::pair<int, int> > UserCell;
+
+  struct UserCellHash
   {
-    m_moblist.push_back(mob);
+    inline size_t operator()(const UserCell& c) const
+    {
+      return (size_t(c.first) * 73856093u) ^ (size_t(c.second.first) * 19349663u) ^ (size_t(c.second.second) * 83492791u);
+    }
+  };
+
+  // Users are put in cells of 2^USER_CELL_BITS blocks for getNearestUser()
+  enum { USER_CELL_BITS = 6 };
+
+  void indexUsers();
+
+  inline size_t idOf(size_t slot) const
+  {
+    return slot | (m_generation[slot] << SLOT_BITS);
   }
 
-  inline MobPtr createMob()
+  // Slot of mob ID id, -1 if it is out of range or from an earlier generation
+  inline size_t slotOf(size_t id) const
   {
-    MobPtr mob(new Mob);
-    addMob(mob);
-    return mob;
+    const size_t slot = id & SLOT_MASK;
+    if (slot >= m_moblist.size() || (id >> SLOT_BITS) != m_generation[slot])
+    {
+      return size_t(-1);
+    }
+    return slot;
   }
 
-private:
   std::vector<MobPtr> m_moblist;
+  std::vector<size_t> m_generation;
+  std::vector<size_t> m_freeSlots;
+  std::tr1::unordered_map<uint32_t, size_t> m_slotByEID;
+
+  // AI state kept for the plugins between ticks, indexed by slot
+  std::vector<int> m_aiState;
+  std::vector<double> m_aiValue;
+
+  // Component arrays handed to the "MobTick" hook, reused every tick
+  std::vector<int> m_id, m_type, m_map, m_health, m_state;
+  std::vector<double> m_x, m_y, m_z, m_yaw, m_pitch, m_headYaw, m_value;
+
+  std::tr1::unordered_map<UserCell, std::vector<User*>, UserCellHash> m_userCells;
 };
 #endif
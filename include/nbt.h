@@ -104,7 +104,7 @@ public:
 
   static NBT_Value* LoadFromFile(const std::string& filename);
   static NBT_Value* LoadFromMemory(uint8_t* buffer, uint32_t len);
-  void SaveToFile(const std::string& filename);
+  bool SaveToFile(const std::string& filename);
   void SaveToMemory(uint8_t* buffer, uint32_t* len);
 
   void Write(std::vector<uint8_t> &buffer);
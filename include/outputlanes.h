@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _OUTPUTLANES_H
+#define _OUTPUTLANES_H
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+class Packet;
+
+//
+// Outgoing messages of one connection that may wait their turn, by kind.
+//
+// Anything written to User::buffer goes out first, in order. Block updates,
+// chat, entity moves and chunk data wait here, and take() hands them on by
+// weighted round robin. The caller only takes a small window at a time, so a
+// burst of chunks never holds up the block change the player is waiting for.
+//
+// A block change for a chunk whose data is still queued is put behind that
+// chunk, the chunk data was serialized before the change. Later changes for
+// the chunk follow it there until the parked ones went out.
+//
+
+class OutputLanes
+{
+public:
+  enum Lane
+  {
+    LANE_BLOCK,
+    LANE_CHAT,
+    LANE_ENTITY, // entity moves and time updates
+    LANE_CHUNK,
+    LANE_COUNT,
+    LANE_CONTROL = LANE_COUNT // stays in User::buffer
+  };
+
+  // Bytes a lane may take per round for each point of weight
+  enum { QUANTUM = 1024 };
+
+  OutputLanes();
+
+  // The lane for data holding whole messages that all belong to the same one,
+  // LANE_CONTROL for anything else
+  static Lane classify(const uint8_t* data, size_t len);
+
+  void push(Lane lane, const uint8_t* data, size_t len);
+  // Chunk data for chunk x, z, replacing data for it that is still queued
+  void pushChunk(int32_t x, int32_t z, const uint8_t* data, size_t len);
+  // Forget queued data for chunk x, z, the client no longer needs it
+  void cancelChunk(int32_t x, int32_t z);
+  // The same for all chunks, when the player changes worlds
+  void cancelChunks();
+
+  // Appends messages to out by weight until at least budget bytes were
+  // taken or all lanes are empty, returns the bytes taken
+  size_t take(Packet& out, size_t budget);
+
+  void clear();
+
+  inline bool empty() const { return m_size == 0; }
+  inline size_t size() const { return m_size; }
+  inline size_t size(Lane lane) const { return m_lanes[lane].size; }
+
+  // Weight of each lane, the same for all connections
+  static unsigned int weights[LANE_COUNT];
+
+private:
+  struct Entry
+  {
+    size_t len;
+    bool chunk;     // chunk data for x, z
+    bool parked;    // block changes put behind chunk data
+    bool cancelled; // replaced or cancelled, skipped by take()
+    int32_t x;
+    int32_t z;
+  };
+
+  struct Queue
+  {
+    std::vector<uint8_t> data; // entries from start on
+    size_t start;
+    std::deque<Entry> entries;
+    size_t size;
+    size_t deficit;
+
+    Queue() : start(0), size(0), deficit(0) {}
+  };
+
+  void append(Lane lane, const uint8_t* data, size_t len, const Entry& entry);
+  void pop(Queue& queue);
+  void release(const std::pair<int32_t, int32_t>& chunk);
+
+  Queue m_lanes[LANE_COUNT];
+  // Chunks with data or parked block changes in LANE_CHUNK, and how many
+  std::map<std::pair<int32_t, int32_t>, size_t> m_pendingChunks;
+  size_t m_size;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _OUTPUTQUEUE_H
+#define _OUTPUTQUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include <openssl/evp.h>
+
+//
+// Outgoing bytes of one connection, ready to go on the wire.
+//
+// Data is encrypted straight into fixed size blocks as it is appended, and
+// flush() hands the queued blocks to the socket in one writev(). A partially
+// sent block just moves its start, nothing is copied again. Emptied blocks are
+// kept for reuse, up to SPARE_BLOCKS per connection.
+//
+
+struct OutputStats
+{
+  uint64_t queued;    // bytes appended
+  uint64_t encrypted; // of which went through a cipher
+  uint64_t sent;      // bytes the sockets took
+  uint64_t writes;    // write calls
+  uint64_t blocks;    // blocks allocated, not counting reuse
+  uint64_t dropped;   // moves and time updates skipped for congested connections
+  uint64_t congested; // times a connection went over the high watermark
+  uint64_t overflows; // connections closed for staying over the hard cap
+
+  OutputStats() : queued(0), encrypted(0), sent(0), writes(0), blocks(0),
+                  dropped(0), congested(0), overflows(0) {}
+};
+
+class OutputQueue
+{
+public:
+  enum
+  {
+    BLOCK_SIZE   = 16384,
+    SPARE_BLOCKS = 4,
+    MAX_IOV      = 64
+  };
+
+  OutputQueue();
+  ~OutputQueue();
+
+  // Queues len bytes, encrypting them with cipher unless it is NULL
+  void append(const uint8_t* data, size_t len, EVP_CIPHER_CTX* cipher = NULL);
+
+  // Writes as much as the socket takes, returns the bytes written or
+  // SOCKET_ERROR with errno (WSAGetLastError() on Windows) telling why
+  int flush(int fd);
+
+  void clear();
+
+  inline bool empty() const { return m_size == 0; }
+  inline size_t size() const { return m_size; }
+
+  // Totals over all connections
+  static OutputStats stats;
+
+private:
+  struct Block
+  {
+    size_t start;
+    size_t end;
+    uint8_t data[BLOCK_SIZE];
+  };
+
+  Block* newBlock();
+  void releaseFront();
+
+  // Not copyable, owns its blocks
+  OutputQueue(const OutputQueue&);
+  OutputQueue& operator=(const OutputQueue&);
+
+  std::deque<Block*> m_blocks;
+  std::vector<Block*> m_spare;
+  size_t m_size;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _PACKETCAPTURE_H
+#define _PACKETCAPTURE_H
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//
+// Records the packets clients send, as the handlers get them: decrypted and
+// framed. benchmarks/replaybench feeds a capture back to the server to
+// reproduce a session's load, with a copy of the world it was taken on.
+//
+// The file starts with "MSPC", a format version byte, the protocol version
+// byte and the start time (8 bytes, seconds since the epoch, big-endian).
+// Then one record per event:
+//   kind          1 byte, CONNECT, PACKET or DISCONNECT
+//   time          varint, microseconds since the previous record
+//   connection    varint, the user's UID
+// PACKET records go on with
+//   packet ID     1 byte
+//   length        varint
+//   body          length bytes, without the ID
+// Varints are 7 bits a byte, least significant first, the high bit set on
+// all but the last byte.
+//
+class PacketCapture
+{
+public:
+  enum Kind
+  {
+    CONNECT,
+    PACKET,
+    DISCONNECT
+  };
+
+  enum { FORMAT_VERSION = 1 };
+
+  struct Record
+  {
+    Kind kind;
+    uint64_t time;  // microseconds since the capture started
+    uint32_t connection;
+    uint8_t id;
+    std::vector<uint8_t> data;
+  };
+
+  PacketCapture();
+  ~PacketCapture();
+
+  bool open(const std::string& file, int protocol);
+  void close();
+
+  void connected(uint32_t connection);
+  void packet(uint32_t connection, uint8_t id, const uint8_t* data, size_t len);
+  void disconnected(uint32_t connection);
+
+  // Records are buffered, the main loop writes them out every second
+  void flush();
+
+  inline uint64_t records() const
+  {
+    return m_records;
+  }
+
+  class Reader
+  {
+  public:
+    Reader();
+    ~Reader();
+
+    bool open(const std::string& file);
+    // False at the end of the file, or when it is cut short
+    bool next(Record& record);
+
+    inline time_t started() const
+    {
+      return m_started;
+    }
+
+    inline int protocol() const
+    {
+      return m_protocol;
+    }
+
+  private:
+    bool readVarint(uint64_t& value);
+
+    FILE* m_file;
+    time_t m_started;
+    int m_protocol;
+    uint64_t m_time;
+  };
+
+private:
+  enum { FLUSH_SIZE = 1024 * 1024 };
+
+  void begin(Kind kind, uint32_t connection);
+  void putVarint(uint64_t value);
+
+  FILE* m_file;
+  std::vector<uint8_t> m_buffer;
+  uint64_t m_start;
+  uint64_t m_last;
+  uint64_t m_records;
+};
+
+#endif
@@ -0,0 +1,345 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _PACKETLAYOUT_H
+#define _PACKETLAYOUT_H
+
+//
+// Client packet layouts, declared once as a list of field types.
+//
+// Layout<...>::frame() looks at the bytes following the packet ID and returns the
+// length of the whole packet body, PACKET_NEED_MORE_DATA if it has not all arrived
+// yet or PACKET_MALFORMED if a length field is out of range. Packets made only of
+// fixed size fields are framed with a single compare, the size is worked out at
+// compile time. The socket code frames every packet before dispatching it, so
+// handlers only ever see complete packets.
+//
+// Span decodes big-endian fields out of contiguous memory with bounds checks,
+// once a read runs past the end the span turns invalid and further reads
+// return zeroes.
+//
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+#define PACKET_NEED_MORE_DATA -3
+#define PACKET_MALFORMED      -4
+
+namespace PacketLayout
+{
+  inline uint16_t get16(const uint8_t* p)
+  {
+    return uint16_t((p[0] << 8) | p[1]);
+  }
+
+  inline uint32_t get32(const uint8_t* p)
+  {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+  }
+
+  inline uint64_t get64(const uint8_t* p)
+  {
+    return (uint64_t(get32(p)) << 32) | get32(p + 4);
+  }
+
+  //
+  // Field types, each one knows its wire size (-1 when it depends on the data)
+  // and how to step over itself.
+  //
+
+  template <int N>
+  struct Fixed
+  {
+    enum { size = N };
+
+    static inline int skip(const uint8_t*, size_t len, size_t& pos)
+    {
+      if (len - pos < size_t(N))
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      pos += N;
+      return 0;
+    }
+  };
+
+  typedef Fixed<1> Byte;
+  typedef Fixed<2> Short;
+  typedef Fixed<4> Int;
+  typedef Fixed<8> Long;
+  typedef Fixed<4> Float;
+  typedef Fixed<8> Double;
+
+  // Terminates a layout
+  typedef Fixed<0> End;
+
+  // Short length followed by that many bytes (Unit = 2 for UCS-2 strings)
+  template <int Unit>
+  struct Array16
+  {
+    enum { size = -1 };
+
+    static inline int skip(const uint8_t* data, size_t len, size_t& pos)
+    {
+      if (len - pos < 2)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      const int16_t count = int16_t(get16(data + pos));
+      if (count < 0)
+      {
+        return PACKET_MALFORMED;
+      }
+      if (len - pos - 2 < size_t(count) * Unit)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      pos += 2 + size_t(count) * Unit;
+      return 0;
+    }
+  };
+
+  typedef Array16<2> String16;
+  typedef Array16<1> ShortBytes;
+
+  // Item slot: short ID, and unless it is -1 a byte count, short damage and
+  // a short length of gzipped NBT data (-1 for none)
+  struct Slot
+  {
+    enum { size = -1 };
+
+    static inline int skip(const uint8_t* data, size_t len, size_t& pos)
+    {
+      if (len - pos < 2)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      if (int16_t(get16(data + pos)) == -1)
+      {
+        pos += 2;
+        return 0;
+      }
+      if (len - pos < 7)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      const int16_t nbtLen = int16_t(get16(data + pos + 5));
+      if (nbtLen < -1)
+      {
+        return PACKET_MALFORMED;
+      }
+      const size_t total = 7 + (nbtLen > 0 ? size_t(nbtLen) : 0);
+      if (len - pos < total)
+      {
+        return PACKET_NEED_MORE_DATA;
+      }
+      pos += total;
+      return 0;
+    }
+  };
+
+  template <class F1,           class F2 = End, class F3 = End, class F4 = End,
+            class F5 = End, class F6 = End, class F7 = End, class F8 = End>
+  struct Layout
+  {
+    enum
+    {
+      isFixed = F1::size >= 0 && F2::size >= 0 && F3::size >= 0 && F4::size >= 0 &&
+                F5::size >= 0 && F6::size >= 0 && F7::size >= 0 && F8::size >= 0,
+      fixedSize = isFixed ? F1::size + F2::size + F3::size + F4::size +
+                            F5::size + F6::size + F7::size + F8::size : -1
+    };
+
+    static int frame(const uint8_t* data, size_t len)
+    {
+      if (isFixed)
+      {
+        return len >= size_t(fixedSize) ? int(fixedSize) : PACKET_NEED_MORE_DATA;
+      }
+
+      size_t pos = 0;
+      int ret;
+      if ((ret = F1::skip(data, len, pos)) < 0 || (ret = F2::skip(data, len, pos)) < 0 ||
+          (ret = F3::skip(data, len, pos)) < 0 || (ret = F4::skip(data, len, pos)) < 0 ||
+          (ret = F5::skip(data, len, pos)) < 0 || (ret = F6::skip(data, len, pos)) < 0 ||
+          (ret = F7::skip(data, len, pos)) < 0 || (ret = F8::skip(data, len, pos)) < 0)
+      {
+        return ret;
+      }
+      return int(pos);
+    }
+  };
+
+  // Packets with no body at all
+  typedef Layout<End> Empty;
+
+  class Span
+  {
+  public:
+    Span(const uint8_t* data, size_t len)
+      : m_data(data), m_len(len), m_pos(0), m_valid(true)
+    {
+    }
+
+    inline bool have(size_t count)
+    {
+      return m_valid = m_valid && (m_len - m_pos >= count);
+    }
+
+    inline operator bool() const { return m_valid; }
+    inline size_t pos() const { return m_pos; }
+    inline size_t left() const { return m_len - m_pos; }
+
+    inline Span& skip(size_t count)
+    {
+      if (have(count))
+      {
+        m_pos += count;
+      }
+      return *this;
+    }
+
+    inline Span& operator>>(int8_t& val)
+    {
+      val = have(1) ? int8_t(m_data[m_pos++]) : 0;
+      return *this;
+    }
+
+    inline Span& operator>>(int16_t& val)
+    {
+      val = 0;
+      if (have(2))
+      {
+        val = int16_t(get16(m_data + m_pos));
+        m_pos += 2;
+      }
+      return *this;
+    }
+
+    inline Span& operator>>(int32_t& val)
+    {
+      val = 0;
+      if (have(4))
+      {
+        val = int32_t(get32(m_data + m_pos));
+        m_pos += 4;
+      }
+      return *this;
+    }
+
+    inline Span& operator>>(int64_t& val)
+    {
+      val = 0;
+      if (have(8))
+      {
+        val = int64_t(get64(m_data + m_pos));
+        m_pos += 8;
+      }
+      return *this;
+    }
+
+    inline Span& operator>>(float& val)
+    {
+      int32_t ival;
+      *this >> ival;
+      memcpy(&val, &ival, 4);
+      return *this;
+    }
+
+    inline Span& operator>>(double& val)
+    {
+      int64_t ival;
+      *this >> ival;
+      memcpy(&val, &ival, 8);
+      return *this;
+    }
+
+    // UCS-2 string, kept as code units; Packet does the UTF-8 conversion
+    inline Span& readString16(std::vector<uint16_t>& str)
+    {
+      int16_t count;
+      *this >> count;
+      str.clear();
+      if (count > 0 && have(size_t(count) * 2))
+      {
+        str.resize(count);
+        for (int16_t i = 0; i < count; i++)
+        {
+          str[i] = get16(m_data + m_pos + 2 * i);
+        }
+        m_pos += size_t(count) * 2;
+      }
+      return *this;
+    }
+
+  private:
+    const uint8_t* m_data;
+    size_t m_len;
+    size_t m_pos;
+    bool m_valid;
+  };
+
+  //
+  // Client to server packets, the body after the packet ID
+  //
+
+  typedef Layout<Int>                                               KeepAlive;
+  // Pre-1.3 login, the handler ignores it and nothing is consumed
+  typedef Empty                                                     LoginRequest;
+  typedef Layout<Byte, String16, String16, Int>                     Handshake;
+  typedef Layout<String16>                                          ChatMessage;
+  typedef Layout<Int, Int, Byte>                                    UseEntity;
+  typedef Layout<Int, Byte, Byte, Short, String16>                  Respawn;
+  typedef Layout<Byte>                                              Player;
+  typedef Layout<Double, Double, Double, Double, Byte>              PlayerPosition;
+  typedef Layout<Float, Float, Byte>                                PlayerLook;
+  typedef Layout<Double, Double, Double, Double, Float, Float, Byte> PlayerPositionAndLook;
+  typedef Layout<Byte, Int, Byte, Int, Byte>                        PlayerDigging;
+  typedef Layout<Int, Byte, Int, Byte, Slot, Byte, Byte, Byte>      PlayerBlockPlacement;
+  typedef Layout<Short>                                             HoldingChange;
+  typedef Layout<Int, Byte>                                         Animation;
+  typedef Layout<Int, Byte>                                         EntityCrouch;
+  typedef Layout<Int, Short, Byte, Short, Int, Int, Int, Fixed<3> > PickupSpawn;
+  typedef Layout<Fixed<18> >                                        Weather;
+  typedef Layout<Int, Short>                                        IncrementStatistics;
+  typedef Layout<Int, Byte, Int, Byte, Byte>                        BlockChange;
+  typedef Layout<Byte>                                              InventoryClose;
+  typedef Layout<Byte, Short, Byte, Short, Byte, Slot>              InventoryChange;
+  typedef Layout<Byte, Short, Byte>                                 Transaction;
+  typedef Layout<Int, Short, Int, String16, String16, String16, String16> Sign;
+  typedef Layout<String16>                                          TabComplete;
+  typedef Layout<String16, Byte, Byte, Byte>                        ClientInfo;
+  typedef Layout<Byte>                                              ClientStatus;
+  typedef Layout<String16, ShortBytes>                              PluginMessage;
+  typedef Layout<ShortBytes, ShortBytes>                            EncryptionResponse;
+  typedef Empty                                                     Ping;
+  typedef Layout<String16>                                          Disconnect;
+}
+
+#endif
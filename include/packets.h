@@ -35,9 +35,8 @@
 #include <iterator>
 #include <stdint.h>
 
-#define PACKET_NEED_MORE_DATA -3
-#define PACKET_DOES_NOT_EXIST -2
-#define PACKET_VARIABLE_LEN   -1
+#include "packetlayout.h"
+
 #define PACKET_OK             0
 
 #ifndef M_PI
@@ -124,13 +123,21 @@ enum
 
 class Packet
 {
-  // A deque has random-access iterators, so we can track the read position in an integer.
-  typedef std::deque<uint8_t> BufferVector;
+  // Both buffers are contiguous: received data is framed and decoded in place,
+  // serialized data is handed to the OutputQueue in one piece
+  typedef std::vector<uint8_t> BufferVector;
+
+  // Buffers grown past this are given back when emptied
+  enum { KEEP_CAPACITY = 256 * 1024 };
 
 private:
   BufferVector m_readBuffer;
   BufferVector m_writeBuffer;
+  size_t m_readStart;
+  size_t m_readReserved;
   size_t m_readPos;
+  size_t m_readLimit;
+  bool m_inFrame;
   bool m_isValid;
 
 public:
@@ -138,7 +145,11 @@ public:
     :
     m_readBuffer(),
     m_writeBuffer(),
+    m_readStart(0),
+    m_readReserved(0),
     m_readPos(0),
+    m_readLimit(0),
+    m_inFrame(false),
     m_isValid(true) 
   {
   }
@@ -147,7 +158,7 @@ public:
 
   inline bool haveData(int requiredBytes)
   {
-    return m_isValid = m_isValid && (m_readPos + requiredBytes <= m_readBuffer.size());
+    return m_isValid = m_isValid && (m_readPos + requiredBytes <= m_readLimit);
   }
 
   inline operator bool() const
@@ -157,16 +168,76 @@ public:
 
   inline void reset()
   {
-    m_readPos = 0;
+    m_readPos = m_readStart;
+    m_readLimit = m_readBuffer.size();
+    m_inFrame = false;
     m_isValid = true;
   }
 
   inline void addToRead(const uint8_t* const data, const size_t len)
   {
+    compactRead();
     m_readBuffer.insert(m_readBuffer.end(), data, data + len);
+    m_readLimit = m_readBuffer.size();
     m_isValid = true;
   }
 
+  // Room for count more bytes at the end of the read buffer, for reading
+  // from the socket in place. Pass how many were filled to commitRead().
+  inline uint8_t* reserveRead(size_t count)
+  {
+    compactRead();
+    m_readReserved = m_readBuffer.size();
+    m_readBuffer.resize(m_readReserved + count);
+    return &m_readBuffer[0] + m_readReserved;
+  }
+
+  inline void commitRead(size_t count)
+  {
+    m_readBuffer.resize(m_readReserved + count);
+    m_readLimit = m_readBuffer.size();
+    m_isValid = true;
+  }
+
+  // Unread data, contiguous from the current read position
+  inline const uint8_t* readData() const
+  {
+    return m_readBuffer.empty() ? NULL : &m_readBuffer[0] + m_readPos;
+  }
+
+  inline size_t readAvailable() const
+  {
+    return m_readBuffer.size() - m_readPos;
+  }
+
+  // Limit reads to the next len bytes until removePacket()
+  inline void beginFrame(size_t len)
+  {
+    m_readLimit = m_readPos + len;
+    m_inFrame = true;
+  }
+
+private:
+  // Drops the packets already handled, before more data is appended
+  inline void compactRead()
+  {
+    if (!m_readStart)
+    {
+      return;
+    }
+    if (m_readStart == m_readBuffer.size() && m_readBuffer.capacity() > KEEP_CAPACITY)
+    {
+      BufferVector().swap(m_readBuffer);
+    }
+    else
+    {
+      m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + m_readStart);
+    }
+    m_readPos -= m_readStart;
+    m_readStart = 0;
+  }
+
+public:
   inline void addToWrite(const Packet& p)
   {
     m_writeBuffer.insert(m_writeBuffer.end(), p.m_writeBuffer.begin(), p.m_writeBuffer.end());
@@ -177,10 +248,17 @@ public:
     m_writeBuffer.insert(m_writeBuffer.end(), buffer, buffer + len);
   }
 
+  // Consumes the current frame, or everything read so far outside a frame
   inline void removePacket()
   {
-    m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + m_readPos);
-    m_readPos = 0;
+    if (m_inFrame)
+    {
+      m_readPos = m_readLimit;
+      m_inFrame = false;
+      m_isValid = true;
+    }
+    m_readStart = m_readPos;
+    m_readLimit = m_readBuffer.size();
   }
 
   Packet& operator<<(int8_t val);
@@ -209,28 +287,56 @@ public:
   {
     if (haveData(count))
     {
-      std::copy(m_readBuffer.begin() + m_readPos, m_readBuffer.begin() + m_readPos + count, buf);
+      memcpy(buf, &m_readBuffer[0] + m_readPos, count);
       m_readPos += count;
     }
   }
 
+  inline void skip(int count)
+  {
+    if (count > 0 && haveData(count))
+    {
+      m_readPos += count;
+    }
+  }
+
+  inline std::string readBytes(int count)
+  {
+    std::string str;
+    if (count > 0 && haveData(count))
+    {
+      str.assign(reinterpret_cast<const char*>(&m_readBuffer[0] + m_readPos), count);
+      m_readPos += count;
+    }
+    return str;
+  }
+
   inline bool getWriteEmpty() const
   {
     return m_writeBuffer.empty();
   }
 
-  inline void getWriteData(std::vector<char>& buf) const
+  inline const uint8_t* writeData() const
+  {
+    return m_writeBuffer.empty() ? NULL : &m_writeBuffer[0];
+  }
+
+  inline size_t writeSize() const
   {
-    buf.clear();
-    buf.resize(m_writeBuffer.size(), 0);
-    std::copy(m_writeBuffer.begin(), m_writeBuffer.end(), buf.begin());
+    return m_writeBuffer.size();
   }
 
-  inline void clearWrite(size_t count)
+  // Empties the write buffer, keeping its memory unless it grew unusually large
+  inline void clearWrite()
   {
-    BufferVector::iterator it = m_writeBuffer.begin();
-    std::advance(it, count);
-    m_writeBuffer.erase(m_writeBuffer.begin(), it);
+    if (m_writeBuffer.capacity() > KEEP_CAPACITY)
+    {
+      BufferVector().swap(m_writeBuffer);
+    }
+    else
+    {
+      m_writeBuffer.clear();
+    }
   }
 };
 
@@ -238,22 +344,25 @@ public:
 struct Packets
 {
   typedef int (*handler_function)(User*);
+  // Returns the body length of the packet at data, see packetlayout.h
+  typedef int (*frame_function)(const uint8_t* data, size_t len);
 
-  int len;
+  frame_function frame;
   handler_function function;
 
-  Packets(int newlen = PACKET_DOES_NOT_EXIST)
-  : len(newlen)
+  // A packet without a frame function does not exist
+  Packets()
+  : frame(NULL), function(NULL)
   {
   }
 
-  Packets(int newlen, handler_function newfunction)
-  : len(newlen), function(newfunction)
+  Packets(frame_function newframe, handler_function newfunction)
+  : frame(newframe), function(newfunction)
   {
   }
 
   Packets(const Packets & other)
-  : len(other.len), function(other.function)
+  : frame(other.frame), function(other.function)
   {
   }
 };
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _PLAYERSTORE_H
+#define _PLAYERSTORE_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "loginpipeline.h"
+
+//
+// Reads and writes player files on a thread of its own, so that a save of
+// everyone or a crowd logging out does not stall the main loop.
+//
+// save() only copies the player's state, the thread builds the NBT and
+// writes it to a temporary file which is then renamed over the old one, so
+// a crash never leaves half a file. A save for a file that still has one
+// queued replaces it, only the newest state gets written.
+//
+// preload() reads a file ahead, during the login handshake, and load() takes
+// the newest state there is for a file: a queued save, a preloaded copy or
+// the file itself, read on the calling thread. load() may be called from
+// any thread, the login workers use it.
+//
+class PlayerStore
+{
+public:
+  typedef LoginPipeline::PlayerData PlayerData;
+
+  struct Stats
+  {
+    uint64_t saves;      // save() calls
+    uint64_t coalesced;  // of which replaced a save still queued
+    uint64_t written;    // files written
+    uint64_t failed;     // files that could not be written
+    uint64_t preloads;   // files read ahead
+    uint64_t hits;       // load() calls answered without reading
+
+    Stats() : saves(0), coalesced(0), written(0), failed(0), preloads(0), hits(0) {}
+  };
+
+  // At most cacheLimit preloaded files are kept waiting for their login
+  explicit PlayerStore(size_t cacheLimit);
+  ~PlayerStore();
+
+  bool start();
+  // Writes everything still queued, then stops the thread
+  void stop();
+
+  void save(const std::string& file, const PlayerData& data);
+  void preload(const std::string& file);
+  bool load(const std::string& file, PlayerData& data);
+
+  // Saves queued or being written
+  size_t pending();
+  Stats stats();
+
+  // Writes a player file, the counterpart of LoginPipeline::readPlayerData()
+  static bool write(const std::string& file, const PlayerData& data);
+
+private:
+  enum JobType
+  {
+    SAVE,
+    PRELOAD
+  };
+
+  struct Job
+  {
+    JobType type;
+    std::string file;
+  };
+
+  struct Pending
+  {
+    PlayerData data;
+    // Bumped by every save(), tells the writer whether it wrote the newest
+    uint32_t version;
+  };
+
+  static void* run(void* arg);
+  void work();
+  void trimCache();
+
+  size_t m_cacheLimit;
+  bool m_running;
+  bool m_started;
+  pthread_t m_thread;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_wakeup;
+  std::deque<Job> m_jobs;
+  std::map<std::string, Pending> m_pending;
+  std::map<std::string, PlayerData> m_cache;
+  std::deque<std::string> m_cacheOrder;
+  Stats m_stats;
+};
+
+#endif
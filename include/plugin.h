@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 #include <ctime>
+#include <stdint.h>
 
 #include "tr1.h"
 #include TR1INCLUDE(memory)
@@ -94,6 +95,87 @@ static char *LIBRARY_ERROR(void)
 // Foe INCONSISTENCY fainted!
 // You got 374¥ for winning!
 
+struct mob_batch;
+
+// Built-in hooks, Plugin::Plugin() registers each of them under this ID
+enum HookID
+{
+  HOOK_TIMER200,
+  HOOK_TIMER1000,
+  HOOK_TIMER10000,
+  HOOK_PLAYER_LOGIN_PRE,
+  HOOK_PLAYER_LOGIN_POST,
+  HOOK_PLAYER_NICK_POST,
+  HOOK_PLAYER_KICK_POST,
+  HOOK_PLAYER_QUIT_POST,
+  HOOK_PLAYER_CHAT_PRE,
+  HOOK_PLAYER_CHAT_POST,
+  HOOK_PLAYER_ARM_SWING,
+  HOOK_PLAYER_DAMAGE_PRE,
+  HOOK_PLAYER_DAMAGE_POST,
+  HOOK_PLAYER_DISCONNECT,
+  HOOK_PLAYER_DIGGING_STARTED,
+  HOOK_PLAYER_DIGGING,
+  HOOK_PLAYER_DIGGING_STOPPED,
+  HOOK_PLAYER_BLOCK_INTERACT,
+  HOOK_BLOCK_BREAK_PRE,
+  HOOK_BLOCK_BREAK_POST,
+  HOOK_BLOCK_NEIGHBOUR_BREAK,
+  HOOK_BLOCK_PLACE_PRE,
+  HOOK_ITEM_RIGHT_CLICK_PRE,
+  HOOK_BLOCK_PLACE_POST,
+  HOOK_BLOCK_NEIGHBOUR_PLACE,
+  HOOK_BLOCK_REPLACE_PRE,
+  HOOK_BLOCK_REPLACE_POST,
+  HOOK_BLOCK_NEIGHBOUR_REPLACE,
+  HOOK_LOG_POST,
+  HOOK_PLAYER_CHAT_COMMAND,
+  HOOK_PLAYER_RESPAWN,
+  HOOK_GOT_ATTACKED,
+  HOOK_INTERACT,
+  HOOK_MOB_TICK,
+  HOOK_BUILTIN_COUNT
+};
+
+// Name and type of the built-in hooks, lets the server fire them without a lookup or a cast:
+//   ServerInstance->plugin()->hook<HOOK_PLAYER_DIGGING>()->doAll(...)
+template <int ID> struct HookTraits;
+
+template <> struct HookTraits<HOOK_TIMER200> { typedef Hook0<bool> type; static const char* name() { return "Timer200"; } };
+template <> struct HookTraits<HOOK_TIMER1000> { typedef Hook0<bool> type; static const char* name() { return "Timer1000"; } };
+template <> struct HookTraits<HOOK_TIMER10000> { typedef Hook0<bool> type; static const char* name() { return "Timer10000"; } };
+template <> struct HookTraits<HOOK_PLAYER_LOGIN_PRE> { typedef Hook2<bool, const char*, char**> type; static const char* name() { return "PlayerLoginPre"; } };
+template <> struct HookTraits<HOOK_PLAYER_LOGIN_POST> { typedef Hook1<bool, const char*> type; static const char* name() { return "PlayerLoginPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_NICK_POST> { typedef Hook2<bool, const char*, const char*> type; static const char* name() { return "PlayerNickPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_KICK_POST> { typedef Hook2<bool, const char*, const char*> type; static const char* name() { return "PlayerKickPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_QUIT_POST> { typedef Hook1<bool, const char*> type; static const char* name() { return "PlayerQuitPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_CHAT_PRE> { typedef Hook3<bool, const char*, time_t, const char*> type; static const char* name() { return "PlayerChatPre"; } };
+template <> struct HookTraits<HOOK_PLAYER_CHAT_POST> { typedef Hook3<bool, const char*, time_t, const char*> type; static const char* name() { return "PlayerChatPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_ARM_SWING> { typedef Hook1<bool, const char*> type; static const char* name() { return "PlayerArmSwing"; } };
+template <> struct HookTraits<HOOK_PLAYER_DAMAGE_PRE> { typedef Hook3<bool, const char*, const char*, int> type; static const char* name() { return "PlayerDamagePre"; } };
+template <> struct HookTraits<HOOK_PLAYER_DAMAGE_POST> { typedef Hook3<bool, const char*, const char*, int> type; static const char* name() { return "PlayerDamagePost"; } };
+template <> struct HookTraits<HOOK_PLAYER_DISCONNECT> { typedef Hook3<bool, const char*, uint32_t, uint16_t> type; static const char* name() { return "PlayerDisconnect"; } };
+template <> struct HookTraits<HOOK_PLAYER_DIGGING_STARTED> { typedef Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t> type; static const char* name() { return "PlayerDiggingStarted"; } };
+template <> struct HookTraits<HOOK_PLAYER_DIGGING> { typedef Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t> type; static const char* name() { return "PlayerDigging"; } };
+template <> struct HookTraits<HOOK_PLAYER_DIGGING_STOPPED> { typedef Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t> type; static const char* name() { return "PlayerDiggingStopped"; } };
+template <> struct HookTraits<HOOK_PLAYER_BLOCK_INTERACT> { typedef Hook4<bool, const char*, int32_t, int16_t, int32_t> type; static const char* name() { return "PlayerBlockInteract"; } };
+template <> struct HookTraits<HOOK_BLOCK_BREAK_PRE> { typedef Hook4<bool, const char*, int32_t, int16_t, int32_t> type; static const char* name() { return "BlockBreakPre"; } };
+template <> struct HookTraits<HOOK_BLOCK_BREAK_POST> { typedef Hook4<bool, const char*, int32_t, int16_t, int32_t> type; static const char* name() { return "BlockBreakPost"; } };
+template <> struct HookTraits<HOOK_BLOCK_NEIGHBOUR_BREAK> { typedef Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t> type; static const char* name() { return "BlockNeighbourBreak"; } };
+template <> struct HookTraits<HOOK_BLOCK_PLACE_PRE> { typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t> type; static const char* name() { return "BlockPlacePre"; } };
+template <> struct HookTraits<HOOK_ITEM_RIGHT_CLICK_PRE> { typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t> type; static const char* name() { return "ItemRightClickPre"; } };
+template <> struct HookTraits<HOOK_BLOCK_PLACE_POST> { typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t> type; static const char* name() { return "BlockPlacePost"; } };
+template <> struct HookTraits<HOOK_BLOCK_NEIGHBOUR_PLACE> { typedef Hook4<bool, const char*, int32_t, int16_t, int32_t> type; static const char* name() { return "BlockNeighbourPlace"; } };
+template <> struct HookTraits<HOOK_BLOCK_REPLACE_PRE> { typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t> type; static const char* name() { return "BlockReplacePre"; } };
+template <> struct HookTraits<HOOK_BLOCK_REPLACE_POST> { typedef Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t> type; static const char* name() { return "BlockReplacePost"; } };
+template <> struct HookTraits<HOOK_BLOCK_NEIGHBOUR_REPLACE> { typedef Hook9<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t, int16_t, int16_t> type; static const char* name() { return "BlockNeighbourReplace"; } };
+template <> struct HookTraits<HOOK_LOG_POST> { typedef Hook3<bool, int, const char*, const char*> type; static const char* name() { return "LogPost"; } };
+template <> struct HookTraits<HOOK_PLAYER_CHAT_COMMAND> { typedef Hook4<bool, const char*, const char*, int, const char**> type; static const char* name() { return "PlayerChatCommand"; } };
+template <> struct HookTraits<HOOK_PLAYER_RESPAWN> { typedef Hook1<bool, const char*> type; static const char* name() { return "PlayerRespawn"; } };
+template <> struct HookTraits<HOOK_GOT_ATTACKED> { typedef Hook2<bool, const char*, int32_t> type; static const char* name() { return "gotAttacked"; } };
+template <> struct HookTraits<HOOK_INTERACT> { typedef Hook2<bool, const char*, int32_t> type; static const char* name() { return "interact"; } };
+template <> struct HookTraits<HOOK_MOB_TICK> { typedef Hook1<bool, mob_batch*> type; static const char* name() { return "MobTick"; } };
+
 typedef std::tr1::shared_ptr<BlockBasic> BlockBasicPtr;
 typedef std::tr1::shared_ptr<ItemBasic>  ItemBasicPtr;
 
@@ -101,7 +183,7 @@ class Plugin
 {
 public:
 
-  typedef std::tr1::unordered_map<std::string, Hook*> HookMap;
+  typedef std::tr1::unordered_map<std::string, int> HookIDMap;
   typedef std::tr1::unordered_map<std::string, LIBRARY_HANDLE> LibHandleMap;
   typedef std::tr1::unordered_map<std::string, void*> PointerMap;
   typedef std::tr1::unordered_map<std::string, float> VersionMap;
@@ -113,14 +195,19 @@ public:
   ~Plugin();
 
   // Hook registry stuff
-  inline bool  hasHook(const HookMap::key_type& name) const { return m_hooks.count(name) > 0; }
-  inline HookMap::mapped_type getHook(const HookMap::key_type& name) const
+  // A hook name gets its ID the first time it is set and keeps it, resolve it once and use the ID after that
+  inline int   getHookID(const std::string& name) const
   {
-    HookMap::const_iterator hook = m_hooks.find(name);
-    return hook == m_hooks.end() ? NULL : hook->second;
+    HookIDMap::const_iterator id = m_hookIDs.find(name);
+    return id == m_hookIDs.end() ? -1 : id->second;
   }
-  inline void  setHook(const HookMap::key_type& name, HookMap::mapped_type hook) { m_hooks[name] = hook; }
-  inline void  remHook(const HookMap::key_type& name) { m_hooks.erase(name); /* erases 0 or 1 elements */ }
+  inline Hook* getHook(int id) const { return (id >= 0 && size_t(id) < m_hooks.size()) ? m_hooks[id] : NULL; }
+  inline Hook* getHook(const std::string& name) const { return getHook(getHookID(name)); }
+  inline bool  hasHook(const std::string& name) const { return getHook(name) != NULL; }
+  template <int ID>
+  inline typename HookTraits<ID>::type* hook() const { return static_cast<typename HookTraits<ID>::type*>(m_hooks[ID]); }
+  int          setHook(const std::string& name, Hook* hook);
+  inline void  remHook(const std::string& name) { const int id = getHookID(name); if (id != -1) m_hooks[id] = NULL; /* the ID stays reserved */ }
 
   // Load/Unload plugins
   bool loadPlugin(const std::string& name, const std::string& path = "", std::string alias = "");
@@ -153,7 +240,15 @@ public:
   inline const ItemCBs  & getItemCB()  const { return m_item_CBs; }
 
 private:
-  HookMap      m_hooks;
+  template <int ID>
+  inline void setBuiltinHook()
+  {
+    m_hookIDs[HookTraits<ID>::name()] = ID;
+    m_hooks[ID] = new typename HookTraits<ID>::type;
+  }
+
+  HookIDMap    m_hookIDs;
+  std::vector<Hook*> m_hooks;
   LibHandleMap m_libraryHandles;
   PointerMap   m_pointers;
   VersionMap   m_pluginVersions;
@@ -87,7 +87,20 @@ struct plugin_pointer_struct
   bool (*doUntilFalse)(const char* hookID, ...);
   void (*doAll)(const char* hookID, ...);
 
-  void* temp[10];
+  // Resolve a hook name once, getHookByID() is then a plain array lookup
+  int (*getHookID)(const char* hookID);
+#ifdef USE_HOOKS
+  Hook*(*getHookByID)(int id);
+#else
+  void*(*getHookByID)(int id);
+#endif
+
+  // Call step(data) a little every tick until it returns false, then done(data, false).
+  // Cancelled tasks get done(data, true). Cancel your tasks before the plugin unloads.
+  int (*addTask)(const char* name, bool (*step)(void* data), void (*done)(void* data, bool cancelled), void* data);
+  bool (*cancelTask)(int id);
+
+  void* temp[6];
 };
 
 struct user_pointer_struct
@@ -109,8 +122,14 @@ struct user_pointer_struct
   bool (*kick)(const char* user);
   bool (*getItemAt)(const char* user, int slot, int* type, int* meta, int* quant);
   bool (*setItemAt)(const char* user, int slot, int type, int meta, int quant);
+  bool (*setViewDistance)(const char* user, int distance);
+  int (*getViewDistance)(const char* user);
+  // Handles stay valid while the user is online and are never reused, -1 if there is no such user
+  int (*getHandle)(const char* user);
+  const char* (*getNickByHandle)(int handle);
+  bool (*getPositionWByHandle)(int handle, double* x, double* y, double* z, int* w, float* yaw, float* pitch, double* stance);
 
-  void* temp[96];
+  void* temp[91];
 };
 
 struct chat_pointer_struct
@@ -128,6 +147,19 @@ struct logger_pointer_struct
   void* temp[100];
 };
 
+// Read-only view of one 16x16x16 chunk section, indexed x + (z << 4) + (y << 8) in
+// section coordinates. The pointers stay good until control returns to the server;
+// compare version with getSectionVersion() to see whether the section changed since.
+struct map_section_view
+{
+  const unsigned char* blocks;     // 4096 block types
+  const unsigned char* data;       // 2048 bytes of 4 bit metas, even x in the low nibble
+  const unsigned char* blocklight; // 2048 bytes, same layout as data
+  const unsigned char* skylight;   // 2048 bytes, same layout as data
+  unsigned int version;
+  bool present;                    // false if the section holds only air
+};
+
 struct map_pointer_struct
 {
   void (*createPickupSpawn)(int x, int y, int z, int type, int count, int health, const char* user);
@@ -144,7 +176,30 @@ struct map_pointer_struct
   unsigned char*(*getMapData_blocklight)(int x, int z);
   bool (*getBlockW)(int x, int y, int z, int w, unsigned char* type, unsigned char* meta);
   bool (*setBlockW)(int x, int y, int z, int w, unsigned char type, unsigned char meta);
-  void* temp[100];
+  // Background pregeneration of chunks x1..x2, z1..z2 or a radius around spawn, see Pregen
+  bool (*pregen)(int w, int x1, int z1, int x2, int z2);
+  bool (*pregenRadius)(int w, int radius);
+  bool (*pregenStop)(int w);
+  bool (*pregenStatus)(int w, int* done, int* total, double* chunksPerSec, int* etaSeconds);
+  // Set every block of the box (only those of type from, unless from is -1) to type/meta,
+  // writing straight into chunk storage with one update per chunk. fillChunk only does
+  // the part of the box in chunk cx,cz, to spread large edits over ticks with plugin.addTask.
+  // Both return the number of blocks changed.
+  int (*fill)(int w, int x1, int y1, int z1, int x2, int y2, int z2, int from, int type, int meta);
+  int (*fillChunk)(int w, int cx, int cz, int x1, int y1, int z1, int x2, int y2, int z2, int from, int type, int meta);
+  // Copy a box of block types and metas (either buffer may be NULL) into buffers of
+  // (x2-x1+1)*(z2-z1+1)*(y2-y1+1) bytes, y running fastest, then z, then x. Chunks that
+  // are not loaded read as air. Returns the number of blocks read from loaded chunks.
+  int (*getBlocks)(int w, int x1, int y1, int z1, int x2, int y2, int z2, unsigned char* types, unsigned char* metas);
+  // Write a box in the same layout, metas may be NULL. Returns the number of blocks changed.
+  int (*setBlocks)(int w, int x1, int y1, int z1, int x2, int y2, int z2, const unsigned char* types, const unsigned char* metas);
+  // Height of the highest non-air block in a column, -1 if none or the chunk is not loaded
+  int (*getTopBlock)(int w, int x, int z, unsigned char* type, unsigned char* meta);
+  // Section cy (0..15) of chunk cx,cz, false if the chunk is not loaded
+  bool (*getSectionView)(int w, int cx, int cy, int cz, struct map_section_view* view);
+  // 0 if the chunk is not loaded
+  unsigned int (*getSectionVersion)(int w, int cx, int cy, int cz);
+  void* temp[89];
 };
 
 struct config_pointer_struct
@@ -159,28 +214,52 @@ struct config_pointer_struct
   void* temp[100];
 };
 
+// All mobs as one array per component, handed to the "MobTick" hook every 200ms.
+// Changes to positions, looks, health and AI state are applied after the callbacks ran.
+struct mob_batch
+{
+  int count;
+  const int* id; // mob ID for the mob_pointer_struct functions
+  const int* type;
+  double* x;
+  double* y;
+  double* z;
+  int* map;
+  double* yaw;
+  double* pitch;
+  double* head_yaw;
+  int* health;
+  int* ai_state;    // Free for the AI, kept between ticks
+  double* ai_value; // Free for the AI, kept between ticks
+};
+
+// Mob IDs stop working once the mob is removed: functions taking one return
+// false, -1 or 0 for it, even if the ID's slot went to a new mob since
 struct mob_pointer_struct
 {
   int (*createMob)(int type);
   int (*createSpawnMob)(int type);
-  void (*spawnMob)(int uid);
-  void (*despawnMob)(int uid);
-  void (*moveMob)(int uid, double x, double y, double z);
-  void (*moveMobW)(int uid, double x, double y, double z, int map);
+  bool (*spawnMob)(int uid);
+  bool (*despawnMob)(int uid);
+  bool (*moveMob)(int uid, double x, double y, double z);
+  bool (*moveMobW)(int uid, double x, double y, double z, int map);
   bool (*getMobPositionW)(int uid, double* x, double* y, double* z, int* w);
   int (*getMobID)(int uid);
   int (*getHealth)(int uid);
-  void (*setHealth)(int uid, int mobHealth);
+  bool (*setHealth)(int uid, int mobHealth);
   int (*getType)(size_t uid);
   bool (*getLook)(int uid, double* yaw, double* pitch, double *head_yaw);
   bool (*setLook)(int uid, double yaw, double pitch, double head_yaw);
-  void (*moveAnimal)(const char* userIn, size_t mobID);
-  void (*animateMob)(const char* userIn, size_t mobID, int animID);
-  void (*animateDamage)(const char* userIn, size_t mobID, int animID);
+  bool (*moveAnimal)(const char* userIn, size_t mobID);
+  bool (*animateMob)(const char* userIn, size_t mobID, int animID);
+  bool (*animateDamage)(const char* userIn, size_t mobID, int animID);
   bool (*setByteMetadata)(int uid, int8_t idx, int8_t byte);
   bool (*updateMetadata)(int uid);
   int8_t (*getByteMetadata)(int uid, int idx);
-  void* temp[97];
+  void (*removeMob)(int uid);
+  int (*getMobByEID)(int eid);
+  bool (*getNearestPlayer)(int map, double x, double y, double z, double maxDistance, const char** nick, double* distance);
+  void* temp[94];
 
 };
 
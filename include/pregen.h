@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _PREGEN_H
+#define _PREGEN_H
+
+#include <stdint.h>
+#include <ctime>
+#include <string>
+#include <vector>
+
+//
+// Generates a rectangle of chunks ahead of time, a slice of every main loop
+// tick at a time. Chunks are written to the region files and released as
+// soon as no later chunk of the rectangle needs them as a neighbour, so only
+// about three columns stay loaded. Progress is kept in pregen.txt in the map
+// directory and picked up again by resume() after a restart.
+//
+class Pregen
+{
+public:
+  Pregen();
+
+  // Generate the chunks x1..x2, z1..z2 of map, replacing a job already on that map
+  bool start(size_t map, int x1, int z1, int x2, int z2);
+  // Generate the square of chunks reaching radius chunks out from the map's spawn
+  bool startRadius(size_t map, int radius);
+  bool stop(size_t map);
+
+  // False if there is no job on the map. Rate and ETA cover this run only.
+  bool status(size_t map, int* done, int* total, double* chunksPerSec, int* etaSeconds) const;
+
+  // Restart the jobs an earlier run left unfinished
+  void resume();
+
+  // Generate until this tick's share (map.pregen.share percent) is used up
+  void update();
+
+private:
+  struct Job
+  {
+    size_t map;
+    int x1, z1, x2, z2;
+    // Chunks done, column by column (x major)
+    int done;
+    int doneAtStart;
+    uint64_t started;
+    time_t lastReport;
+
+    int total() const { return (x2 - x1 + 1) * (z2 - z1 + 1); }
+  };
+
+  std::vector<Job> m_jobs;
+  int m_share;
+
+  Job* find(size_t map);
+  const Job* find(size_t map) const;
+  std::string progressFile(size_t map) const;
+  void saveProgress(const Job& job) const;
+  void releaseColumn(const Job& job, int x) const;
+  void report(const Job& job) const;
+};
+
+#endif
@@ -247,6 +247,15 @@ class Protocol
       return ret;
     }
 
+    static Packet pickupSpawn(int eid, int16_t item, int8_t count, int16_t health, int x, int y, int z)
+    {
+      Packet ret;
+      ret << (int8_t)PACKET_PICKUP_SPAWN << (int32_t)eid << (int16_t)item << (int8_t)count << (int16_t)health
+          << (int32_t)x << (int32_t)y << (int32_t)z
+          << (int8_t)0 << (int8_t)0 << (int8_t)0;
+      return ret;
+    }
+
     static Packet preChunk(int x, int z, bool create)
     {
       Packet ret;
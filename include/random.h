@@ -95,4 +95,59 @@ double uniform01();
   return uni(prng);\
 }\
 
+
+/// Counter-based generator for world generation. The n-th number of a stream
+/// is a hash of (world seed, chunk x, chunk z, feature, n), nothing is shared
+/// between streams: a chunk is decorated the same in whatever order, or on
+/// whatever thread, the chunks are generated.
+
+class ChunkRNG
+{
+public:
+  /// Feature ids, one stream per feature and chunk
+  enum Feature
+  {
+    TERRAIN = 1,
+    TREES   = 2,
+    ORE     = 0x100  // + block type of the ore
+  };
+
+  ChunkRNG(int64_t seed, int32_t chunkX, int32_t chunkZ, uint32_t feature);
+
+  inline uint32_t next()
+  {
+    return uint32_t(mix(m_key + ++m_counter * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+
+  /// Uniform in [0, n), 0 for n = 0
+  inline uint32_t below(uint32_t n)
+  {
+    return uint32_t((uint64_t(next()) * n) >> 32);
+  }
+
+  /// Uniform in [min, max]
+  inline int32_t between(int32_t min, int32_t max)
+  {
+    return min + int32_t(below(uint32_t(max - min) + 1));
+  }
+
+  /// Uniform in [0, 1], like uniform01()
+  inline double uniform01()
+  {
+    return double(next()) / 4294967295.0;
+  }
+
+private:
+  // SplitMix64 finalizer
+  static inline uint64_t mix(uint64_t z)
+  {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t m_key;
+  uint64_t m_counter;
+};
+
 #endif
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _SESSIONVALIDATOR_H
+#define _SESSIONVALIDATOR_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <pthread.h>
+
+//
+// Checks logins against the session server on a fixed pool of worker threads.
+//
+// submit() queues a check (the queue is bounded, a full queue refuses it) and
+// the main loop collects finished checks with poll() every tick. Each worker
+// keeps its HTTP connection to the session server alive between requests.
+// A check that cannot be answered within the timeout, counted from submit(),
+// fails rather than holding the login up. Answers are cached for a while per
+// nick and server hash, so a client retrying the same handshake is not sent
+// to the session server again.
+//
+class SessionValidator
+{
+public:
+  struct Result
+  {
+    uint32_t UID;
+    std::string nick;
+    bool valid;
+    // The session server could not be asked, or did not answer in time
+    bool failed;
+  };
+
+  struct Stats
+  {
+    uint64_t requests;
+    uint64_t cacheHits;
+    uint64_t refused;   // queue was full
+    uint64_t connects;  // new connections to the session server
+    uint64_t timeouts;
+    uint64_t failures;  // other errors
+
+    Stats() : requests(0), cacheHits(0), refused(0), connects(0), timeouts(0), failures(0) {}
+  };
+
+  SessionValidator(const std::string& host, int port, int workers, size_t queueLimit,
+                   uint32_t timeoutMs, uint32_t cacheSeconds);
+  ~SessionValidator();
+
+  bool start();
+  // Waits for the workers, checks still queued are dropped
+  void stop();
+
+  // Returns false if the queue is full
+  bool submit(uint32_t UID, const std::string& nick, const std::string& serverHash);
+  // Appends the checks finished since the last call
+  void poll(std::vector<Result>& results);
+
+  size_t queued();
+  Stats stats();
+
+private:
+  struct Request
+  {
+    uint32_t UID;
+    std::string nick;
+    std::string serverHash;
+    uint64_t deadline;
+  };
+
+  struct CacheEntry
+  {
+    bool valid;
+    uint64_t expires;
+  };
+
+  // One HTTP connection per worker
+  struct Connection
+  {
+    int fd;
+    std::string buffer;
+    Connection() : fd(-1) {}
+  };
+
+  static void* run(void* arg);
+  void work();
+  bool check(Connection& conn, const Request& request, bool& valid, bool& timedOut);
+  bool connectTo(Connection& conn, uint64_t deadline, bool& timedOut);
+  bool get(Connection& conn, const std::string& path, uint64_t deadline, std::string& body, bool& timedOut);
+  int receive(Connection& conn, uint64_t deadline, bool& timedOut);
+  void disconnect(Connection& conn);
+  void complete(const Request& request, bool valid, bool failed);
+
+  static uint64_t nowMs();
+
+  std::string m_host;
+  int m_port;
+  int m_workerCount;
+  size_t m_queueLimit;
+  uint32_t m_timeout;
+  uint32_t m_cacheTime;
+
+  std::vector<pthread_t> m_workers;
+  bool m_running;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_wakeup;
+  std::deque<Request> m_queue;
+  std::vector<Result> m_done;
+  std::map<std::string, CacheEntry> m_cache;
+  Stats m_stats;
+};
+
+#endif
@@ -25,6 +25,11 @@
   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#ifndef _SOCKETS_H
+#define _SOCKETS_H
+
+#include <stdint.h>
+
 /*
   We declare functions that serve as C callbacks explicitly as 'extern "C"'
   to avoid any potential ABI incompatibilities.
@@ -33,5 +38,20 @@ class User;
 
 extern "C" void accept_callback(int fd, short ev, void* arg);
 extern "C" void client_callback(int fd, short ev, void* arg);
-extern "C" void *user_validation_thread(void *arg);
 bool client_write(User *user);
+//Handles the complete packets in the user's read buffer, false if the user was deleted
+bool client_dispatch(User* user);
+
+//Totals over all connections, for profiling the read path
+struct InputStats
+{
+  uint64_t wakeups;  // read events handled
+  uint64_t reads;    // recv calls
+  uint64_t received; // bytes
+
+  InputStats() : wakeups(0), reads(0), received(0) {}
+};
+
+extern InputStats inputStats;
+
+#endif
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _TASKQUEUE_H
+#define _TASKQUEUE_H
+
+#include <stdint.h>
+#include <string>
+#include <list>
+
+//
+// Runs long jobs (mostly plugin commands) a step at a time across main loop
+// ticks. Tasks take turns, and update() stops handing out steps once the
+// tick's budget (system.tasks.budget ms) is used up, so a step should only
+// do a small piece of work, like one chunk of an edit.
+//
+class TaskQueue
+{
+public:
+  // Return true while there is work left
+  typedef bool (*Step)(void* data);
+  // Called once when the task finished or was cancelled
+  typedef void (*Done)(void* data, bool cancelled);
+
+  TaskQueue();
+  ~TaskQueue();
+
+  // Returns the task id
+  int add(const std::string& name, Step step, Done done, void* data);
+  bool cancel(int id);
+  bool running(int id) const;
+
+  size_t size() const
+  {
+    return m_tasks.size();
+  }
+
+  void update();
+
+private:
+  struct Task
+  {
+    int id;
+    std::string name;
+    Step step;
+    Done done;
+    void* data;
+    uint64_t started;
+    uint32_t steps;
+  };
+
+  void finish(std::list<Task>::iterator it, bool cancelled);
+
+  std::list<Task> m_tasks;
+  int m_nextId;
+  uint32_t m_budget;
+};
+
+#endif
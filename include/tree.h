@@ -37,6 +37,7 @@
 #include "constants.h"
 #include "mineserver.h"
 #include "map.h"
+#include "random.h"
 #include "vec.h"
 
 
@@ -101,7 +102,14 @@ class Tree : public ITree
 {
 public:
   Tree(int32_t x, int32_t y, int32_t z, int map, uint8_t limit = MAX_TRUNK)
-  : ITree(x, y, z, map), n_branches(0)
+  : ITree(x, y, z, map), n_branches(0), m_rng(NULL)
+  {
+    generate(limit);
+  }
+
+  // Tree of a generated chunk, shaped by the chunk's random stream
+  Tree(int32_t x, int32_t y, int32_t z, int map, ChunkRNG& rng, uint8_t limit = MAX_TRUNK)
+  : ITree(x, y, z, map), n_branches(0), m_rng(&rng)
   {
     generate(limit);
   }
@@ -109,6 +117,15 @@ public:
   void generate(uint8_t);
 
 private:
+  double random01()
+  {
+    return m_rng ? m_rng->uniform01() : uniform01();
+  }
+  uint8_t randomUINT8(uint8_t min, uint8_t max)
+  {
+    return m_rng ? uint8_t(m_rng->between(min, max)) : uniformUINT8(min, max);
+  }
+
   void set(int32_t xloc, int32_t yloc, int32_t zloc, int blocktType, char metaData);
   std::tr1::array<TrunkPtr, 256> m_Branch; // 1KB on x86 and 2KB on x86_64 Faster than stack or vector tho :)
 
@@ -119,6 +136,9 @@ private:
 
   uint8_t n_branches;
 
+  // Stream of the chunk being generated, NULL for saplings (global PRNG)
+  ChunkRNG* m_rng;
+
   void generateCanopy();
   void generateBranches(TrunkPtr);
 };
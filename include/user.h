@@ -41,6 +41,9 @@
 #include "vec.h"
 #include "inventory.h"
 #include "packets.h"
+#include "outputqueue.h"
+#include "outputlanes.h"
+#include "loginpipeline.h"
 #include "mineserver.h"
 
 struct position
@@ -69,13 +72,22 @@ public:
   time_t lastData;
 
   //View distance in chunks -viewDistance <-> viewDistance
-  static const int viewDistance = 10;
+  int viewDistance;
+  //View distance asked for by config, client or plugin, before the server limits apply
+  int wantedViewDistance;
   uint8_t action;
   bool waitForData;
+  //How much to ask the socket for per read, grows while reads come back full
+  size_t readChunk;
   uint32_t write_err_count;
   bool logged;
+  //Between startLogin() and sendLoginInfo()
+  bool loginPending;
   bool muted;
   bool dnd;
+  //Chat rate limit: tokens left and when they were last topped up (microTime)
+  double chatTokens;
+  uint64_t chatTokensTime;
   int16_t health;
   uint16_t timeUnderwater;
   double fallDistance;
@@ -115,12 +127,23 @@ public:
 
   //Input buffer
   Packet buffer;
-  Packet bufferCrypted;
+  //Output waiting for the socket, encrypted once crypted is set
+  OutputQueue output;
+  //Block updates, chat, entity moves and chunks waiting to go into output, see send()
+  OutputLanes lanes;
+  //Set once output and lanes go over ServerInstance->m_outputHigh, until they are back under m_outputLow
+  bool congested;
+  //When output and lanes went over m_outputCap, 0 while they are under
+  time_t overCapSince;
+  //Moves and time updates dropped while congested, caught up by resync()
+  std::set<int32_t> staleEntities;
+  bool staleTime;
   Packet loginBuffer; // Used to send all login info at once
 
   static std::set<User*>& all();
   static bool isUser(int sock);
   static User* byNick(std::string nick);
+  static User* byUID(uint32_t uid);
 
   bool changeNick(std::string _nick);
   void checkEnvironmentDamage();
@@ -142,12 +165,32 @@ public:
   static bool sendGuests(const Packet& packet);
   static bool sendGuests(uint8_t* data, size_t len);
 
-  //Login
-  bool sendLoginInfo();
+  //Queue whole messages for this user: block updates, chat, entity moves and
+  //time updates go through lanes, anything else straight into buffer
+  void send(const Packet& packet);
+  void send(const uint8_t* data, size_t len);
+
+  //True if data is a lone entity move or time update and we are congested,
+  //the caller then skips it and resync() sends the latest state later
+  bool dropCongested(const uint8_t* data, size_t len);
+  //Update congested and overCapSince from the output and lane sizes, after a flush
+  void updateCongestion();
+  //Teleport the entities and send the time left stale while congested
+  void resync();
+
+  //Login, run through ServerInstance->loginPipeline(): startLogin() has the
+  //player file read, copyLoginChunks() picks the chunks sent with the login
+  //once the data is in, and sendLoginInfo() sends everything
+  void startLogin();
+  void copyLoginChunks(std::vector<LoginPipeline::Chunk>& chunks);
+  bool sendLoginInfo(std::vector<LoginPipeline::Chunk>& chunks);
 
   //Load/save player data from/to a file at <mapdir>/players/<nick>.dat
+  std::string dataFile() const;
   bool saveData();
   bool loadData();
+  void applyData(const LoginPipeline::PlayerData& data);
+  void collectData(LoginPipeline::PlayerData& data) const;
 
   // Kick player
   bool kick(std::string kickMsg);
@@ -197,6 +240,11 @@ public:
 
   void clearLoadingMap();
 
+  // Set the wanted view distance, the server limits still apply
+  bool setViewDistance(int distance);
+  // Recalculate the effective view distance and queue chunks that came into or left view
+  bool updateViewDistance();
+
 
   // Getter/Setter for item currently in hold
   int16_t currentItemSlot();
@@ -209,9 +257,12 @@ public:
   }
 
   struct event* GetEvent();
+  struct event* GetWriteEvent();
 
 private:
+  //Persistent read event, and a one-shot write event while output is pending
   event m_event;
+  event m_writeEvent;
 
   // Item currently in hold
   int16_t m_currentItemSlot;
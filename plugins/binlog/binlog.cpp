@@ -36,16 +36,23 @@
 #include <cstring>
 #include <ctime>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
 #include "plugin_api.h"
 #include "binlog.h"
 
 Binlog::Binlog (std::string filename) 
+  : m_filename(filename),
+    m_segmentLength(3600),
+    m_bufferSize(64 * 1024),
+    m_cacheSegments(8),
+    m_active(0)
 {
-  log_stream.open(filename.c_str(), std::fstream::in | std::fstream::out | std::fstream::binary );
-  if (!log_stream.is_open()) {
-    return;
-  } 
+  readNicks();
+  readManifest();
 }
 
 Binlog &Binlog::get(std::string filename)
@@ -53,94 +60,358 @@ Binlog &Binlog::get(std::string filename)
   static Binlog instance(filename);
   return instance;
 }
+
+void Binlog::configure (int segmentLength, size_t bufferSize, size_t cacheSegments)
+{
+  m_segmentLength = std::max(segmentLength, 60);
+  m_bufferSize    = std::max(bufferSize, (size_t)RECORD_SIZE);
+  m_cacheSegments = std::max(cacheSegments, (size_t)1);
+}
+
+std::string Binlog::segmentFile (time_t start) const
+{
+  std::ostringstream name;
+  name << m_filename << "." << (int64_t)start;
+  return name.str();
+}
+
+void Binlog::readManifest ()
+{
+  std::ifstream manifest((m_filename + ".segments").c_str());
+  int64_t start;
+  while (manifest >> start) {
+    m_segments[(time_t)start].start = (time_t)start;
+  }
+}
+
+void Binlog::readNicks ()
+{
+  std::ifstream nicks((m_filename + ".nicks").c_str());
+  std::string nick;
+  while (std::getline(nicks, nick)) {
+    m_nickIds[nick] = m_nicks.size();
+    m_nicks.push_back(nick);
+  }
+}
+
+uint16_t Binlog::nickId (const char* nick)
+{
+  std::map<std::string, uint16_t>::const_iterator it = m_nickIds.find(nick);
+  if (it != m_nickIds.end()) {
+    return it->second;
+  }
+
+  // The id space is 16 bits, the last id is shared by any overflow
+  if (m_nicks.size() >= 0xFFFF) {
+    return 0xFFFF;
+  }
+
+  uint16_t id = m_nicks.size();
+  m_nicks.push_back(nick);
+  m_nickIds[nick] = id;
+
+  std::ofstream nicks((m_filename + ".nicks").c_str(), std::ios::out | std::ios::app);
+  nicks << nick << "\n";
+  return id;
+}
+
+// Switch writes to the segment starting at start
+void Binlog::openSegment (time_t start)
+{
+  flush();
+
+  if (m_segments.find(start) == m_segments.end()) {
+    m_segments[start].start = start;
+    std::ofstream manifest((m_filename + ".segments").c_str(), std::ios::out | std::ios::app);
+    manifest << (int64_t)start << "\n";
+  }
+
+  m_active = start;
+  loadSegment(start);
+}
+
+// Read a whole segment and build its indexes, unless it is already cached
+Binlog::Segment &Binlog::loadSegment (time_t start)
+{
+  Segment& segment = m_segments[start];
+  segment.start = start;
+
+  if (!segment.loaded) {
+    std::ifstream in(segmentFile(start).c_str(), std::ios::in | std::ios::binary);
+    if (in.is_open()) {
+      in.seekg(0, std::ios::end);
+      size_t count = (size_t)in.tellg() / RECORD_SIZE;
+      in.seekg(0, std::ios::beg);
+
+      std::vector<char> data(count * RECORD_SIZE);
+      if (count > 0 && in.read(&data[0], data.size())) {
+        segment.records.resize(count);
+        for (size_t i = 0; i < count; i++) {
+          unpack(&data[i * RECORD_SIZE], &segment.records[i]);
+          indexRecord(segment, segment.records[i], i);
+        }
+      }
+    }
+    segment.loaded = true;
+  }
+
+  touchSegment(start);
+  return segment;
+}
+
+// Keep at most m_cacheSegments segments in memory, never dropping the one being
+// written or the one just asked for (both may have to stay with a cache of one)
+void Binlog::touchSegment (time_t start)
+{
+  m_cache.remove(start);
+  m_cache.push_front(start);
+
+  while (m_cache.size() > m_cacheSegments) {
+    std::list<time_t>::iterator victim = --m_cache.end();
+    while (victim != m_cache.begin() && *victim == m_active) {
+      --victim;
+    }
+    if (victim == m_cache.begin()) {
+      break;
+    }
+
+    Segment& segment = m_segments[*victim];
+    std::vector<Record>().swap(segment.records);
+    segment.byNick.clear();
+    segment.byRegion.clear();
+    segment.loaded = false;
+    m_cache.erase(victim);
+  }
+}
+
+uint64_t Binlog::regionKey (int rx, int rz)
+{
+  return ((uint64_t)(uint32_t)rx << 32) | (uint32_t)rz;
+}
+
+void Binlog::indexRecord (Segment& segment, const Record& record, uint32_t n)
+{
+  segment.byNick[record.nick].push_back(n);
+  segment.byRegion[regionKey(record.x >> REGION_SHIFT, record.z >> REGION_SHIFT)].push_back(n);
+}
+
+void Binlog::pack (const Record& record, char* out)
+{
+  memcpy(out,      &record.timestamp, 8);
+  memcpy(out + 8,  &record.x, 4);
+  memcpy(out + 12, &record.z, 4);
+  memcpy(out + 16, &record.y, 2);
+  out[18] = record.otype;
+  out[19] = record.ntype;
+  out[20] = record.ometa;
+  out[21] = record.nmeta;
+  memcpy(out + 22, &record.nick, 2);
+}
+
+void Binlog::unpack (const char* in, Record* record)
+{
+  memcpy(&record->timestamp, in, 8);
+  memcpy(&record->x, in + 8, 4);
+  memcpy(&record->z, in + 12, 4);
+  memcpy(&record->y, in + 16, 2);
+  record->otype = in[18];
+  record->ntype = in[19];
+  record->ometa = in[20];
+  record->nmeta = in[21];
+  memcpy(&record->nick, in + 22, 2);
+}
+
+void Binlog::toEvent (const Record& record, event_t* event) const
+{
+  event->timestamp = (time_t)record.timestamp;
+  event->x = record.x;
+  event->y = record.y;
+  event->z = record.z;
+  event->otype = record.otype;
+  event->ntype = record.ntype;
+  event->ometa = record.ometa;
+  event->nmeta = record.nmeta;
+
+  const char* nick = record.nick < m_nicks.size() ? m_nicks[record.nick].c_str() : "";
+  strncpy(event->nick, nick, sizeof(event->nick) - 1);
+  event->nick[sizeof(event->nick) - 1] = 0;
+  event->nsize = strlen(event->nick);
+}
  
 // Log action to binary log 
 void Binlog::log (event_t event)
 {
-  if(!log_stream.bad()) {
-    event.timestamp = time (NULL);
-    event.nsize = strlen(event.nick);
-
-    log_stream.seekp(0, std::ios::end);
-    log_stream.write((char *) &event.timestamp, sizeof(time_t));
-    log_stream.write((char *) &event.x, sizeof(int));
-    log_stream.write((char *) &event.y, sizeof(int));
-    log_stream.write((char *) &event.z, sizeof(int));
-    log_stream.write((char *) &event.otype, sizeof(unsigned char));
-    log_stream.write((char *) &event.ntype, sizeof(unsigned char));
-    log_stream.write((char *) &event.ometa, sizeof(unsigned char));
-    log_stream.write((char *) &event.nmeta, sizeof(unsigned char));
-    log_stream.write((char *) &event.nsize, sizeof(int));
-    log_stream.write((char *) &event.nick, event.nsize+1);
+  event.timestamp = time (NULL);
+
+  time_t start = event.timestamp - event.timestamp % m_segmentLength;
+  if (start != m_active) {
+    openSegment(start);
+  }
+
+  Record record;
+  record.timestamp = event.timestamp;
+  record.x = event.x;
+  record.y = event.y;
+  record.z = event.z;
+  record.otype = event.otype;
+  record.ntype = event.ntype;
+  record.ometa = event.ometa;
+  record.nmeta = event.nmeta;
+  record.nick = nickId(event.nick);
+
+  Segment& segment = m_segments[m_active];
+  indexRecord(segment, record, segment.records.size());
+  segment.records.push_back(record);
+
+  size_t offset = m_buffer.size();
+  m_buffer.resize(offset + RECORD_SIZE);
+  pack(record, &m_buffer[offset]);
+
+  if (m_buffer.size() >= m_bufferSize) {
+    flush();
   }
 }
 
-// Get logs based on nick and timestamp
-bool Binlog::getLogs (time_t t, std::string &nick, std::vector<event_t> *logs) 
+// Write buffered records to the active segment
+void Binlog::flush ()
 {
-  event_t event; 
+  if (m_buffer.empty()) {
+    return;
+  }
 
-  log_stream.flush();
-  log_stream.seekg(0, std::ios::beg);
-  while(this->getEvent(&event)) {
-    if(event.timestamp > t && (strcmp(event.nick, nick.c_str()) == 0)) {
-      logs->push_back(event);
+  std::ofstream out(segmentFile(m_active).c_str(), std::ios::out | std::ios::binary | std::ios::app);
+  out.write(&m_buffer[0], m_buffer.size());
+  m_buffer.clear();
+}
+
+// Visit matching events newest first. Segments are skipped entirely when
+// they end before query.since, and the nick or region index is used to
+// pick candidate records instead of walking the whole segment.
+size_t Binlog::scan (const binlog_query_t& query, BinlogVisitor& visitor)
+{
+  uint16_t nick = 0;
+  if (!query.nick.empty()) {
+    std::map<std::string, uint16_t>::const_iterator it = m_nickIds.find(query.nick);
+    if (it == m_nickIds.end()) {
+      return 0;
     }
+    nick = it->second;
   }
+
+  int x1 = std::min(query.x1, query.x2), x2 = std::max(query.x1, query.x2);
+  int z1 = std::min(query.z1, query.z2), z2 = std::max(query.z1, query.z2);
+
+  size_t visited = 0;
+  bool end = false;
+  time_t segmentEnd = 0;
+
+  for (SegmentMap::reverse_iterator it = m_segments.rbegin(); it != m_segments.rend(); ++it) {
+    // Segments are contiguous, so this one ends where the newer one started
+    if (end && segmentEnd <= query.since) {
+      break;
+    }
+    end = true;
+    segmentEnd = it->first;
+
+    Segment& segment = loadSegment(it->first);
+
+    std::vector<uint32_t> candidates;
+    const std::vector<uint32_t>* list = NULL;
+    if (!query.nick.empty()) {
+      NickIndex::const_iterator found = segment.byNick.find(nick);
+      if (found == segment.byNick.end()) {
+        continue;
+      }
+      list = &found->second;
+    } else if (query.hasArea) {
+      for (int rx = x1 >> REGION_SHIFT; rx <= (x2 >> REGION_SHIFT); rx++) {
+        for (int rz = z1 >> REGION_SHIFT; rz <= (z2 >> REGION_SHIFT); rz++) {
+          RegionIndex::const_iterator found = segment.byRegion.find(regionKey(rx, rz));
+          if (found != segment.byRegion.end()) {
+            candidates.insert(candidates.end(), found->second.begin(), found->second.end());
+          }
+        }
+      }
+      std::sort(candidates.begin(), candidates.end());
+      list = &candidates;
+    }
+
+    size_t count = list ? list->size() : segment.records.size();
+    for (size_t i = count; i-- > 0;) {
+      const Record& record = segment.records[list ? (*list)[i] : i];
+      if (record.timestamp <= query.since) {
+        continue;
+      }
+      if (query.hasArea && (record.x < x1 || record.x > x2 || record.z < z1 || record.z > z2)) {
+        continue;
+      }
+
+      event_t event;
+      toEvent(record, &event);
+      visited++;
+      if (!visitor.visit(event)) {
+        return visited;
+      }
+    }
+  }
+
+  return visited;
+}
+
+namespace
+{
+  class CollectVisitor : public BinlogVisitor
+  {
+  public:
+    CollectVisitor(std::vector<event_t>* logs) : m_logs(logs) {}
+    bool visit(const event_t& event)
+    {
+      m_logs->push_back(event);
+      return true;
+    }
+  private:
+    std::vector<event_t>* m_logs;
+  };
+
+  void collect(Binlog& binlog, const binlog_query_t& query, std::vector<event_t>* logs)
+  {
+    size_t first = logs->size();
+    CollectVisitor visitor(logs);
+    binlog.scan(query, visitor);
+    std::reverse(logs->begin() + first, logs->end());
+  }
+}
+
+// Get logs based on nick and timestamp
+bool Binlog::getLogs (time_t t, std::string &nick, std::vector<event_t> *logs) 
+{
+  binlog_query_t query;
+  query.since = t;
+  query.nick = nick;
+  collect(*this, query, logs);
   return true;
 }
 
 // Get logs based on timestamp
 bool Binlog::getLogs (time_t t, std::vector<event_t> *logs) 
 {
-  event_t event;
-
-  log_stream.flush();
-  log_stream.seekg(0, std::ios::beg);
-  while(this->getEvent(&event)) {
-    if(event.timestamp > t) {
-      logs->push_back(event);
-    }
-  }
+  binlog_query_t query;
+  query.since = t;
+  collect(*this, query, logs);
   return true;
 }
 
 // Get all logs
 bool Binlog::getLogs (std::vector<event_t> *logs) 
 {
-  event_t event;
-
-  log_stream.flush();
-  log_stream.seekg(0, std::ios::beg);
-  while(this->getEvent(&event)) {
-    logs->push_back(event);
-  }
+  binlog_query_t query;
+  collect(*this, query, logs);
   return true;
 }
 
-// Get event from log
-bool Binlog::getEvent (event_t *event) 
-{
-  if(!log_stream.eof()) {
-    log_stream.read((char *) &event->timestamp, sizeof(time_t));
-    log_stream.read((char *) &event->x, sizeof(int));
-    log_stream.read((char *) &event->y, sizeof(int));
-    log_stream.read((char *) &event->z, sizeof(int));
-    log_stream.read((char *) &event->otype, sizeof(unsigned char));
-    log_stream.read((char *) &event->ntype, sizeof(unsigned char));
-    log_stream.read((char *) &event->ometa, sizeof(unsigned char));
-    log_stream.read((char *) &event->nmeta, sizeof(unsigned char));
-    log_stream.read((char *) &event->nsize, sizeof(int));
-    log_stream.read((char *) &event->nick, event->nsize+1);
-    return true;
-  }
-  log_stream.clear(); 
-  return false;
-}
-
 Binlog::~Binlog() 
 {
-  log_stream.close();
+  flush();
 }
 
 mineserver_pointer_struct* mineserver;
@@ -148,34 +419,135 @@ std::string pluginName = "binlog";
 std::string filename;
 bool enabled;
 
-// Rollback Transaction Logs
+// Accepts an absolute unix time or an age such as 90s, 30m, 2h or 1d
+time_t parseTime (const char* arg)
+{
+  std::stringstream ss (std::stringstream::in | std::stringstream::out);
+  ss << arg;
+
+  int64_t value = 0;
+  char unit = 0;
+  ss >> value >> unit;
+
+  switch (unit) {
+    case 's': return time(NULL) - value;
+    case 'm': return time(NULL) - value * 60;
+    case 'h': return time(NULL) - value * 3600;
+    case 'd': return time(NULL) - value * 86400;
+    default:  return (time_t)value;
+  }
+}
+
+// Remembers the oldest logged state of every block the scan touches,
+// grouped by chunk so each chunk is restored in one pass
+class RollbackVisitor : public BinlogVisitor
+{
+public:
+  struct Restore
+  {
+    int x, y, z;
+    unsigned char type, meta;
+  };
+  typedef std::map<int, Restore> BlockMap;
+  typedef std::map<std::pair<int, int>, BlockMap> ChunkMap;
+
+  ChunkMap chunks;
+  size_t events;
+
+  RollbackVisitor() : events(0) {}
+
+  bool visit(const event_t& event)
+  {
+    // Events arrive newest first, so the last write per block wins
+    Restore& restore = chunks[std::make_pair(event.x >> 4, event.z >> 4)][(event.y << 8) | ((event.x & 15) << 4) | (event.z & 15)];
+    restore.x = event.x;
+    restore.y = event.y;
+    restore.z = event.z;
+    restore.type = event.otype;
+    restore.meta = event.ometa;
+    events++;
+    return true;
+  }
+};
+
+// Restore one chunk's blocks: read the box around them, patch it and write it
+// back, so the chunk's users get a single update
+size_t restoreChunk (int cx, int cz, const RollbackVisitor::BlockMap& blocks)
+{
+  int y1 = 255, y2 = 0;
+  RollbackVisitor::BlockMap::const_iterator block;
+  for(block = blocks.begin(); block != blocks.end(); block++) {
+    y1 = std::min(y1, block->second.y);
+    y2 = std::max(y2, block->second.y);
+  }
+
+  const int x1 = cx << 4, z1 = cz << 4;
+  const int height = y2 - y1 + 1;
+  std::vector<unsigned char> types(16 * 16 * height), metas(16 * 16 * height);
+
+  // Not loaded, the single block calls load it
+  if(mineserver->map.getBlocks(0, x1, y1, z1, x1 + 15, y2, z1 + 15, &types[0], &metas[0]) != (int)types.size()) {
+    for(block = blocks.begin(); block != blocks.end(); block++) {
+      const RollbackVisitor::Restore& restore = block->second;
+      mineserver->map.setBlock(restore.x, restore.y, restore.z, restore.type, restore.meta);
+    }
+    return blocks.size();
+  }
+
+  for(block = blocks.begin(); block != blocks.end(); block++) {
+    const RollbackVisitor::Restore& restore = block->second;
+    const size_t index = ((restore.x - x1) * 16 + (restore.z - z1)) * height + (restore.y - y1);
+    types[index] = restore.type;
+    metas[index] = restore.meta;
+  }
+  mineserver->map.setBlocks(0, x1, y1, z1, x1 + 15, y2, z1 + 15, &types[0], &metas[0]);
+  return blocks.size();
+}
+
+// Rollback Transaction Logs: /rollback [time] [nick|*] [radius]
 void rollBack (const char* user, int argc, const char** args)
 {
-  std::vector<event_t> logs;                                                         
-  time_t timestamp;
+  binlog_query_t query;
 
   if(argc > 0) {
-    std::stringstream ss (std::stringstream::in | std::stringstream::out);
-    ss << args[0];
-    ss >> timestamp;
+    query.since = parseTime(args[0]);
   }
 
-  if(argc == 2 ) {
-    std::string victim = args[1];
-    Binlog::get(filename).getLogs(timestamp, victim, &logs);
-  } else if (argc == 1) {
-    Binlog::get(filename).getLogs(timestamp, &logs);
-  } else {
-    Binlog::get(filename).getLogs(&logs);
+  if(argc > 1 && strcmp(args[1], "*") != 0) {
+    query.nick = args[1];
   }
 
-  std::vector<event_t>::reverse_iterator event;
-  if(logs.size() > 0) {
+  if(argc > 2) {
+    double x, y, z, stance;
+    float yaw, pitch;
+    int radius = atoi(args[2]);
+    if(radius <= 0 || !mineserver->user.getPosition(user, &x, &y, &z, &yaw, &pitch, &stance)) {
+      mineserver->chat.sendmsgTo(user, "Usage: /rollback [time] [nick|*] [radius]");
+      return;
+    }
+    query.hasArea = true;
+    query.x1 = (int)floor(x) - radius;
+    query.z1 = (int)floor(z) - radius;
+    query.x2 = (int)floor(x) + radius;
+    query.z2 = (int)floor(z) + radius;
+  }
+
+  RollbackVisitor rollback;
+  Binlog::get(filename).scan(query, rollback);
+
+  if(rollback.events > 0) {
     mineserver->chat.sendmsgTo(user, "Rolling back map...");
-    for(event = logs.rbegin(); event != logs.rend(); event++) {
-      mineserver->map.setBlock(event->x, event->y, event->z, event->otype, event->ometa);
+
+    size_t blocks = 0;
+    RollbackVisitor::ChunkMap::const_iterator chunk;
+    for(chunk = rollback.chunks.begin(); chunk != rollback.chunks.end(); chunk++) {
+      blocks += restoreChunk(chunk->first.first, chunk->first.second, chunk->second);
     }
-    mineserver->chat.sendmsgTo(user, "Map roll back completed!");
+
+    std::ostringstream msg;
+    msg << "Map roll back completed! " << rollback.events << " changes, "
+        << blocks << " blocks in " << rollback.chunks.size() << " chunks";
+    mineserver->chat.sendmsgTo(user, msg.str().c_str());
   } else {
     mineserver->chat.sendmsgTo(user, "No binary logs found!");
   }
@@ -266,6 +638,13 @@ bool callbackBlockPlacePre (const char* user,int32_t x,int8_t y,int32_t z, unsig
   return true;
 }
 
+// Push buffered records to disk
+bool timer10000Function ()
+{
+  Binlog::get(filename).flush();
+  return true;
+}
+
 // Command Registration
 bool callbackPlayerChatCommand (const char* user, const char* command, int argc, const char** args) 
 {
@@ -293,6 +672,12 @@ PLUGIN_API_EXPORT void CALLCONVERSION binlog_init(mineserver_pointer_struct* min
   enabled = mineserver->config.bData("enable_binary_logging");
   filename = mineserver->config.sData("binary_log");
 
+  Binlog& binlog = Binlog::get(filename);
+  binlog.configure(
+    mineserver->config.has("binary_log_segment_length") ? mineserver->config.iData("binary_log_segment_length") : 3600,
+    mineserver->config.has("binary_log_buffer") ? mineserver->config.iData("binary_log_buffer") : 64 * 1024,
+    mineserver->config.has("binary_log_cache") ? mineserver->config.iData("binary_log_cache") : 8);
+
   if (mineserver->plugin.getPluginVersion("binlog") > 0)
   {
     std::string msg = "binlog is already loaded v."+dtos(mineserver->plugin.getPluginVersion(pluginName.c_str()));
@@ -306,6 +691,7 @@ PLUGIN_API_EXPORT void CALLCONVERSION binlog_init(mineserver_pointer_struct* min
   {
     mineserver->plugin.addCallback("BlockPlacePre", reinterpret_cast<voidF>(callbackBlockPlacePre));
     mineserver->plugin.addCallback("BlockBreakPre", reinterpret_cast<voidF>(callbackBlockBreakPre));
+    mineserver->plugin.addCallback("Timer10000", reinterpret_cast<voidF>(timer10000Function));
   }
   mineserver->plugin.addCallback("PlayerChatCommand", reinterpret_cast<voidF>(callbackPlayerChatCommand));
 }
@@ -317,4 +703,5 @@ PLUGIN_API_EXPORT void CALLCONVERSION binlog_shutdown(void)
     mineserver->logger.log(LOG_INFO, "plugin.binlog", "binlog is not loaded!");
     return;
   }
+  Binlog::get(filename).flush();
 }
@@ -26,18 +26,21 @@
  */
 
 //
-// Mineserver trxlogger.h
+// Mineserver binlog.h
 //
 
 #include <string>
 #include <fstream>
+#include <vector>
+#include <map>
+#include <list>
 #include <time.h>
 
 #include "plugin_api.h"
 
 #ifndef _BINLOG_H
 #define _BINLOG_H
-#define PLUGIN_VERSION 0.1
+#define PLUGIN_VERSION 0.2
 #endif
 
 struct event_t {
@@ -51,19 +54,103 @@ struct event_t {
   char nick[17];
 };
 
+// Selects events for getLogs/scan. An empty nick matches everyone and
+// the area is only checked when hasArea is set.
+struct binlog_query_t {
+  time_t since;
+  std::string nick;
+  bool hasArea;
+  int x1, z1, x2, z2;
+
+  binlog_query_t() : since(0), hasArea(false), x1(0), z1(0), x2(0), z2(0) {}
+};
+
+// Receives events from Binlog::scan, newest first. Returning false stops
+// the scan.
+class BinlogVisitor
+{
+public:
+  virtual ~BinlogVisitor() {}
+  virtual bool visit(const event_t& event) = 0;
+};
+
+//
+// The log is split into segments of segmentLength seconds, stored as
+// "<filename>.<segment start>" and listed in "<filename>.segments".
+// Every record has the same size and the nick is stored as an id into
+// "<filename>.nicks", so a segment is read with a single read and
+// indexed by nick and by 512x512 block region while it is in memory.
+// Writes go through a buffer that is flushed when it fills up, when the
+// segment changes and every ten seconds from the plugin timer.
+//
 class Binlog 
 {
 
 public:
+  enum { RECORD_SIZE = 24, REGION_SHIFT = 9 };
+
   void log(event_t event);
   static Binlog &get(std::string filename);
+  void configure(int segmentLength, size_t bufferSize, size_t cacheSegments);
+  void flush();
+  size_t scan(const binlog_query_t& query, BinlogVisitor& visitor);
   bool getLogs(time_t t, std::string &nick, std::vector<event_t> *logs);
   bool getLogs(time_t t, std::vector<event_t> *logs);
   bool getLogs(std::vector<event_t> *logs);
-  bool getEvent(event_t *event);
 
 private:
-  std::fstream log_stream;
+  struct Record
+  {
+    int64_t timestamp;
+    int32_t x;
+    int32_t z;
+    int16_t y;
+    uint8_t otype, ntype, ometa, nmeta;
+    uint16_t nick;
+  };
+
+  typedef std::map<uint16_t, std::vector<uint32_t> > NickIndex;
+  typedef std::map<uint64_t, std::vector<uint32_t> > RegionIndex;
+
+  struct Segment
+  {
+    time_t start;
+    bool loaded;
+    std::vector<Record> records;
+    NickIndex byNick;
+    RegionIndex byRegion;
+
+    Segment() : start(0), loaded(false) {}
+  };
+
+  typedef std::map<time_t, Segment> SegmentMap;
+
+  std::string m_filename;
+  int m_segmentLength;
+  size_t m_bufferSize;
+  size_t m_cacheSegments;
+
+  SegmentMap m_segments;
+  std::list<time_t> m_cache;
+  time_t m_active;
+  std::vector<char> m_buffer;
+
+  std::vector<std::string> m_nicks;
+  std::map<std::string, uint16_t> m_nickIds;
+
   Binlog(std::string filename);
   ~Binlog();
+
+  std::string segmentFile(time_t start) const;
+  void readManifest();
+  void readNicks();
+  uint16_t nickId(const char* nick);
+  void openSegment(time_t start);
+  Segment& loadSegment(time_t start);
+  void touchSegment(time_t start);
+  static void indexRecord(Segment& segment, const Record& record, uint32_t n);
+  static uint64_t regionKey(int rx, int rz);
+  static void pack(const Record& record, char* out);
+  static void unpack(const char* in, Record* record);
+  void toEvent(const Record& record, event_t* event) const;
 };
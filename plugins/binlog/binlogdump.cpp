@@ -37,7 +37,7 @@
 int main (int argc, const char* argv[] ) 
 {
   if(argc != 2) {
-    printf("Usage: %s <filename>\n", argv[0]);
+    printf("Usage: %s <binary_log>\n", argv[0]);
     return 1;
   }
   std::vector<event_t> logs;
@@ -46,7 +46,7 @@ int main (int argc, const char* argv[] )
   for(event = logs.begin(); event != logs.end(); event++) 
   {
     printf("{timestamp:%d, nick:%s, x:%i, y:%i, z:%i, old_type:%#x, old_meta:%#x, new_type:%#x, new_meta:%#x}\n", 
-      event->timestamp, event->nick, event->x, event->y, event->z, 
+      (int) event->timestamp, event->nick, event->x, event->y, event->z, 
       (int) event->otype, (int) event->ometa, (int) event->ntype, (int) event->nmeta );
   }
   return 0;
@@ -33,6 +33,9 @@
 #include <stdint.h>
 #include <cstdlib>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <set>
 
 #include "tr1.h"
 #include TR1INCLUDE(unordered_map)
@@ -64,6 +67,25 @@ struct cuboidStruct
 
 std::tr1::unordered_map<std::string, cuboidStruct> cuboidMap;
 
+// Largest box /cuboid and /replace take on, the edit itself is spread over ticks
+#define MAX_EDIT_VOLUME (256 * 256 * 128)
+
+// A box edit that fills one chunk per task step
+struct EditJob
+{
+  int id;
+  std::string user;
+  std::string doneMsg;
+  int w;
+  int x1, y1, z1, x2, y2, z2;
+  int from, type, meta;
+  // Next chunk to fill
+  int cx, cz;
+  int changed;
+};
+
+std::set<int> editTasks;
+
 std::string dtos(double n)
 {
   std::ostringstream result;
@@ -71,6 +93,65 @@ std::string dtos(double n)
   return result.str();
 }
 
+bool editStep(void* data)
+{
+  EditJob* job = static_cast<EditJob*>(data);
+  job->changed += mineserver->map.fillChunk(job->w, job->cx, job->cz, job->x1, job->y1, job->z1, job->x2, job->y2, job->z2, job->from, job->type, job->meta);
+
+  if (++job->cz > (job->z2 >> 4))
+  {
+    job->cz = job->z1 >> 4;
+    if (++job->cx > (job->x2 >> 4))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void editDone(void* data, bool cancelled)
+{
+  EditJob* job = static_cast<EditJob*>(data);
+  editTasks.erase(job->id);
+  if (!cancelled)
+  {
+    mineserver->chat.sendmsgTo(job->user.c_str(), (job->doneMsg + ", " + dtos(job->changed) + " blocks changed").c_str());
+  }
+  delete job;
+}
+
+// Queue a fill of the box, type/meta replacing blocks of type from (or any block if from is -1)
+bool startEdit(const std::string& user, int w, int x1, int y1, int z1, int x2, int y2, int z2, int from, int type, int meta, const std::string& doneMsg)
+{
+  EditJob* job = new EditJob;
+  job->user    = user;
+  job->doneMsg = doneMsg;
+  job->w       = w;
+  job->x1      = std::min(x1, x2);
+  job->y1      = std::min(y1, y2);
+  job->z1      = std::min(z1, z2);
+  job->x2      = std::max(x1, x2);
+  job->y2      = std::max(y1, y2);
+  job->z2      = std::max(z1, z2);
+  job->from    = from;
+  job->type    = type;
+  job->meta    = meta;
+  job->cx      = job->x1 >> 4;
+  job->cz      = job->z1 >> 4;
+  job->changed = 0;
+
+  if (double(job->x2 - job->x1 + 1) * (job->y2 - job->y1 + 1) * (job->z2 - job->z1 + 1) > MAX_EDIT_VOLUME)
+  {
+    mineserver->chat.sendmsgTo(user.c_str(), "Area too large!");
+    delete job;
+    return false;
+  }
+
+  job->id = mineserver->plugin.addTask(("edit by " + user).c_str(), editStep, editDone, job);
+  editTasks.insert(job->id);
+  return true;
+}
+
 typedef void (*CommandCallback)(std::string nick, std::string, std::deque<std::string>);
 
 struct Command
@@ -393,7 +474,8 @@ void replacechunk(std::string user, std::string command, std::deque<std::string>
   if(args.size() == 2)
   {
     double x,y,z;
-    if(mineserver->user.getPosition(user.c_str(), &x,&y,&z,NULL,NULL,NULL))
+    int w;
+    if(mineserver->user.getPositionW(user.c_str(), &x,&y,&z,&w,NULL,NULL,NULL))
     {
 
       int fromBlock = atoi(args[0].c_str());
@@ -423,25 +505,10 @@ void replacechunk(std::string user, std::string command, std::deque<std::string>
         return;
       }
 
-      int chunkx,chunkz;
-      chunkx = ((int)x)>>4;
-      chunkz = ((int)z)>>4;
-      unsigned char* blocks = mineserver->map.getMapData_block(chunkx,chunkz);
-      for(int bX = 0; bX < 16; bX++)
-      {
-        for(int bZ = 0; bZ < 16; bZ++)
-        {
-          for(int bY = 0; bY < 128; bY++)
-          {
-            if(blocks[bY + ((bZ << 7) + (bX << 11))] == fromBlock)
-            {
-              blocks[bY + ((bZ << 7) + (bX << 11))] = toBlock;
-            }
-          }
-        }
-      }
+      const int chunkx = (int)floor(x) >> 4;
+      const int chunkz = (int)floor(z) >> 4;
+      mineserver->map.fillChunk(w, chunkx, chunkz, chunkx << 4, 0, chunkz << 4, (chunkx << 4) + 15, 255, (chunkz << 4) + 15, fromBlock, toBlock, 0);
 
-      // TODO: Send chunk update to all players.
       mineserver->chat.sendmsgTo(user.c_str(),"Replace chunk done");
     }
   }
@@ -452,7 +519,8 @@ void flattenchunk(std::string user, std::string command, std::deque<std::string>
   if(args.size() == 1)
   {
     double x,y,z;
-    if(mineserver->user.getPosition(user.c_str(), &x,&y,&z,NULL,NULL,NULL))
+    int w;
+    if(mineserver->user.getPositionW(user.c_str(), &x,&y,&z,&w,NULL,NULL,NULL))
     {
 
       int topBlock = atoi(args[0].c_str());
@@ -468,33 +536,12 @@ void flattenchunk(std::string user, std::string command, std::deque<std::string>
         return;
       }
 
-      int chunkx,chunkz;
-      chunkx = ((int)x)>>4;
-      chunkz = ((int)z)>>4;
-      unsigned char* blocks = mineserver->map.getMapData_block(chunkx,chunkz);
-      for(int bX = 0; bX < 16; bX++)
-      {
-        for(int bZ = 0; bZ < 16; bZ++)
-        {
-          for(int bY = 127; bY >= 0; bY--)
-          {
-            if(bY >= y)
-            {
-              blocks[bY + ((bZ << 7) + (bX << 11))] = 0;
-            }
-            else if(bY == y - 1)
-            {
-              blocks[bY + ((bZ << 7) + (bX << 11))] = topBlock;
-            }
-            else
-            {
-              // Do nothing; leave this block untouched
-            }
-          }
-        }
-      }
+      const int chunkx = (int)floor(x) >> 4;
+      const int chunkz = (int)floor(z) >> 4;
+      const int level  = (int)floor(y);
+      mineserver->map.fillChunk(w, chunkx, chunkz, chunkx << 4, level, chunkz << 4, (chunkx << 4) + 15, 255, (chunkz << 4) + 15, -1, 0, 0);
+      mineserver->map.fillChunk(w, chunkx, chunkz, chunkx << 4, level - 1, chunkz << 4, (chunkx << 4) + 15, level - 1, (chunkz << 4) + 15, -1, topBlock, 0);
 
-      // TODO: Send chunk update to all players.
       mineserver->chat.sendmsgTo(user.c_str(),"Flatten chunk done");
     }
   }
@@ -523,6 +570,67 @@ void saveMap(std::string user, std::string command, std::deque<std::string> args
   mineserver->chat.sendmsgTo(user.c_str(),"Saved map!");
 }
 
+void pregen(std::string user, std::string command, std::deque<std::string> args)
+{
+  // World defaults to the one the user is in, the console's is 0
+  int w = 0;
+  mineserver->user.getPositionW(user.c_str(), NULL, NULL, NULL, &w, NULL, NULL, NULL);
+
+  const std::string action = args.empty() ? "" : args[0];
+  if (action == "stop" || action == "status")
+  {
+    if (args.size() == 2)
+    {
+      w = atoi(args[1].c_str());
+    }
+  }
+  else if (args.size() == 2 || args.size() == 5)
+  {
+    w = atoi(args.back().c_str());
+  }
+
+  if (action == "stop")
+  {
+    mineserver->chat.sendmsgTo(user.c_str(), mineserver->map.pregenStop(w) ? "Pregeneration stopped" : "Nothing to stop");
+    return;
+  }
+
+  if (action == "status")
+  {
+    int done, total, eta;
+    double rate;
+    if (!mineserver->map.pregenStatus(w, &done, &total, &rate, &eta))
+    {
+      mineserver->chat.sendmsgTo(user.c_str(), "No pregeneration running");
+      return;
+    }
+    std::string msg = dtos(done) + "/" + dtos(total) + " chunks, " + dtos(int(rate * 10) / 10.0) + " chunks/s";
+    if (eta >= 0)
+    {
+      msg += ", " + dtos(eta / 60) + " min left";
+    }
+    mineserver->chat.sendmsgTo(user.c_str(), msg.c_str());
+    return;
+  }
+
+  bool started = false;
+  if (args.size() == 1 || args.size() == 2)
+  {
+    started = mineserver->map.pregenRadius(w, atoi(args[0].c_str()));
+  }
+  else if (args.size() == 4 || args.size() == 5)
+  {
+    started = mineserver->map.pregen(w, atoi(args[0].c_str()), atoi(args[1].c_str()), atoi(args[2].c_str()), atoi(args[3].c_str()));
+  }
+  else
+  {
+    mineserver->chat.sendmsgTo(user.c_str(), "Usage: /pregen <radius> [world] | <x1> <z1> <x2> <z2> [world] | stop [world] | status [world]");
+    return;
+  }
+
+  mineserver->chat.sendmsgTo(user.c_str(), started ? "Pregeneration started, see /pregen status" : "Cannot pregenerate that");
+}
+
 void setTime(std::string user, std::string command, std::deque<std::string> args)
 {
   if(args.size() == 1)
@@ -618,27 +726,7 @@ bool startedDiggingFunction(const char* userIn, int32_t x,int8_t y,int32_t z,int
           zstart=(z<cuboidMap[user].z)?z:cuboidMap[user].z;
           zend=(z<cuboidMap[user].z)?cuboidMap[user].z:z;
 
-          unsigned char block,meta;
-
-          if((xend-xstart) * (yend-ystart) * (zend-zstart) > 10000)
-          {
-            mineserver->chat.sendmsgTo(user.c_str(),"Area too large!");
-            return true;
-          }
-          for(int xpos = xstart; xpos <= xend; xpos ++)
-          {
-            for(int zpos = zstart;  zpos <= zend; zpos ++)
-            {     
-              for(int ypos = ystart;  ypos <= yend; ypos ++)
-              {  
-                if(mineserver->map.getBlock(xpos,ypos,zpos,&block,&meta) && block == cuboidMap[user].fromBlock)
-                {
-                  mineserver->map.setBlock(xpos,ypos,zpos,cuboidMap[user].toBlock,map);
-                }
-              }
-            }
-          }
-          mineserver->chat.sendmsgTo(user.c_str(),"Replace done");
+          startEdit(user, map, xstart, ystart, zstart, xend, yend, zend, cuboidMap[user].fromBlock, cuboidMap[user].toBlock, 0, "Replace done");
           cuboidMap.erase(user);
         }        
       }
@@ -682,22 +770,9 @@ bool blockPlacePreFunction(const char* userIn, int32_t x,int8_t y,int32_t z,int1
 
 			  zstart=(z<cuboidMap[user].z)?z:cuboidMap[user].z;
 			  zend=(z<cuboidMap[user].z)?cuboidMap[user].z:z;
-			  if((xend-xstart) * (yend-ystart) * (zend-zstart) > 10000)
-			  {
-			    mineserver->chat.sendmsgTo(user.c_str(),"Area too large!");
-			    return true;
-			  }
-			  for(int xpos = xstart; xpos <= xend; xpos ++)
-			  {
-			    for(int zpos = zstart;  zpos <= zend; zpos ++)
-			    {                
-				  for(int ypos = ystart;  ypos <= yend; ypos ++)
-				  {
-				    mineserver->map.setBlock(xpos,ypos,zpos,block,0);
-				  }
-			    }
-			  }
-		    mineserver->chat.sendmsgTo(user.c_str(),"Cuboid done");
+			  int map = 0;
+			  mineserver->user.getPositionW(userIn, NULL, NULL, NULL, &map, NULL, NULL, NULL);
+			  startEdit(user, map, xstart, ystart, zstart, xend, yend, zend, -1, block, 0, "Cuboid done");
 		    cuboidMap.erase(user);
 	  	  }
 	    }
@@ -844,6 +919,7 @@ PLUGIN_API_EXPORT void CALLCONVERSION commands_init(mineserver_pointer_struct* m
   registerCommand(ComPtr(new Command(parseCmd("igive i item"), "<id/alias> [count]", "Gives self [count] pieces of <id/alias>. By default [count] = 1", giveItemsSelf)));
   registerCommand(ComPtr(new Command(parseCmd("motd"), "", "Displays the server's MOTD", sendMOTD)));
   registerCommand(ComPtr(new Command(parseCmd("players who names list"), "", "Lists online players", playerList)));
+  registerCommand(ComPtr(new Command(parseCmd("pregen"), "<radius>|<x1> <z1> <x2> <z2>|stop|status [world]", "Generates chunks (coordinates) in the background, saving them to disc", pregen)));
   registerCommand(ComPtr(new Command(parseCmd("replace"), "<from-id/alias> <to-id/alias>", "Type in the command and left-click two blocks, it will replace the selected blocks with the new blocks", replace)));
   registerCommand(ComPtr(new Command(parseCmd("replacechunk"), "<from-id/alias> <to-id/alias>", "Replaces the chunk you are at with the block you specify", replacechunk)));
   registerCommand(ComPtr(new Command(parseCmd("rules"), "", "Displays server rules", sendRules)));
@@ -861,6 +937,13 @@ PLUGIN_API_EXPORT void CALLCONVERSION commands_shutdown(void)
     mineserver->logger.log(LOG_INFO, "plugin.commands", "commands is not loaded!");
     return;
   }
+
+  // Edits still running would call back into the unloaded plugin
+  const std::set<int> tasks = editTasks;
+  for (std::set<int>::const_iterator it = tasks.begin(); it != tasks.end(); ++it)
+  {
+    mineserver->plugin.cancelTask(*it);
+  }
 }
 
 
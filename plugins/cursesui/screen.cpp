@@ -34,8 +34,10 @@
 
 #include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <iostream>
 #include <stack>
+#include <pthread.h>
 
 // Constants
 #define PLUGIN_NAME "cursesui"
@@ -487,16 +489,50 @@ void CursesScreen::updatePlayerList(bool joining, const char *username)
   CursesScreen::redrawPlayerList();
 }
 
+// LogPost runs on the server's log writer thread, curses is only touched
+// from the main thread in checkForCommand()
+struct LogLine
+{
+  LogType::LogType type;
+  std::string source;
+  std::string message;
+};
+
+std::deque<LogLine> pendingLog;
+pthread_mutex_t pendingLogMutex = PTHREAD_MUTEX_INITIALIZER;
+
 bool logPost(int type, const char* source, const char* message)
 {
-  screen->log((LogType::LogType)type, source, message);
+  LogLine line;
+  line.type = (LogType::LogType)type;
+  line.source = source;
+  line.message = message;
+
+  pthread_mutex_lock(&pendingLogMutex);
+  pendingLog.push_back(line);
+  pthread_mutex_unlock(&pendingLogMutex);
   return false;
 }
 
+void showPendingLog()
+{
+  std::deque<LogLine> lines;
+  pthread_mutex_lock(&pendingLogMutex);
+  lines.swap(pendingLog);
+  pthread_mutex_unlock(&pendingLogMutex);
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    screen->log(lines[i].type, lines[i].source, lines[i].message);
+  }
+}
+
 static const unsigned int SERVER_CONSOLE_UID = -1;
 
 bool checkForCommand()
 {
+  showPendingLog();
+
   if (screen->hasCommand())
   {
     // Now handle this command as normal
@@ -32,6 +32,7 @@
 #include <cstdlib>
 #include <map>
 #include <vector>
+#include <set>
 #include <iostream>
 #include <ctime>
 #include <stdint.h>
@@ -68,32 +69,17 @@ static const int passiveMobs[] = { MOB_SHEEP, MOB_COW, MOB_CHICKEN, MOB_PIG };
 
 // The list of Mobs this plugin has control of
 // Note that other plugins may make other mobs, and control them itself
-class MyPetMob
-{
-public:
-  int ID;
-  int deSpawn;
-  double velocity;
-  explicit MyPetMob(int ID, double velocity = 0) : ID(ID), deSpawn(0), velocity(velocity) { }
-};
-
-typedef std::tr1::shared_ptr<MyPetMob> MyPetMobPtr;
-
-std::vector<MyPetMobPtr> MyMobs;
+// The AI state of a mob counts the ticks it has been dead, the AI value is its velocity
+std::set<int> MyMobs;
 
 const unsigned int maxMobs = 15; // Maximum ammount of mobs allowed
 time_t lastSpawn = time(NULL);
 
 int topBlockSuitable(int x, int z, int w)
 {
-  int y;
-  unsigned char block, meta;
-  for(y = 127; y > 0; y--)
-  {
-    mineserver->map.getBlockW(x,y,z,w,&block,&meta);
-    if(block!=0){break;}
-  }
-  if(block == 78 || block == 2 || block == 38 || block == 37)
+  unsigned char block;
+  int y = mineserver->map.getTopBlock(w, x, z, &block, NULL);
+  if(y > 0 && (block == 78 || block == 2 || block == 38 || block == 37))
   {
     return y;
   }
@@ -120,11 +106,13 @@ bool moveSuitable(double* x, double* y, double* z, int w)
 
 void fallMob(double* x, double* y, double* z, int w)
 {
-  unsigned char block, meta;
+  // The 127 blocks below the mob in one call, lowest first
+  const int bx = (int)floor(*x), bz = (int)floor(*z), by = (int)(*y);
+  unsigned char column[127];
+  mineserver->map.getBlocks(w, bx, by - 127, bz, bx, by - 1, bz, column, NULL);
   for(int count = 1; count < 128; count ++)
   {
-    mineserver->map.getBlockW((int)floor(*x),(int)(*y)-count,(int)floor(*z),w,&block,&meta);
-    if (!canStepIn(block))
+    if (!canStepIn(column[127 - count]))
     {
       *y=(1+(*y))-count;
       return;
@@ -186,8 +174,7 @@ void spawn()
         int type = passiveMobs[mineserver->tools.uniformInt(0, sizeof(passiveMobs) / sizeof(passiveMobs[0]) - 1)];
         int newMob = mineserver->mob.createMob(type);
         mineserver->mob.setHealth(newMob, defaultHealth(type));
-        MyPetMobPtr newMobData(new MyPetMob(newMob));
-        MyMobs.push_back(newMobData);
+        MyMobs.insert(newMob);
         mineserver->mob.moveMobW(newMob,x,y,z,w);
         mineserver->mob.spawnMob(newMob);
         if (type == MOB_SHEEP)
@@ -205,63 +192,56 @@ void spawn()
 void timer200Function()
 {
   spawn();
+}
+
+void forgetMob(int mobID)
+{
+  mineserver->mob.despawnMob(mobID);
+  mineserver->mob.removeMob(mobID);
+  MyMobs.erase(mobID);
+}
 
-  for (int i = MyMobs.size() - 1; i >= 0; i--)
+void mobTickFunction(mob_batch* mobs)
+{
+  for (int i = 0; i < mobs->count; i++)
   {
-    double x,y,z;
-    int w;
-    // get position and world
-    mineserver->mob.getMobPositionW(MyMobs[i]->ID, &x, &y, &z, &w);
+    const int mobID = mobs->id[i];
+    if (MyMobs.find(mobID) == MyMobs.end())
+    {
+      continue;
+    }
+
+    double x = mobs->x[i], y = mobs->y[i], z = mobs->z[i];
+    const int w = mobs->map[i];
     // kill dead mobs
-    if(mineserver->mob.getHealth(MyMobs[i]->ID) == 0)
+    if (mobs->health[i] == 0)
     {
-      if (MyMobs[i]->deSpawn < 12)
+      if (mobs->ai_state[i] < 12)
       {
-        MyMobs[i]->deSpawn++;
+        mobs->ai_state[i]++;
       }
       else
       {
-        mineserver->mob.despawnMob(MyMobs[i]->ID);
-        /* TODO: fix memory leak */
-        MyMobs.erase(MyMobs.begin()+i);
+        forgetMob(mobID);
       }
       continue;
     }
     else
     {
-      MyMobs[i]->deSpawn=0;
+      mobs->ai_state[i] = 0;
     }
-    // get the nearest user
-    int nearest = 10000;
-    double nearest_x = .0, nearest_y = .0, nearest_z = .0;
-    for (int j = 0; j < mineserver->user.getCount(); j++)
+    // if there is no user here, despawn the mob
+    if (!mineserver->mob.getNearestPlayer(w, x, y, z, 200, NULL, NULL))
     {
-      const char * const name = mineserver->user.getUserNumbered(j);
-      double px,py,pz;
-      int pmap;
-      mineserver->user.getPositionW(name, &px,&py,&pz,&pmap,NULL,NULL,NULL);
-
-      if (w != pmap) { continue; }
-      int distance = abs(int(px-x)) + abs(int(py-y)) + abs(int(pz-z));
-      if(distance < nearest) {
-        nearest = distance;
-        nearest_x = px;
-        nearest_y = py;
-        nearest_z = pz;
-      }
-    }
-    if(nearest < 0 || nearest > 200)
-    {
-      // if there is no user here, despawn the mob
-      mineserver->mob.despawnMob(MyMobs[i]->ID);
-      MyMobs.erase(MyMobs.begin()+i);
+      forgetMob(mobID);
       continue;
     }
     // do something, my little mob
     int action = rand() % 150;
-    double yaw, pitch, head_yaw;
+    double& yaw = mobs->yaw[i];
+    double& head_yaw = mobs->head_yaw[i];
+    double& velocity = mobs->ai_value[i];
     float forward = 0;
-    mineserver->mob.getLook(MyMobs[i]->ID, &yaw, &pitch, &head_yaw);
     if (action < 5)
     {
       yaw += 30;
@@ -295,19 +275,15 @@ void timer200Function()
       // turn around!
       yaw -= 180;
     }
-    MyMobs[i]->velocity += forward;
-    if (MyMobs[i]->velocity > 2.0){ MyMobs[i]->velocity = 2.0; }
-    if (MyMobs[i]->velocity < 0.0){ MyMobs[i]->velocity = 0.0; }
-    forward = MyMobs[i]->velocity;
+    velocity += forward;
+    if (velocity > 2.0){ velocity = 2.0; }
+    if (velocity < 0.0){ velocity = 0.0; }
+    forward = velocity;
 
     if (yaw <= 0) { yaw += 360; }
     if (yaw >= 360) { yaw -= 360; }
 
     // TODO: make it look at the player if he's near enough.
-    // (nearest_x, nearest_y, nearest_z).
-/*    if(nearest_z != z) {
-      head_yaw = RADIANS_TO_DEGREES(tan((nearest_x - x) / (nearest_z - z)));
-    }*/
 
     if (forward>0.1 && rand()%6 == 3)
     {
@@ -318,12 +294,11 @@ void timer200Function()
       if(moveSuitable(&x,&y,&z,w))
       {
         fallMob(&x,&y,&z,w);
-        mineserver->mob.moveMobW(MyMobs[i]->ID,x,y,z,w);
+        mobs->x[i] = x;
+        mobs->y[i] = y;
+        mobs->z[i] = z;
       }
-      fallMob(&x,&y,&z,w); // Even if they dont move, make them fall
     }
-    mineserver->mob.setLook(MyMobs[i]->ID, yaw, pitch, head_yaw);
-
   }
 }
 
@@ -435,6 +410,7 @@ PLUGIN_API_EXPORT void CALLCONVERSION passiveMobs_init(mineserver_pointer_struct
     cos_lt[i] = cos(((double)(i/10)*PI/180));
   }
   mineserver->plugin.addCallback("Timer200", reinterpret_cast<voidF>(timer200Function));
+  mineserver->plugin.addCallback("MobTick", reinterpret_cast<voidF>(mobTickFunction));
   mineserver->plugin.addCallback("gotAttacked", reinterpret_cast<voidF>(gotAttacked));
   mineserver->plugin.addCallback("interact", reinterpret_cast<voidF>(interact));
 }
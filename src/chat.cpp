@@ -25,6 +25,7 @@
   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
 #include <ctime>
 #include <iostream>
 #include <fstream>
@@ -42,7 +43,22 @@
 #include "chat.h"
 
 Chat::Chat()
+  : m_rate(2.0),
+    m_burst(8.0),
+    m_budget(10)
 {
+  if (ServerInstance->config()->has("system.chat.rate"))
+  {
+    m_rate = std::max(0.0, ServerInstance->config()->dData("system.chat.rate"));
+  }
+  if (ServerInstance->config()->has("system.chat.burst"))
+  {
+    m_burst = std::max(1.0, ServerInstance->config()->dData("system.chat.burst"));
+  }
+  if (ServerInstance->config()->has("system.chat.budget"))
+  {
+    m_budget = std::max(1, ServerInstance->config()->iData("system.chat.budget"));
+  }
 }
 
 Chat::~Chat()
@@ -110,6 +126,88 @@ std::deque<std::string> Chat::parseCmd(std::string cmd)
   return temp;
 }
 
+bool Chat::takeToken(User* user)
+{
+  if (m_rate <= 0 || user->UID == SERVER_CONSOLE_UID)
+  {
+    return true;
+  }
+
+  const uint64_t now = microTime();
+  if (user->chatTokens < 0)
+  {
+    user->chatTokens = m_burst;
+  }
+  else
+  {
+    user->chatTokens = std::min(m_burst, user->chatTokens + (now - user->chatTokensTime) / 1000000.0 * m_rate);
+  }
+  user->chatTokensTime = now;
+
+  if (user->chatTokens < 1.0)
+  {
+    return false;
+  }
+  user->chatTokens -= 1.0;
+  return true;
+}
+
+bool Chat::queueMsg(User* user, const std::string& msg)
+{
+  if (msg.empty())
+  {
+    return true;
+  }
+
+  if (!takeToken(user))
+  {
+    sendMsg(user, MC_COLOR_RED + "You are sending messages too fast", USER);
+    return false;
+  }
+
+  QueuedMsg queued;
+  queued.user = user;
+  queued.msg  = msg;
+  m_queue.push_back(queued);
+  return true;
+}
+
+void Chat::update()
+{
+  const uint64_t start = microTime();
+  const uint64_t budget = uint64_t(m_budget) * 1000;
+
+  // Whatever the budget, handle at least one message per tick
+  while (!m_queue.empty())
+  {
+    QueuedMsg queued = m_queue.front();
+    m_queue.pop_front();
+    handleMsg(queued.user, queued.msg);
+
+    if (microTime() - start >= budget)
+    {
+      break;
+    }
+  }
+
+  flushBroadcast();
+}
+
+void Chat::removeUser(User* user)
+{
+  for (std::deque<QueuedMsg>::iterator it = m_queue.begin(); it != m_queue.end();)
+  {
+    if (it->user == user)
+    {
+      it = m_queue.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
 bool Chat::handleMsg(User* user, std::string msg)
 {
   if (msg.empty()) // If the message is empty handle it as if there is no message.
@@ -123,11 +221,11 @@ bool Chat::handleMsg(User* user, std::string msg)
   std::string timeStamp(asctime(Tm));
   timeStamp = timeStamp.substr(11, 5);
 
-  if ((static_cast<Hook3<bool, const char*, time_t, const char*>*>(ServerInstance->plugin()->getHook("PlayerChatPre")))->doUntilFalse(user->nick.c_str(), rawTime, msg.c_str()))
+  if (ServerInstance->plugin()->hook<HOOK_PLAYER_CHAT_PRE>()->doUntilFalse(user->nick.c_str(), rawTime, msg.c_str()))
   {
     return false;
   }
-  (static_cast<Hook3<bool, const char*, time_t, const char*>*>(ServerInstance->plugin()->getHook("PlayerChatPost")))->doAll(user->nick.c_str(), rawTime, msg.c_str());
+  ServerInstance->plugin()->hook<HOOK_PLAYER_CHAT_POST>()->doAll(user->nick.c_str(), rawTime, msg.c_str());
   char prefix = msg[0];
 
   switch (prefix)
@@ -188,7 +286,7 @@ void Chat::handleCommand(User* user, std::string msg, const std::string& timeSta
   }
   else
   {
-    (static_cast<Hook4<bool, const char*, const char*, int, const char**>*>(ServerInstance->plugin()->getHook("PlayerChatCommand")))->doAll(user->nick.c_str(), command.c_str(), cmd.size(), (const char**)param);
+    ServerInstance->plugin()->hook<HOOK_PLAYER_CHAT_COMMAND>()->doAll(user->nick.c_str(), command.c_str(), cmd.size(), (const char**)param);
   }
 
   delete [] param;
@@ -256,14 +354,20 @@ bool Chat::sendMsg(User* user, std::string msg, MessageTarget action)
     tmpArray[2 * i + 4] = (result[i] & 0xFF); // low byte
   }
 
+  // Keep the order of messages to different targets
+  if (action != ALL)
+  {
+    flushBroadcast();
+  }
+
   switch (action)
   {
   case ALL:
-    user->sendAll(tmpArray, tmpArrayLen);
+    m_broadcast.insert(m_broadcast.end(), tmpArray, tmpArray + tmpArrayLen);
     break;
 
   case USER:
-    user->buffer.addToWrite(tmpArray, tmpArrayLen);
+    user->send(tmpArray, tmpArrayLen);
     break;
 
   case ADMINS:
@@ -287,3 +391,14 @@ bool Chat::sendMsg(User* user, std::string msg, MessageTarget action)
 
   return true;
 }
+
+void Chat::flushBroadcast()
+{
+  if (m_broadcast.empty())
+  {
+    return;
+  }
+
+  User::sendAll(&m_broadcast[0], m_broadcast.size());
+  m_broadcast.clear();
+}
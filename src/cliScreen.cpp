@@ -79,8 +79,8 @@ void CliScreen::init(std::string version)
   stdinThread = CreateThread(NULL, 0, _stdinThreadProc, (void*)this, 0, NULL);
 #endif
 
-  static_cast<Hook3<bool, int, const char*, const char*>*>(ServerInstance->plugin()->getHook("LogPost"))->addCallback(&CliScreen::Log);
-  static_cast<Hook0<bool>*>(ServerInstance->plugin()->getHook("Timer200"))->addCallback(&CliScreen::CheckForCommand);
+  ServerInstance->plugin()->hook<HOOK_LOG_POST>()->addCallback(&CliScreen::Log);
+  ServerInstance->plugin()->hook<HOOK_TIMER200>()->addCallback(&CliScreen::CheckForCommand);
 }
 
 void CliScreen::end()
@@ -93,7 +93,8 @@ void CliScreen::end()
 
 void CliScreen::log(LogType::LogType type, const std::string& source, const std::string& message)
 {
-  std::cout << "[" << currentTimestamp(true) << "] " << source << ": " << message << std::endl;
+  // Logger flushes after each batch
+  std::cout << "[" << currentTimestamp(true) << "] " << source << ": " << message << '\n';
 }
 
 void CliScreen::updatePlayerList(std::vector<User*> users)
@@ -29,51 +29,347 @@
 // Mineserver logger.cpp
 //
 
+#include <algorithm>
 #include <sstream>
 #include <stdio.h>
+#include <stdarg.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 #include "mineserver.h"
 #include "plugin.h"
+#include "config.h"
 
 #include "logger.h"
 
-void Logger::log(const std::string& msg, const std::string& file, int line)
+#define LOG_QUEUE_SIZE 4096
+// Messages written per flush
+#define LOG_BATCH      256
+
+#ifdef DEBUG
+#define LOG_DEFAULT_LEVEL LogType::LOG_DEBUG
+#else
+#define LOG_DEFAULT_LEVEL LogType::LOG_INFO
+#endif
+
+#ifdef WIN32
+static inline bool compareAndSwap(volatile uint32_t* value, uint32_t expected, uint32_t desired)
 {
-  std::ostringstream str;
-  size_t pos;
+  return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, (LONG)desired, (LONG)expected) == expected;
+}
 
-  pos = file.rfind(PATH_SEPARATOR);
-  if (pos != std::string::npos)
+static inline void atomicIncrement(volatile uint32_t* value)
+{
+  InterlockedIncrement((volatile LONG*)value);
+}
+
+static inline void memoryFence()
+{
+  MemoryBarrier();
+}
+
+static inline void sleepMs(int ms)
+{
+  Sleep(ms);
+}
+#else
+static inline bool compareAndSwap(volatile uint32_t* value, uint32_t expected, uint32_t desired)
+{
+  return __sync_bool_compare_and_swap(value, expected, desired);
+}
+
+static inline void atomicIncrement(volatile uint32_t* value)
+{
+  __sync_fetch_and_add(value, 1);
+}
+
+static inline void memoryFence()
+{
+  __sync_synchronize();
+}
+
+static inline void sleepMs(int ms)
+{
+  usleep(ms * 1000);
+}
+#endif
+
+// Same order as LogType
+static const char* levelNames[] = { "emerg", "alert", "critical", "error", "warning", "notice", "info", "debug" };
+
+Logger::Logger()
+  : m_level(LOG_DEFAULT_LEVEL),
+    m_overflow(OVERFLOW_DROP),
+    m_ring(NULL),
+    m_capacity(LOG_QUEUE_SIZE),
+    m_head(0),
+    m_tail(0),
+    m_dropped(0),
+    m_running(false)
+{
+}
+
+Logger::~Logger()
+{
+  stop();
+  delete [] m_ring;
+}
+
+void Logger::configure()
+{
+  const std::tr1::shared_ptr<Config> config = ServerInstance->config();
+
+  if (config->has("system.log.level"))
+  {
+    const std::string level = config->sData("system.log.level");
+    for (int i = 0; i < LogType::LOG_COUNT; i++)
+    {
+      if (level == levelNames[i])
+      {
+        m_level = (LogType::LogType)i;
+      }
+    }
+  }
+
+  if (config->has("system.log.overflow"))
   {
-    str << file.substr(pos + 1, file.length());
+    m_overflow = config->sData("system.log.overflow") == "block" ? OVERFLOW_BLOCK : OVERFLOW_DROP;
   }
-  str << ":";
-  str << (int)line;
 
-  log(LogType::LOG_INFO, str.str(), msg);
+  if (config->has("system.log.queue_size") && m_ring == NULL)
+  {
+    // Power of two, so tickets map to slots with a mask
+    const uint32_t size = uint32_t(std::max(16, config->iData("system.log.queue_size")));
+    m_capacity = 16;
+    while (m_capacity < size)
+    {
+      m_capacity <<= 1;
+    }
+  }
 }
 
-void Logger::log(LogType::LogType type, const std::string& source, const std::string& message)
+void Logger::start()
 {
-  Hook* hook = NULL;
-  if (!ServerInstance->plugin()
-      || !(hook = ServerInstance->plugin()->getHook("LogPost")))
+  if (m_running)
   {
-    std::clog.tie(&std::cout);
-    if (type < LogType::LOG_WARNING)
+    return;
+  }
+
+  if (m_ring == NULL)
+  {
+    m_ring = new Entry[m_capacity];
+    for (uint32_t i = 0; i < m_capacity; i++)
     {
-      std::clog.tie(&std::cerr);
+      m_ring[i].sequence = i;
     }
+  }
 
-    std::clog << source << ": " << message << std::endl;
+  memoryFence();
+  m_running = true;
+  if (pthread_create(&m_thread, NULL, &Logger::run, this) != 0)
+  {
+    m_running = false;
+    log(LogType::LOG_WARNING, "Logger", std::string("Cannot start the log writer thread, writing synchronously"));
+  }
+}
+
+void Logger::stop()
+{
+  if (!m_running)
+  {
     return;
   }
 
-  (static_cast<Hook3<bool, int, const char*, const char*>*>(hook))->doAll((int)type, source.c_str(), message.c_str());
+  m_running = false;
+  pthread_join(m_thread, NULL);
+
+  // Anything pushed while the writer was on its way out
+  while (drain(LOG_BATCH) != 0)
+  {
+  }
+  flush();
+}
+
+void* Logger::run(void* arg)
+{
+  Logger* logger = static_cast<Logger*>(arg);
+
+  for (;;)
+  {
+    const bool running = logger->m_running;
+    const size_t written = logger->drain(LOG_BATCH);
+
+    uint32_t dropped = logger->m_dropped;
+    while (dropped != 0 && !compareAndSwap(&logger->m_dropped, dropped, 0))
+    {
+      dropped = logger->m_dropped;
+    }
+    if (dropped != 0)
+    {
+      logger->write(LogType::LOG_WARNING, "Logger", dtos(dropped) + " messages dropped, the log queue was full");
+    }
+
+    if (written != 0 || dropped != 0)
+    {
+      logger->flush();
+    }
+    else if (!running)
+    {
+      break;
+    }
+    else
+    {
+      sleepMs(5);
+    }
+  }
+
+  return NULL;
+}
+
+void Logger::push(LogType::LogType type, const char* file, int line, const char* function, const std::string& source, const std::string& message)
+{
+  uint32_t ticket = m_head;
+
+  for (;;)
+  {
+    Entry& entry = m_ring[ticket & (m_capacity - 1)];
+    const int32_t diff = int32_t(entry.sequence - ticket);
+    memoryFence();
+
+    if (diff == 0)
+    {
+      if (compareAndSwap(&m_head, ticket, ticket + 1))
+      {
+        entry.type     = type;
+        entry.file     = file;
+        entry.line     = line;
+        entry.function = function;
+        entry.source   = source;
+        entry.message  = message;
+        memoryFence();
+        entry.sequence = ticket + 1;
+        return;
+      }
+    }
+    else if (diff < 0)
+    {
+      // Full, the writer has not freed this slot since the last lap
+      if (m_overflow == OVERFLOW_DROP && type > LogType::LOG_WARNING)
+      {
+        atomicIncrement(&m_dropped);
+        return;
+      }
+      sleepMs(1);
+    }
+
+    ticket = m_head;
+  }
+}
+
+size_t Logger::drain(size_t max)
+{
+  size_t count = 0;
+
+  while (count < max)
+  {
+    Entry& entry = m_ring[m_tail & (m_capacity - 1)];
+    if (int32_t(entry.sequence - (m_tail + 1)) < 0)
+    {
+      break;
+    }
+    memoryFence();
+
+    if (entry.file != NULL)
+    {
+      entry.source = formatSource(entry.file, entry.line, entry.function);
+    }
+    write(entry.type, entry.source, entry.message);
+
+    // Keep the capacity, the next lap reuses it
+    entry.source.clear();
+    entry.message.clear();
+    memoryFence();
+    entry.sequence = m_tail + m_capacity;
+    m_tail++;
+    count++;
+  }
+
+  return count;
+}
+
+std::string Logger::formatSource(const char* file, int line, const char* function)
+{
+  std::string source(file);
+  const size_t pos = source.rfind(PATH_SEPARATOR);
+  if (pos != std::string::npos)
+  {
+    source.erase(0, pos + 1);
+  }
+
+  if (line != 0)
+  {
+    source += ":" + dtos(line);
+  }
+
+  if (function != NULL)
+  {
+    source += "::" + std::string(function) + "()";
+  }
+
+  return source;
+}
+
+void Logger::log(const std::string& msg, const std::string& file, int line)
+{
+  if (enabled(LogType::LOG_INFO))
+  {
+    log(LogType::LOG_INFO, formatSource(file.c_str(), line, NULL), msg);
+  }
+}
+
+void Logger::log(LogType::LogType type, const char* file, int line, const char* function, const std::string& message)
+{
+  if (!enabled(type))
+  {
+    return;
+  }
+
+  if (m_running && !pthread_equal(pthread_self(), m_thread))
+  {
+    push(type, file, line, function, std::string(), message);
+    return;
+  }
+
+  write(type, formatSource(file, line, function), message);
+  flush();
+}
+
+void Logger::log(LogType::LogType type, const std::string& source, const std::string& message)
+{
+  if (!enabled(type))
+  {
+    return;
+  }
+
+  // The writer thread itself (a LogPost callback logging) must not wait on the ring
+  if (m_running && !pthread_equal(pthread_self(), m_thread))
+  {
+    push(type, NULL, 0, NULL, source, message);
+    return;
+  }
+
+  write(type, source, message);
+  flush();
 }
 
 void Logger::log(LogType::LogType type, const std::string& source, const char* message, ...)
 {
+  if (!enabled(type))
+  {
+    return;
+  }
+
   // Message formatting
   char buffer[4096];
   va_list args;
@@ -84,3 +380,28 @@ void Logger::log(LogType::LogType type, const std::string& source, const char* m
   // Call back to our own logging function because i am too lazy to make it here
   this->log(type, source, std::string(buffer));
 }
+
+void Logger::write(LogType::LogType type, const std::string& source, const std::string& message)
+{
+  HookTraits<HOOK_LOG_POST>::type* hook = NULL;
+  if (!ServerInstance->plugin()
+      || !(hook = ServerInstance->plugin()->hook<HOOK_LOG_POST>()))
+  {
+    std::clog.tie(&std::cout);
+    if (type < LogType::LOG_WARNING)
+    {
+      std::clog.tie(&std::cerr);
+    }
+
+    std::clog << source << ": " << message << '\n';
+    return;
+  }
+
+  hook->doAll((int)type, source.c_str(), message.c_str());
+}
+
+void Logger::flush()
+{
+  std::clog.flush();
+  std::cout.flush();
+}
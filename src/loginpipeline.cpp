@@ -0,0 +1,540 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <zlib.h>
+#include <openssl/crypto.h>
+
+#include "loginpipeline.h"
+#include "playerstore.h"
+#include "nbt.h"
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL before 1.1 is only thread safe with locking callbacks, which the
+// RSA blinding shared by the workers needs
+static pthread_mutex_t* sslLocks = NULL;
+
+static void sslLock(int mode, int n, const char*, int)
+{
+  if (mode & CRYPTO_LOCK)
+  {
+    pthread_mutex_lock(&sslLocks[n]);
+  }
+  else
+  {
+    pthread_mutex_unlock(&sslLocks[n]);
+  }
+}
+
+static unsigned long sslThreadId()
+{
+  return (unsigned long)pthread_self();
+}
+
+static void initSslLocks()
+{
+  if (sslLocks != NULL || CRYPTO_get_locking_callback() != NULL)
+  {
+    return;
+  }
+  sslLocks = new pthread_mutex_t[CRYPTO_num_locks()];
+  for (int i = 0; i < CRYPTO_num_locks(); i++)
+  {
+    pthread_mutex_init(&sslLocks[i], NULL);
+  }
+  CRYPTO_set_id_callback(sslThreadId);
+  CRYPTO_set_locking_callback(sslLock);
+}
+#endif
+
+LoginPipeline::PlayerData::PlayerData()
+  : found(false), x(0), y(0), z(0), yaw(0), pitch(0), health(20)
+{
+  for (int i = 0; i < 45; i++)
+  {
+    inv[i].type   = -1;
+    inv[i].count  = 0;
+    inv[i].health = 0;
+  }
+}
+
+LoginPipeline::LoginPipeline(RSA* rsa, const std::string& verifyToken, int workers, size_t queueLimit,
+                             PlayerStore* store)
+  : m_rsa(rsa),
+    m_verifyToken(verifyToken),
+    m_store(store),
+    m_workerCount(std::max(0, workers)),
+    m_queueLimit(std::max(size_t(1), queueLimit)),
+    m_running(false),
+    m_handshakesQueued(0),
+    m_rateLogins(0),
+    m_rateTime(nowMs())
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_wakeup, NULL);
+}
+
+LoginPipeline::~LoginPipeline()
+{
+  stop();
+  pthread_cond_destroy(&m_wakeup);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+bool LoginPipeline::start()
+{
+  if (m_running)
+  {
+    return true;
+  }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  initSslLocks();
+#endif
+
+  m_running = true;
+  if (m_workerCount == 0)
+  {
+    return true;
+  }
+
+  for (int i = 0; i < m_workerCount; i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &LoginPipeline::run, this) != 0)
+    {
+      break;
+    }
+    m_workers.push_back(thread);
+  }
+
+  if (m_workers.empty())
+  {
+    m_running = false;
+  }
+  return m_running;
+}
+
+void LoginPipeline::stop()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_running = false;
+  m_queue.clear();
+  m_handshakesQueued = 0;
+  pthread_cond_broadcast(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    pthread_join(m_workers[i], NULL);
+  }
+  m_workers.clear();
+}
+
+bool LoginPipeline::submitHandshake(uint32_t UID, const std::string& secret, const std::string& verify)
+{
+  pthread_mutex_lock(&m_mutex);
+  if (!m_running || m_handshakesQueued >= m_queueLimit)
+  {
+    m_stats.refused++;
+    pthread_mutex_unlock(&m_mutex);
+    return false;
+  }
+
+  m_queue.push_back(Job());
+  Job& job   = m_queue.back();
+  job.stage  = HANDSHAKE;
+  job.UID    = UID;
+  job.first  = secret;
+  job.second = verify;
+  m_handshakesQueued++;
+
+  pthread_cond_signal(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+  runInline();
+  return true;
+}
+
+void LoginPipeline::submitPlayerData(uint32_t UID, const std::string& file)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_queue.push_back(Job());
+  Job& job  = m_queue.back();
+  job.stage = PLAYER_DATA;
+  job.UID   = UID;
+  job.first = file;
+
+  pthread_cond_signal(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+  runInline();
+}
+
+void LoginPipeline::submitChunks(uint32_t UID, std::vector<Chunk>& chunks)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_queue.push_back(Job());
+  Job& job  = m_queue.back();
+  job.stage = CHUNKS;
+  job.UID   = UID;
+  job.chunks.swap(chunks);
+
+  pthread_cond_signal(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+  chunks.clear();
+  runInline();
+}
+
+void LoginPipeline::poll(std::vector<Result>& results)
+{
+  pthread_mutex_lock(&m_mutex);
+  for (size_t i = 0; i < m_done.size(); i++)
+  {
+    results.push_back(Result());
+    Result& result = results.back();
+    result.stage  = m_done[i].stage;
+    result.UID    = m_done[i].UID;
+    result.ok     = m_done[i].ok;
+    result.player = m_done[i].player;
+    result.secret.swap(m_done[i].secret);
+    result.chunks.swap(m_done[i].chunks);
+  }
+  m_done.clear();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void LoginPipeline::loggedIn()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_stats.logins++;
+  pthread_mutex_unlock(&m_mutex);
+}
+
+double LoginPipeline::loginRate()
+{
+  const uint64_t now = nowMs();
+
+  pthread_mutex_lock(&m_mutex);
+  const uint64_t logins = m_stats.logins - m_rateLogins;
+  m_rateLogins = m_stats.logins;
+  pthread_mutex_unlock(&m_mutex);
+
+  const uint64_t elapsed = now - m_rateTime;
+  m_rateTime = now;
+  return elapsed == 0 ? 0.0 : logins * 1000.0 / elapsed;
+}
+
+size_t LoginPipeline::queued()
+{
+  pthread_mutex_lock(&m_mutex);
+  const size_t size = m_queue.size();
+  pthread_mutex_unlock(&m_mutex);
+  return size;
+}
+
+LoginPipeline::Stats LoginPipeline::stats()
+{
+  pthread_mutex_lock(&m_mutex);
+  const Stats stats = m_stats;
+  pthread_mutex_unlock(&m_mutex);
+  return stats;
+}
+
+bool LoginPipeline::decrypt(RSA* rsa, const std::string& verifyToken, const std::string& secret,
+                            const std::string& verify, std::string& decrypted)
+{
+  uint8_t buffer[1024];
+
+  // Those should be around 128 bytes
+  if (verify.size() > sizeof(buffer) || secret.size() > sizeof(buffer))
+  {
+    return false;
+  }
+
+  // Check the verification bytes match the ones sent
+  int ret = RSA_private_decrypt(int(verify.size()), (const uint8_t*)verify.data(), buffer, rsa, RSA_PKCS1_PADDING);
+  if (ret != int(verifyToken.size()) || std::string((char*)buffer, ret) != verifyToken)
+  {
+    return false;
+  }
+
+  ret = RSA_private_decrypt(int(secret.size()), (const uint8_t*)secret.data(), buffer, rsa, RSA_PKCS1_PADDING);
+  // The cipher is keyed with the first 16 bytes
+  if (ret < 16)
+  {
+    return false;
+  }
+  decrypted.assign((char*)buffer, ret);
+  return true;
+}
+
+bool LoginPipeline::readPlayerData(const std::string& file, PlayerData& player)
+{
+  struct stat stFileInfo;
+  if (stat(file.c_str(), &stFileInfo) != 0)
+  {
+    return false;
+  }
+
+  NBT_Value* playerRoot = NBT_Value::LoadFromFile(file.c_str());
+  if (playerRoot == NULL)
+  {
+    return false;
+  }
+  NBT_Value& nbtPlayer = *playerRoot;
+
+  NBT_Value* pos    = nbtPlayer["Pos"];
+  NBT_Value* health = nbtPlayer["Health"];
+  NBT_Value* rot    = nbtPlayer["Rotation"];
+  NBT_Value* inv    = nbtPlayer["Inventory"];
+  if (pos == NULL || pos->GetList() == NULL || pos->GetList()->size() < 3 ||
+      rot == NULL || rot->GetList() == NULL || rot->GetList()->size() < 2 ||
+      health == NULL || inv == NULL || inv->GetList() == NULL)
+  {
+    delete playerRoot;
+    return false;
+  }
+
+  std::vector<NBT_Value*>& _pos = *pos->GetList();
+  player.x = (double)(*_pos[0]);
+  player.y = (double)(*_pos[1]);
+  player.z = (double)(*_pos[2]);
+
+  player.health = *health;
+
+  std::vector<NBT_Value*>& _rot = *rot->GetList();
+  player.yaw   = (float)(*_rot[0]);
+  player.pitch = (float)(*_rot[1]);
+
+  std::vector<NBT_Value*>::iterator iter = inv->GetList()->begin(), end = inv->GetList()->end();
+  for (; iter != end ; iter++)
+  {
+    int8_t slot, count;
+    int16_t damage, item_id;
+
+    slot    = *(**iter)["Slot"];
+    count   = *(**iter)["Count"];
+    damage  = *(**iter)["Damage"];
+    item_id = *(**iter)["id"];
+    if (item_id == 0 || count < 1)
+    {
+      item_id = -1;
+      count   =  0;
+    }
+
+    int index = -1;
+    // Main inventory slot, converting 0-35 slots to 9-44
+    if (slot >= 0 && slot <= 35)
+    {
+      index = slot + 9;
+    }
+    // Crafting, converting 80-83 slots to 1-4
+    else if (slot >= 80 && slot <= 83)
+    {
+      index = slot - 79;
+    }
+    // Equipped, converting 100-103 slots to 8-5 (reverse order!)
+    else if (slot >= 100 && slot <= 103)
+    {
+      index = 8 + (100 - slot);
+    }
+
+    if (index != -1)
+    {
+      player.inv[index].type   = item_id;
+      player.inv[index].count  = count;
+      player.inv[index].health = damage;
+    }
+  }
+  delete playerRoot;
+
+  player.found = true;
+  return true;
+}
+
+void LoginPipeline::compressChunk(Chunk& chunk)
+{
+  uLongf written = compressBound(uLong(chunk.data.size()));
+  std::vector<uint8_t> compressed(written);
+
+  if (chunk.data.empty() || compress(&compressed[0], &written, &chunk.data[0], uLong(chunk.data.size())) != Z_OK)
+  {
+    written = 0;
+  }
+  compressed.resize(written);
+  chunk.data.swap(compressed);
+}
+
+void* LoginPipeline::run(void* arg)
+{
+  static_cast<LoginPipeline*>(arg)->work();
+  return NULL;
+}
+
+void LoginPipeline::work()
+{
+  Job job;
+
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while (m_running && m_queue.empty())
+    {
+      pthread_cond_wait(&m_wakeup, &m_mutex);
+    }
+    if (!m_running)
+    {
+      break;
+    }
+
+    takeJob(job);
+    pthread_mutex_unlock(&m_mutex);
+    process(job);
+    pthread_mutex_lock(&m_mutex);
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+// Without workers the stages run right away on the submitting thread,
+// their results still come out of the next poll()
+void LoginPipeline::runInline()
+{
+  if (m_workerCount != 0)
+  {
+    return;
+  }
+
+  Job job;
+  pthread_mutex_lock(&m_mutex);
+  while (!m_queue.empty())
+  {
+    takeJob(job);
+    pthread_mutex_unlock(&m_mutex);
+    process(job);
+    pthread_mutex_lock(&m_mutex);
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+// Moves the oldest job out of the queue, m_mutex must be held
+void LoginPipeline::takeJob(Job& job)
+{
+  Job& front = m_queue.front();
+  job.stage = front.stage;
+  job.UID   = front.UID;
+  job.first.swap(front.first);
+  job.second.swap(front.second);
+  job.chunks.swap(front.chunks);
+  m_queue.pop_front();
+  if (job.stage == HANDSHAKE)
+  {
+    m_handshakesQueued--;
+  }
+}
+
+void LoginPipeline::process(Job& job)
+{
+  Result result;
+  result.stage = job.stage;
+  result.UID   = job.UID;
+
+  switch (job.stage)
+  {
+  case HANDSHAKE:
+    result.ok = decrypt(m_rsa, m_verifyToken, job.first, job.second, result.secret);
+    break;
+
+  case PLAYER_DATA:
+    // No player file is fine, the player starts at the spawn
+    if (m_store != NULL)
+    {
+      m_store->load(job.first, result.player);
+    }
+    else
+    {
+      readPlayerData(job.first, result.player);
+    }
+    result.ok = true;
+    break;
+
+  case CHUNKS:
+    for (size_t i = 0; i < job.chunks.size(); i++)
+    {
+      compressChunk(job.chunks[i]);
+    }
+    result.chunks.swap(job.chunks);
+    result.ok = true;
+    break;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  switch (result.stage)
+  {
+  case HANDSHAKE:
+    m_stats.handshakes++;
+    if (!result.ok)
+    {
+      m_stats.badHandshakes++;
+    }
+    break;
+  case PLAYER_DATA:
+    m_stats.playerFiles++;
+    break;
+  case CHUNKS:
+    m_stats.chunks += result.chunks.size();
+    break;
+  }
+
+  m_done.push_back(Result());
+  Result& done = m_done.back();
+  done.stage  = result.stage;
+  done.UID    = result.UID;
+  done.ok     = result.ok;
+  done.player = result.player;
+  done.secret.swap(result.secret);
+  done.chunks.swap(result.chunks);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+uint64_t LoginPipeline::nowMs()
+{
+#ifdef WIN32
+  return GetTickCount();
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+#endif
+}
@@ -38,15 +38,22 @@
 #include "tree.h"
 #include "furnaceManager.h"
 #include "mcregion.h"
+#include "protocol.h"
+#include "inventory.h"
 
 // Copy Construtor
 Map::Map(const Map& oldmap)
   :
   chunks(oldmap.chunks),
+  populating(NULL),
+  blockVersion(oldmap.blockVersion),
   mapLastused(oldmap.mapLastused),
   mapChanged(oldmap.mapChanged),
   mapLightRegen(oldmap.mapLightRegen),
   items(oldmap.items),
+  itemDespawnQueue(oldmap.itemDespawnQueue),
+  itemDespawnTime(oldmap.itemDespawnTime),
+  itemMerge(oldmap.itemMerge),
   mapTime(oldmap.mapTime),
   mapSeed(oldmap.mapSeed)
 {
@@ -54,7 +61,11 @@ Map::Map(const Map& oldmap)
 
 Map::Map()
   :
-  chunks(441) // buckets!
+  chunks(441), // buckets!
+  populating(NULL),
+  blockVersion(0),
+  itemDespawnTime(300),
+  itemMerge(true)
 {
   std::fill(emitLight, emitLight + 256, 0);
 
@@ -115,7 +126,7 @@ Map::~Map()
   }
 
   // Free item memory
-  for (std::map<uint32_t, spawnedItem*>::const_iterator it = items.begin(); it != items.end(); ++it)
+  for (ItemMap::const_iterator it = items.begin(); it != items.end(); ++it)
   {
     delete it->second;
   }
@@ -227,6 +238,15 @@ void Map::init(int number)
 
   LOG2(INFO, "Using world: " + mapDirectory);
 
+  if (ServerInstance->config()->has("map.items.despawn"))
+  {
+    itemDespawnTime = std::max(0, ServerInstance->config()->iData("map.items.despawn"));
+  }
+  if (ServerInstance->config()->has("map.items.merge"))
+  {
+    itemMerge = ServerInstance->config()->bData("map.items.merge");
+  }
+
   if (mapDirectory == "Not found!")
   {
     LOG2(WARNING, "mapdir not defined");
@@ -258,7 +278,9 @@ void Map::init(int number)
     level["Data"]->Insert("SpawnX", new NBT_Value((int32_t)0));
     level["Data"]->Insert("SpawnY", new NBT_Value((int32_t)120));
     level["Data"]->Insert("SpawnZ", new NBT_Value((int32_t)0));
-    level["Data"]->Insert("RandomSeed", new NBT_Value((int64_t)(rand() * 65535)));
+    // map.seed makes new worlds reproducible, for benchmarks
+    const int64_t seed = ServerInstance->config()->has("map.seed") ? ServerInstance->config()->iData("map.seed") : (int64_t)(rand() * 65535);
+    level["Data"]->Insert("RandomSeed", new NBT_Value(seed));
     level["Data"]->Insert("version", new NBT_Value((int32_t)19133));
     level["Data"]->Insert("LevelName", new NBT_Value(std::string("Mineserver world")));
 
@@ -347,9 +369,17 @@ sChunk* Map::getMapData(int x, int z,  bool generate)
 {
   const ChunkMap::const_iterator it = chunks.find(Coords(x, z));
 
-  if (it != chunks.end()) return it->second;
+  if (it != chunks.end())
+  {
+    if (generate && !it->second->populated && populating == NULL)
+    {
+      populateMap(it->second);
+    }
+    return it->second;
+  }
 
-  return generate == false ? NULL : loadMap(x, z, true);
+  // Features of the chunk being populated stay within the loaded neighbours
+  return (generate == false || populating != NULL) ? NULL : loadMap(x, z, true);
 }
 
 bool Map::saveWholeMap()
@@ -407,6 +437,8 @@ bool Map::saveWholeMap()
 
 bool Map::generateLight(int x, int z, sChunk* chunk)
 {
+  MapGenStats::Timer timer(MapGen::stats, MapGenStats::LIGHTING);
+
   if (chunk == NULL)
   {
     const ChunkMap::const_iterator it = chunks.find(Coords(x, z));
@@ -717,7 +749,8 @@ bool Map::getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool gener
 
   if (!chunk)
   {
-    if (generate)
+    // Features reaching past the populated chunk's neighbours are cut off
+    if (generate && populating == NULL)
     {
       LOGLF("Loading chunk failed (getBlock)");
     }
@@ -905,7 +938,10 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
 
   if (!chunk)
   {
-    LOGLF("Loading chunk failed (setBlock)");
+    if (populating == NULL)
+    {
+      LOGLF("Loading chunk failed (setBlock)");
+    }
     return false;
   }
 
@@ -930,6 +966,11 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
     metadata |= meta;
   }
   metapointer[index >> 1] = metadata;
+  touchSection(chunk, y >> 4);
+  if (type != BLOCK_AIR)
+  {
+    chunk->chunks_present |= 1 << (y >> 4);
+  }
 
   chunk->changed       = true;
   chunk->lightRegen    = true;
@@ -946,12 +987,14 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
     // We've actually moved down past the last air block to the one beneath, so we need to go back up one
     temp_y++;
 
-    std::map<uint32_t, spawnedItem*>::const_iterator it_a = items.begin(), it_b = items.end();
-    for (; it_a != it_b; ++it_a)
+    // Only the items in the cell of this chunk containing x,z can be resting on the block
+    std::vector<spawnedItem*> nearItems;
+    chunk->items.find(chunk_block_x, chunk_block_z, chunk_block_x, chunk_block_z, nearItems);
+    for (size_t i = 0; i < nearItems.size(); i++)
     {
-      if ((floor(static_cast<double>(it_a->second->pos.x()) / 32) == x) && (floor(static_cast<double>(it_a->second->pos.y()) / 32) == y + 1) && (floor(static_cast<double>(it_a->second->pos.z()) / 32) == z))
+      if (((nearItems[i]->pos.x() >> 5) == x) && ((nearItems[i]->pos.y() >> 5) == y + 1) && ((nearItems[i]->pos.z() >> 5) == z))
       {
-        it_a->second->pos.y() = temp_y * 32;
+        nearItems[i]->pos.y() = temp_y * 32;
       }
     }
   }
@@ -959,6 +1002,321 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
   return true;
 }
 
+// Above this many changed blocks fillChunk() resends the whole chunk instead of a multi block change
+#define FILL_RESEND_LIMIT 512
+
+int Map::fillChunk(int chunk_x, int chunk_z, int x1, int y1, int z1, int x2, int y2, int z2, int from, uint8_t type, uint8_t meta)
+{
+  const int baseX = chunk_x << 4;
+  const int baseZ = chunk_z << 4;
+
+  // Clip the box to the chunk, in chunk block coordinates
+  const int bx1 = std::max(std::min(x1, x2), baseX) - baseX;
+  const int bx2 = std::min(std::max(x1, x2), baseX + 15) - baseX;
+  const int bz1 = std::max(std::min(z1, z2), baseZ) - baseZ;
+  const int bz2 = std::min(std::max(z1, z2), baseZ + 15) - baseZ;
+  const int by1 = std::max(std::min(y1, y2), 0);
+  const int by2 = std::min(std::max(y1, y2), 255);
+
+  if (bx1 > bx2 || bz1 > bz2 || by1 > by2)
+  {
+    return 0;
+  }
+
+  sChunk* chunk = getMapData(chunk_x, chunk_z, true);
+  if (!chunk)
+  {
+    LOGLF("Loading chunk failed (fillChunk)");
+    return 0;
+  }
+
+  meta &= 0x0f;
+
+  std::set<vec> changedBlocks;
+  int changed = 0;
+
+  for (int section = by1 >> 4; section <= (by2 >> 4); section++)
+  {
+    // A section that is not present holds only air
+    if (!(chunk->chunks_present & (1 << section)) && (from > 0 || (from < 0 && type == BLOCK_AIR)))
+    {
+      continue;
+    }
+
+    int sectionChanged = 0;
+    const int sy1 = std::max(by1, section << 4);
+    const int sy2 = std::min(by2, (section << 4) + 15);
+
+    for (int y = sy1; y <= sy2; y++)
+    {
+      for (int z = bz1; z <= bz2; z++)
+      {
+        for (int x = bx1; x <= bx2; x++)
+        {
+          const int index = x + (z << 4) + (y << 8);
+          const int shift = (x & 1) << 2;
+          uint8_t& metadata = chunk->data[index >> 1];
+
+          if ((from >= 0 && chunk->blocks[index] != from) ||
+              (chunk->blocks[index] == type && ((metadata >> shift) & 0x0f) == meta))
+          {
+            continue;
+          }
+
+          chunk->blocks[index] = type;
+          metadata = (metadata & (0xf0 >> shift)) | (meta << shift);
+
+          sectionChanged++;
+          if (changed + sectionChanged <= FILL_RESEND_LIMIT)
+          {
+            changedBlocks.insert(vec(baseX + x, y, baseZ + z));
+          }
+        }
+      }
+    }
+
+    if (sectionChanged != 0)
+    {
+      touchSection(chunk, section);
+      if (type != BLOCK_AIR)
+      {
+        chunk->chunks_present |= 1 << section;
+      }
+    }
+    changed += sectionChanged;
+  }
+
+  sendChunkChanges(chunk, changedBlocks, changed);
+  return changed;
+}
+
+void Map::sendChunkChanges(sChunk* chunk, std::set<vec>& changedBlocks, int changed)
+{
+  if (changed == 0)
+  {
+    return;
+  }
+
+  chunk->changed    = true;
+  chunk->lightRegen = true;
+  chunk->lastused   = time(NULL);
+
+  if (changed <= FILL_RESEND_LIMIT)
+  {
+    // Clients light small changes themselves, ours is redone when the chunk is next sent or saved
+    sendMultiBlocks(changedBlocks);
+  }
+  else
+  {
+    generateLight(chunk->x, chunk->z, chunk);
+    chunk->lightRegen = false;
+
+    for (std::set<User*>::const_iterator it = chunk->users.begin(); it != chunk->users.end(); ++it)
+    {
+      if ((*it)->logged)
+      {
+        sendToUser(*it, chunk->x, chunk->z);
+      }
+    }
+  }
+}
+
+int Map::fill(int x1, int y1, int z1, int x2, int y2, int z2, int from, uint8_t type, uint8_t meta)
+{
+  int changed = 0;
+
+  for (int chunk_x = blockToChunk(std::min(x1, x2)); chunk_x <= blockToChunk(std::max(x1, x2)); chunk_x++)
+  {
+    for (int chunk_z = blockToChunk(std::min(z1, z2)); chunk_z <= blockToChunk(std::max(z1, z2)); chunk_z++)
+    {
+      changed += fillChunk(chunk_x, chunk_z, x1, y1, z1, x2, y2, z2, from, type, meta);
+    }
+  }
+
+  return changed;
+}
+
+int Map::getBlocks(int x1, int y1, int z1, int x2, int y2, int z2, uint8_t* types, uint8_t* metas)
+{
+  if (x1 > x2) std::swap(x1, x2);
+  if (y1 > y2) std::swap(y1, y2);
+  if (z1 > z2) std::swap(z1, z2);
+
+  const int sizeY = y2 - y1 + 1;
+  const int sizeZ = z2 - z1 + 1;
+  const size_t total = size_t(x2 - x1 + 1) * sizeZ * sizeY;
+
+  if (types != NULL)
+  {
+    std::fill(types, types + total, 0);
+  }
+  if (metas != NULL)
+  {
+    std::fill(metas, metas + total, 0);
+  }
+
+  const int ylow  = std::max(y1, 0);
+  const int yhigh = std::min(y2, 255);
+  int read = 0;
+
+  for (int chunk_x = blockToChunk(x1); chunk_x <= blockToChunk(x2); chunk_x++)
+  {
+    for (int chunk_z = blockToChunk(z1); chunk_z <= blockToChunk(z2); chunk_z++)
+    {
+      sChunk* chunk = getChunk(chunk_x, chunk_z);
+      if (chunk == NULL)
+      {
+        continue;
+      }
+
+      const int xlow  = std::max(x1, chunk_x << 4), xhigh = std::min(x2, (chunk_x << 4) + 15);
+      const int zlow  = std::max(z1, chunk_z << 4), zhigh = std::min(z2, (chunk_z << 4) + 15);
+
+      for (int x = xlow; x <= xhigh; x++)
+      {
+        for (int z = zlow; z <= zhigh; z++)
+        {
+          size_t out = (size_t(x - x1) * sizeZ + (z - z1)) * sizeY + (ylow - y1);
+          int index = (x & 15) + ((z & 15) << 4) + (ylow << 8);
+
+          for (int y = ylow; y <= yhigh; y++, out++, index += 256)
+          {
+            if (types != NULL)
+            {
+              types[out] = chunk->blocks[index];
+            }
+            if (metas != NULL)
+            {
+              metas[out] = (chunk->data[index >> 1] >> ((x & 1) << 2)) & 0x0f;
+            }
+          }
+          read += std::max(0, yhigh - ylow + 1);
+        }
+      }
+    }
+  }
+
+  return read;
+}
+
+int Map::setBlocks(int x1, int y1, int z1, int x2, int y2, int z2, const uint8_t* types, const uint8_t* metas)
+{
+  if (x1 > x2) std::swap(x1, x2);
+  if (y1 > y2) std::swap(y1, y2);
+  if (z1 > z2) std::swap(z1, z2);
+
+  const int sizeY = y2 - y1 + 1;
+  const int sizeZ = z2 - z1 + 1;
+  const int ylow  = std::max(y1, 0);
+  const int yhigh = std::min(y2, 255);
+  int total = 0;
+
+  for (int chunk_x = blockToChunk(x1); chunk_x <= blockToChunk(x2); chunk_x++)
+  {
+    for (int chunk_z = blockToChunk(z1); chunk_z <= blockToChunk(z2); chunk_z++)
+    {
+      sChunk* chunk = getMapData(chunk_x, chunk_z, true);
+      if (chunk == NULL)
+      {
+        LOGLF("Loading chunk failed (setBlocks)");
+        continue;
+      }
+
+      const int xlow  = std::max(x1, chunk_x << 4), xhigh = std::min(x2, (chunk_x << 4) + 15);
+      const int zlow  = std::max(z1, chunk_z << 4), zhigh = std::min(z2, (chunk_z << 4) + 15);
+
+      std::set<vec> changedBlocks;
+      uint16_t touched = 0;
+      int changed = 0;
+
+      for (int x = xlow; x <= xhigh; x++)
+      {
+        const int shift = (x & 1) << 2;
+        for (int z = zlow; z <= zhigh; z++)
+        {
+          size_t in = (size_t(x - x1) * sizeZ + (z - z1)) * sizeY + (ylow - y1);
+          int index = (x & 15) + ((z & 15) << 4) + (ylow << 8);
+
+          for (int y = ylow; y <= yhigh; y++, in++, index += 256)
+          {
+            const uint8_t type = types[in];
+            const uint8_t meta = metas != NULL ? (metas[in] & 0x0f) : 0;
+            uint8_t& metadata  = chunk->data[index >> 1];
+
+            if (chunk->blocks[index] == type && ((metadata >> shift) & 0x0f) == meta)
+            {
+              continue;
+            }
+
+            chunk->blocks[index] = type;
+            metadata = (metadata & (0xf0 >> shift)) | (meta << shift);
+
+            touched |= 1 << (y >> 4);
+            if (type != BLOCK_AIR)
+            {
+              chunk->chunks_present |= 1 << (y >> 4);
+            }
+            if (++changed <= FILL_RESEND_LIMIT)
+            {
+              changedBlocks.insert(vec(x, y, z));
+            }
+          }
+        }
+      }
+
+      for (int section = 0; section < 16; section++)
+      {
+        if (touched & (1 << section))
+        {
+          touchSection(chunk, section);
+        }
+      }
+
+      sendChunkChanges(chunk, changedBlocks, changed);
+      total += changed;
+    }
+  }
+
+  return total;
+}
+
+int Map::getTopBlock(int x, int z, uint8_t* type, uint8_t* meta)
+{
+  sChunk* chunk = getChunk(blockToChunk(x), blockToChunk(z));
+  if (chunk == NULL)
+  {
+    return -1;
+  }
+
+  const int column = (x & 15) + ((z & 15) << 4);
+  for (int section = 15; section >= 0; section--)
+  {
+    if (!(chunk->chunks_present & (1 << section)))
+    {
+      continue;
+    }
+
+    for (int y = (section << 4) + 15; y >= (section << 4); y--)
+    {
+      const int index = column + (y << 8);
+      if (chunk->blocks[index] != BLOCK_AIR)
+      {
+        if (type != NULL)
+        {
+          *type = chunk->blocks[index];
+        }
+        if (meta != NULL)
+        {
+          *meta = (chunk->data[index >> 1] >> ((x & 1) << 2)) & 0x0f;
+        }
+        return y;
+      }
+    }
+  }
+
+  return -1;
+}
+
 bool Map::sendBlockChange(int x, int y, int z, int16_t type, char meta)
 {
   const ChunkMap::const_iterator it = chunks.find(Coords(blockToChunk(x), blockToChunk(z)));
@@ -997,33 +1355,130 @@ bool Map::sendNote(int x, int y, int z, char instrument, char pitch)
 
 bool Map::sendPickupSpawn(spawnedItem item)
 {
+  const ChunkMap::const_iterator it = chunks.find(Coords(blockToChunk(item.pos.x() >> 5), blockToChunk(item.pos.z() >> 5)));
+
+  // Nobody could ever see or pick up an item in an unloaded chunk
+  if (it == chunks.end())
+  {
+    return false;
+  }
+
+  // Try to add the item to an equal stack lying next to it instead of spawning a new entity
+  if (itemMerge && !Item::isEnchantable(item.item))
+  {
+    std::vector<spawnedItem*> nearItems;
+    getItemsNear(item.pos.x() >> 5, item.pos.y() >> 5, item.pos.z() >> 5, 1, nearItems);
+    for (size_t i = 0; i < nearItems.size(); i++)
+    {
+      spawnedItem* stack = nearItems[i];
+      if (stack->item == item.item && stack->health == item.health && stack->count + item.count <= 64)
+      {
+        stack->count += item.count;
+
+        // The merged stack lives as long as a new drop would
+        stack->spawnedAt = item.spawnedAt;
+        if (itemDespawnTime > 0)
+        {
+          itemDespawnQueue.push_back(std::make_pair(stack->spawnedAt, stack->EID));
+        }
+
+        // The client can't change the size of a dropped stack, respawn it
+        sChunk* chunk = getChunk(blockToChunk(stack->pos.x() >> 5), blockToChunk(stack->pos.z() >> 5));
+        Packet pkt = Protocol::destroyEntity(stack->EID);
+        pkt << Protocol::pickupSpawn(stack->EID, stack->item, stack->count, stack->health, stack->pos.x(), stack->pos.y(), stack->pos.z());
+        chunk->sendPacket(pkt);
+
+        return true;
+      }
+    }
+  }
+
   //Push to global item storage
   spawnedItem* storedItem = new spawnedItem;
   *storedItem     = item;
   items[item.EID] = storedItem;
 
+  if (itemDespawnTime > 0)
+  {
+    itemDespawnQueue.push_back(std::make_pair(item.spawnedAt, item.EID));
+  }
+
   //Push to local item storage
-  int chunk_x = blockToChunk(item.pos.x() / 32);
-  int chunk_z = blockToChunk(item.pos.z() / 32);
+  it->second->items.add(storedItem);
 
-  const ChunkMap::const_iterator it = chunks.find(Coords(chunk_x, chunk_z));
+  Packet pkt = Protocol::pickupSpawn(item.EID, item.item, item.count, item.health, item.pos.x(), item.pos.y(), item.pos.z());
 
-  if (it == chunks.end())
+  it->second->sendPacket(pkt);
+
+  return true;
+}
+
+void Map::getItemsNear(int x, int y, int z, int radius, std::vector<spawnedItem*>& found)
+{
+  std::vector<spawnedItem*> candidates;
+
+  for (int chunk_x = blockToChunk(x - radius); chunk_x <= blockToChunk(x + radius); chunk_x++)
   {
-    return false;
+    for (int chunk_z = blockToChunk(z - radius); chunk_z <= blockToChunk(z + radius); chunk_z++)
+    {
+      const sChunk* chunk = getChunk(chunk_x, chunk_z);
+      if (chunk == NULL || chunk->items.empty())
+      {
+        continue;
+      }
+
+      // Block area relative to this chunk, find() clamps it to the chunk
+      chunk->items.find(x - radius - (chunk_x << 4), z - radius - (chunk_z << 4),
+                        x + radius - (chunk_x << 4), z + radius - (chunk_z << 4), candidates);
+    }
   }
 
-  it->second->items.push_back(storedItem);
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    if (abs(x - (candidates[i]->pos.x() >> 5)) <= radius &&
+        abs(y - (candidates[i]->pos.y() >> 5)) <= radius &&
+        abs(z - (candidates[i]->pos.z() >> 5)) <= radius)
+    {
+      found.push_back(candidates[i]);
+    }
+  }
+}
 
-  Packet pkt;
+void Map::removeItem(spawnedItem* item)
+{
+  sChunk* chunk = getChunk(blockToChunk(item->pos.x() >> 5), blockToChunk(item->pos.z() >> 5));
+  if (chunk != NULL)
+  {
+    chunk->items.remove(item);
+    chunk->sendPacket(Protocol::destroyEntity(item->EID));
+  }
 
-  pkt << (int8_t)PACKET_PICKUP_SPAWN << (int32_t)item.EID << (int16_t)item.item << (int8_t)item.count << (int16_t)item.health
-      << (int32_t)item.pos.x() << (int32_t)item.pos.y() << (int32_t)item.pos.z()
-      << (int8_t)0 << (int8_t)0 << (int8_t)0;
+  items.erase(item->EID);
+  delete item;
+}
 
-  it->second->sendPacket(pkt);
+void Map::checkItemDespawn()
+{
+  if (itemDespawnTime <= 0)
+  {
+    itemDespawnQueue.clear();
+    return;
+  }
 
-  return true;
+  const time_t timeNow = time(NULL);
+
+  while (!itemDespawnQueue.empty() && itemDespawnQueue.front().first + itemDespawnTime <= timeNow)
+  {
+    // Items already picked up or released with their chunk are simply skipped,
+    // as are entries left behind when a merge gave the item a later time
+    const ItemMap::iterator it = items.find(itemDespawnQueue.front().second);
+    if (it != items.end() && it->second->spawnedAt == itemDespawnQueue.front().first)
+    {
+      removeItem(it->second);
+    }
+
+    itemDespawnQueue.pop_front();
+  }
 }
 
 void Map::createPickupSpawn(int x, int y, int z, int type, int count, int health, User* user)
@@ -1128,6 +1583,91 @@ bool Map::sendProjectileSpawn(User* user, int8_t projID)
 }
 
 sChunk* Map::loadMap(int x, int z, bool generate)
+{
+  sChunk* chunk = loadProtoMap(x, z, generate);
+
+  if (chunk != NULL && generate && !chunk->populated && populating == NULL)
+  {
+    populateMap(chunk);
+  }
+
+  return chunk;
+}
+
+bool Map::populateMap(sChunk* chunk)
+{
+  const int x = chunk->x;
+  const int z = chunk->z;
+
+  // Terrain of the neighbours first, populating them is left to their own turn
+  for (int i = -1; i <= 1; i++)
+  {
+    for (int j = -1; j <= 1; j++)
+    {
+      if ((i != 0 || j != 0) && loadProtoMap(x + i, z + j, true) == NULL)
+      {
+        LOGLF("Loading chunk failed (populateMap)");
+        return false;
+      }
+    }
+  }
+
+  // Re-seed! We share map gens with other maps
+  populating = chunk;
+  ServerInstance->mapGen(m_number)->init((int32_t)mapSeed);
+  ServerInstance->mapGen(m_number)->populateChunk(x, z, m_number);
+  populating = NULL;
+
+  chunk->populated = true;
+  *(*(*chunk->nbt)["Level"])["TerrainPopulated"] = (int8_t)1;
+  for (int section = 0; section < 16; section++)
+  {
+    touchSection(chunk, section);
+  }
+  generateLight(x, z, chunk);
+  chunk->lightRegen = false;
+
+  //If we populated spawn pos, make sure the position is not underground!
+  if (x == blockToChunk(spawnPos.x()) && z == blockToChunk(spawnPos.z()))
+  {
+    uint8_t block, meta;
+    bool foundLand = false;
+    if (getBlock(spawnPos.x(), spawnPos.y(), spawnPos.z(), &block, &meta, false) && block == BLOCK_AIR)
+    {
+      uint8_t new_y;
+      for (new_y = spawnPos.y(); new_y > 30; new_y--)
+      {
+        if (getBlock(spawnPos.x(), new_y, spawnPos.z(), &block, &meta, false) && block != BLOCK_AIR)
+        {
+          foundLand = true;
+          break;
+        }
+      }
+      if (foundLand)
+      {
+        //Store new spawn position to level.dat
+        spawnPos.y() = new_y + 1;
+        std::string infile = mapDirectory + "/level.dat";
+        NBT_Value* root = NBT_Value::LoadFromFile(infile);
+        if (root != NULL)
+        {
+          NBT_Value& data = *((*root)["Data"]);
+          *data["SpawnX"] = (int32_t)spawnPos.x();
+          *data["SpawnY"] = (int32_t)spawnPos.y();
+          *data["SpawnZ"] = (int32_t)spawnPos.z();
+
+          root->SaveToFile(infile);
+
+          delete root;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+sChunk* Map::loadProtoMap(int x, int z, bool generate)
 {
   const ChunkMap::const_iterator it = chunks.find(Coords(x, z));
 
@@ -1159,43 +1699,6 @@ sChunk* Map::loadMap(int x, int z, bool generate)
       // Re-seed! We share map gens with other maps
       ServerInstance->mapGen(m_number)->init((int32_t)mapSeed);
       ServerInstance->mapGen(m_number)->generateChunk(x, z, m_number);
-      generateLight(x, z);
-      //If we generated spawn pos, make sure the position is not underground!
-      if (x == blockToChunk(spawnPos.x()) && z == blockToChunk(spawnPos.z()))
-      {
-        uint8_t block, meta;
-        bool foundLand = false;
-        if (getBlock(spawnPos.x(), spawnPos.y(), spawnPos.z(), &block, &meta, false) && block == BLOCK_AIR)
-        {
-          uint8_t new_y;
-          for (new_y = spawnPos.y(); new_y > 30; new_y--)
-          {
-            if (getBlock(spawnPos.x(), new_y, spawnPos.z(), &block, &meta, false) && block != BLOCK_AIR)
-            {
-              foundLand = true;
-              break;
-            }
-          }
-          if (foundLand)
-          {
-            //Store new spawn position to level.dat
-            spawnPos.y() = new_y + 1;
-            std::string infile = mapDirectory + "/level.dat";
-            NBT_Value* root = NBT_Value::LoadFromFile(infile);
-            if (root != NULL)
-            {
-              NBT_Value& data = *((*root)["Data"]);
-              *data["SpawnX"] = (int32_t)spawnPos.x();
-              *data["SpawnY"] = (int32_t)spawnPos.y();
-              *data["SpawnZ"] = (int32_t)spawnPos.z();
-
-              root->SaveToFile(infile);
-
-              delete root;
-            }
-          }
-        }
-      }
       delete newRegion;
       delete [] chunkPointer;
       return getChunk(x, z);
@@ -1225,7 +1728,6 @@ sChunk* Map::loadMap(int x, int z, bool generate)
     delete chunk;
     ServerInstance->mapGen(m_number)->init((int32_t)mapSeed);
     ServerInstance->mapGen(m_number)->generateChunk(x, z, m_number);
-    generateLight(x, z);
     return getChunk(x, z);
   }
 
@@ -1237,7 +1739,6 @@ sChunk* Map::loadMap(int x, int z, bool generate)
     delete chunk;
     ServerInstance->mapGen(m_number)->init((int32_t)mapSeed);
     ServerInstance->mapGen(m_number)->generateChunk(x, z, m_number);
-    generateLight(x, z);
     return getChunk(x, z);
   }
 
@@ -1255,7 +1756,6 @@ sChunk* Map::loadMap(int x, int z, bool generate)
     delete chunk;
     ServerInstance->mapGen(m_number)->init((int32_t)mapSeed);
     ServerInstance->mapGen(m_number)->generateChunk(x, z, m_number);
-    generateLight(x, z);
     return getChunk(x, z);
   }
 
@@ -1332,6 +1832,12 @@ sChunk* Map::loadMap(int x, int z, bool generate)
   chunk->changed    = false;
   chunk->lightRegen = false;
 
+  // Chunks of older worlds and of other servers may lack the flag
+  NBT_Value* terrainPopulated = (*level)["TerrainPopulated"];
+  chunk->populated = terrainPopulated == NULL || terrainPopulated->GetType() != NBT_Value::TAG_BYTE || (int8_t)*terrainPopulated != 0;
+  // Saved as terrain only, write it back once populated or its features come twice
+  chunk->changed = !chunk->populated;
+
   //Get list of chests,furnaces etc on the chunk
   NBT_Value* entityList = (*level)["TileEntities"];
 
@@ -1504,8 +2010,8 @@ bool Map::saveMap(int x, int z)
     return true;
   }
 
-  // Recalculate light maps
-  if (chunk->lightRegen)
+  // Recalculate light maps, terrain only chunks are lit once populated
+  if (chunk->lightRegen && chunk->populated)
   {
     generateLight(x, z, chunk);
   }
@@ -1665,8 +2171,22 @@ bool Map::releaseMap(int x, int z)
   // save first
   saveMap(x, z);
 
+  sChunk* chunk = getChunk(x, z);
+
+  // dropped items are not saved, they go away with the chunk
+  if (chunk != NULL && !chunk->items.empty())
+  {
+    std::vector<spawnedItem*> chunkItems;
+    chunk->items.getAll(chunkItems);
+    for (size_t i = 0; i < chunkItems.size(); i++)
+    {
+      items.erase(chunkItems[i]->EID);
+      delete chunkItems[i];
+    }
+  }
+
   // free the memory allocated to the sChunk
-  delete getChunk(x, z);
+  delete chunk;
 
   // erase the chunk pointer from the collection
   chunks.erase(Coords(x, z));
@@ -1730,10 +2250,9 @@ bool Map::sendMultiBlocks(std::set<vec>& blocks)
       continue;
     }
 
+    // One message, the users' lanes must not see the parts on their own
+    packet << pC << pT << pM;
     it->second->sendPacket(packet);
-    it->second->sendPacket(pC);
-    it->second->sendPacket(pT);
-    it->second->sendPacket(pM);
   }
 
   return true;
@@ -1742,25 +2261,40 @@ bool Map::sendMultiBlocks(std::set<vec>& blocks)
 // Send chunk to user
 void Map::sendToUser(User* user, int x, int z, bool login)
 {
-  Packet* p;
+  std::vector<uint8_t> mapdata;
+  sChunk* chunk = copyChunk(x, z, mapdata);
+  if (chunk == NULL)
+  {
+    return;
+  }
+
+  uLongf written = compressBound(uLong(mapdata.size()));
+  std::vector<uint8_t> buffer(written);
+
+  // Compress data with zlib deflate
+  compress(&buffer[0], &written, &mapdata[0], uLong(mapdata.size()));
+
   if (login)
   {
-    p = &user->loginBuffer;
+    writeChunk(user->loginBuffer, chunk, &buffer[0], written);
   }
   else
   {
-    p = &user->buffer;
+    // Waits in the chunk lane, so block changes and moves can go first
+    Packet p;
+    writeChunk(p, chunk, &buffer[0], written);
+    user->lanes.pushChunk(x, z, p.writeData(), p.writeSize());
   }
+}
+
+sChunk* Map::copyChunk(int x, int z, std::vector<uint8_t>& raw)
+{
   sChunk* chunk = loadMap(x, z);
   if (chunk == NULL)
   {
-    return;
+    return NULL;
   }
 
-  uint8_t* mapdata = new uint8_t[98304*2+256];
-  int32_t mapposx    = x;
-  int32_t mapposz    = z;
-
   //Regenerate lighting if needed
   if (chunk->lightRegen)
   {
@@ -1768,42 +2302,34 @@ void Map::sendToUser(User* user, int x, int z, bool login)
     chunk->lightRegen = false;
   }
 
-  
-  //ToDo: now sending all 16 16x16 chunks, limit to only those with blocks.
-  // Chunk
-  (*p) << (int8_t)PACKET_MAP_CHUNK << (int32_t)(mapposx) << (int32_t)(mapposz)
-       << (int8_t)1 /* Biome Data bool? */ << (int16_t)0xffff /* Enabled chunks 0..15 */ 
-       << (int16_t)0xffff /* Enabled additional data? in the enabled chunks */;
-
-
-  memcpy(&mapdata[0], chunk->blocks, 32768*2);
-  memcpy(&mapdata[32768*2], chunk->data, 16384*2);
-  memcpy(&mapdata[(32768 + 16384)*2], chunk->blocklight, 16384*2);
-  memcpy(&mapdata[(32768 + 16384 + 16384)*2], chunk->skylight, 16384*2);
-  memcpy(&mapdata[(32768 + 16384 + 16384 + 16384)*2], chunk->addblocks, 16384*2);
+  raw.resize(98304*2+256);
+  memcpy(&raw[0], chunk->blocks, 32768*2);
+  memcpy(&raw[32768*2], chunk->data, 16384*2);
+  memcpy(&raw[(32768 + 16384)*2], chunk->blocklight, 16384*2);
+  memcpy(&raw[(32768 + 16384 + 16384)*2], chunk->skylight, 16384*2);
+  memcpy(&raw[(32768 + 16384 + 16384 + 16384)*2], chunk->addblocks, 16384*2);
   //Biome data
-  memset(&mapdata[(32768 + 16384 + 16384 + 16384 + 16384)*2], 0, 256);
+  memset(&raw[(32768 + 16384 + 16384 + 16384 + 16384)*2], 0, 256);
 
+  return chunk;
+}
 
-  uLongf written = 98304*2+256;
-  uint8_t* buffer = new uint8_t[written];
-
-  // Compress data with zlib deflate
-  compress(buffer, &written, &mapdata[0], 98304*2+256);
+void Map::writeChunk(Packet& p, sChunk* chunk, const uint8_t* compressed, size_t len)
+{
+  //ToDo: now sending all 16 16x16 chunks, limit to only those with blocks.
+  // Chunk
+  p << (int8_t)PACKET_MAP_CHUNK << (int32_t)(chunk->x) << (int32_t)(chunk->z)
+    << (int8_t)1 /* Biome Data bool? */ << (int16_t)0xffff /* Enabled chunks 0..15 */
+    << (int16_t)0xffff /* Enabled additional data? in the enabled chunks */;
 
-  (*p) << (int32_t)written;
-  (*p).addToWrite(buffer, written);
+  p << (int32_t)len;
+  p.addToWrite(compressed, len);
 
   //Push sign data to player
   for (size_t i = 0; i < chunk->signs.size(); ++i)
   {
-    (*p) << (int8_t)PACKET_SIGN << chunk->signs[i]->x << (int16_t)chunk->signs[i]->y << chunk->signs[i]->z;
-    (*p) << chunk->signs[i]->text1 << chunk->signs[i]->text2 << chunk->signs[i]->text3 << chunk->signs[i]->text4;
+    p << (int8_t)PACKET_SIGN << chunk->signs[i]->x << (int16_t)chunk->signs[i]->y << chunk->signs[i]->z;
+    p << chunk->signs[i]->text1 << chunk->signs[i]->text2 << chunk->signs[i]->text3 << chunk->signs[i]->text4;
   }
-
-
-  delete[] buffer;
-
-  delete[] mapdata;
 }
 
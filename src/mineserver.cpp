@@ -47,6 +47,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 
 #include "mineserver.h"
 #include "signalhandler.h"
@@ -72,6 +73,12 @@
 #include "redstoneSimulation.h"
 #include "plugin.h"
 #include "furnaceManager.h"
+#include "pregen.h"
+#include "taskqueue.h"
+#include "sessionvalidator.h"
+#include "loginpipeline.h"
+#include "playerstore.h"
+#include "packetcapture.h"
 #include "cliScreen.h"
 #include "hook.h"
 #include "mob.h"
@@ -125,6 +132,8 @@ int printHelp(int code)
   return code;
 }
 
+// Tools linking the server sources (benchmarks/) bring their own main()
+#ifndef MINESERVER_NO_MAIN
 // Main :D
 int main(int argc, char* argv[])
 {
@@ -150,6 +159,7 @@ int main(int argc, char* argv[])
   
   return ret ? EXIT_SUCCESS : EXIT_FAILURE;
 }
+#endif
 
 
 Mineserver::Mineserver(int args, char **argarray)
@@ -161,8 +171,22 @@ Mineserver::Mineserver(int args, char **argarray)
      m_pvp_enabled   (false),
      m_damage_enabled(false),
      m_only_helmets  (false),
+     m_viewDistance  (10),
+     m_viewDistanceMin(3),
+     m_viewDistanceMax(15),
+     m_chunkBudget   (0),
+     m_tickBudget    (0),
+     m_outputHigh    (256 * 1024),
+     m_outputLow     (64 * 1024),
+     m_outputCap     (4096 * 1024),
+     m_outputCapSeconds(10),
+     m_outputWindow  (32 * 1024),
      m_running       (false),
      m_eventBase     (NULL),
+     m_viewDistanceCap(15),
+     m_tickTimeMax   (0),
+     m_lastTenSeconds(std::time(NULL)),
+     m_lastSecond    (std::time(NULL)),
 
      // core modules
      m_config        (new Config()),
@@ -174,9 +198,14 @@ Mineserver::Mineserver(int args, char **argarray)
      m_furnaceManager(NULL),
      m_packetHandler (NULL),
      m_inventory     (NULL),
-     m_mobs          (NULL)
+     m_mobs          (NULL),
+     m_pregen        (NULL),
+     m_tasks         (NULL),
+     m_validator     (NULL),
+     m_loginPipeline (NULL),
+     m_playerStore   (NULL),
+     m_capture       (NULL)
 {
-  pthread_mutex_init(&m_validation_mutex,NULL);
   ServerInstance = this;
   InitSignals();
   
@@ -354,6 +383,64 @@ Mineserver::Mineserver(int args, char **argarray)
   m_pvp_enabled = m_config->bData("system.pvp.enabled");
   m_damage_enabled = m_config->bData("system.damage.enabled");
 
+  if (m_config->has("system.view_distance.min"))
+  {
+    m_viewDistanceMin = std::max(1, m_config->iData("system.view_distance.min"));
+  }
+  if (m_config->has("system.view_distance.max"))
+  {
+    m_viewDistanceMax = std::max(m_viewDistanceMin, m_config->iData("system.view_distance.max"));
+  }
+  if (m_config->has("system.view_distance.default"))
+  {
+    m_viewDistance = m_config->iData("system.view_distance.default");
+  }
+  m_viewDistance    = std::min(std::max(m_viewDistance, m_viewDistanceMin), m_viewDistanceMax);
+  m_viewDistanceCap = m_viewDistanceMax;
+  m_chunkBudget     = std::max(0, m_config->iData("system.view_distance.budget.chunks"));
+  m_tickBudget      = std::max(0, m_config->iData("system.view_distance.budget.tick_ms"));
+
+  if (m_config->has("system.output.high_kb"))
+  {
+    m_outputHigh = std::max(1, m_config->iData("system.output.high_kb")) * 1024;
+  }
+  if (m_config->has("system.output.low_kb"))
+  {
+    m_outputLow = std::max(0, m_config->iData("system.output.low_kb")) * 1024;
+  }
+  if (m_config->has("system.output.cap_kb"))
+  {
+    m_outputCap = std::max(1, m_config->iData("system.output.cap_kb")) * 1024;
+  }
+  if (m_config->has("system.output.cap_seconds"))
+  {
+    m_outputCapSeconds = std::max(0, m_config->iData("system.output.cap_seconds"));
+  }
+  m_outputLow = std::min(m_outputLow, m_outputHigh);
+  m_outputCap = std::max(m_outputCap, m_outputHigh);
+  if (m_config->has("system.output.window_kb"))
+  {
+    m_outputWindow = std::max(1, m_config->iData("system.output.window_kb")) * 1024;
+  }
+
+  const char* laneNames[OutputLanes::LANE_COUNT] = { "block", "chat", "entity", "chunk" };
+  for (int i = 0; i < OutputLanes::LANE_COUNT; i++)
+  {
+    const std::string key = std::string("system.output.weight.") + laneNames[i];
+    if (m_config->has(key))
+    {
+      OutputLanes::weights[i] = std::max(1, m_config->iData(key));
+    }
+  }
+
+  m_statsFile = m_config->has("system.stats_file") ? m_config->sData("system.stats_file") : "";
+  if (!m_statsFile.empty())
+  {
+    m_tickHistogram.resize(TICK_HISTOGRAM_SIZE);
+  }
+
+  m_logger->configure();
+
   const char* key = "map.storage.nbt.directories"; // Prefix for worlds config
   if (m_config->has(key) && (m_config->type(key) == CONFIG_NODE_LIST))
   {
@@ -395,6 +482,55 @@ Mineserver::Mineserver(int args, char **argarray)
   m_packetHandler  = new PacketHandler;
   m_inventory      = new Inventory(m_config->sData("system.path.data") + '/' + "recipes", ".recipe", "ENABLED_RECIPES.cfg");
   m_mobs           = new Mobs;
+  m_pregen         = new Pregen;
+  m_tasks          = new TaskQueue;
+
+  if (m_config->bData("system.user_validation"))
+  {
+    m_validator = new SessionValidator(
+      m_config->has("system.validation.host") ? m_config->sData("system.validation.host") : "session.minecraft.net",
+      m_config->has("system.validation.port") ? m_config->iData("system.validation.port") : 80,
+      m_config->has("system.validation.workers") ? m_config->iData("system.validation.workers") : 4,
+      m_config->has("system.validation.queue_size") ? m_config->iData("system.validation.queue_size") : 256,
+      m_config->has("system.validation.timeout") ? m_config->iData("system.validation.timeout") : 5000,
+      m_config->has("system.validation.cache") ? m_config->iData("system.validation.cache") : 60);
+    if (!m_validator->start())
+    {
+      LOG2(WARNING, "Cannot start the session validation threads, logins will be refused");
+    }
+  }
+
+  m_playerStore = new PlayerStore(
+    m_config->has("system.player_files.cache") ? m_config->iData("system.player_files.cache") : 256);
+  if (!m_playerStore->start())
+  {
+    LOG2(WARNING, "Cannot start the player file thread, player files are written on the main loop");
+  }
+
+  m_loginPipeline = new LoginPipeline(rsa, encryptionBytes,
+    m_config->has("system.login.workers") ? m_config->iData("system.login.workers") : 2,
+    m_config->has("system.login.queue_size") ? m_config->iData("system.login.queue_size") : 256,
+    m_playerStore);
+  if (!m_loginPipeline->start())
+  {
+    LOG2(WARNING, "Cannot start the login threads, logins will be refused");
+  }
+
+  const std::string captureFile = m_config->has("system.capture.file") ? m_config->sData("system.capture.file") : "";
+  if (!captureFile.empty())
+  {
+    m_capture = new PacketCapture;
+    if (m_capture->open(captureFile, PROTOCOL_VERSION))
+    {
+      LOG2(INFO, "Capturing client packets to " + captureFile);
+    }
+    else
+    {
+      LOG2(WARNING, "Cannot open " + captureFile + " for the packet capture");
+      delete m_capture;
+      m_capture = NULL;
+    }
+  }
 
 } // End Mineserver constructor
 
@@ -421,12 +557,22 @@ Mineserver::~Mineserver()
   delete m_packetHandler;
   delete m_inventory;
   delete m_mobs;
+  delete m_pregen;
+  delete m_tasks;
+  delete m_validator;
+  delete m_loginPipeline;
+  // Writes the player files still queued
+  delete m_playerStore;
+  delete m_capture;
 
   for(int i = m_mapGenNames.size()-1; i >= 0 ; i--)
   {
     delete m_mapGenNames[i];
   }
 
+  // No LogPost callback may run while the plugins go away
+  logger()->stop();
+
   if (m_plugin)
   {
     delete m_plugin;
@@ -475,13 +621,332 @@ size_t Mineserver::getLoggedUsersCount()
   return count;
 }
 
+void Mineserver::addUser(User* user)
+{
+  if (!m_users.insert(user).second)
+  {
+    return;
+  }
+  m_userListIndex[user] = m_userList.size();
+  m_userList.push_back(user);
+  m_usersByUID[user->UID] = user;
+  if (user->fd != -1)
+  {
+    m_usersByFd[user->fd] = user;
+  }
+  indexNick(user);
+}
 
-bool Mineserver::run()
+void Mineserver::removeUser(User* user)
+{
+  if (m_users.erase(user) == 0)
+  {
+    return;
+  }
+
+  // Order doesn't matter, move the last user into the hole
+  const size_t index = m_userListIndex[user];
+  m_userList[index] = m_userList.back();
+  m_userListIndex[m_userList[index]] = index;
+  m_userList.pop_back();
+  m_userListIndex.erase(user);
+
+  // Only drop the entries which still point to this user
+  if (userByUID(user->UID) == user)
+  {
+    m_usersByUID.erase(user->UID);
+  }
+  if (userByFd(user->fd) == user)
+  {
+    m_usersByFd.erase(user->fd);
+  }
+  unindexNick(user);
+}
+
+void Mineserver::setUserNick(User* user, const std::string& nick)
+{
+  if (m_users.count(user))
+  {
+    unindexNick(user);
+    user->nick = nick;
+    indexNick(user);
+    return;
+  }
+  user->nick = nick;
+}
+
+void Mineserver::indexNick(User* user)
+{
+  if (!user->nick.empty())
+  {
+    m_usersByNick[strToLower(user->nick)].push_back(user);
+  }
+}
+
+void Mineserver::unindexNick(User* user)
 {
-  uint32_t starttime = (uint32_t)time(0);
-  uint32_t tick      = (uint32_t)time(0);
+  if (user->nick.empty())
+  {
+    return;
+  }
+  const std::tr1::unordered_map<std::string, std::vector<User*> >::iterator it = m_usersByNick.find(strToLower(user->nick));
+  if (it == m_usersByNick.end())
+  {
+    return;
+  }
+  std::vector<User*>& users = it->second;
+  users.erase(std::remove(users.begin(), users.end(), user), users.end());
+  if (users.empty())
+  {
+    m_usersByNick.erase(it);
+  }
+}
+
+// A player who is in the game keeps the nick, of the others the one who took it last
+User* Mineserver::userByNick(const std::string& nick) const
+{
+  const std::tr1::unordered_map<std::string, std::vector<User*> >::const_iterator it = m_usersByNick.find(strToLower(nick));
+  if (it == m_usersByNick.end())
+  {
+    return NULL;
+  }
+  const std::vector<User*>& users = it->second;
+  for (size_t i = 0; i < users.size(); i++)
+  {
+    if (users[i]->logged)
+    {
+      return users[i];
+    }
+  }
+  return users.back();
+}
+
+User* Mineserver::userByUID(uint32_t uid) const
+{
+  const std::tr1::unordered_map<uint32_t, User*>::const_iterator it = m_usersByUID.find(uid);
+  return it == m_usersByUID.end() ? NULL : it->second;
+}
+
+User* Mineserver::userByFd(int fd) const
+{
+  const std::tr1::unordered_map<int, User*>::const_iterator it = m_usersByFd.find(fd);
+  return it == m_usersByFd.end() ? NULL : it->second;
+}
+
+size_t Mineserver::getLoadedChunksCount()
+{
+  size_t count = 0;
+  for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+  {
+    count += m_map[i]->chunks.size();
+  }
+  return count;
+}
+
+// Lets in (or kicks) the users the session server has answered for
+void Mineserver::finishValidations()
+{
+  if (m_validator == NULL)
+  {
+    return;
+  }
 
+  std::vector<SessionValidator::Result> results;
+  m_validator->poll(results);
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    //To make sure user hasn't timed out or anything while validating
+    User* user = userByUID(results[i].UID);
+    if (user == NULL)
+    {
+      continue;
+    }
+
+    if (results[i].valid)
+    {
+      LOG(INFO, "Packets", user->nick + " is VALID ");
+      user->crypted = true;
+      user->buffer << (int8_t)PACKET_ENCRYPTION_RESPONSE << (int16_t)0 << (int16_t) 0;
+      user->uncryptedLeft = 5;
+    }
+    else if (results[i].failed)
+    {
+      user->kick("Could not reach the session server, try again");
+    }
+    else
+    {
+      user->kick("User not Premium");
+    }
+    //Flush
+    client_write(user);
+  }
+}
+
+// Takes the logins the pipeline has done a stage of on to the next one
+void Mineserver::finishLogins()
+{
+  std::vector<LoginPipeline::Result> results;
+  m_loginPipeline->poll(results);
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    LoginPipeline::Result& result = results[i];
+    User* user = userByUID(result.UID);
+    if (user == NULL)
+    {
+      continue;
+    }
+
+    switch (result.stage)
+    {
+    case LoginPipeline::HANDSHAKE:
+      if (!result.ok)
+      {
+        user->kick("Decryption failed");
+        break;
+      }
+      user->secret = result.secret;
+      //We're going crypted!
+      user->initCipher();
+
+      if (m_validator == NULL)
+      {
+        //Response
+        user->crypted = true;
+        user->buffer << (int8_t)PACKET_ENCRYPTION_RESPONSE << (int16_t)0 << (int16_t) 0;
+        user->uncryptedLeft = 5; //5 first bytes are uncrypted
+      }
+      else
+      {
+        LOG(INFO, "Packets", "Validating " + user->nick + " against the session server");
+        if (!m_validator->submit(user->UID, user->nick, user->generateDigest()))
+        {
+          user->kick("Too many logins at once, try again");
+        }
+      }
+      break;
+
+    case LoginPipeline::PLAYER_DATA:
+    {
+      user->applyData(result.player);
+      std::vector<LoginPipeline::Chunk> chunks;
+      user->copyLoginChunks(chunks);
+      m_loginPipeline->submitChunks(user->UID, chunks);
+      break;
+    }
 
+    case LoginPipeline::CHUNKS:
+      user->sendLoginInfo(result.chunks);
+      m_loginPipeline->loggedIn();
+      break;
+    }
+  }
+}
+
+// One "name value" per line, tick lines are "tick <step start in us> <ticks>" for
+// the steps that have any. Written aside and renamed, so readers never see half a file.
+void Mineserver::writeStats()
+{
+  const std::string temp = m_statsFile + ".tmp";
+  std::ofstream out(temp.c_str());
+  if (out.fail())
+  {
+    return;
+  }
+
+  uint64_t ticks = 0;
+  for (size_t i = 0; i < m_tickHistogram.size(); i++)
+  {
+    ticks += m_tickHistogram[i];
+  }
+
+  size_t outputQueued = 0;
+  size_t outputMax = 0;
+  size_t congested = 0;
+  size_t laneQueued[OutputLanes::LANE_COUNT] = { 0 };
+  for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+  {
+    const size_t queued = (*it)->output.size() + (*it)->buffer.writeSize() + (*it)->lanes.size();
+    outputQueued += queued;
+    outputMax = std::max(outputMax, queued);
+    congested += (*it)->congested ? 1 : 0;
+    for (int i = 0; i < OutputLanes::LANE_COUNT; i++)
+    {
+      laneQueued[i] += (*it)->lanes.size(OutputLanes::Lane(i));
+    }
+  }
+
+  out << "pid " << getpid() << "\n"
+      << "users " << getLoggedUsersCount() << "\n"
+      << "connections " << users().size() << "\n"
+      << "chunks " << getLoadedChunksCount() << "\n"
+      << "logins " << m_loginPipeline->stats().logins << "\n"
+      << "player_saves_pending " << m_playerStore->pending() << "\n"
+      << "output_queued " << outputQueued << "\n"
+      << "output_queued_max " << outputMax << "\n"
+      << "output_congested " << congested << "\n"
+      << "output_lanes " << laneQueued[OutputLanes::LANE_BLOCK] << " " << laneQueued[OutputLanes::LANE_CHAT]
+      << " " << laneQueued[OutputLanes::LANE_ENTITY] << " " << laneQueued[OutputLanes::LANE_CHUNK] << "\n"
+      << "output_dropped " << OutputQueue::stats.dropped << "\n"
+      << "output_overflows " << OutputQueue::stats.overflows << "\n"
+      << "ticks " << ticks << "\n";
+  for (size_t i = 0; i < m_tickHistogram.size(); i++)
+  {
+    if (m_tickHistogram[i] != 0)
+    {
+      out << "tick " << i * TICK_HISTOGRAM_STEP << " " << m_tickHistogram[i] << "\n";
+    }
+  }
+  out.close();
+
+#ifdef WIN32
+  remove(m_statsFile.c_str());
+#endif
+  rename(temp.c_str(), m_statsFile.c_str());
+}
+
+// Narrow everyone's view while the server is over its chunk or tick budget,
+// and widen it again one step at a time once there is headroom
+void Mineserver::updateViewDistanceBudget()
+{
+  const size_t loadedChunks = getLoadedChunksCount();
+  const uint32_t tickTime = m_tickTimeMax;
+  m_tickTimeMax = 0;
+
+  const bool overChunks = m_chunkBudget != 0 && loadedChunks > m_chunkBudget;
+  const bool overTick   = m_tickBudget != 0 && tickTime > m_tickBudget;
+  // Only grow when comfortably below budget, so we don't oscillate around it
+  const bool underChunks = m_chunkBudget == 0 || loadedChunks < m_chunkBudget / 4 * 3;
+  const bool underTick   = m_tickBudget == 0 || tickTime < m_tickBudget / 4 * 3;
+
+  int cap = m_viewDistanceCap;
+  if ((overChunks || overTick) && cap > m_viewDistanceMin)
+  {
+    cap--;
+  }
+  else if (underChunks && underTick && cap < m_viewDistanceMax)
+  {
+    cap++;
+  }
+
+  if (cap == m_viewDistanceCap)
+  {
+    return;
+  }
+
+  LOG2(INFO, "View distance limit " + dtos(m_viewDistanceCap) + " -> " + dtos(cap) + " (" + dtos(loadedChunks) + " chunks loaded, tick " + dtos(tickTime) + "ms)");
+  m_viewDistanceCap = cap;
+
+  for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+  {
+    (*it)->updateViewDistance();
+  }
+}
+
+// Loads the plugins and the worlds, everything but the listening socket
+void Mineserver::prepare()
+{
   // load plugins
   if (config()->has("system.plugins") && (config()->type("system.plugins") == CONFIG_NODE_LIST))
   {
@@ -556,9 +1021,20 @@ bool Mineserver::run()
 #endif
   }
 
+  // Pick up pregeneration where the last run stopped
+  pregen()->resume();
+
   // Initialize packethandler
   packetHandler()->init();
 
+  m_lastTenSeconds = time(NULL);
+  m_lastSecond     = m_lastTenSeconds;
+}
+
+bool Mineserver::run()
+{
+  prepare();
+
   // Load ip from config
   const std::string ip = config()->sData("net.ip");
 
@@ -646,190 +1122,222 @@ bool Mineserver::run()
   m_running = true;
   event_base_loopexit(m_eventBase, &loopTime);
 
+  // Plugins are in place, LogPost callbacks run on the log writer from here on
+  logger()->start();
+
   // Create our Server Console user so we can issue commands
 
-  time_t timeNow = time(NULL);
   while (m_running && event_base_loop(m_eventBase, 0) == 0)
   {
     event_base_loopexit(m_eventBase, &loopTime);
 
-    // Run 200ms timer hook
-    static_cast<Hook0<bool>*>(plugin()->getHook("Timer200"))->doAll();
+    tick(time(NULL));
 
-    // Alert any block types that care about timers
-    for (size_t i = 0 ; i < plugin()->getBlockCB().size(); ++i)
-    {
-      const BlockBasicPtr blockcb = plugin()->getBlockCB()[i];
-      if (blockcb != NULL)
-      {
-        blockcb->timer200();
-      }
-    }
+    // Pregeneration only gets its share of the tick, and is left out of the tick time
+    pregen()->update();
+  }
+  #ifdef WIN32
+  closesocket(m_socketlisten);
+  #else
+  close(m_socketlisten);
+  #endif
 
-    //Update physics every 200ms
-    for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+  logger()->stop();
+
+  saveAll();
+
+  event_base_free(m_eventBase);
+
+  return true;
+}
+
+// One pass of the main loop's timers, run every 200ms. timeNow is the clock
+// the 1s and 10s timers and the user timeouts go by. Returns the time it took in us.
+uint64_t Mineserver::tick(time_t timeNow)
+{
+  const uint64_t tickStart = microTime();
+
+  // Run 200ms timer hook
+  plugin()->hook<HOOK_TIMER200>()->doAll();
+
+  // Run the mob AI over all mobs at once
+  mobs()->tick();
+
+  // Alert any block types that care about timers
+  for (size_t i = 0 ; i < plugin()->getBlockCB().size(); ++i)
+  {
+    const BlockBasicPtr blockcb = plugin()->getBlockCB()[i];
+    if (blockcb != NULL)
     {
-      physics(i)->update();
-      redstone(i)->update();
+      blockcb->timer200();
     }
+  }
 
+  //Update physics every 200ms
+  for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+  {
+    physics(i)->update();
+    redstone(i)->update();
+  }
 
-    //Every 10 seconds..
-    timeNow = time(0);
-    if (timeNow - starttime > 10)
-    {
-      starttime = (uint32_t)timeNow;
+  // Long running commands get a slice of the tick, then the queued chat is handled
+  tasks()->update();
+  chat()->update();
 
-      //Map saving on configurable interval
-      if (m_saveInterval != 0 && timeNow - m_lastSave >= m_saveInterval)
-      {
-        //Save
-        for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
-        {
-          m_map[i]->saveWholeMap();
-        }
+  // Session server answers and login stages are picked up every tick
+  finishValidations();
+  finishLogins();
 
-        m_lastSave = timeNow;
-      }
+  //Every 10 seconds..
+  if (timeNow - m_lastTenSeconds > 10)
+  {
+    m_lastTenSeconds = timeNow;
 
-      // If users, ping them
-      if (!User::all().empty())
+    //Map saving on configurable interval
+    if (m_saveInterval != 0 && timeNow - m_lastSave >= m_saveInterval)
+    {
+      //Save
+      for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
       {
-        // Send server time and keepalive
-        Packet pkt;
-        pkt << Protocol::timeUpdate(m_map[0]->mapTime);        
-        pkt << Protocol::keepalive(0);
-        pkt << Protocol::playerlist();
-        (*User::all().begin())->sendAll(pkt);        
+        m_map[i]->saveWholeMap();
       }
 
-      //Check for tree generation from saplings
-      for (size_t i = 0; i < m_map.size(); ++i)
-      {
-        m_map[i]->checkGenTrees();
-      }
+      m_lastSave = timeNow;
+    }
 
-      // TODO: Run garbage collection for chunk storage dealie?
+    // If users, ping them
+    if (!User::all().empty())
+    {
+      // Send server time and keepalive, the time on its own so congested clients can skip it
+      User::sendAll(Protocol::timeUpdate(m_map[0]->mapTime));
+      Packet pkt;
+      pkt << Protocol::keepalive(0);
+      pkt << Protocol::playerlist();
+      (*User::all().begin())->sendAll(pkt);        
+    }
 
-      // Run 10s timer hook
-      static_cast<Hook0<bool>*>(plugin()->getHook("Timer10000"))->doAll();
+    //Check for tree generation from saplings
+    for (size_t i = 0; i < m_map.size(); ++i)
+    {
+      m_map[i]->checkGenTrees();
     }
 
-    // Every second
-    if (timeNow - tick > 0)
+    // Login rate, the number to watch while a crowd reconnects
+    const double loginRate = m_loginPipeline->loginRate();
+    if (loginRate > 0)
     {
-      tick = (uint32_t)timeNow;
+      LOG2(INFO, dtos(loginRate) + " logins/s, " + dtos(m_loginPipeline->queued()) + " login stages queued");
+    }
 
-      // Loop users
-      for (std::set<User*>::iterator it = users().begin(), it_end = users().end(); it != it_end;)
-      {
+    // TODO: Run garbage collection for chunk storage dealie?
+
+    // Run 10s timer hook
+    plugin()->hook<HOOK_TIMER10000>()->doAll();
+  }
+
+  // Every second
+  if (timeNow - m_lastSecond > 0)
+  {
+    m_lastSecond = timeNow;
+
+    // Loop users
+    for (std::set<User*>::iterator it = users().begin(), it_end = users().end(); it != it_end;)
+    {
 	// NOTE: iterators corrupt when you delete their objects, therefore we have to iterate in a special way - Justasic
 	User *u = *it;
 	++it;
-        // No data received in 30s, timeout
-        if (u->logged && timeNow - u->lastData > 30)
-        {
-          LOG2(INFO, "Player " + u->nick + " timed out");
-          delete u;
-        }
-        else if (!u->logged && timeNow - u->lastData > 100)
-          delete u;
-        else
-        {
-          if (m_damage_enabled)
-          {
-            u->checkEnvironmentDamage();
-          }
-          u->pushMap();
-          u->popMap();
-        }
-
+      // No data received in 30s, timeout
+      if (u->logged && timeNow - u->lastData > 30)
+      {
+        LOG2(INFO, "Player " + u->nick + " timed out");
+        delete u;
       }
-
-      for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+      else if (!u->logged && timeNow - u->lastData > 100)
+        delete u;
+      // Not taking its data, don't let the queue grow any further
+      else if (u->overCapSince != 0 && timeNow - u->overCapSince >= m_outputCapSeconds)
       {
-        m_map[i]->mapTime += 20;
-        if (m_map[i]->mapTime >= 24000)
+        LOG2(INFO, "Player " + u->nick + " disconnected, " + dtos(u->output.size()) + " bytes of output not taken");
+        OutputQueue::stats.overflows++;
+        delete u;
+      }
+      else
+      {
+        if (m_damage_enabled)
         {
-          m_map[i]->mapTime = 0;
+          u->checkEnvironmentDamage();
         }
+        u->pushMap();
+        u->popMap();
       }
 
-      for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+    }
+
+    for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+    {
+      m_map[i]->mapTime += 20;
+      if (m_map[i]->mapTime >= 24000)
       {
-        (*it)->pushMap();
-        (*it)->popMap();
+        m_map[i]->mapTime = 0;
       }
+    }
 
-      // Check for Furnace activity
-      furnaceManager()->update();
-
-      // Check for user validation results
-      pthread_mutex_lock(&ServerInstance->m_validation_mutex);
-      for(uint32_t i = 0; i < ServerInstance->validatedUsers.size(); i++)
-      {
-        //To make sure user hasn't timed out or anything while validating
-        User *tempuser = NULL;
-        for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
-        {
-          if((*it)->UID == ServerInstance->validatedUsers[i].UID)
-          {
-            tempuser = (*it);
-            break;
-          }
-        }
+    for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+    {
+      (*it)->pushMap();
+      (*it)->popMap();
+    }
 
-        if(tempuser != NULL)
-        {
-          if(ServerInstance->validatedUsers[i].valid)
-          {
-            LOG(INFO, "Packets", tempuser->nick + " is VALID ");
-            tempuser->crypted = true;
-            tempuser->buffer << (int8_t)PACKET_ENCRYPTION_RESPONSE << (int16_t)0 << (int16_t) 0;
-            tempuser->uncryptedLeft = 5;
-          }
-          else
-          {
-            tempuser->kick("User not Premium");
-          }
-          //Flush
-          client_write(tempuser);          
-        }
-      }
-      ServerInstance->validatedUsers.clear();
-      pthread_mutex_unlock(&ServerInstance->m_validation_mutex);
+    // Check for Furnace activity
+    furnaceManager()->update();
 
-      // Run 1s timer hook
-      static_cast<Hook0<bool>*>(plugin()->getHook("Timer1000"))->doAll();
+    // Despawn old dropped items
+    for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+    {
+      m_map[i]->checkItemDespawn();
     }
 
-    // Underwater check / drowning
-    // ToDo: this could be done a bit differently? - Fador
-    // -- User::all() == users() - louisdx
+    // Run 1s timer hook
+    plugin()->hook<HOOK_TIMER1000>()->doAll();
 
+    // Adjust view distances to the load
+    updateViewDistanceBudget();
 
-    for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+    if (!m_statsFile.empty())
     {
-      (*it)->isUnderwater();
-      if ((*it)->pos.y < 0)
-      {
-        (*it)->sethealth((*it)->health - 5);
-      }
-      //Flush data
-      client_write((*it));
+      writeStats();
+    }
+
+    if (m_capture != NULL)
+    {
+      m_capture->flush();
     }
   }
-  #ifdef WIN32
-  closesocket(m_socketlisten);
-  #else
-  close(m_socketlisten);
-  #endif
 
-  saveAll();
+  // Underwater check / drowning
+  // ToDo: this could be done a bit differently? - Fador
+  // -- User::all() == users() - louisdx
 
-  event_base_free(m_eventBase);
 
-  return true;
+  for (std::set<User*>::const_iterator it = users().begin(); it != users().end(); ++it)
+  {
+    (*it)->isUnderwater();
+    if ((*it)->pos.y < 0)
+    {
+      (*it)->sethealth((*it)->health - 5);
+    }
+    //Flush data
+    client_write((*it));
+  }
+
+  const uint64_t tickUs = microTime() - tickStart;
+  const uint32_t tickTime = uint32_t(tickUs / 1000);
+  m_tickTimeMax = std::max(m_tickTimeMax, tickTime);
+  if (!m_tickHistogram.empty())
+  {
+    m_tickHistogram[std::min<uint64_t>(tickUs / TICK_HISTOGRAM_STEP, TICK_HISTOGRAM_SIZE - 1)]++;
+  }
+  return tickUs;
 }
 
 bool Mineserver::stop()
@@ -27,7 +27,9 @@
 
 #include "mob.h"
 #include "protocol.h"
+#include "plugin.h"
 #include <algorithm>
+#include <cmath>
 
 Mob::Mob()
   :
@@ -191,3 +193,226 @@ void Mob::headLook(int16_t head_yaw)
   }
   this->head_yaw = h_byte;
 }
+
+size_t Mobs::addMob(MobPtr mob)
+{
+  size_t slot;
+  if (!m_freeSlots.empty())
+  {
+    slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    m_moblist[slot] = mob;
+    m_aiState[slot] = 0;
+    m_aiValue[slot] = 0;
+  }
+  else
+  {
+    slot = m_moblist.size();
+    m_moblist.push_back(mob);
+    m_generation.push_back(0);
+    m_aiState.push_back(0);
+    m_aiValue.push_back(0);
+  }
+  m_slotByEID[mob->UID] = slot;
+  return idOf(slot);
+}
+
+MobPtr Mobs::createMob()
+{
+  MobPtr mob(new Mob);
+  addMob(mob);
+  return mob;
+}
+
+void Mobs::removeMob(size_t id)
+{
+  const size_t slot = slotOf(id);
+  if (slot == size_t(-1) || !m_moblist[slot])
+  {
+    return;
+  }
+  m_slotByEID.erase(m_moblist[slot]->UID);
+  m_moblist[slot].reset();
+  m_generation[slot] = (m_generation[slot] + 1) & GENERATION_MASK;
+  m_freeSlots.push_back(slot);
+}
+
+void Mobs::indexUsers()
+{
+  m_userCells.clear();
+
+  for (std::set<User*>::const_iterator it = User::all().begin(); it != User::all().end(); ++it)
+  {
+    const User* user = *it;
+    if (!user->logged)
+    {
+      continue;
+    }
+    const UserCell cell(int(user->pos.map), std::make_pair(int(std::floor(user->pos.x)) >> USER_CELL_BITS,
+                                                           int(std::floor(user->pos.z)) >> USER_CELL_BITS));
+    m_userCells[cell].push_back(*it);
+  }
+}
+
+User* Mobs::getNearestUser(int map, double x, double y, double z, double maxDistance, double* distance) const
+{
+  const int cell_x = int(std::floor(x)) >> USER_CELL_BITS;
+  const int cell_z = int(std::floor(z)) >> USER_CELL_BITS;
+  const int rings  = (int(std::ceil(maxDistance)) >> USER_CELL_BITS) + 1;
+
+  User* nearest = NULL;
+  double best = maxDistance * maxDistance;
+
+  // Search rings of cells around x,z until no closer user can be found
+  for (int r = 0; r <= rings; r++)
+  {
+    // Everything in ring r is at least r - 1 cells away
+    const double ringDistance = double((r - 1) << USER_CELL_BITS);
+    if (r > 1 && ringDistance * ringDistance > best)
+    {
+      break;
+    }
+
+    for (int dx = -r; dx <= r; dx++)
+    {
+      for (int dz = -r; dz <= r; dz++)
+      {
+        if (std::abs(dx) != r && std::abs(dz) != r)
+        {
+          continue;
+        }
+
+        const std::tr1::unordered_map<UserCell, std::vector<User*>, UserCellHash>::const_iterator it =
+          m_userCells.find(UserCell(map, std::make_pair(cell_x + dx, cell_z + dz)));
+        if (it == m_userCells.end())
+        {
+          continue;
+        }
+
+        for (size_t i = 0; i < it->second.size(); i++)
+        {
+          User* user = it->second[i];
+          const double d2 = (user->pos.x - x) * (user->pos.x - x) +
+                            (user->pos.y - y) * (user->pos.y - y) +
+                            (user->pos.z - z) * (user->pos.z - z);
+          if (d2 <= best)
+          {
+            best    = d2;
+            nearest = user;
+          }
+        }
+      }
+    }
+  }
+
+  if (nearest != NULL && distance != NULL)
+  {
+    *distance = std::sqrt(best);
+  }
+  return nearest;
+}
+
+void Mobs::tick()
+{
+  Hook1<bool, mob_batch*>* hook = ServerInstance->plugin()->hook<HOOK_MOB_TICK>();
+  if (hook == NULL || hook->numCallbacks() == 0)
+  {
+    return;
+  }
+
+  m_id.clear();
+  m_type.clear();
+  m_map.clear();
+  m_health.clear();
+  m_state.clear();
+  m_x.clear();
+  m_y.clear();
+  m_z.clear();
+  m_yaw.clear();
+  m_pitch.clear();
+  m_headYaw.clear();
+  m_value.clear();
+
+  for (size_t slot = 0; slot < m_moblist.size(); slot++)
+  {
+    const Mob* mob = m_moblist[slot].get();
+    if (mob == NULL)
+    {
+      continue;
+    }
+    m_id.push_back(int(idOf(slot)));
+    m_type.push_back(mob->type);
+    m_map.push_back(int(mob->map));
+    m_health.push_back(mob->health);
+    m_state.push_back(m_aiState[slot]);
+    m_x.push_back(mob->x);
+    m_y.push_back(mob->y);
+    m_z.push_back(mob->z);
+    m_yaw.push_back(mob->yaw * 360.0 / 256.0);
+    m_pitch.push_back(mob->pitch * 360.0 / 256.0);
+    m_headYaw.push_back(mob->head_yaw * 360.0 / 256.0);
+    m_value.push_back(m_aiValue[slot]);
+  }
+
+  if (m_id.empty())
+  {
+    return;
+  }
+
+  indexUsers();
+
+  // Keep the entity IDs, a mob removed by a callback may have its ID reused
+  std::vector<uint32_t> eids(m_id.size());
+  for (size_t i = 0; i < m_id.size(); i++)
+  {
+    eids[i] = getMobByID(m_id[i])->UID;
+  }
+
+  mob_batch batch;
+  batch.count    = int(m_id.size());
+  batch.id       = &m_id[0];
+  batch.type     = &m_type[0];
+  batch.x        = &m_x[0];
+  batch.y        = &m_y[0];
+  batch.z        = &m_z[0];
+  batch.map      = &m_map[0];
+  batch.yaw      = &m_yaw[0];
+  batch.pitch    = &m_pitch[0];
+  batch.head_yaw = &m_headYaw[0];
+  batch.health   = &m_health[0];
+  batch.ai_state = &m_state[0];
+  batch.ai_value = &m_value[0];
+
+  hook->doAll(&batch);
+
+  // Write back what the callbacks changed
+  for (size_t i = 0; i < m_id.size(); i++)
+  {
+    const size_t slot = slotOf(m_id[i]);
+    if (slot == size_t(-1) || !m_moblist[slot] || m_moblist[slot]->UID != eids[i])
+    {
+      continue;
+    }
+    MobPtr mob = m_moblist[slot];
+
+    m_aiState[slot] = m_state[i];
+    m_aiValue[slot] = m_value[i];
+
+    if (m_x[i] != mob->x || m_y[i] != mob->y || m_z[i] != mob->z || m_map[i] != int(mob->map))
+    {
+      mob->moveTo(m_x[i], m_y[i], m_z[i], m_map[i]);
+    }
+    if (m_yaw[i] != mob->yaw * 360.0 / 256.0 || m_pitch[i] != mob->pitch * 360.0 / 256.0)
+    {
+      mob->look((int16_t)m_yaw[i], (int16_t)m_pitch[i]);
+    }
+    if (m_headYaw[i] != mob->head_yaw * 360.0 / 256.0)
+    {
+      mob->headLook((int16_t)m_headYaw[i]);
+    }
+    if (m_health[i] != mob->health)
+    {
+      mob->sethealth(m_health[i]);
+    }
+  }
+}
@@ -653,7 +653,7 @@ NBT_Value* NBT_Value::LoadFromMemory(uint8_t* buffer, uint32_t len)
   return root;
 }
 
-void NBT_Value::SaveToFile(const std::string& filename)
+bool NBT_Value::SaveToFile(const std::string& filename)
 {
   std::vector<uint8_t> buffer;
 
@@ -669,8 +669,12 @@ void NBT_Value::SaveToFile(const std::string& filename)
   buffer.push_back(0);
 
   gzFile nbtFile = gzopen(filename.c_str(), "wb");
-  gzwrite(nbtFile, &buffer[0], buffer.size());
-  gzclose(nbtFile);
+  if (nbtFile == NULL)
+  {
+    return false;
+  }
+  const bool written = gzwrite(nbtFile, &buffer[0], unsigned(buffer.size())) == int(buffer.size());
+  return gzclose(nbtFile) == Z_OK && written;
 }
 
 
@@ -0,0 +1,302 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "outputlanes.h"
+#include "packets.h"
+#include "tools.h"
+
+// Lane weights: block updates first, chunks get what is left
+unsigned int OutputLanes::weights[OutputLanes::LANE_COUNT] = { 8, 4, 2, 1 };
+
+// Length of the message at data and its lane, 0 if it has none or is cut short
+static size_t messageLength(const uint8_t* data, size_t len, OutputLanes::Lane& lane)
+{
+  size_t msgLen;
+  switch (data[0])
+  {
+  case PACKET_BLOCK_CHANGE:
+    lane   = OutputLanes::LANE_BLOCK;
+    msgLen = 13;
+    break;
+  case PACKET_MULTI_BLOCK_CHANGE:
+    // As Map::sendMultiBlocks() writes it: chunk x, z, count, then 4 bytes per block
+    lane   = OutputLanes::LANE_BLOCK;
+    msgLen = len < 11 ? 0 : 11 + 4 * ((size_t(data[9]) << 8) | data[10]);
+    break;
+  case PACKET_CHAT_MESSAGE:
+    lane   = OutputLanes::LANE_CHAT;
+    msgLen = len < 3 ? 0 : 3 + 2 * ((size_t(data[1]) << 8) | data[2]);
+    break;
+  case PACKET_TIME_UPDATE:               lane = OutputLanes::LANE_ENTITY; msgLen = 9;  break;
+  case PACKET_ENTITY_VELOCITY:           lane = OutputLanes::LANE_ENTITY; msgLen = 11; break;
+  case PACKET_ENTITY_RELATIVE_MOVE:      lane = OutputLanes::LANE_ENTITY; msgLen = 8;  break;
+  case PACKET_ENTITY_LOOK:               lane = OutputLanes::LANE_ENTITY; msgLen = 7;  break;
+  case PACKET_ENTITY_LOOK_RELATIVE_MOVE: lane = OutputLanes::LANE_ENTITY; msgLen = 10; break;
+  case PACKET_ENTITY_TELEPORT:           lane = OutputLanes::LANE_ENTITY; msgLen = 19; break;
+  case PACKET_ENTITY_HEAD_LOOK:          lane = OutputLanes::LANE_ENTITY; msgLen = 6;  break;
+  default:
+    return 0;
+  }
+  return msgLen <= len ? msgLen : 0;
+}
+
+// Chunk a block change is for
+static std::pair<int32_t, int32_t> blockChunk(const uint8_t* data)
+{
+  const int32_t x = getSint32(const_cast<uint8_t*>(data + 1));
+  if (data[0] == PACKET_MULTI_BLOCK_CHANGE)
+  {
+    return std::make_pair(x, getSint32(const_cast<uint8_t*>(data + 5)));
+  }
+  return std::make_pair(blockToChunk(x), blockToChunk(getSint32(const_cast<uint8_t*>(data + 6))));
+}
+
+OutputLanes::OutputLanes()
+  : m_size(0)
+{
+}
+
+OutputLanes::Lane OutputLanes::classify(const uint8_t* data, size_t len)
+{
+  Lane result = LANE_CONTROL;
+  size_t pos = 0;
+
+  while (pos < len)
+  {
+    Lane lane;
+    const size_t msgLen = messageLength(data + pos, len - pos, lane);
+    if (msgLen == 0 || (pos != 0 && lane != result))
+    {
+      return LANE_CONTROL;
+    }
+    result = lane;
+    pos += msgLen;
+  }
+
+  return result;
+}
+
+void OutputLanes::push(Lane lane, const uint8_t* data, size_t len)
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  Entry entry;
+  entry.len       = len;
+  entry.chunk     = false;
+  entry.parked    = false;
+  entry.cancelled = false;
+  entry.x         = 0;
+  entry.z         = 0;
+
+  // Keep block changes behind the data of their chunk and behind the changes
+  // parked there before them
+  if (lane == LANE_BLOCK && !m_pendingChunks.empty())
+  {
+    size_t pos = 0;
+    while (pos < len)
+    {
+      Lane msgLane;
+      const size_t msgLen = messageLength(data + pos, len - pos, msgLane);
+      if (msgLen == 0 || m_pendingChunks.count(blockChunk(data + pos)) != 0)
+      {
+        lane = LANE_CHUNK;
+        entry.parked = true;
+        break;
+      }
+      pos += msgLen;
+    }
+  }
+
+  // Every chunk a parked entry touches waits for it, pop() lets them go
+  if (entry.parked)
+  {
+    Lane msgLane;
+    size_t msgLen;
+    for (size_t pos = 0; pos < len && (msgLen = messageLength(data + pos, len - pos, msgLane)) != 0; pos += msgLen)
+    {
+      m_pendingChunks[blockChunk(data + pos)]++;
+    }
+  }
+
+  append(lane, data, len, entry);
+}
+
+void OutputLanes::pushChunk(int32_t x, int32_t z, const uint8_t* data, size_t len)
+{
+  cancelChunk(x, z);
+
+  Entry entry;
+  entry.len       = len;
+  entry.chunk     = true;
+  entry.parked    = false;
+  entry.cancelled = false;
+  entry.x         = x;
+  entry.z         = z;
+  append(LANE_CHUNK, data, len, entry);
+  m_pendingChunks[std::make_pair(x, z)]++;
+}
+
+// Parked block changes are still sent, they are cheap and keep their order
+void OutputLanes::cancelChunk(int32_t x, int32_t z)
+{
+  if (m_pendingChunks.count(std::make_pair(x, z)) == 0)
+  {
+    return;
+  }
+
+  std::deque<Entry>& entries = m_lanes[LANE_CHUNK].entries;
+  for (std::deque<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+  {
+    if (it->chunk && !it->cancelled && it->x == x && it->z == z)
+    {
+      it->cancelled = true;
+      release(std::make_pair(x, z));
+    }
+  }
+}
+
+void OutputLanes::cancelChunks()
+{
+  std::deque<Entry>& entries = m_lanes[LANE_CHUNK].entries;
+  for (std::deque<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+  {
+    if (it->chunk && !it->cancelled)
+    {
+      it->cancelled = true;
+      release(std::make_pair(it->x, it->z));
+    }
+  }
+}
+
+void OutputLanes::release(const std::pair<int32_t, int32_t>& chunk)
+{
+  std::map<std::pair<int32_t, int32_t>, size_t>::iterator it = m_pendingChunks.find(chunk);
+  if (it != m_pendingChunks.end() && --it->second == 0)
+  {
+    m_pendingChunks.erase(it);
+  }
+}
+
+void OutputLanes::append(Lane lane, const uint8_t* data, size_t len, const Entry& entry)
+{
+  Queue& queue = m_lanes[lane];
+  queue.data.insert(queue.data.end(), data, data + len);
+  queue.entries.push_back(entry);
+  queue.size += len;
+  m_size += len;
+}
+
+void OutputLanes::pop(Queue& queue)
+{
+  const Entry& entry = queue.entries.front();
+  if (entry.chunk && !entry.cancelled)
+  {
+    release(std::make_pair(entry.x, entry.z));
+  }
+  else if (entry.parked)
+  {
+    const uint8_t* data = &queue.data[queue.start];
+    Lane msgLane;
+    size_t msgLen;
+    for (size_t pos = 0; pos < entry.len && (msgLen = messageLength(data + pos, entry.len - pos, msgLane)) != 0; pos += msgLen)
+    {
+      release(blockChunk(data + pos));
+    }
+  }
+
+  queue.start += entry.len;
+  queue.size  -= entry.len;
+  m_size      -= entry.len;
+  queue.entries.pop_front();
+
+  if (queue.entries.empty())
+  {
+    queue.data.clear();
+    queue.start   = 0;
+    queue.deficit = 0;
+  }
+  // Drop the sent front once it is most of the buffer
+  else if (queue.start > queue.data.size() / 2)
+  {
+    queue.data.erase(queue.data.begin(), queue.data.begin() + queue.start);
+    queue.start = 0;
+  }
+}
+
+size_t OutputLanes::take(Packet& out, size_t budget)
+{
+  size_t taken = 0;
+
+  // Deficit round robin: every round each waiting lane may take its weight in
+  // quanta, what a lane can't use for a large message is saved for the next round
+  while (taken < budget && m_size != 0)
+  {
+    for (int i = 0; i < LANE_COUNT && taken < budget; i++)
+    {
+      Queue& queue = m_lanes[i];
+      if (queue.entries.empty())
+      {
+        continue;
+      }
+
+      queue.deficit += weights[i] * QUANTUM;
+      while (!queue.entries.empty() && taken < budget)
+      {
+        const Entry& entry = queue.entries.front();
+        if (entry.cancelled)
+        {
+          pop(queue);
+          continue;
+        }
+        if (entry.len > queue.deficit)
+        {
+          break;
+        }
+
+        out.addToWrite(&queue.data[queue.start], entry.len);
+        taken += entry.len;
+        queue.deficit -= entry.len;
+        pop(queue);
+      }
+    }
+  }
+
+  return taken;
+}
+
+void OutputLanes::clear()
+{
+  for (int i = 0; i < LANE_COUNT; i++)
+  {
+    m_lanes[i] = Queue();
+  }
+  m_pendingChunks.clear();
+  m_size = 0;
+}
@@ -0,0 +1,192 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#include "outputqueue.h"
+
+#ifndef WIN32
+#define SOCKET_ERROR -1
+#endif
+
+OutputStats OutputQueue::stats;
+
+OutputQueue::OutputQueue()
+  : m_size(0)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+  clear();
+  for (size_t i = 0; i < m_spare.size(); i++)
+  {
+    delete m_spare[i];
+  }
+}
+
+OutputQueue::Block* OutputQueue::newBlock()
+{
+  Block* block;
+  if (!m_spare.empty())
+  {
+    block = m_spare.back();
+    m_spare.pop_back();
+  }
+  else
+  {
+    block = new Block;
+    stats.blocks++;
+  }
+  block->start = 0;
+  block->end = 0;
+  return block;
+}
+
+void OutputQueue::releaseFront()
+{
+  Block* block = m_blocks.front();
+  m_blocks.pop_front();
+  if (m_spare.size() < SPARE_BLOCKS)
+  {
+    m_spare.push_back(block);
+  }
+  else
+  {
+    delete block;
+  }
+}
+
+void OutputQueue::append(const uint8_t* data, size_t len, EVP_CIPHER_CTX* cipher)
+{
+  stats.queued += len;
+  if (cipher != NULL)
+  {
+    stats.encrypted += len;
+  }
+  m_size += len;
+
+  while (len)
+  {
+    if (m_blocks.empty() || m_blocks.back()->end == BLOCK_SIZE)
+    {
+      m_blocks.push_back(newBlock());
+    }
+
+    Block* block = m_blocks.back();
+    const size_t count = std::min(len, size_t(BLOCK_SIZE) - block->end);
+    if (cipher != NULL)
+    {
+      // CFB8 is a stream mode, the output is exactly as long as the input
+      int outLen = int(count);
+      EVP_EncryptUpdate(cipher, block->data + block->end, &outLen, data, int(count));
+    }
+    else
+    {
+      memcpy(block->data + block->end, data, count);
+    }
+    block->end += count;
+    data += count;
+    len -= count;
+  }
+}
+
+int OutputQueue::flush(int fd)
+{
+  int total = 0;
+
+  while (!m_blocks.empty())
+  {
+#ifdef WIN32
+    Block* block = m_blocks.front();
+    const size_t wanted = block->end - block->start;
+    const int written = send(fd, reinterpret_cast<const char*>(block->data + block->start), int(wanted), 0);
+#else
+    struct iovec iov[MAX_IOV];
+    const size_t count = std::min(m_blocks.size(), size_t(MAX_IOV));
+    size_t wanted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      iov[i].iov_base = m_blocks[i]->data + m_blocks[i]->start;
+      iov[i].iov_len  = m_blocks[i]->end - m_blocks[i]->start;
+      wanted += iov[i].iov_len;
+    }
+    const int written = int(writev(fd, iov, int(count)));
+#endif
+    stats.writes++;
+
+    if (written == SOCKET_ERROR)
+    {
+      return total ? total : SOCKET_ERROR;
+    }
+
+    stats.sent += written;
+    m_size -= written;
+    total += written;
+
+    size_t left = written;
+    while (left)
+    {
+      Block* block = m_blocks.front();
+      const size_t blockLen = block->end - block->start;
+      if (left < blockLen)
+      {
+        block->start += left;
+        break;
+      }
+      left -= blockLen;
+      releaseFront();
+    }
+
+    // The socket buffer is full, come back on EV_WRITE
+    if (size_t(written) < wanted)
+    {
+      break;
+    }
+  }
+
+  return total;
+}
+
+void OutputQueue::clear()
+{
+  while (!m_blocks.empty())
+  {
+    releaseFront();
+  }
+  m_size = 0;
+}
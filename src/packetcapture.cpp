@@ -0,0 +1,256 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+
+#include "packetcapture.h"
+#include "tools.h"
+
+static const char MAGIC[4] = { 'M', 'S', 'P', 'C' };
+static const size_t HEADER_SIZE = 14;
+
+PacketCapture::PacketCapture()
+  : m_file(NULL),
+    m_start(0),
+    m_last(0),
+    m_records(0)
+{
+}
+
+PacketCapture::~PacketCapture()
+{
+  close();
+}
+
+bool PacketCapture::open(const std::string& file, int protocol)
+{
+  close();
+
+  m_file = fopen(file.c_str(), "wb");
+  if (m_file == NULL)
+  {
+    return false;
+  }
+
+  uint8_t header[HEADER_SIZE];
+  memcpy(header, MAGIC, 4);
+  header[4] = FORMAT_VERSION;
+  header[5] = uint8_t(protocol);
+  const uint64_t started = uint64_t(time(NULL));
+  for (int i = 0; i < 8; i++)
+  {
+    header[6 + i] = uint8_t(started >> (56 - i * 8));
+  }
+  fwrite(header, 1, HEADER_SIZE, m_file);
+
+  m_start   = microTime();
+  m_last    = 0;
+  m_records = 0;
+  return true;
+}
+
+void PacketCapture::close()
+{
+  if (m_file == NULL)
+  {
+    return;
+  }
+  flush();
+  fclose(m_file);
+  m_file = NULL;
+}
+
+void PacketCapture::connected(uint32_t connection)
+{
+  begin(CONNECT, connection);
+}
+
+void PacketCapture::packet(uint32_t connection, uint8_t id, const uint8_t* data, size_t len)
+{
+  begin(PACKET, connection);
+  if (m_file == NULL)
+  {
+    return;
+  }
+  m_buffer.push_back(id);
+  putVarint(len);
+  m_buffer.insert(m_buffer.end(), data, data + len);
+
+  if (m_buffer.size() >= FLUSH_SIZE)
+  {
+    flush();
+  }
+}
+
+void PacketCapture::disconnected(uint32_t connection)
+{
+  begin(DISCONNECT, connection);
+}
+
+void PacketCapture::flush()
+{
+  if (m_file == NULL || m_buffer.empty())
+  {
+    return;
+  }
+  fwrite(&m_buffer[0], 1, m_buffer.size(), m_file);
+  fflush(m_file);
+  m_buffer.clear();
+}
+
+void PacketCapture::begin(Kind kind, uint32_t connection)
+{
+  if (m_file == NULL)
+  {
+    return;
+  }
+
+  const uint64_t now = microTime() - m_start;
+  m_buffer.push_back(uint8_t(kind));
+  putVarint(now - m_last);
+  putVarint(connection);
+  m_last = now;
+  m_records++;
+}
+
+void PacketCapture::putVarint(uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    m_buffer.push_back(uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  m_buffer.push_back(uint8_t(value));
+}
+
+
+PacketCapture::Reader::Reader()
+  : m_file(NULL),
+    m_started(0),
+    m_protocol(0),
+    m_time(0)
+{
+}
+
+PacketCapture::Reader::~Reader()
+{
+  if (m_file != NULL)
+  {
+    fclose(m_file);
+  }
+}
+
+bool PacketCapture::Reader::open(const std::string& file)
+{
+  if (m_file != NULL)
+  {
+    fclose(m_file);
+  }
+
+  m_file = fopen(file.c_str(), "rb");
+  if (m_file == NULL)
+  {
+    return false;
+  }
+
+  uint8_t header[HEADER_SIZE];
+  if (fread(header, 1, HEADER_SIZE, m_file) != HEADER_SIZE ||
+      memcmp(header, MAGIC, 4) != 0 || header[4] != FORMAT_VERSION)
+  {
+    fclose(m_file);
+    m_file = NULL;
+    return false;
+  }
+
+  m_protocol = header[5];
+  uint64_t started = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    started = (started << 8) | header[6 + i];
+  }
+  m_started = time_t(started);
+  m_time    = 0;
+  return true;
+}
+
+bool PacketCapture::Reader::next(Record& record)
+{
+  if (m_file == NULL)
+  {
+    return false;
+  }
+
+  const int kind = getc(m_file);
+  uint64_t delta, connection;
+  if (kind == EOF || kind > DISCONNECT || !readVarint(delta) || !readVarint(connection))
+  {
+    return false;
+  }
+
+  m_time += delta;
+  record.kind       = Kind(kind);
+  record.time       = m_time;
+  record.connection = uint32_t(connection);
+  record.id         = 0;
+  record.data.clear();
+
+  if (record.kind == PACKET)
+  {
+    const int id = getc(m_file);
+    uint64_t len;
+    if (id == EOF || !readVarint(len) || len > 16 * 1024 * 1024)
+    {
+      return false;
+    }
+    record.id = uint8_t(id);
+    record.data.resize(size_t(len));
+    if (len != 0 && fread(&record.data[0], 1, size_t(len), m_file) != len)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PacketCapture::Reader::readVarint(uint64_t& value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    const int byte = getc(m_file);
+    if (byte == EOF)
+    {
+      return false;
+    }
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
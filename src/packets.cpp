@@ -61,7 +61,8 @@
 #include "mob.h"
 #include "utf8.h"
 #include "protocol.h"
-#include "sockets.h"
+#include "loginpipeline.h"
+#include "playerstore.h"
 
 #ifdef PROTOCOL_ENCRYPTION
 #include <openssl/rsa.h>
@@ -70,36 +71,36 @@
 
 void PacketHandler::init()
 {
-  packets[PACKET_KEEP_ALIVE]               = Packets(0, &PacketHandler::keep_alive);
-  packets[PACKET_LOGIN_REQUEST]            = Packets(PACKET_VARIABLE_LEN, &PacketHandler::login_request);
-  packets[PACKET_HANDSHAKE]                = Packets(PACKET_VARIABLE_LEN, &PacketHandler::handshake);
-  packets[PACKET_CHAT_MESSAGE]             = Packets(PACKET_VARIABLE_LEN, &PacketHandler::chat_message);
-  packets[PACKET_USE_ENTITY]               = Packets(9, &PacketHandler::use_entity);
-  packets[PACKET_PLAYER]                   = Packets(1, &PacketHandler::player);
-  packets[PACKET_PLAYER_POSITION]          = Packets(33, &PacketHandler::player_position);
-  packets[PACKET_PLAYER_LOOK]              = Packets(9, &PacketHandler::player_look);
-  packets[PACKET_PLAYER_POSITION_AND_LOOK] = Packets(41, &PacketHandler::player_position_and_look);
-  packets[PACKET_PLAYER_DIGGING]           = Packets(11, &PacketHandler::player_digging);
-  packets[PACKET_PLAYER_BLOCK_PLACEMENT]   = Packets(PACKET_VARIABLE_LEN, &PacketHandler::player_block_placement);
-  packets[PACKET_HOLDING_CHANGE]           = Packets(2, &PacketHandler::holding_change);
-  packets[PACKET_ANIMATION]            = Packets(5, &PacketHandler::arm_animation);
-  packets[PACKET_PICKUP_SPAWN]             = Packets(22, &PacketHandler::pickup_spawn);
-  packets[PACKET_DISCONNECT]               = Packets(PACKET_VARIABLE_LEN, &PacketHandler::disconnect);
-  packets[PACKET_RESPAWN]                  = Packets(PACKET_VARIABLE_LEN, &PacketHandler::respawn);
-  packets[PACKET_INVENTORY_CHANGE]         = Packets(PACKET_VARIABLE_LEN, &PacketHandler::inventory_change);
-  packets[PACKET_INVENTORY_CLOSE]          = Packets(1, &PacketHandler::inventory_close);
-  packets[PACKET_SIGN]                     = Packets(PACKET_VARIABLE_LEN, &PacketHandler::change_sign);
-  packets[PACKET_TRANSACTION]              = Packets(4, &PacketHandler::inventory_transaction);
-  packets[PACKET_ENTITY_CROUCH]            = Packets(5, &PacketHandler::entity_crouch);
-  packets[PACKET_WEATHER]                  = Packets(18, &PacketHandler::unhandledPacket);
-  packets[PACKET_INCREMENT_STATISTICS]     = Packets(6, &PacketHandler::unhandledPacket);
-  packets[PACKET_PING]                     = Packets(0, &PacketHandler::ping);
-  packets[PACKET_BLOCK_CHANGE]             = Packets(11, &PacketHandler::block_change);
-  packets[PACKET_TAB_COMPLETE]             = Packets(PACKET_VARIABLE_LEN, &PacketHandler::tab_complete);
-  packets[PACKET_CLIENT_INFO]              = Packets(PACKET_VARIABLE_LEN, &PacketHandler::client_info);
-  packets[PACKET_CLIENT_STATUS]            = Packets(1, &PacketHandler::client_status);
-  packets[PACKET_ENCRYPTION_RESPONSE]      = Packets(PACKET_VARIABLE_LEN, &PacketHandler::encryption_response);
-  packets[PACKET_PLUGIN_MESSAGE]           = Packets(PACKET_VARIABLE_LEN, &PacketHandler::plugin_message);
+  packets[PACKET_KEEP_ALIVE]               = Packets(&PacketLayout::KeepAlive::frame, &PacketHandler::keep_alive);
+  packets[PACKET_LOGIN_REQUEST]            = Packets(&PacketLayout::LoginRequest::frame, &PacketHandler::login_request);
+  packets[PACKET_HANDSHAKE]                = Packets(&PacketLayout::Handshake::frame, &PacketHandler::handshake);
+  packets[PACKET_CHAT_MESSAGE]             = Packets(&PacketLayout::ChatMessage::frame, &PacketHandler::chat_message);
+  packets[PACKET_USE_ENTITY]               = Packets(&PacketLayout::UseEntity::frame, &PacketHandler::use_entity);
+  packets[PACKET_PLAYER]                   = Packets(&PacketLayout::Player::frame, &PacketHandler::player);
+  packets[PACKET_PLAYER_POSITION]          = Packets(&PacketLayout::PlayerPosition::frame, &PacketHandler::player_position);
+  packets[PACKET_PLAYER_LOOK]              = Packets(&PacketLayout::PlayerLook::frame, &PacketHandler::player_look);
+  packets[PACKET_PLAYER_POSITION_AND_LOOK] = Packets(&PacketLayout::PlayerPositionAndLook::frame, &PacketHandler::player_position_and_look);
+  packets[PACKET_PLAYER_DIGGING]           = Packets(&PacketLayout::PlayerDigging::frame, &PacketHandler::player_digging);
+  packets[PACKET_PLAYER_BLOCK_PLACEMENT]   = Packets(&PacketLayout::PlayerBlockPlacement::frame, &PacketHandler::player_block_placement);
+  packets[PACKET_HOLDING_CHANGE]           = Packets(&PacketLayout::HoldingChange::frame, &PacketHandler::holding_change);
+  packets[PACKET_ANIMATION]                = Packets(&PacketLayout::Animation::frame, &PacketHandler::arm_animation);
+  packets[PACKET_PICKUP_SPAWN]             = Packets(&PacketLayout::PickupSpawn::frame, &PacketHandler::pickup_spawn);
+  packets[PACKET_DISCONNECT]               = Packets(&PacketLayout::Disconnect::frame, &PacketHandler::disconnect);
+  packets[PACKET_RESPAWN]                  = Packets(&PacketLayout::Respawn::frame, &PacketHandler::respawn);
+  packets[PACKET_INVENTORY_CHANGE]         = Packets(&PacketLayout::InventoryChange::frame, &PacketHandler::inventory_change);
+  packets[PACKET_INVENTORY_CLOSE]          = Packets(&PacketLayout::InventoryClose::frame, &PacketHandler::inventory_close);
+  packets[PACKET_SIGN]                     = Packets(&PacketLayout::Sign::frame, &PacketHandler::change_sign);
+  packets[PACKET_TRANSACTION]              = Packets(&PacketLayout::Transaction::frame, &PacketHandler::inventory_transaction);
+  packets[PACKET_ENTITY_CROUCH]            = Packets(&PacketLayout::EntityCrouch::frame, &PacketHandler::entity_crouch);
+  packets[PACKET_WEATHER]                  = Packets(&PacketLayout::Weather::frame, &PacketHandler::unhandledPacket);
+  packets[PACKET_INCREMENT_STATISTICS]     = Packets(&PacketLayout::IncrementStatistics::frame, &PacketHandler::unhandledPacket);
+  packets[PACKET_PING]                     = Packets(&PacketLayout::Ping::frame, &PacketHandler::ping);
+  packets[PACKET_BLOCK_CHANGE]             = Packets(&PacketLayout::BlockChange::frame, &PacketHandler::block_change);
+  packets[PACKET_TAB_COMPLETE]             = Packets(&PacketLayout::TabComplete::frame, &PacketHandler::tab_complete);
+  packets[PACKET_CLIENT_INFO]              = Packets(&PacketLayout::ClientInfo::frame, &PacketHandler::client_info);
+  packets[PACKET_CLIENT_STATUS]            = Packets(&PacketLayout::ClientStatus::frame, &PacketHandler::client_status);
+  packets[PACKET_ENCRYPTION_RESPONSE]      = Packets(&PacketLayout::EncryptionResponse::frame, &PacketHandler::encryption_response);
+  packets[PACKET_PLUGIN_MESSAGE]           = Packets(&PacketLayout::PluginMessage::frame, &PacketHandler::plugin_message);
 }
 
 int PacketHandler::unhandledPacket(User* user)
@@ -110,36 +111,11 @@ int PacketHandler::unhandledPacket(User* user)
 
 int PacketHandler::plugin_message(User* user)
 {
-
-  if (!user->buffer.haveData(4))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  
   std::string channel;
-  int16_t datalen;
 
+  // The data is skipped along with the rest of the frame
   user->buffer >> channel;
 
-  if (!user->buffer || !user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  user->buffer >> datalen;
-
-  if (!user->buffer.haveData(datalen))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  for(int i = 0; i < datalen; i++)
-  {
-    int8_t byte;
-    user->buffer >> byte;
-  }
-
   LOG2(INFO, "Plugin message: "+channel);
 
   user->buffer.removePacket();
@@ -151,42 +127,13 @@ int PacketHandler::plugin_message(User* user)
 int PacketHandler::encryption_response(User* user)
 {
 
-  if (!user->buffer.haveData(4))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   int16_t secretLen, verifyLen;
   std::string secret,verify;
-  std::string decryptedSecret(' ', 16);
 
   user->buffer >> secretLen;
-
-  if (!user->buffer.haveData(secretLen))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  for(int i = 0; i < secretLen; i++)
-  {
-    int8_t byte;
-    user->buffer >> byte;
-    secret.push_back(byte);
-  }
-
+  secret = user->buffer.readBytes(secretLen);
   user->buffer >> verifyLen;
-
-  if (!user->buffer.haveData(verifyLen))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  for(int i = 0; i < verifyLen; i++)
-  {
-    int8_t byte;
-    user->buffer >> byte;
-    verify.push_back(byte);
-  }  
+  verify = user->buffer.readBytes(verifyLen);
   user->buffer.removePacket();
   
   //Those should be around 128 bytes
@@ -196,43 +143,12 @@ int PacketHandler::encryption_response(User* user)
     return PACKET_OK;
   }
 
-  
-  uint8_t buffer[1024];
-  memset(buffer, 0, 1024);
-  //Decrypt the verification bytes
-  int ret = RSA_private_decrypt(verifyLen,(const uint8_t *)verify.c_str(),buffer,ServerInstance->rsa,RSA_PKCS1_PADDING);
-  //Check they match with the ones sent
-  if(ret != 4 || std::string((char *)buffer) != ServerInstance->encryptionBytes)
+  //Decrypted off the main thread, Mineserver::finishLogins() goes on from there
+  if (!ServerInstance->loginPipeline()->submitHandshake(user->UID, secret, verify))
   {
-    user->kick("Decryption failed");
-    return PACKET_OK;
+    user->kick("Too many logins at once, try again");
   }
 
-  //Decrypt secret sent by the client and store
-  memset(buffer, 0, 1024);
-  ret = RSA_private_decrypt(secretLen,(const uint8_t *)secret.c_str(),buffer,ServerInstance->rsa,RSA_PKCS1_PADDING);
-  user->secret = std::string((char *)buffer, ret);
-  //We're going crypted!  
-  user->initCipher();
-  
-  
-  if(!ServerInstance->config()->bData("system.user_validation"))
-  {
-    //Response
-    user->crypted = true;
-    user->buffer << (int8_t)PACKET_ENCRYPTION_RESPONSE << (int16_t)0 << (int16_t) 0;
-    user->uncryptedLeft = 5; //5 first bytes are uncrypted
-  }
-  else
-  {
-    pthread_t validation_thread;
-    Mineserver::userValidation* valid = new Mineserver::userValidation;
-    valid->user = user;
-    valid->UID = user->UID;
-    pthread_create(&validation_thread,NULL,user_validation_thread,(void*)valid);
-  }
-  
-
   return PACKET_OK;
 }
 #endif
@@ -250,7 +166,7 @@ int PacketHandler::client_status(User* user)
   if(payload == 0 && user->crypted)
   {
     LOG2(INFO, "Sending login info..");
-    user->sendLoginInfo();
+    user->startLogin();
   }
   //player respawns
   if(payload == 1)
@@ -264,27 +180,17 @@ int PacketHandler::client_status(User* user)
 
 int PacketHandler::client_info(User* user)
 {
-  // Wait for length-short. HEHE
-  if (!user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   std::string locale;
   int8_t viewDistance,chatFlags,difficulty;
 
-  user->buffer >> locale;
-
-  if (!user->buffer || !user->buffer.haveData(3))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
-  user->buffer >> viewDistance >> chatFlags >> difficulty;
+  user->buffer >> locale >> viewDistance >> chatFlags >> difficulty;
 
   user->buffer.removePacket();
 
-  //ToDo: Do something with the values
+  // 0-3 for far, normal, short and tiny, which the client renders as 16, 8, 4 and 2 chunks
+  user->setViewDistance(16 >> (viewDistance & 3));
+
+  //ToDo: Do something with the other values
 
 
   return PACKET_OK;
@@ -293,20 +199,9 @@ int PacketHandler::client_info(User* user)
 
 int PacketHandler::tab_complete(User* user)
 {
-  // Wait for length-short. HEHE
-  if (!user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   std::string msg;
 
   user->buffer >> msg;
-
-  if (!user->buffer)
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
   user->buffer.removePacket();
 
   //ToDo: autocomplete!
@@ -356,36 +251,12 @@ int PacketHandler::entity_crouch(User* user)
 
 int PacketHandler::change_sign(User* user)
 {
-  if (!user->buffer.haveData(16))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
   int32_t x, z;
   int16_t y;
   std::string strings1, strings2, strings3, strings4;
 
   user->buffer >> x >> y >> z;
-
-  if (!user->buffer.haveData(8))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-  user->buffer >> strings1;
-  if (!user->buffer.haveData(6))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-  user->buffer >> strings2;
-  if (!user->buffer.haveData(4))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-  user->buffer >> strings3;
-  if (!user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-  user->buffer >> strings4;
+  user->buffer >> strings1 >> strings2 >> strings3 >> strings4;
 
   //ToDo: Save signs!
   signDataPtr newSign(new signData);
@@ -450,10 +321,6 @@ int PacketHandler::inventory_transaction(User* user)
 
 int PacketHandler::inventory_change(User* user)
 {
-  if (!user->buffer.haveData(10))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
   int8_t windowID = 0;
   int16_t slot = 0;
   int8_t rightClick = 0;
@@ -466,10 +333,6 @@ int PacketHandler::inventory_change(User* user)
   user->buffer >> windowID >> slot >> rightClick >> actionNumber >> shift >> itemID;
   if (itemID != -1)
   {
-    if (!user->buffer.haveData(2))
-    {
-      return PACKET_NEED_MORE_DATA;
-    }
     user->buffer >> itemCount >> itemUses;
     //if(Item::isEnchantable(itemID)) {
       int16_t enchantment_data_len;
@@ -505,29 +368,18 @@ int PacketHandler::login_request(User* user)
 
 int PacketHandler::handshake(User* user)
 {
-  if (!user->buffer.haveData(9))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   std::string player, host;
   int8_t version;
   int32_t port;
 
   user->buffer >> version >> player >> host >> port;
 
-  // Check for data
-  if (!user->buffer)
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   // Remove package from buffer
   user->buffer.removePacket();
 
   LOG(INFO, "Packets", "Player " + dtos(user->UID) + " login v." + dtos(version) + " : " + player);
 
-  user->nick = player;
+  ServerInstance->setUserNick(user, player);
 
   // If version is not the current version
   if (version != PROTOCOL_VERSION)
@@ -544,7 +396,7 @@ int PacketHandler::handshake(User* user)
   }
 
   char* kickMessage = NULL;
-  if ((static_cast<Hook2<bool, const char*, char**>*>(ServerInstance->plugin()->getHook("PlayerLoginPre")))->doUntilFalse(player.c_str(), &kickMessage))
+  if (ServerInstance->plugin()->hook<HOOK_PLAYER_LOGIN_PRE>()->doUntilFalse(player.c_str(), &kickMessage))
   {
     user->kick(std::string(kickMessage));
   }
@@ -553,13 +405,15 @@ int PacketHandler::handshake(User* user)
     //We can skip the protocol encryption
     if(!ServerInstance->config()->bData("system.protocol_encryption"))
     {
-      user->sendLoginInfo();
+      user->startLogin();
     }
     else
     {
       user->buffer << Protocol::encryptionRequest();
+      //Read the player file while the client does the handshake
+      ServerInstance->playerStore()->preload(user->dataFile());
     }
-    (static_cast<Hook1<bool, const char*>*>(ServerInstance->plugin()->getHook("PlayerLoginPost")))->doAll(player.c_str());
+    ServerInstance->plugin()->hook<HOOK_PLAYER_LOGIN_POST>()->doAll(player.c_str());
   }
 
   
@@ -570,24 +424,12 @@ int PacketHandler::handshake(User* user)
 
 int PacketHandler::chat_message(User* user)
 {
-  // Wait for length-short. HEHE
-  if (!user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   std::string msg;
 
   user->buffer >> msg;
-
-  if (!user->buffer)
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   user->buffer.removePacket();
 
-  ServerInstance->chat()->handleMsg(user, msg);
+  ServerInstance->chat()->queueMsg(user, msg);
 
   return PACKET_OK;
 }
@@ -709,7 +551,7 @@ int PacketHandler::player_digging(User* user)
   {
   case BLOCK_STATUS_STARTED_DIGGING:
   {
-    (static_cast<Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t>*>(ServerInstance->plugin()->getHook("PlayerDiggingStarted")))->doAll(user->nick.c_str(), x, y, z, direction);
+    ServerInstance->plugin()->hook<HOOK_PLAYER_DIGGING_STARTED>()->doAll(user->nick.c_str(), x, y, z, direction);
 
     for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
     {
@@ -751,13 +593,13 @@ int PacketHandler::player_digging(User* user)
                                               user->inv[itemSlot].getCount(), user->inv[itemSlot].getHealth());
     }
 
-    if ((static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockBreakPre")))->doUntilFalse(user->nick.c_str(), x, y, z))
+    if (ServerInstance->plugin()->hook<HOOK_BLOCK_BREAK_PRE>()->doUntilFalse(user->nick.c_str(), x, y, z))
     {
       blockD.revertBlock(user, x, y, z, user->pos.map);
       return PACKET_OK;
     }
 
-    (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockBreakPost")))->doAll(user->nick.c_str(), x, y, z);
+    ServerInstance->plugin()->hook<HOOK_BLOCK_BREAK_POST>()->doAll(user->nick.c_str(), x, y, z);
 
     for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
     {
@@ -780,7 +622,7 @@ int PacketHandler::player_digging(User* user)
     status = block;
     if (ServerInstance->map(user->pos.map)->getBlock(x + 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x + 1, y, z, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x + 1, y, z, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -794,7 +636,7 @@ int PacketHandler::player_digging(User* user)
 
     if (ServerInstance->map(user->pos.map)->getBlock(x - 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x - 1, y, z, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x - 1, y, z, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -808,7 +650,7 @@ int PacketHandler::player_digging(User* user)
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y + 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y + 1, z, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x, y + 1, z, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -822,7 +664,7 @@ int PacketHandler::player_digging(User* user)
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y - 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y - 1, z, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x, y - 1, z, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -836,7 +678,7 @@ int PacketHandler::player_digging(User* user)
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y, z + 1, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y, z + 1, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x, y, z + 1, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -850,7 +692,7 @@ int PacketHandler::player_digging(User* user)
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y, z - 1, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y, z - 1, x, int8_t(y), z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_BREAK>()->doAll(user->nick.c_str(), x, y, z - 1, x, int8_t(y), z);
       for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
       {
         blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -887,10 +729,6 @@ int PacketHandler::player_digging(User* user)
 
 int PacketHandler::player_block_placement(User* user)
 {
-  if (!user->buffer.haveData(12))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
   int16_t y = 0;
   int8_t temp_y = 0;
   int8_t direction = 0;
@@ -916,21 +754,10 @@ int PacketHandler::player_block_placement(User* user)
     int16_t damage;
     user->buffer >> count >> damage;
     user->buffer >> slotLen;
-    if(slotLen != -1)
+    if(slotLen > 0)
     {
-      if (!user->buffer.haveData(slotLen+3))
-      {
-        return PACKET_NEED_MORE_DATA;
-      }
-      uint8_t *buf = new uint8_t[slotLen];
-      for(int i = 0; i < slotLen; i++)
-      {
-        int8_t data;
-        user->buffer >> data;
-        buf[i] = data;
-      }
       //Do something with the slot data
-      delete[] buf;
+      user->buffer.skip(slotLen);
     }
   }
 
@@ -946,7 +773,7 @@ int PacketHandler::player_block_placement(User* user)
   {
     // Right clicked without pointing at a tile
     Item* item = &(user->inv[user->curItem + 36]);
-    if ((static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>*>(ServerInstance->plugin()->getHook("ItemRightClickPre")))->doUntilFalse(user->nick.c_str(), x, y, z, item->getType(), direction))
+    if (ServerInstance->plugin()->hook<HOOK_ITEM_RIGHT_CLICK_PRE>()->doUntilFalse(user->nick.c_str(), x, y, z, item->getType(), direction))
     {
       return PACKET_OK;
     }
@@ -972,7 +799,7 @@ int PacketHandler::player_block_placement(User* user)
   /* Protocol docs say this should be what interacting is. */
   if (oldblock != BLOCK_AIR)
   {
-    (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("PlayerBlockInteract")))->doAll(user->nick.c_str(), x, y, z);
+    ServerInstance->plugin()->hook<HOOK_PLAYER_BLOCK_INTERACT>()->doAll(user->nick.c_str(), x, y, z);
     for (uint32_t i = 0 ; i < ServerInstance->plugin()->getBlockCB().size(); i++)
     {
       blockcb = ServerInstance->plugin()->getBlockCB()[i];
@@ -1100,12 +927,12 @@ int PacketHandler::player_block_placement(User* user)
         }
       }
 
-      if ((static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>*>(ServerInstance->plugin()->getHook("BlockReplacePre")))->doUntilFalse(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock))
+      if (ServerInstance->plugin()->hook<HOOK_BLOCK_REPLACE_PRE>()->doUntilFalse(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock))
       {
         blockD.revertBlock(user, x, y, z, user->pos.map);
         return PACKET_OK;
       }
-      (static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>*>(ServerInstance->plugin()->getHook("BlockReplacePost")))->doAll(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_REPLACE_POST>()->doAll(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock);
     }
     else
     {
@@ -1118,15 +945,15 @@ int PacketHandler::player_block_placement(User* user)
               }
             }*/
 
-      if ((static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>*>(ServerInstance->plugin()->getHook("BlockReplacePre")))->doUntilFalse(user->nick.c_str(), x, y, z, oldblock, newblock))
+      if (ServerInstance->plugin()->hook<HOOK_BLOCK_REPLACE_PRE>()->doUntilFalse(user->nick.c_str(), x, y, z, oldblock, newblock))
       {
         blockD.revertBlock(user, x, y, z, user->pos.map);
         return PACKET_OK;
       }
-      (static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>*>(ServerInstance->plugin()->getHook("BlockReplacePost")))->doAll(user->nick.c_str(), x, y, z, oldblock, newblock);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_REPLACE_POST>()->doAll(user->nick.c_str(), x, y, z, oldblock, newblock);
     }
 
-    if ((static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>*>(ServerInstance->plugin()->getHook("BlockPlacePre")))->doUntilFalse(user->nick.c_str(), x, y, z, newblock, direction))
+    if (ServerInstance->plugin()->hook<HOOK_BLOCK_PLACE_PRE>()->doUntilFalse(user->nick.c_str(), x, y, z, newblock, direction))
     {
       blockD.revertBlock(user, x, y, z, user->pos.map);
       return PACKET_OK;
@@ -1151,7 +978,7 @@ int PacketHandler::player_block_placement(User* user)
         }
       }
     }
-    (static_cast<Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>*>(ServerInstance->plugin()->getHook("BlockPlacePost")))->doAll(user->nick.c_str(), x, y, z, newblock, direction);
+    ServerInstance->plugin()->hook<HOOK_BLOCK_PLACE_POST>()->doAll(user->nick.c_str(), x, y, z, newblock, direction);
 
     /* notify neighbour blocks of the placed block */
     if (ServerInstance->map(user->pos.map)->getBlock(x + 1, y, z, &block, &meta) && block != BLOCK_AIR)
@@ -1165,7 +992,7 @@ int PacketHandler::player_block_placement(User* user)
         }
       }
 
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x + 1, y, z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x + 1, y, z);
     }
 
     if (ServerInstance->map(user->pos.map)->getBlock(x - 1, y, z, &block, &meta) && block != BLOCK_AIR)
@@ -1178,7 +1005,7 @@ int PacketHandler::player_block_placement(User* user)
           blockcb->onNeighbourPlace(user, newblock, x - 1, y, z, user->pos.map, direction);
         }
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x - 1, y, z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x - 1, y, z);
     }
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y + 1, z, &block, &meta) && block != BLOCK_AIR)
@@ -1191,7 +1018,7 @@ int PacketHandler::player_block_placement(User* user)
           blockcb->onNeighbourPlace(user, newblock, x, y + 1, z, user->pos.map, direction);
         }
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y + 1, z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x, y + 1, z);
     }
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y - 1, z, &block, &meta) && block != BLOCK_AIR)
@@ -1204,7 +1031,7 @@ int PacketHandler::player_block_placement(User* user)
           blockcb->onNeighbourPlace(user, newblock, x, y - 1, z, user->pos.map, direction);
         }
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y - 1, z);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x, y - 1, z);
     }
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y, z + 1, &block, &meta) && block != BLOCK_AIR)
@@ -1217,7 +1044,7 @@ int PacketHandler::player_block_placement(User* user)
           blockcb->onNeighbourPlace(user, newblock, x, y, z + 1, user->pos.map, direction);
         }
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y, z + 1);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x, y, z + 1);
     }
 
     if (ServerInstance->map(user->pos.map)->getBlock(x, y, z - 1, &block, &meta) && block != BLOCK_AIR)
@@ -1230,7 +1057,7 @@ int PacketHandler::player_block_placement(User* user)
           blockcb->onNeighbourPlace(user, newblock, x, y, z - 1, user->pos.map, direction);
         }
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int16_t, int32_t>*>(ServerInstance->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y, z - 1);
+      ServerInstance->plugin()->hook<HOOK_BLOCK_NEIGHBOUR_PLACE>()->doAll(user->nick.c_str(), x, y, z - 1);
     }
   }
   // Now we're sure we're using it, lets remove from inventory!
@@ -1293,7 +1120,7 @@ int PacketHandler::arm_animation(User* user)
   Packet pkt = Protocol::animation(user->UID,animType);
   user->sendOthers(pkt);
 
-  (static_cast<Hook1<bool, const char*>*>(ServerInstance->plugin()->getHook("PlayerArmSwing")))->doAll(user->nick.c_str());
+  ServerInstance->plugin()->hook<HOOK_PLAYER_ARM_SWING>()->doAll(user->nick.c_str());
 
   return PACKET_OK;
 }
@@ -1339,21 +1166,10 @@ int PacketHandler::pickup_spawn(User* user)
 
 int PacketHandler::disconnect(User* user)
 {
-  if (!user->buffer.haveData(2))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   std::string msg;
   user->buffer >> msg;
-
-  if (!user->buffer)
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
-
   user->buffer.removePacket();
-  
+
   LOG(INFO, "Packets", "Disconnect: " + msg);
 
   return PACKET_OK;
@@ -1377,14 +1193,12 @@ int PacketHandler::use_entity(User* user)
   if (!leftClick)
   {
     // right clicks: interaction, attaching, ...
-    for (size_t i = 0; i < ServerInstance->mobs()->getMobCount(); i++)
+    const size_t mobID = ServerInstance->mobs()->getMobByTarget(target);
+    if (mobID != size_t(-1))
     {
-      if (ServerInstance->mobs()->getMobByID(i)->UID == (uint32_t)target)
-      {
-        (static_cast<Hook2<bool, const char* ,int32_t>*>(ServerInstance->plugin()->getHook("interact")))->doAll(user->nick.c_str(), (int32_t)ServerInstance->mobs()->getMobByTarget(target));
-        //make a callback
-        return PACKET_OK;
-      }
+      ServerInstance->plugin()->hook<HOOK_INTERACT>()->doAll(user->nick.c_str(), (int32_t)mobID);
+      //make a callback
+      return PACKET_OK;
     }
 
     // No? Try to attach.
@@ -1442,16 +1256,11 @@ int PacketHandler::use_entity(User* user)
         }
       }
     }
-    for (size_t i = 0; i < ServerInstance->mobs()->getMobCount(); i++)
+    const size_t mobID = ServerInstance->mobs()->getMobByTarget(target);
+    if (mobID != size_t(-1))
     {
-      if (ServerInstance->mobs()->getMobByID(i)->UID == (uint32_t)target)
-      {
-        //int h = ServerInstance->mobs()->getMobByID(i)->health - 1;
-        //ServerInstance->mobs()->getMobByID(i)->sethealth(h);
-        (static_cast<Hook2<bool, const char* ,int32_t>*>(ServerInstance->plugin()->getHook("gotAttacked")))->doAll(user->nick.c_str(),(int32_t)ServerInstance->mobs()->getMobByTarget(target));
-        //make a callback
-        break;
-      }
+      ServerInstance->plugin()->hook<HOOK_GOT_ATTACKED>()->doAll(user->nick.c_str(),(int32_t)mobID);
+      //make a callback
     }
   }
 
@@ -1477,10 +1286,6 @@ int PacketHandler::ping(User* user)
 
 int PacketHandler::respawn(User* user)
 {
-  if (!user->buffer.haveData(10))
-  {
-    return PACKET_NEED_MORE_DATA;
-  }
   int32_t dimension;
   int8_t difficulty,creative;
   int16_t height;
@@ -1536,10 +1341,8 @@ Packet& Packet::operator>>(int16_t& val)
 {
   if (haveData(2))
   {
-    int16_t res;
-    uint8_t* p = reinterpret_cast<uint8_t*>(&res);
-    for (size_t i = 0; i < sizeof(res); ++i) *p++ = m_readBuffer[m_readPos++];
-    val = ntohs(res);
+    val = int16_t(PacketLayout::get16(&m_readBuffer[m_readPos]));
+    m_readPos += 2;
   }
   return *this;
 }
@@ -1555,10 +1358,8 @@ Packet& Packet::operator>>(int32_t& val)
 {
   if (haveData(4))
   {
-    int32_t res;
-    uint8_t* p = reinterpret_cast<uint8_t*>(&res);
-    for (size_t i = 0; i < sizeof(res); ++i) *p++ = m_readBuffer[m_readPos++];
-    val = ntohl(res);
+    val = int32_t(PacketLayout::get32(&m_readBuffer[m_readPos]));
+    m_readPos += 4;
   }
   return *this;
 }
@@ -1574,10 +1375,8 @@ Packet& Packet::operator>>(int64_t& val)
 {
   if (haveData(8))
   {
-    int64_t res;
-    uint8_t* p = reinterpret_cast<uint8_t*>(&res);
-    for (size_t i = 0; i < sizeof(res); ++i) *p++ = m_readBuffer[m_readPos++];
-    val = ntohll(val);
+    val = int64_t(PacketLayout::get64(&m_readBuffer[m_readPos]));
+    m_readPos += 8;
   }
   return *this;
 }
@@ -1595,10 +1394,8 @@ Packet& Packet::operator>>(float& val)
 {
   if (haveData(4))
   {
-    uint32_t res;
-    uint8_t* p = reinterpret_cast<uint8_t*>(&res);
-    for (size_t i = 0; i < sizeof(res); ++i) *p++ = m_readBuffer[m_readPos++];
-    uint32_t ival = ntohl(res);
+    uint32_t ival = PacketLayout::get32(&m_readBuffer[m_readPos]);
+    m_readPos += 4;
     memcpy(&val, &ival, 4);
   }
   return *this;
@@ -1617,10 +1414,8 @@ Packet& Packet::operator>>(double& val)
 {
   if (haveData(8))
   {
-    uint64_t res;
-    uint8_t* p = reinterpret_cast<uint8_t*>(&res);
-    for (size_t i = 0; i < sizeof(res); ++i) *p++ = m_readBuffer[m_readPos++];
-    uint64_t ival = ntohll(res);
+    uint64_t ival = PacketLayout::get64(&m_readBuffer[m_readPos]);
+    m_readPos += 8;
     memcpy(&val, &ival, 8);
   }
   return *this;
@@ -1653,15 +1448,12 @@ Packet& Packet::operator>>(std::string& str)
 
     if (lenval && haveData(2 * lenval)) // We ASSUME that every character takes 2 bytes. DANGEROUS.
     {
-      unsigned char buf[2];
       t_codepoint ccp;
 
       for (size_t i = 0;  i < lenval; ++i)
       {
-        buf[0] = m_readBuffer[m_readPos++];
-        buf[1] = m_readBuffer[m_readPos++];
-
-        codepointToUTF8(((unsigned int)(buf[0]) << 8) | ((unsigned int)(buf[1])), &ccp);
+        codepointToUTF8(PacketLayout::get16(&m_readBuffer[m_readPos]), &ccp);
+        m_readPos += 2;
         str += std::string(ccp.c);
       }
     }
@@ -1693,11 +1485,7 @@ std::string Packet::readString()
     int16_t lenval = 0;
     *this >> lenval;
 
-    if (lenval && haveData(lenval))
-    {
-      for (size_t i = 0; i < uint16_t(lenval); ++i)
-        str += m_readBuffer[m_readPos++];
-    }
+    str = readBytes(lenval);
   }
 
   return str;
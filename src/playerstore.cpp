@@ -0,0 +1,369 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include "playerstore.h"
+#include "nbt.h"
+#include "tools.h"
+
+PlayerStore::PlayerStore(size_t cacheLimit)
+  : m_cacheLimit(cacheLimit),
+    m_running(false),
+    m_started(false)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_wakeup, NULL);
+}
+
+PlayerStore::~PlayerStore()
+{
+  stop();
+  pthread_cond_destroy(&m_wakeup);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+bool PlayerStore::start()
+{
+  if (m_started)
+  {
+    return true;
+  }
+
+  m_running = true;
+  if (pthread_create(&m_thread, NULL, &PlayerStore::run, this) != 0)
+  {
+    m_running = false;
+    return false;
+  }
+  m_started = true;
+  return true;
+}
+
+void PlayerStore::stop()
+{
+  if (!m_started)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_running = false;
+  pthread_cond_broadcast(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+
+  pthread_join(m_thread, NULL);
+  m_started = false;
+}
+
+void PlayerStore::save(const std::string& file, const PlayerData& data)
+{
+  // No thread, write it here
+  if (!m_started)
+  {
+    const bool ok = write(file, data);
+    pthread_mutex_lock(&m_mutex);
+    m_stats.saves++;
+    ok ? m_stats.written++ : m_stats.failed++;
+    m_cache.erase(file);
+    pthread_mutex_unlock(&m_mutex);
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_stats.saves++;
+  m_cache.erase(file);
+
+  std::map<std::string, Pending>::iterator it = m_pending.find(file);
+  if (it != m_pending.end())
+  {
+    it->second.data = data;
+    it->second.version++;
+    m_stats.coalesced++;
+  }
+  else
+  {
+    Pending& pending = m_pending[file];
+    pending.data    = data;
+    pending.version = 0;
+
+    m_jobs.push_back(Job());
+    m_jobs.back().type = SAVE;
+    m_jobs.back().file = file;
+    pthread_cond_signal(&m_wakeup);
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void PlayerStore::preload(const std::string& file)
+{
+  if (!m_started)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  if (m_pending.find(file) == m_pending.end() && m_cache.find(file) == m_cache.end())
+  {
+    m_jobs.push_back(Job());
+    m_jobs.back().type = PRELOAD;
+    m_jobs.back().file = file;
+    pthread_cond_signal(&m_wakeup);
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+bool PlayerStore::load(const std::string& file, PlayerData& data)
+{
+  pthread_mutex_lock(&m_mutex);
+  std::map<std::string, Pending>::const_iterator pending = m_pending.find(file);
+  if (pending != m_pending.end())
+  {
+    data = pending->second.data;
+    m_stats.hits++;
+    pthread_mutex_unlock(&m_mutex);
+    return data.found;
+  }
+
+  std::map<std::string, PlayerData>::iterator cached = m_cache.find(file);
+  if (cached != m_cache.end())
+  {
+    data = cached->second;
+    m_cache.erase(cached);
+    m_stats.hits++;
+    pthread_mutex_unlock(&m_mutex);
+    return data.found;
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  return LoginPipeline::readPlayerData(file, data);
+}
+
+size_t PlayerStore::pending()
+{
+  pthread_mutex_lock(&m_mutex);
+  const size_t size = m_pending.size();
+  pthread_mutex_unlock(&m_mutex);
+  return size;
+}
+
+PlayerStore::Stats PlayerStore::stats()
+{
+  pthread_mutex_lock(&m_mutex);
+  const Stats stats = m_stats;
+  pthread_mutex_unlock(&m_mutex);
+  return stats;
+}
+
+void* PlayerStore::run(void* arg)
+{
+  static_cast<PlayerStore*>(arg)->work();
+  return NULL;
+}
+
+void PlayerStore::work()
+{
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while (m_running && m_jobs.empty())
+    {
+      pthread_cond_wait(&m_wakeup, &m_mutex);
+    }
+    // Stopping only once the saves are all written
+    if (m_jobs.empty())
+    {
+      break;
+    }
+
+    const Job job = m_jobs.front();
+    m_jobs.pop_front();
+
+    if (job.type == SAVE)
+    {
+      const Pending pending = m_pending[job.file];
+      pthread_mutex_unlock(&m_mutex);
+      const bool ok = write(job.file, pending.data);
+      pthread_mutex_lock(&m_mutex);
+
+      ok ? m_stats.written++ : m_stats.failed++;
+      std::map<std::string, Pending>::iterator it = m_pending.find(job.file);
+      if (it->second.version == pending.version)
+      {
+        m_pending.erase(it);
+      }
+      else
+      {
+        // Saved again while it was being written
+        m_jobs.push_back(job);
+      }
+      continue;
+    }
+
+    // Preloads are not worth it when stopping, or when the data is here already
+    if (!m_running || m_pending.find(job.file) != m_pending.end() || m_cache.find(job.file) != m_cache.end())
+    {
+      continue;
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+    PlayerData data;
+    LoginPipeline::readPlayerData(job.file, data);
+    pthread_mutex_lock(&m_mutex);
+
+    // A save queued meanwhile is newer than what was read
+    if (m_pending.find(job.file) == m_pending.end())
+    {
+      m_cache[job.file] = data;
+      m_cacheOrder.push_back(job.file);
+      m_stats.preloads++;
+      trimCache();
+    }
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+// Drops the oldest preloads beyond the limit, m_mutex must be held
+void PlayerStore::trimCache()
+{
+  while (m_cache.size() > m_cacheLimit && !m_cacheOrder.empty())
+  {
+    m_cache.erase(m_cacheOrder.front());
+    m_cacheOrder.pop_front();
+  }
+  // Names of preloads already taken by load() pile up otherwise
+  if (m_cacheOrder.size() > m_cacheLimit * 2)
+  {
+    std::deque<std::string> order;
+    for (size_t i = 0; i < m_cacheOrder.size(); i++)
+    {
+      if (m_cache.find(m_cacheOrder[i]) != m_cache.end())
+      {
+        order.push_back(m_cacheOrder[i]);
+      }
+    }
+    m_cacheOrder.swap(order);
+  }
+}
+
+static NBT_Value* itemValue(const PlayerStore::PlayerData& data, int slot, int8_t fileSlot)
+{
+  const LoginPipeline::Slot& item = data.inv[slot];
+  if (item.count == 0 || item.type == 0 || item.type == -1)
+  {
+    return NULL;
+  }
+
+  NBT_Value* val = new NBT_Value(NBT_Value::TAG_COMPOUND);
+  val->Insert("Count", new NBT_Value((int8_t)item.count));
+  val->Insert("Slot", new NBT_Value(fileSlot));
+  val->Insert("Damage", new NBT_Value((int16_t)item.health));
+  val->Insert("id", new NBT_Value((int16_t)item.type));
+  return val;
+}
+
+bool PlayerStore::write(const std::string& file, const PlayerData& data)
+{
+  // Try to create the players directory if necessary
+  const std::string::size_type slash = file.find_last_of("/\\");
+  struct stat stFileInfo;
+  if (slash != std::string::npos && stat(file.substr(0, slash).c_str(), &stFileInfo) != 0 &&
+      !makeDirectory(file.substr(0, slash)))
+  {
+    return false;
+  }
+
+  NBT_Value val(NBT_Value::TAG_COMPOUND);
+  val.Insert("OnGround", new NBT_Value((int8_t)1));
+  val.Insert("Air", new NBT_Value((int16_t)300));
+  val.Insert("AttackTime", new NBT_Value((int16_t)0));
+  val.Insert("DeathTime", new NBT_Value((int16_t)0));
+  val.Insert("Fire", new NBT_Value((int16_t) - 20));
+  val.Insert("Health", new NBT_Value((int16_t)data.health));
+  val.Insert("HurtTime", new NBT_Value((int16_t)0));
+  val.Insert("FallDistance", new NBT_Value(54.f));
+
+  NBT_Value* nbtInv = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_COMPOUND);
+  std::vector<NBT_Value*>& items = *nbtInv->GetList();
+
+  // Start with main items
+  for (int slot = 9; slot < 45; slot++)
+  {
+    if (NBT_Value* item = itemValue(data, slot, int8_t(slot - 9)))
+    {
+      items.push_back(item);
+    }
+  }
+  // Crafting slots
+  for (int slot = 1; slot < 6; slot++)
+  {
+    if (NBT_Value* item = itemValue(data, slot, int8_t(79 + slot)))
+    {
+      items.push_back(item);
+    }
+  }
+  // Equipped items last
+  for (int slot = 5; slot < 9; slot++)
+  {
+    if (NBT_Value* item = itemValue(data, slot, int8_t(108 - slot)))
+    {
+      items.push_back(item);
+    }
+  }
+  val.Insert("Inventory", nbtInv);
+
+  NBT_Value* nbtPos = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_DOUBLE);
+  nbtPos->GetList()->push_back(new NBT_Value((double)data.x));
+  nbtPos->GetList()->push_back(new NBT_Value((double)data.y));
+  nbtPos->GetList()->push_back(new NBT_Value((double)data.z));
+  val.Insert("Pos", nbtPos);
+
+  NBT_Value* nbtRot = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_FLOAT);
+  nbtRot->GetList()->push_back(new NBT_Value((float)data.yaw));
+  nbtRot->GetList()->push_back(new NBT_Value((float)data.pitch));
+  val.Insert("Rotation", nbtRot);
+
+  NBT_Value* nbtMotion = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_DOUBLE);
+  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
+  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
+  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
+  val.Insert("Motion", nbtMotion);
+
+  // Written aside and renamed over the old file, which stays whole until then
+  const std::string temp = file + ".tmp";
+  if (!val.SaveToFile(temp))
+  {
+    remove(temp.c_str());
+    return false;
+  }
+#ifdef WIN32
+  remove(file.c_str());
+#endif
+  return rename(temp.c_str(), file.c_str()) == 0;
+}
@@ -73,39 +73,42 @@
 // Create default hooks
 Plugin::Plugin()
 {
-  setHook("Timer200", new Hook0<bool>);
-  setHook("Timer1000", new Hook0<bool>);
-  setHook("Timer10000", new Hook0<bool>);
-  setHook("PlayerLoginPre", new Hook2<bool, const char*, char***>);
-  setHook("PlayerLoginPost", new Hook1<bool, const char*>);
-  setHook("PlayerNickPost", new Hook2<bool, const char*, const char*>);
-  setHook("PlayerKickPost", new Hook2<bool, const char*, const char*>);
-  setHook("PlayerQuitPost", new Hook1<bool, const char*>);
-  setHook("PlayerChatPre", new Hook3<bool, const char*, time_t, const char*>);
-  setHook("PlayerChatPost", new Hook3<bool, const char*, time_t, const char*>);
-  setHook("PlayerArmSwing", new Hook1<bool, const char*>);
-  setHook("PlayerDamagePre", new Hook3<bool, const char*, const char*, int>);
-  setHook("PlayerDamagePost", new Hook3<bool, const char*, const char*, int>);
-  setHook("PlayerDisconnect", new Hook3<bool, const char*, uint32_t, uint16_t>);
-  setHook("PlayerDiggingStarted", new Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t>);
-  setHook("PlayerDigging", new Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t>);
-  setHook("PlayerDiggingStopped", new Hook5<bool, const char*, int32_t, int16_t, int32_t, int8_t>);
-  setHook("PlayerBlockInteract", new Hook4<bool, const char*, int32_t, int16_t, int32_t>);
-  setHook("BlockBreakPre", new Hook4<bool, const char*, int32_t, int16_t, int32_t>);
-  setHook("BlockBreakPost", new Hook4<bool, const char*, int32_t, int16_t, int32_t>);
-  setHook("BlockNeighbourBreak", new Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>);
-  setHook("BlockPlacePre", new Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>);
-  setHook("ItemRightClickPre", new Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>);
-  setHook("BlockPlacePost", new Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int8_t>);
-  setHook("BlockNeighbourPlace", new Hook7<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t>);
-  setHook("BlockReplacePre", new Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>);
-  setHook("BlockReplacePost", new Hook6<bool, const char*, int32_t, int16_t, int32_t, int16_t, int16_t>);
-  setHook("BlockNeighbourReplace", new Hook9<bool, const char*, int32_t, int16_t, int32_t, int32_t, int8_t, int32_t, int16_t, int16_t>);
-  setHook("LogPost", new Hook3<bool, int, const char*, const char*>);
-  setHook("PlayerChatCommand", new Hook4<bool, const char*, const char*, int, const char**>);
-  setHook("PlayerRespawn", new Hook1<bool, const char*>);
-  setHook("gotAttacked", new Hook2<bool, const char*, int32_t>);
-  setHook("interact", new Hook2<bool, const char*, int32_t>);
+  m_hooks.resize(HOOK_BUILTIN_COUNT, NULL);
+
+  setBuiltinHook<HOOK_TIMER200>();
+  setBuiltinHook<HOOK_TIMER1000>();
+  setBuiltinHook<HOOK_TIMER10000>();
+  setBuiltinHook<HOOK_PLAYER_LOGIN_PRE>();
+  setBuiltinHook<HOOK_PLAYER_LOGIN_POST>();
+  setBuiltinHook<HOOK_PLAYER_NICK_POST>();
+  setBuiltinHook<HOOK_PLAYER_KICK_POST>();
+  setBuiltinHook<HOOK_PLAYER_QUIT_POST>();
+  setBuiltinHook<HOOK_PLAYER_CHAT_PRE>();
+  setBuiltinHook<HOOK_PLAYER_CHAT_POST>();
+  setBuiltinHook<HOOK_PLAYER_ARM_SWING>();
+  setBuiltinHook<HOOK_PLAYER_DAMAGE_PRE>();
+  setBuiltinHook<HOOK_PLAYER_DAMAGE_POST>();
+  setBuiltinHook<HOOK_PLAYER_DISCONNECT>();
+  setBuiltinHook<HOOK_PLAYER_DIGGING_STARTED>();
+  setBuiltinHook<HOOK_PLAYER_DIGGING>();
+  setBuiltinHook<HOOK_PLAYER_DIGGING_STOPPED>();
+  setBuiltinHook<HOOK_PLAYER_BLOCK_INTERACT>();
+  setBuiltinHook<HOOK_BLOCK_BREAK_PRE>();
+  setBuiltinHook<HOOK_BLOCK_BREAK_POST>();
+  setBuiltinHook<HOOK_BLOCK_NEIGHBOUR_BREAK>();
+  setBuiltinHook<HOOK_BLOCK_PLACE_PRE>();
+  setBuiltinHook<HOOK_ITEM_RIGHT_CLICK_PRE>();
+  setBuiltinHook<HOOK_BLOCK_PLACE_POST>();
+  setBuiltinHook<HOOK_BLOCK_NEIGHBOUR_PLACE>();
+  setBuiltinHook<HOOK_BLOCK_REPLACE_PRE>();
+  setBuiltinHook<HOOK_BLOCK_REPLACE_POST>();
+  setBuiltinHook<HOOK_BLOCK_NEIGHBOUR_REPLACE>();
+  setBuiltinHook<HOOK_LOG_POST>();
+  setBuiltinHook<HOOK_PLAYER_CHAT_COMMAND>();
+  setBuiltinHook<HOOK_PLAYER_RESPAWN>();
+  setBuiltinHook<HOOK_GOT_ATTACKED>();
+  setBuiltinHook<HOOK_INTERACT>();
+  setBuiltinHook<HOOK_MOB_TICK>();
 
   init();
 }
@@ -113,12 +116,26 @@ Plugin::Plugin()
 // Remove existing hooks
 Plugin::~Plugin()
 {
-  for (HookMap::iterator it = m_hooks.begin(); it != m_hooks.end(); ++it)
+  for (size_t i = 0; i < m_hooks.size(); i++)
   {
-    delete it->second;
+    delete m_hooks[i];
   }
 
   m_hooks.clear();
+  m_hookIDs.clear();
+}
+
+int Plugin::setHook(const std::string& name, Hook* hook)
+{
+  int id = getHookID(name);
+  if (id == -1)
+  {
+    id = int(m_hooks.size());
+    m_hooks.push_back(NULL);
+    m_hookIDs[name] = id;
+  }
+  m_hooks[id] = hook;
+  return id;
 }
 
 void Plugin::init()
@@ -36,6 +36,8 @@
 #include "config.h"
 #include "map.h"
 #include "mob.h"
+#include "pregen.h"
+#include "taskqueue.h"
 #include "random.h"
 #include "blocks/default.h"
 #include "blocks/falling.h"
@@ -58,13 +60,21 @@ mineserver_pointer_struct plugin_api_pointers;
 // HELPER FUNCTIONS
 User* userFromName(std::string user)
 {
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
+  User* found = ServerInstance->userByNick(user);
+  if (found != NULL && found->fd && found->logged && user == found->nick)
   {
-    // Don't send to his user if he is DND and the message is a chat message
-    if (((*it)->fd && (*it)->logged && user == (*it)->nick))
-    {
-      return *it;
-    }
+    return found;
+  }
+  return NULL;
+}
+
+// Plugins may cache the handle of a user, it is the entity ID and never reused
+User* userFromHandle(int handle)
+{
+  User* found = ServerInstance->userByUID((uint32_t)handle);
+  if (found != NULL && found->fd && found->logged)
+  {
+    return found;
   }
   return NULL;
 }
@@ -179,6 +189,26 @@ void hook_doAll(const char* hookID, ...)
   va_end(argList);
 }
 
+int plugin_getHookID(const char* hookID)
+{
+  return ServerInstance->plugin()->getHookID(hookID);
+}
+
+Hook* plugin_getHookByID(int id)
+{
+  return ServerInstance->plugin()->getHook(id);
+}
+
+int plugin_addTask(const char* name, bool (*step)(void* data), void (*done)(void* data, bool cancelled), void* data)
+{
+  return ServerInstance->tasks()->add(std::string(name), step, done, data);
+}
+
+bool plugin_cancelTask(int id)
+{
+  return ServerInstance->tasks()->cancel(id);
+}
+
 // LOGGER WRAPPER FUNCTIONS
 void logger_log(int type, const char* source, const char* message)
 {
@@ -196,14 +226,13 @@ bool chat_sendmsgTo(const char* user, const char* msg)
     return true;
   }
 
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
+  User* userPtr = userFromName(userStr);
+  if (userPtr != NULL)
   {
-    // Don't send to his user if he is DND and the message is a chat message
-    if ((*it)->fd && (*it)->logged && userStr == (*it)->nick)
-    {
-      (*it)->buffer << (int8_t)PACKET_CHAT_MESSAGE << std::string(msg);
-      return true;
-    }
+    Packet pkt;
+    pkt << (int8_t)PACKET_CHAT_MESSAGE << std::string(msg);
+    userPtr->send(pkt);
+    return true;
   }
 
   return false;
@@ -211,14 +240,15 @@ bool chat_sendmsgTo(const char* user, const char* msg)
 
 bool chat_sendmsg(const char* msg)
 {
-  const std::string msgStr(msg);
+  Packet pkt;
+  pkt << (int8_t)PACKET_CHAT_MESSAGE << std::string(msg);
 
   for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
   {
     // Don't send to his user if he is DND and the message is a chat message
     if ((*it)->fd && (*it)->logged && !(*it)->dnd)
     {
-      (*it)->buffer << (int8_t)PACKET_CHAT_MESSAGE << msgStr;
+      (*it)->send(pkt);
     }
   }
 
@@ -336,6 +366,81 @@ void map_saveWholeMap(void)
   ServerInstance->saveAll();
 }
 
+bool map_pregen(int w, int x1, int z1, int x2, int z2)
+{
+  return w >= 0 && ServerInstance->pregen()->start(w, x1, z1, x2, z2);
+}
+
+bool map_pregenRadius(int w, int radius)
+{
+  return w >= 0 && ServerInstance->pregen()->startRadius(w, radius);
+}
+
+bool map_pregenStop(int w)
+{
+  return w >= 0 && ServerInstance->pregen()->stop(w);
+}
+
+bool map_pregenStatus(int w, int* done, int* total, double* chunksPerSec, int* etaSeconds)
+{
+  return w >= 0 && ServerInstance->pregen()->status(w, done, total, chunksPerSec, etaSeconds);
+}
+
+int map_fill(int w, int x1, int y1, int z1, int x2, int y2, int z2, int from, int type, int meta)
+{
+  return ServerInstance->map(w)->fill(x1, y1, z1, x2, y2, z2, from, type, meta);
+}
+
+int map_fillChunk(int w, int cx, int cz, int x1, int y1, int z1, int x2, int y2, int z2, int from, int type, int meta)
+{
+  return ServerInstance->map(w)->fillChunk(cx, cz, x1, y1, z1, x2, y2, z2, from, type, meta);
+}
+
+int map_getBlocks(int w, int x1, int y1, int z1, int x2, int y2, int z2, unsigned char* types, unsigned char* metas)
+{
+  return ServerInstance->map(w)->getBlocks(x1, y1, z1, x2, y2, z2, types, metas);
+}
+
+int map_setBlocks(int w, int x1, int y1, int z1, int x2, int y2, int z2, const unsigned char* types, const unsigned char* metas)
+{
+  return ServerInstance->map(w)->setBlocks(x1, y1, z1, x2, y2, z2, types, metas);
+}
+
+int map_getTopBlock(int w, int x, int z, unsigned char* type, unsigned char* meta)
+{
+  return ServerInstance->map(w)->getTopBlock(x, z, type, meta);
+}
+
+bool map_getSectionView(int w, int cx, int cy, int cz, map_section_view* view)
+{
+  Map* map = ServerInstance->map(w);
+  sChunk* chunk = map->getChunk(cx, cz);
+  if (chunk == NULL || cy < 0 || cy > 15)
+  {
+    return false;
+  }
+
+  const int offset = cy << 12;
+  view->blocks     = chunk->blocks + offset;
+  view->data       = chunk->data + (offset >> 1);
+  view->blocklight = chunk->blocklight + (offset >> 1);
+  view->skylight   = chunk->skylight + (offset >> 1);
+  view->version    = map->sectionVersion(chunk, cy);
+  view->present    = (chunk->chunks_present & (1 << cy)) != 0;
+  return true;
+}
+
+unsigned int map_getSectionVersion(int w, int cx, int cy, int cz)
+{
+  Map* map = ServerInstance->map(w);
+  sChunk* chunk = map->getChunk(cx, cz);
+  if (chunk == NULL || cy < 0 || cy > 15)
+  {
+    return 0;
+  }
+  return map->sectionVersion(chunk, cy);
+}
+
 unsigned char* map_getMapData_block(int x, int z)
 {
   sChunk* chunk = ServerInstance->map(0)->getMapData(x, z);
@@ -376,66 +481,60 @@ unsigned char* map_getMapData_blocklight(int x, int z)
 // USER WRAPPER FUNCTIONS
 bool user_toggleDND(const char* user)
 {
-  const std::string username(user);
-
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
+  User* tempUser = userFromName(std::string(user));
+  if (tempUser != NULL)
   {
-    if ((*it)->fd && (*it)->logged && username == (*it)->nick)
-    {
-      (*it)->toggleDND();
-      return true;
-    }
+    tempUser->toggleDND();
+    return true;
   }
 
   return false;
 }
 
-bool user_getPosition(const char* user, double* x, double* y, double* z, float* yaw, float* pitch, double* stance)
+static bool getUserPosition(const User* tempUser, double* x, double* y, double* z, int* w, float* yaw, float* pitch, double* stance)
 {
-  const std::string userStr(user);
-
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
+  if (tempUser == NULL)
   {
-    //Is this the user?
-    if ((*it)->fd && (*it)->logged && userStr == (*it)->nick)
-    {
-      //For safety, check for NULL pointers!
-      if (x != NULL)  *x = (*it)->pos.x;
-      if (y != NULL)  *y = (*it)->pos.y;
-      if (z != NULL)  *z = (*it)->pos.z;
-      if (yaw != NULL)    *yaw    = (*it)->pos.yaw;
-      if (pitch != NULL)  *pitch  = (*it)->pos.pitch;
-      if (stance != NULL) *stance = (*it)->pos.stance;
-
-      return true;
-    }
+    return false;
   }
 
-  return false;
+  //For safety, check for NULL pointers!
+  if (x != NULL)      *x = tempUser->pos.x;
+  if (y != NULL)      *y = tempUser->pos.y;
+  if (z != NULL)      *z = tempUser->pos.z;
+  if (yaw != NULL)    *yaw = tempUser->pos.yaw;
+  if (pitch != NULL)  *pitch = tempUser->pos.pitch;
+  if (stance != NULL) *stance = tempUser->pos.stance;
+  if (w != NULL)      *w = tempUser->pos.map;
+
+  return true;
+}
+
+bool user_getPosition(const char* user, double* x, double* y, double* z, float* yaw, float* pitch, double* stance)
+{
+  return getUserPosition(userFromName(std::string(user)), x, y, z, NULL, yaw, pitch, stance);
 }
 
 bool user_getPositionW(const char* user, double* x, double* y, double* z, int* w, float* yaw, float* pitch, double* stance)
 {
-  const std::string userStr(user);
+  return getUserPosition(userFromName(std::string(user)), x, y, z, w, yaw, pitch, stance);
+}
 
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
-  {
-    //Is this the user?
-    if ((*it)->fd && (*it)->logged && userStr == (*it)->nick)
-    {
-      //For safety, check for NULL pointers!
-      if (x != NULL)      *x = (*it)->pos.x;
-      if (y != NULL)      *y = (*it)->pos.y;
-      if (z != NULL)      *z = (*it)->pos.z;
-      if (yaw != NULL)    *yaw = (*it)->pos.yaw;
-      if (pitch != NULL)  *pitch = (*it)->pos.pitch;
-      if (stance != NULL) *stance = (*it)->pos.stance;
-      if (w != NULL)      *w = (*it)->pos.map;
-
-      return true;
-    }
-  }
-  return false;
+int user_getHandle(const char* user)
+{
+  User* tempUser = userFromName(std::string(user));
+  return tempUser == NULL ? -1 : (int)tempUser->UID;
+}
+
+const char* user_getNickByHandle(int handle)
+{
+  User* tempUser = userFromHandle(handle);
+  return tempUser == NULL ? NULL : tempUser->nick.c_str();
+}
+
+bool user_getPositionWByHandle(int handle, double* x, double* y, double* z, int* w, float* yaw, float* pitch, double* stance)
+{
+  return getUserPosition(userFromHandle(handle), x, y, z, w, yaw, pitch, stance);
 }
 
 bool user_teleport(const char* user, double x, double y, double z)
@@ -492,9 +591,8 @@ int user_getCount()
 
 const char* user_getUserNumbered(int c)
 {
-  std::set<User*>::const_iterator it = ServerInstance->users().begin();
-  std::advance(it, c);
-  return (*it)->nick.c_str();
+  User* tempUser = ServerInstance->userNumbered(c);
+  return tempUser == NULL ? NULL : tempUser->nick.c_str();
 }
 
 bool user_getItemInHand(const char* user, int* type, int* meta, int* quant)
@@ -721,6 +819,27 @@ bool user_setItemAt(const char* user, int slotn, int type, int meta, int quant)
   return true;
 }
 
+bool user_setViewDistance(const char* user, int distance)
+{
+  User* tempuser = userFromName(std::string(user));
+  if (tempuser == NULL)
+  {
+    return false;
+  }
+  tempuser->setViewDistance(distance);
+  return true;
+}
+
+int user_getViewDistance(const char* user)
+{
+  User* tempuser = userFromName(std::string(user));
+  if (tempuser == NULL)
+  {
+    return 0;
+  }
+  return tempuser->viewDistance;
+}
+
 // CONFIG WRAPPER FUNCTIONS
 bool config_has(const char* name)
 {
@@ -761,7 +880,7 @@ int mob_createMob(int type)
 {
   MobPtr m = ServerInstance->mobs()->createMob();
   m->type = type;
-  return ServerInstance->mobs()->getAll().size() - 1;
+  return (int)ServerInstance->mobs()->getMobByTarget(m->UID);
 }
 
 int mob_createSpawnMob(int type)
@@ -770,72 +889,116 @@ int mob_createSpawnMob(int type)
   m->type = type;
   m->spawnToAll();
   m->teleportToAll();
-  return ServerInstance->mobs()->getAll().size() - 1;
+  return (int)ServerInstance->mobs()->getMobByTarget(m->UID);
 }
 
-void mob_spawnMob(int uid)
+bool mob_spawnMob(int uid)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
+  if (!m)
+  {
+    return false;
+  }
   m->spawnToAll();
+  return true;
 }
 
-void mob_despawnMob(int uid)
+bool mob_despawnMob(int uid)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
+  if (!m)
+  {
+    return false;
+  }
   m->deSpawnToAll();
+  return true;
 }
 
-void mob_moveMob(int uid, double x, double y, double z)
+bool mob_moveMob(int uid, double x, double y, double z)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
+  if (!m)
+  {
+    return false;
+  }
   m->moveTo(x, y, z, -1);
+  return true;
 }
 
-void mob_moveMobW(int uid, double x, double y, double z, int map)
+bool mob_moveMobW(int uid, double x, double y, double z, int map)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
+  if (!m)
+  {
+    return false;
+  }
   m->moveTo(x, y, z, map);
+  return true;
 }
 
+// Entity ID of the mob, -1 if there is no such mob
 int mob_getMobID(int uid)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
-  return m->UID;
+  return m ? int(m->UID) : -1;
 }
 
+// 0 if there is no such mob
 int mob_getHealth(int uid)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
-  return m->health;
+  return m ? m->health : 0;
 }
 
-void mob_setHealth(int uid, int mobHealth)
+bool mob_setHealth(int uid, int mobHealth)
 {
-  ServerInstance->mobs()->getMobByID(uid)->sethealth(mobHealth);
+  MobPtr m = ServerInstance->mobs()->getMobByID(uid);
+  if (!m)
+  {
+    return false;
+  }
+  m->sethealth(mobHealth);
+  return true;
 }
 
-void mob_moveAnimal(const char*, size_t mobID)
+bool mob_moveAnimal(const char*, size_t mobID)
 {
-  MobPtr m = ServerInstance->mobs()->getMobByID((int)mobID);
+  MobPtr m = ServerInstance->mobs()->getMobByID(mobID);
+  if (!m)
+  {
+    return false;
+  }
   m->moveAnimal();
+  return true;
 }
 
-void mob_animateMob(const char*, size_t mobID, int animID) 
+bool mob_animateMob(const char*, size_t mobID, int animID) 
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(mobID);
+  if (!m)
+  {
+    return false;
+  }
   m->animateMob(animID);
+  return true;
 }
 
-void mob_animateDamage(const char*, size_t mobID, int animID) 
+bool mob_animateDamage(const char*, size_t mobID, int animID) 
 {
- MobPtr m = ServerInstance->mobs()->getMobByID(mobID);
- m->animateDamage(animID);
+  MobPtr m = ServerInstance->mobs()->getMobByID(mobID);
+  if (!m)
+  {
+    return false;
+  }
+  m->animateDamage(animID);
+  return true;
 }
 
+// -1 if there is no such mob
 int mob_getType(size_t uid)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
-  return m->type;
+  return m ? m->type : -1;
 }
 
 bool mob_getLook(int uid, double* rot, double* pitch, double* head_yaw)
@@ -918,13 +1081,37 @@ bool mob_updateMetadata(int uid)
 int8_t mob_getByteMetadata(int uid, int idx)
 {
   MobPtr m = ServerInstance->mobs()->getMobByID(uid);
-  if (!m) return false;
+  if (!m) return 0;
   MetaDataElemPtr x = m->metadata.get(idx);
   MetaDataElemByte* data = dynamic_cast<MetaDataElemByte*>(x.get());
   if (!data) return 0;
   return data->val;
 }
 
+void mob_removeMob(int uid)
+{
+  ServerInstance->mobs()->removeMob(uid);
+}
+
+int mob_getMobByEID(int eid)
+{
+  return (int)ServerInstance->mobs()->getMobByTarget(eid);
+}
+
+bool mob_getNearestPlayer(int map, double x, double y, double z, double maxDistance, const char** nick, double* distance)
+{
+  User* user = ServerInstance->mobs()->getNearestUser(map, x, y, z, maxDistance, distance);
+  if (user == NULL)
+  {
+    return false;
+  }
+  if (nick != NULL)
+  {
+    *nick = user->nick.c_str();
+  }
+  return true;
+}
+
 bool permission_setAdmin(const char* name)
 {
   User* tempuser = userFromName(std::string(name));
@@ -1054,6 +1241,10 @@ void init_plugin_api(void)
   plugin_api_pointers.plugin.doUntilTrue           = &hook_doUntilTrue;
   plugin_api_pointers.plugin.doUntilFalse          = &hook_doUntilFalse;
   plugin_api_pointers.plugin.doAll                 = &hook_doAll;
+  plugin_api_pointers.plugin.getHookID             = &plugin_getHookID;
+  plugin_api_pointers.plugin.getHookByID           = &plugin_getHookByID;
+  plugin_api_pointers.plugin.addTask               = &plugin_addTask;
+  plugin_api_pointers.plugin.cancelTask            = &plugin_cancelTask;
 
   plugin_api_pointers.map.setTime                  = &map_setTime;
   plugin_api_pointers.map.getTime                  = &map_getTime;
@@ -1069,6 +1260,17 @@ void init_plugin_api(void)
   plugin_api_pointers.map.getMapData_blocklight    = &map_getMapData_blocklight;
   plugin_api_pointers.map.setBlockW                = &map_setBlockW;
   plugin_api_pointers.map.getBlockW                = &map_getBlockW;
+  plugin_api_pointers.map.pregen                   = &map_pregen;
+  plugin_api_pointers.map.pregenRadius             = &map_pregenRadius;
+  plugin_api_pointers.map.pregenStop               = &map_pregenStop;
+  plugin_api_pointers.map.pregenStatus             = &map_pregenStatus;
+  plugin_api_pointers.map.fill                     = &map_fill;
+  plugin_api_pointers.map.fillChunk                = &map_fillChunk;
+  plugin_api_pointers.map.getBlocks                = &map_getBlocks;
+  plugin_api_pointers.map.setBlocks                = &map_setBlocks;
+  plugin_api_pointers.map.getTopBlock              = &map_getTopBlock;
+  plugin_api_pointers.map.getSectionView           = &map_getSectionView;
+  plugin_api_pointers.map.getSectionVersion        = &map_getSectionVersion;
 
   plugin_api_pointers.user.getPosition             = &user_getPosition;
   plugin_api_pointers.user.teleport                = &user_teleport;
@@ -1087,6 +1289,11 @@ void init_plugin_api(void)
   plugin_api_pointers.user.kick                    = &user_kick;
   plugin_api_pointers.user.getItemAt               = &user_getItemAt;
   plugin_api_pointers.user.setItemAt               = &user_setItemAt;
+  plugin_api_pointers.user.setViewDistance         = &user_setViewDistance;
+  plugin_api_pointers.user.getViewDistance         = &user_getViewDistance;
+  plugin_api_pointers.user.getHandle               = &user_getHandle;
+  plugin_api_pointers.user.getNickByHandle         = &user_getNickByHandle;
+  plugin_api_pointers.user.getPositionWByHandle    = &user_getPositionWByHandle;
 
   plugin_api_pointers.config.has                   = &config_has;
   plugin_api_pointers.config.iData                 = &config_iData;
@@ -1115,6 +1322,9 @@ void init_plugin_api(void)
   plugin_api_pointers.mob.setByteMetadata          = &mob_setByteMetadata;
   plugin_api_pointers.mob.updateMetadata           = &mob_updateMetadata;
   plugin_api_pointers.mob.getByteMetadata          = &mob_getByteMetadata;
+  plugin_api_pointers.mob.removeMob                = &mob_removeMob;
+  plugin_api_pointers.mob.getMobByEID              = &mob_getMobByEID;
+  plugin_api_pointers.mob.getNearestPlayer         = &mob_getNearestPlayer;
 
   plugin_api_pointers.permissions.setAdmin         = &permission_setAdmin;
   plugin_api_pointers.permissions.setOp            = &permission_setOp;
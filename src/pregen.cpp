@@ -0,0 +1,280 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "pregen.h"
+
+#include "mineserver.h"
+#include "config.h"
+#include "logger.h"
+#include "map.h"
+#include "tools.h"
+
+// Length of a main loop tick, see Mineserver::run()
+#define PREGEN_TICK_USEC 200000
+
+static std::string formatSeconds(int seconds)
+{
+  if (seconds < 0)
+  {
+    return "unknown";
+  }
+
+  char buf[32];
+  sprintf(buf, "%dh%02dm%02ds", seconds / 3600, seconds / 60 % 60, seconds % 60);
+  return buf;
+}
+
+Pregen::Pregen()
+  : m_share(25)
+{
+  if (ServerInstance->config()->has("map.pregen.share"))
+  {
+    m_share = std::max(1, std::min(100, ServerInstance->config()->iData("map.pregen.share")));
+  }
+}
+
+Pregen::Job* Pregen::find(size_t map)
+{
+  for (size_t i = 0; i < m_jobs.size(); i++)
+  {
+    if (m_jobs[i].map == map)
+    {
+      return &m_jobs[i];
+    }
+  }
+  return NULL;
+}
+
+const Pregen::Job* Pregen::find(size_t map) const
+{
+  return const_cast<Pregen*>(this)->find(map);
+}
+
+std::string Pregen::progressFile(size_t map) const
+{
+  return ServerInstance->map(map)->mapDirectory + "/pregen.txt";
+}
+
+bool Pregen::start(size_t map, int x1, int z1, int x2, int z2)
+{
+  if (map >= ServerInstance->mapCount())
+  {
+    return false;
+  }
+
+  stop(map);
+
+  Job job;
+  job.map         = map;
+  job.x1          = std::min(x1, x2);
+  job.z1          = std::min(z1, z2);
+  job.x2          = std::max(x1, x2);
+  job.z2          = std::max(z1, z2);
+  job.done        = 0;
+  job.doneAtStart = 0;
+  job.started     = 0;
+  job.lastReport  = 0;
+  m_jobs.push_back(job);
+  saveProgress(job);
+
+  LOG2(INFO, "Pregenerating " + dtos(job.total()) + " chunks of map " + dtos(map));
+  return true;
+}
+
+bool Pregen::startRadius(size_t map, int radius)
+{
+  if (map >= ServerInstance->mapCount() || radius < 0)
+  {
+    return false;
+  }
+
+  const vec& spawn = ServerInstance->map(map)->spawnPos;
+  const int x = blockToChunk(spawn.x());
+  const int z = blockToChunk(spawn.z());
+  return start(map, x - radius, z - radius, x + radius, z + radius);
+}
+
+bool Pregen::stop(size_t map)
+{
+  for (std::vector<Job>::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it)
+  {
+    if (it->map == map)
+    {
+      LOG2(INFO, "Stopped pregenerating map " + dtos(map) + " at " + dtos(it->done) + "/" + dtos(it->total()) + " chunks");
+      m_jobs.erase(it);
+      std::remove(progressFile(map).c_str());
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Pregen::status(size_t map, int* done, int* total, double* chunksPerSec, int* etaSeconds) const
+{
+  const Job* job = find(map);
+  if (job == NULL)
+  {
+    return false;
+  }
+
+  // Jobs queued behind another one have no rate yet
+  const double seconds = job->started != 0 ? (microTime() - job->started) / 1000000.0 : 0.0;
+  const double rate = seconds > 0.0 ? (job->done - job->doneAtStart) / seconds : 0.0;
+
+  if (done != NULL)         *done = job->done;
+  if (total != NULL)        *total = job->total();
+  if (chunksPerSec != NULL) *chunksPerSec = rate;
+  if (etaSeconds != NULL)   *etaSeconds = rate > 0.0 ? int((job->total() - job->done) / rate) : -1;
+
+  return true;
+}
+
+void Pregen::resume()
+{
+  for (size_t map = 0; map < ServerInstance->mapCount(); map++)
+  {
+    std::ifstream file(progressFile(map).c_str());
+
+    Job job;
+    if (!(file >> job.x1 >> job.z1 >> job.x2 >> job.z2 >> job.done) || job.done < 0 || job.done >= job.total())
+    {
+      continue;
+    }
+
+    job.map         = map;
+    job.doneAtStart = job.done;
+    job.started     = 0;
+    job.lastReport  = 0;
+    m_jobs.push_back(job);
+
+    LOG2(INFO, "Resuming pregeneration of map " + dtos(map) + " at " + dtos(job.done) + "/" + dtos(job.total()) + " chunks");
+  }
+}
+
+void Pregen::saveProgress(const Job& job) const
+{
+  std::ofstream file(progressFile(job.map).c_str(), std::ios_base::trunc);
+  file << job.x1 << " " << job.z1 << " " << job.x2 << " " << job.z2 << " " << job.done << std::endl;
+}
+
+void Pregen::releaseColumn(const Job& job, int x) const
+{
+  Map* map = ServerInstance->map(job.map);
+
+  // The column and the ring of terrain only chunks around the rectangle
+  for (int z = job.z1 - 1; z <= job.z2 + 1; z++)
+  {
+    sChunk* chunk = map->getChunk(x, z);
+    if (chunk != NULL && chunk->users.empty())
+    {
+      map->releaseMap(x, z);
+    }
+  }
+}
+
+void Pregen::report(const Job& job) const
+{
+  int done, total, eta;
+  double rate;
+  status(job.map, &done, &total, &rate, &eta);
+
+  LOG2(INFO, "Pregen map " + dtos(job.map) + ": " + dtos(done) + "/" + dtos(total) + " chunks, "
+       + dtos(int(rate * 10) / 10.0) + " chunks/s, ETA " + formatSeconds(eta));
+}
+
+void Pregen::update()
+{
+  if (m_jobs.empty())
+  {
+    return;
+  }
+
+  const uint64_t start = microTime();
+  const uint64_t budget = uint64_t(PREGEN_TICK_USEC) * m_share / 100;
+
+  // One job at a time, in the order they were started
+  do
+  {
+    Job& job = m_jobs.front();
+    if (job.started == 0)
+    {
+      job.started     = start;
+      job.doneAtStart = job.done;
+      job.lastReport  = time(NULL);
+    }
+
+    Map* map = ServerInstance->map(job.map);
+    const int depth = job.z2 - job.z1 + 1;
+    const int x = job.x1 + job.done / depth;
+    const int z = job.z1 + job.done % depth;
+
+    // Chunks already populated on disk are left as they are
+    sChunk* chunk = map->loadProtoMap(x, z);
+    if (chunk != NULL && !chunk->populated)
+    {
+      chunk = map->loadMap(x, z);
+      if (chunk != NULL && chunk->populated)
+      {
+        // Saved on release even with map.save_unchanged_chunks off
+        chunk->changed = true;
+      }
+    }
+    job.done++;
+
+    if (job.done % depth != 0)
+    {
+      continue;
+    }
+
+    // Column x is finished, x - 1 is nobody's neighbour anymore
+    releaseColumn(job, x - 1);
+
+    if (job.done < job.total())
+    {
+      saveProgress(job);
+      continue;
+    }
+
+    releaseColumn(job, x);
+    releaseColumn(job, x + 1);
+    report(job);
+    LOG2(INFO, "Pregeneration of map " + dtos(job.map) + " done");
+    std::remove(progressFile(job.map).c_str());
+    m_jobs.erase(m_jobs.begin());
+  }
+  while (!m_jobs.empty() && microTime() - start < budget);
+
+  if (!m_jobs.empty() && time(NULL) - m_jobs.front().lastReport >= 10)
+  {
+    report(m_jobs.front());
+    m_jobs.front().lastReport = time(NULL);
+  }
+}
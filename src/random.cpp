@@ -86,3 +86,12 @@ double uniform01()
 {
   return double(m_uniformUINT(prng)) / double(std::numeric_limits<MyUniform::result_type>::max());
 }
+
+ChunkRNG::ChunkRNG(int64_t seed, int32_t chunkX, int32_t chunkZ, uint32_t feature)
+  : m_counter(0)
+{
+  m_key = mix(uint64_t(seed));
+  m_key = mix(m_key ^ uint32_t(chunkX));
+  m_key = mix(m_key ^ (uint64_t(uint32_t(chunkZ)) << 32));
+  m_key = mix(m_key ^ feature);
+}
@@ -0,0 +1,596 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "sessionvalidator.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Responses bigger than this are not from a session server
+static const size_t MAX_RESPONSE = 16384;
+
+static void closeSocket(int fd)
+{
+#ifdef WIN32
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+static void setBlocking(int fd, bool blocking)
+{
+#ifdef WIN32
+  u_long mode = blocking ? 0 : 1;
+  ioctlsocket(fd, FIONBIO, &mode);
+#else
+  int flags = fcntl(fd, F_GETFL);
+  flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+  fcntl(fd, F_SETFL, flags);
+#endif
+}
+
+// Waits until fd can be read (or written), false on timeout
+static bool waitFor(int fd, bool write, uint64_t timeoutMs)
+{
+#ifdef WIN32
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(fd, &set);
+  timeval tv;
+  tv.tv_sec  = long(timeoutMs / 1000);
+  tv.tv_usec = long(timeoutMs % 1000) * 1000;
+  return select(fd + 1, write ? NULL : &set, write ? &set : NULL, NULL, &tv) > 0;
+#else
+  // poll() rather than select(), the server easily has more than FD_SETSIZE sockets open
+  pollfd p;
+  p.fd      = fd;
+  p.events  = write ? POLLOUT : POLLIN;
+  p.revents = 0;
+  return poll(&p, 1, int(timeoutMs)) > 0;
+#endif
+}
+
+// Nicks come from the client, keep them from changing the request
+static std::string urlEncode(const std::string& str)
+{
+  std::string out;
+  for (size_t i = 0; i < str.size(); i++)
+  {
+    const unsigned char c = str[i];
+    if (isalnum(c) || c == '_' || c == '-' || c == '.')
+    {
+      out += char(c);
+    }
+    else
+    {
+      char hex[4];
+      sprintf(hex, "%%%02X", c);
+      out += hex;
+    }
+  }
+  return out;
+}
+
+// Value of a header, name given in lower case
+static std::string header(const std::string& headers, const std::string& name)
+{
+  std::string lower(headers);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+  const size_t pos = lower.find("\r\n" + name + ":");
+  if (pos == std::string::npos)
+  {
+    return "";
+  }
+  size_t start = pos + name.size() + 3;
+  const size_t end = lower.find("\r\n", start);
+  while (start < end && lower[start] == ' ')
+  {
+    start++;
+  }
+  return lower.substr(start, end - start);
+}
+
+SessionValidator::SessionValidator(const std::string& host, int port, int workers, size_t queueLimit,
+                                   uint32_t timeoutMs, uint32_t cacheSeconds)
+  : m_host(host),
+    m_port(port),
+    m_workerCount(std::max(1, workers)),
+    m_queueLimit(std::max(size_t(1), queueLimit)),
+    m_timeout(timeoutMs),
+    m_cacheTime(cacheSeconds * 1000),
+    m_running(false)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_wakeup, NULL);
+}
+
+SessionValidator::~SessionValidator()
+{
+  stop();
+  pthread_cond_destroy(&m_wakeup);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+bool SessionValidator::start()
+{
+  if (m_running)
+  {
+    return true;
+  }
+
+  m_running = true;
+  for (int i = 0; i < m_workerCount; i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &SessionValidator::run, this) != 0)
+    {
+      break;
+    }
+    m_workers.push_back(thread);
+  }
+
+  if (m_workers.empty())
+  {
+    m_running = false;
+  }
+  return m_running;
+}
+
+void SessionValidator::stop()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_running = false;
+  m_queue.clear();
+  pthread_cond_broadcast(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    pthread_join(m_workers[i], NULL);
+  }
+  m_workers.clear();
+}
+
+bool SessionValidator::submit(uint32_t UID, const std::string& nick, const std::string& serverHash)
+{
+  Request request;
+  request.UID        = UID;
+  request.nick       = nick;
+  request.serverHash = serverHash;
+  request.deadline   = nowMs() + m_timeout;
+
+  pthread_mutex_lock(&m_mutex);
+  m_stats.requests++;
+
+  std::map<std::string, CacheEntry>::iterator cached = m_cache.find(nick + ':' + serverHash);
+  if (cached != m_cache.end() && cached->second.expires > nowMs())
+  {
+    m_stats.cacheHits++;
+    complete(request, cached->second.valid, false);
+    pthread_mutex_unlock(&m_mutex);
+    return true;
+  }
+
+  if (!m_running || m_queue.size() >= m_queueLimit)
+  {
+    m_stats.refused++;
+    pthread_mutex_unlock(&m_mutex);
+    return false;
+  }
+
+  m_queue.push_back(request);
+  pthread_cond_signal(&m_wakeup);
+  pthread_mutex_unlock(&m_mutex);
+  return true;
+}
+
+void SessionValidator::poll(std::vector<Result>& results)
+{
+  pthread_mutex_lock(&m_mutex);
+  results.insert(results.end(), m_done.begin(), m_done.end());
+  m_done.clear();
+
+  // Expired answers go once there are a fair number of them
+  if (m_cache.size() > m_queueLimit)
+  {
+    const uint64_t now = nowMs();
+    std::map<std::string, CacheEntry>::iterator it = m_cache.begin();
+    while (it != m_cache.end())
+    {
+      if (it->second.expires <= now)
+      {
+        m_cache.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+size_t SessionValidator::queued()
+{
+  pthread_mutex_lock(&m_mutex);
+  const size_t size = m_queue.size();
+  pthread_mutex_unlock(&m_mutex);
+  return size;
+}
+
+SessionValidator::Stats SessionValidator::stats()
+{
+  pthread_mutex_lock(&m_mutex);
+  const Stats stats = m_stats;
+  pthread_mutex_unlock(&m_mutex);
+  return stats;
+}
+
+// Called with m_mutex held
+void SessionValidator::complete(const Request& request, bool valid, bool failed)
+{
+  Result result;
+  result.UID    = request.UID;
+  result.nick   = request.nick;
+  result.valid  = valid;
+  result.failed = failed;
+  m_done.push_back(result);
+}
+
+void* SessionValidator::run(void* arg)
+{
+  static_cast<SessionValidator*>(arg)->work();
+  return NULL;
+}
+
+void SessionValidator::work()
+{
+  Connection conn;
+
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while (m_running && m_queue.empty())
+    {
+      pthread_cond_wait(&m_wakeup, &m_mutex);
+    }
+    if (!m_running)
+    {
+      break;
+    }
+
+    const Request request = m_queue.front();
+    m_queue.pop_front();
+    pthread_mutex_unlock(&m_mutex);
+
+    bool valid = false;
+    bool timedOut = false;
+    const bool answered = check(conn, request, valid, timedOut);
+
+    pthread_mutex_lock(&m_mutex);
+    if (!answered)
+    {
+      if (timedOut)
+      {
+        m_stats.timeouts++;
+      }
+      else
+      {
+        m_stats.failures++;
+      }
+    }
+    else if (m_cacheTime)
+    {
+      CacheEntry& entry = m_cache[request.nick + ':' + request.serverHash];
+      entry.valid   = valid;
+      entry.expires = nowMs() + m_cacheTime;
+    }
+    complete(request, valid, !answered);
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  disconnect(conn);
+}
+
+bool SessionValidator::check(Connection& conn, const Request& request, bool& valid, bool& timedOut)
+{
+  // Waited too long in the queue already
+  if (nowMs() >= request.deadline)
+  {
+    timedOut = true;
+    return false;
+  }
+
+  const std::string path = "/game/checkserver.jsp?user=" + urlEncode(request.nick) +
+                           "&serverId=" + urlEncode(request.serverHash);
+  std::string body;
+
+  // The server may have closed a kept-alive connection meanwhile, then a new one gets a go
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    const bool reused = conn.fd != -1;
+    if (get(conn, path, request.deadline, body, timedOut))
+    {
+      // The session server answers "YES" if the user is valid
+      valid = body.compare(0, 3, "YES") == 0;
+      return true;
+    }
+    if (!reused || timedOut)
+    {
+      break;
+    }
+  }
+  return false;
+}
+
+bool SessionValidator::connectTo(Connection& conn, uint64_t deadline, bool& timedOut)
+{
+  char port[16];
+  sprintf(port, "%d", m_port);
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo* info = NULL;
+  if (getaddrinfo(m_host.c_str(), port, &hints, &info) != 0 || info == NULL)
+  {
+    return false;
+  }
+
+  const int fd = int(socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+  if (fd == -1)
+  {
+    freeaddrinfo(info);
+    return false;
+  }
+
+  // Connect without blocking so the timeout holds
+  setBlocking(fd, false);
+  bool connected = connect(fd, info->ai_addr, int(info->ai_addrlen)) == 0;
+  freeaddrinfo(info);
+
+  if (!connected)
+  {
+    const uint64_t now = nowMs();
+    if (now < deadline && waitFor(fd, true, deadline - now))
+    {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) == 0 && error == 0;
+    }
+    else
+    {
+      timedOut = true;
+    }
+  }
+
+  if (!connected)
+  {
+    closeSocket(fd);
+    return false;
+  }
+
+  // Left non-blocking, send() and recv() only run once waitFor() says they won't block
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+  conn.fd = fd;
+  conn.buffer.clear();
+
+  pthread_mutex_lock(&m_mutex);
+  m_stats.connects++;
+  pthread_mutex_unlock(&m_mutex);
+  return true;
+}
+
+// Reads what has arrived, 1 for data, 0 when the server closed, -1 on error or timeout
+int SessionValidator::receive(Connection& conn, uint64_t deadline, bool& timedOut)
+{
+  const uint64_t now = nowMs();
+  if (now >= deadline || !waitFor(conn.fd, false, deadline - now))
+  {
+    timedOut = true;
+    return -1;
+  }
+
+  char buf[4096];
+  const int received = recv(conn.fd, buf, sizeof(buf), 0);
+  if (received <= 0)
+  {
+    return received == 0 ? 0 : -1;
+  }
+  conn.buffer.append(buf, received);
+  return conn.buffer.size() > MAX_RESPONSE ? -1 : 1;
+}
+
+bool SessionValidator::get(Connection& conn, const std::string& path, uint64_t deadline, std::string& body, bool& timedOut)
+{
+  if (conn.fd == -1 && !connectTo(conn, deadline, timedOut))
+  {
+    return false;
+  }
+
+  const std::string request = "GET " + path + " HTTP/1.1\r\n"
+                              "Host: " + m_host + "\r\n"
+                              "Connection: keep-alive\r\n\r\n";
+  size_t sent = 0;
+  while (sent < request.size())
+  {
+    const uint64_t now = nowMs();
+    if (now >= deadline || !waitFor(conn.fd, true, deadline - now))
+    {
+      timedOut = true;
+      disconnect(conn);
+      return false;
+    }
+    const int written = send(conn.fd, request.data() + sent, int(request.size() - sent), MSG_NOSIGNAL);
+    if (written <= 0)
+    {
+      disconnect(conn);
+      return false;
+    }
+    sent += written;
+  }
+
+  // Status line and headers
+  conn.buffer.clear();
+  size_t headerEnd;
+  while ((headerEnd = conn.buffer.find("\r\n\r\n")) == std::string::npos)
+  {
+    if (receive(conn, deadline, timedOut) != 1)
+    {
+      disconnect(conn);
+      return false;
+    }
+  }
+
+  const std::string headers = conn.buffer.substr(0, headerEnd + 2);
+  const int status = headers.size() > 12 ? atoi(headers.c_str() + 9) : 0;
+  const std::string length = header(headers, "content-length");
+  const bool chunked = header(headers, "transfer-encoding").find("chunked") != std::string::npos;
+  bool keepAlive = header(headers, "connection") != "close" && headers.compare(0, 8, "HTTP/1.0") != 0;
+  size_t pos = headerEnd + 4;
+
+  body.clear();
+  if (chunked)
+  {
+    for (;;)
+    {
+      size_t lineEnd;
+      while ((lineEnd = conn.buffer.find("\r\n", pos)) == std::string::npos)
+      {
+        if (receive(conn, deadline, timedOut) != 1)
+        {
+          disconnect(conn);
+          return false;
+        }
+      }
+      const size_t size = strtoul(conn.buffer.c_str() + pos, NULL, 16);
+      pos = lineEnd + 2;
+      // Chunk data and its CRLF, the last chunk is empty and ends the body
+      while (conn.buffer.size() < pos + size + 2)
+      {
+        if (receive(conn, deadline, timedOut) != 1)
+        {
+          disconnect(conn);
+          return false;
+        }
+      }
+      body.append(conn.buffer, pos, size);
+      pos += size + 2;
+      if (size == 0)
+      {
+        break;
+      }
+    }
+  }
+  else if (!length.empty())
+  {
+    const size_t size = strtoul(length.c_str(), NULL, 10);
+    while (conn.buffer.size() < pos + size)
+    {
+      if (receive(conn, deadline, timedOut) != 1)
+      {
+        disconnect(conn);
+        return false;
+      }
+    }
+    body = conn.buffer.substr(pos, size);
+  }
+  else
+  {
+    // No length given, the body runs until the server closes
+    int received;
+    while ((received = receive(conn, deadline, timedOut)) == 1)
+    {
+    }
+    if (received != 0)
+    {
+      disconnect(conn);
+      return false;
+    }
+    body = conn.buffer.substr(pos);
+    keepAlive = false;
+  }
+
+  // An error page may come from a proxy in a bad state, a retry gets a new connection
+  if (!keepAlive || status != 200)
+  {
+    disconnect(conn);
+  }
+  conn.buffer.clear();
+
+  return status == 200;
+}
+
+void SessionValidator::disconnect(Connection& conn)
+{
+  if (conn.fd != -1)
+  {
+    closeSocket(conn.fd);
+    conn.fd = -1;
+  }
+  conn.buffer.clear();
+}
+
+uint64_t SessionValidator::nowMs()
+{
+#ifdef WIN32
+  return GetTickCount();
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+#endif
+}
@@ -39,9 +39,6 @@ typedef int socklen_t;
 #include <sstream>
 #include <algorithm>
 
-#include "tr1.h"
-#include TR1INCLUDE(array)
-
 #include "sockets.h"
 #include "tools.h"
 #include "logger.h"
@@ -52,6 +49,7 @@ typedef int socklen_t;
 #include "nbt.h"
 #include "mineserver.h"
 #include "packets.h"
+#include "packetcapture.h"
 #include "config.h"
 
 
@@ -61,115 +59,111 @@ extern int setnonblock(int fd);
 #define SOCKET_ERROR -1
 #endif
 
-static const size_t BUFSIZE = 2048;
-static std::tr1::array<uint8_t, BUFSIZE> BUF;
-static std::tr1::array<uint8_t, BUFSIZE> BUFCRYPT;
-static char* const cpBUF = reinterpret_cast<char*>(BUF.data());
-static uint8_t* const upBUF = BUF.data();
+//Reads start at READ_CHUNK_MIN bytes and double while they come back full
+static const size_t READ_CHUNK_MIN = 4096;
+static const size_t READ_CHUNK_MAX = 65536;
+//Leave the rest for the next wakeup so one client can't hold up the others
+static const size_t READ_MAX_PER_WAKEUP = 256 * 1024;
 
-static char* cpBUFCRYPT = reinterpret_cast<char*>(BUFCRYPT.data());
+InputStats inputStats;
 
 
 bool client_write(User *user)
 {
-  //If there is data in the output buffer, crypt it before writing
-  if (!user->buffer.getWriteEmpty())
+  //One window at a time for as long as the socket keeps up
+  for (;;)
   {
-    std::vector<char> buf;
-    
-    user->buffer.getWriteData(buf);
-    
-    //More glue - Fador
-    if(user->crypted)
+    //Top the output up from the lanes, only a window ahead of the socket so
+    //whatever is sent next doesn't queue behind all of them
+    if (!user->lanes.empty() && user->output.size() < ServerInstance->m_outputWindow)
+    {
+      user->lanes.take(user->buffer, ServerInstance->m_outputWindow - user->output.size());
+    }
+
+    //Move what the handlers serialized into the output blocks, encrypting on the way
+    if (!user->buffer.getWriteEmpty())
     {
-      //We might have to write some data uncrypted ToDo: fix
-      if(user->uncryptedLeft)
+      const uint8_t* data = user->buffer.writeData();
+      const size_t len = user->buffer.writeSize();
+
+      if(user->crypted)
       {
-        user->bufferCrypted.addToWrite((uint8_t *)buf.data(),user->uncryptedLeft);
+        //The first bytes after switching, the encryption response, still go out in the clear
+        const size_t plain = std::min(len, size_t(user->uncryptedLeft));
+        user->output.append(data, plain);
+        user->output.append(data + plain, len - plain, &user->en);
+        user->uncryptedLeft -= plain;
       }
-      int p_len = buf.size()-user->uncryptedLeft, f_len = 0;
-      if(p_len)
+      else
       {
-        uint8_t *buffer = (uint8_t *)malloc(p_len+1);
-        EVP_EncryptUpdate(&user->en, (uint8_t *)buffer, &p_len, (const uint8_t *)buf.data()+user->uncryptedLeft, buf.size()-user->uncryptedLeft);
-        int written = p_len + f_len;
-        user->bufferCrypted.addToWrite((uint8_t *)buffer,written);
-        free(buffer);
+        user->output.append(data, len);
+        user->uncryptedLeft = 0;
       }
-      user->uncryptedLeft = 0;
+
+      user->buffer.clearWrite();
     }
-    else
+
+    //We have data ready to be written
+    if(!user->output.empty())
     {
-      user->bufferCrypted.addToWrite((uint8_t *)buf.data(),buf.size());
-      user->uncryptedLeft = 0;
-    }
+      const size_t queued = user->output.size();
 
-    //free(outBuf);
-    user->buffer.clearWrite(buf.size());
-  }
+      //Try to write all of it
+      const int written = user->output.flush(user->fd);
 
-  //We have crypted data ready to be written
-  if(!user->bufferCrypted.getWriteEmpty())
-  {
-    std::vector<char> buf;
-    user->bufferCrypted.getWriteData(buf);
+      //Handle errors
+      if (written == SOCKET_ERROR)
+      {
+      #ifdef WIN32
+      #define ERROR_NUMBER WSAGetLastError()
+        if ((ERROR_NUMBER != WSATRY_AGAIN && ERROR_NUMBER != WSAEINTR && ERROR_NUMBER != WSAEWOULDBLOCK))
+      #else
+      #define ERROR_NUMBER errno
+        if ((errno != EAGAIN && errno != EINTR))
+      #endif
+        {
+          LOG2(ERROR, "Error writing to client, tried to write " + dtos(queued) + " bytes, code: " + dtos(ERROR_NUMBER));
+          delete user;
+          return false;
+        }
+      }
 
-    //Try to write the whole buffer
-    const int written = send(user->fd, buf.data(), buf.size(), 0);
+      user->updateCongestion();
 
-    //Handle errors
-    if (written == SOCKET_ERROR)
-    {
-    #ifdef WIN32
-    #define ERROR_NUMBER WSAGetLastError()
-      if ((ERROR_NUMBER != WSATRY_AGAIN && ERROR_NUMBER != WSAEINTR && ERROR_NUMBER != WSAEWOULDBLOCK))
-    #else
-    #define ERROR_NUMBER errno
-      if ((errno != EAGAIN && errno != EINTR))
-    #endif
+      //If we couldn't write everything at once, add EV_WRITE event calling this function again..
+      if (!user->output.empty())
       {
-        LOG2(ERROR, "Error writing to client, tried to write " + dtos(buf.size()) + " bytes, code: " + dtos(ERROR_NUMBER));
-        delete user;
+        event_add(user->GetWriteEvent(), NULL);
         return false;
       }
+
+      //The socket took it all, go on with the lanes
+      if (!user->lanes.empty())
+      {
+        continue;
+      }
     }
-    else
+    else if (user->congested)
     {
-      //Remove written amount from the buffer
-      user->bufferCrypted.clearWrite(written);
-    }
-
-    //If we couldn't write everything at once, add EV_WRITE event calling this function again..
-    if (!user->bufferCrypted.getWriteEmpty())
-    {
-      event_set(user->GetEvent(), user->fd, EV_WRITE | EV_READ, client_callback, user);
-      event_add(user->GetEvent(), NULL);
-      return false;
+      user->updateCongestion();
     }
+    return true;
   }
-  return true;
 }
 
-extern "C" void client_callback(int fd, short ev, void* arg)
+//Drains the socket into the user's read buffer, decrypting in place.
+//Returns false if the user was deleted.
+static bool client_read(User* user)
 {
-  User* user = reinterpret_cast<User*>(arg);
+  size_t total = 0;
+  inputStats.wakeups++;
 
-  if (ev & EV_READ)
+  while (total < READ_MAX_PER_WAKEUP)
   {
-    int read = 1;
-
-    //Data must be decrypted if we are in crypted mode
-    if(user->crypted)
-    {
-      read = recv(fd, cpBUFCRYPT, BUFSIZE, 0);
-      int p_len = read, f_len = 0;  
-      EVP_DecryptUpdate(&user->de, upBUF, &p_len, (const uint8_t *)cpBUFCRYPT, read);
-      read = p_len + f_len;
-    }
-    else
-    {
-      read = recv(fd, cpBUF, BUFSIZE, 0);
-    }
+    const size_t wanted = user->readChunk;
+    uint8_t* const space = user->buffer.reserveRead(wanted);
+    const int read = recv(user->fd, reinterpret_cast<char*>(space), int(wanted), 0);
+    inputStats.reads++;
 
     if (read == 0)
     {
@@ -182,85 +176,138 @@ extern "C" void client_callback(int fd, short ev, void* arg)
         LOG2(INFO, "Socket closed");
       }
       delete user;
-      return;
+      return false;
     }
 
     if (read == SOCKET_ERROR)
     {
+      user->buffer.commitRead(0);
+    #ifdef WIN32
+      if (WSAGetLastError() == WSAEWOULDBLOCK || WSAGetLastError() == WSAEINTR)
+    #else
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    #endif
+      {
+        break;
+      }
       LOG2(INFO, "Socket error");
       delete user;
-      return;
+      return false;
     }
 
-    //Keep track on incoming data, can timeout inactive users
+    //Data must be decrypted if we are in crypted mode, CFB8 works in place
+    if(user->crypted)
+    {
+      int p_len = read;
+      EVP_DecryptUpdate(&user->de, space, &p_len, space, read);
+    }
+    user->buffer.commitRead(read);
+    total += read;
+
+    //A short read means the socket is empty, no need to wait for EAGAIN
+    if (size_t(read) < wanted)
+    {
+      if (size_t(read) < wanted / 4 && wanted > READ_CHUNK_MIN)
+      {
+        user->readChunk = wanted / 2;
+      }
+      break;
+    }
+    if (wanted < READ_CHUNK_MAX)
+    {
+      user->readChunk = wanted * 2;
+    }
+  }
+
+  inputStats.received += total;
+
+  //Keep track on incoming data, can timeout inactive users
+  if (total)
+  {
     user->lastData = std::time(NULL);
+  }
+  return true;
+}
 
-    user->buffer.addToRead(upBUF, read);
-    user->buffer.reset();
+bool client_dispatch(User* user)
+{
+  user->buffer.reset();
 
-    while (user->buffer >> (int8_t&)user->action)
-    {  
-      //Variable len package
-      if (ServerInstance->packetHandler()->packets[user->action].len == PACKET_VARIABLE_LEN)
-      {
-        //Call specific function
-        const bool disconnecting = user->action == 0xFF;
-        const int curpos = ServerInstance->packetHandler()->packets[user->action].function(user);
+  while (user->buffer >> (int8_t&)user->action)
+  {
+    const Packets& packet = ServerInstance->packetHandler()->packets[user->action];
 
-        if (curpos == PACKET_NEED_MORE_DATA)
-        {
-          user->waitForData = true;
-          event_set(user->GetEvent(), fd, EV_READ, client_callback, user);
-          event_add(user->GetEvent(), NULL);
-          return;
-        }
+    if (packet.frame == NULL)
+    {
+      std::ostringstream str;
+      str << "Unknown packet: 0x" << std::hex << (unsigned int)(user->action);
+      LOG2(DEBUG, str.str());
 
-        if (disconnecting) // disconnect -- player gone
-        {
-          if(user->nick.size())
-          {
-            LOG2(INFO, "User "+ user->nick + " disconnected normally");
-          }
-          delete user;
-          return;
-        }
-      }
-      else if (ServerInstance->packetHandler()->packets[user->action].len == PACKET_DOES_NOT_EXIST)
-      {
-        std::ostringstream str;
-        str << "Unknown packet: 0x" << std::hex << (unsigned int)(user->action);
-        LOG2(DEBUG, str.str());
+      delete user;
+      return false;
+    }
 
-        delete user;
-        return;
-      }
-      //Constant len packets
-      else
-      {
-        //Check that the buffer has enough data before calling the function
-        if (!user->buffer.haveData(ServerInstance->packetHandler()->packets[user->action].len))
-        {
-          user->waitForData = true;
-          event_set(user->GetEvent(), fd, EV_READ, client_callback, user);
-          event_add(user->GetEvent(), NULL);
-          return;
-        }
+    //Find where the packet ends, handlers only ever see complete packets
+    const int len = packet.frame(user->buffer.readData(), user->buffer.readAvailable());
+
+    //The read event stays armed, the rest comes with the next wakeup
+    if (len == PACKET_NEED_MORE_DATA)
+    {
+      user->waitForData = true;
+      break;
+    }
+
+    if (len == PACKET_MALFORMED)
+    {
+      std::ostringstream str;
+      str << "Malformed packet: 0x" << std::hex << (unsigned int)(user->action);
+      LOG2(WARNING, str.str());
 
-        //Call specific function
-        ServerInstance->packetHandler()->packets[user->action].function(user);
+      delete user;
+      return false;
+    }
+
+    if (ServerInstance->capture() != NULL)
+    {
+      ServerInstance->capture()->packet(user->UID, user->action, user->buffer.readData(), len);
+    }
+
+    //Call specific function
+    const bool disconnecting = user->action == 0xFF;
+    user->buffer.beginFrame(len);
+    packet.function(user);
+
+    if (disconnecting) // disconnect -- player gone
+    {
+      if(user->nick.size())
+      {
+        LOG2(INFO, "User "+ user->nick + " disconnected normally");
       }
-    } // while(user->buffer)
-  } //End reading
+      delete user;
+      return false;
+    }
+
+    //Skip whatever the handler left unread
+    user->buffer.removePacket();
+  } // while(user->buffer)
+
+  return true;
+}
 
-  //Write data to user socket
-  if(!client_write(user))
+extern "C" void client_callback(int fd, short ev, void* arg)
+{
+  User* user = reinterpret_cast<User*>(arg);
+
+  if (ev & EV_READ)
   {
-    return;
-  }  
+    if (!client_read(user) || !client_dispatch(user))
+    {
+      return;
+    }
+  } //End reading
 
-  //Add EV_READ event again
-  event_set(user->GetEvent(), fd, EV_READ, client_callback, user);
-  event_add(user->GetEvent(), NULL);
+  //Write data to user socket, this arms the write event if it doesn't all fit
+  client_write(user);
 }
 
 extern "C" void accept_callback(int fd, short ev, void* arg)
@@ -283,85 +330,13 @@ extern "C" void accept_callback(int fd, short ev, void* arg)
   int one = 1;
   setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(int));
 
-  event_set(client->GetEvent(), client_fd, EV_WRITE | EV_READ, client_callback, client);
+  //Reading stays armed for the life of the connection, writing only while output is pending
+  event_set(client->GetEvent(), client_fd, EV_READ | EV_PERSIST, client_callback, client);
+  event_set(client->GetWriteEvent(), client_fd, EV_WRITE, client_callback, client);
   event_add(client->GetEvent(), NULL);
-}
 
-//Opens a socket and connects to the host/port
-int socket_connect(char* host, int port)
-{
-  struct hostent* hp;
-  struct sockaddr_in addr;
-  int on = 1, sock;
-
-  if ((hp = gethostbyname(host)) == NULL)
+  if (ServerInstance->capture() != NULL)
   {
-    return 0;
+    ServerInstance->capture()->connected(client->UID);
   }
-
-  memmove(&addr.sin_addr, hp->h_addr, hp->h_length);
-  addr.sin_port = htons(port);
-  addr.sin_family = AF_INET;
-  sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-  //Set 5s timeout
-  struct timeval tv;
-  tv.tv_sec = 5;
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(struct timeval));
-  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(struct timeval));
-  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(int));
-
-  if (sock == -1 || connect(sock, (struct sockaddr*)&addr, sizeof(struct sockaddr_in)) == -1)
-  {
-    return 0;
-  }
-
-  return sock;
 }
-
-//Connects to session server and verifies the client
-//Will store output thread-safely to array which is read in the main loop
-void *user_validation_thread(void *arg)
-{
-  Mineserver::userValidation *user = reinterpret_cast<Mineserver::userValidation *>(arg);
-  user->valid=false;
-  std::string url = "/game/checkserver.jsp?user=" + user->user->nick + "&serverId=" + user->user->generateDigest();
-  LOG(INFO, "Packets", "Validating " + user->user->nick + " against session.minecraft.net: ");
-
-  std::string http_request = "GET " + url + " HTTP/1.1\r\n"
-                            + "Host: session.minecraft.net\r\n"
-                            + "Connection: close\r\n\r\n";
-
-  int fd = socket_connect((char*)"session.minecraft.net", 80);
-  if (fd)
-  {
-    send(fd, http_request.c_str(), http_request.length(), 0);
-
-    #define BUFFER_SIZE 1024
-    char* buffer = new char[BUFFER_SIZE];
-    std::string stringbuffer;
-
-    while (int received = recv(fd, buffer, BUFFER_SIZE - 1, 0) != 0)
-    {
-      stringbuffer += std::string(buffer);
-    }
-    delete[] buffer;
-#ifdef WIN32
-    closesocket(fd);
-#else
-    close(fd);
-#endif
-    //session server will return "YES" if user is valid, have to skip HTTP headers
-    if ((stringbuffer.size() >= 3 && stringbuffer.find("\r\n\r\nYES", 0) != std::string::npos))
-    {  
-      user->valid = true;
-    }
-  }
-  pthread_mutex_lock(&ServerInstance->m_validation_mutex);
-  ServerInstance->validatedUsers.push_back(*user);
-  pthread_mutex_unlock(&ServerInstance->m_validation_mutex);
-  user->user = NULL;
-  delete user;
-  pthread_exit(NULL);
-  return NULL;
-}
\ No newline at end of file
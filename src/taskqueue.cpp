@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+
+#include "taskqueue.h"
+
+#include "mineserver.h"
+#include "config.h"
+#include "logger.h"
+#include "tools.h"
+
+TaskQueue::TaskQueue()
+  : m_nextId(1),
+    m_budget(20)
+{
+  if (ServerInstance->config()->has("system.tasks.budget"))
+  {
+    m_budget = std::max(1, ServerInstance->config()->iData("system.tasks.budget"));
+  }
+}
+
+TaskQueue::~TaskQueue()
+{
+  while (!m_tasks.empty())
+  {
+    finish(m_tasks.begin(), true);
+  }
+}
+
+int TaskQueue::add(const std::string& name, Step step, Done done, void* data)
+{
+  Task task;
+  task.id      = m_nextId++;
+  task.name    = name;
+  task.step    = step;
+  task.done    = done;
+  task.data    = data;
+  task.started = microTime();
+  task.steps   = 0;
+  m_tasks.push_back(task);
+
+  LOG2(DEBUG, "Task " + dtos(task.id) + " (" + name + ") queued");
+  return task.id;
+}
+
+bool TaskQueue::cancel(int id)
+{
+  for (std::list<Task>::iterator it = m_tasks.begin(); it != m_tasks.end(); ++it)
+  {
+    if (it->id == id)
+    {
+      finish(it, true);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TaskQueue::running(int id) const
+{
+  for (std::list<Task>::const_iterator it = m_tasks.begin(); it != m_tasks.end(); ++it)
+  {
+    if (it->id == id)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskQueue::finish(std::list<Task>::iterator it, bool cancelled)
+{
+  // Take the task off the list first, the callback may add or cancel tasks
+  Task task = *it;
+  m_tasks.erase(it);
+
+  LOG2(DEBUG, "Task " + dtos(task.id) + " (" + task.name + ") " + (cancelled ? "cancelled" : "done")
+       + " after " + dtos(task.steps) + " steps, " + dtos((microTime() - task.started) / 1000) + "ms");
+
+  if (task.done != NULL)
+  {
+    task.done(task.data, cancelled);
+  }
+}
+
+void TaskQueue::update()
+{
+  if (m_tasks.empty())
+  {
+    return;
+  }
+
+  const uint64_t start = microTime();
+  const uint64_t budget = uint64_t(m_budget) * 1000;
+
+  // Round robin, every call makes progress on at least one task
+  do
+  {
+    std::list<Task>::iterator it = m_tasks.begin();
+    const int id = it->id;
+    it->steps++;
+    const bool more = it->step(it->data);
+
+    // The step may have cancelled tasks, itself included
+    for (it = m_tasks.begin(); it != m_tasks.end() && it->id != id; ++it)
+    {
+    }
+    if (it == m_tasks.end())
+    {
+      continue;
+    }
+
+    if (more)
+    {
+      m_tasks.splice(m_tasks.end(), m_tasks, it);
+    }
+    else
+    {
+      finish(it, false);
+    }
+  }
+  while (!m_tasks.empty() && microTime() - start < budget);
+}
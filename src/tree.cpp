@@ -36,7 +36,7 @@
 void Tree::generate(uint8_t limit)
 {
 
-  const uint8_t m_trunkHeight = uniformUINT8(MIN_TRUNK, limit);
+  const uint8_t m_trunkHeight = randomUINT8(MIN_TRUNK, limit);
 
   bool smalltree = false;
   uint8_t type = 0;
@@ -46,10 +46,10 @@ void Tree::generate(uint8_t limit)
     smalltree = true;
   }
 
-  if (uniform01() > 0.5) // 1/2 chance
+  if (random01() > 0.5) // 1/2 chance
   {
     ++type;
-    if (uniform01() > 0.5) // 1/4
+    if (random01() > 0.5) // 1/4
     {
       ++type;
     }
@@ -90,9 +90,9 @@ void Tree::generateBranches(TrunkPtr wrap)
 
   uint32_t schanse = BRANCHING_CHANCE;
 
-  if (uniform01() > 1.0 - (1.0 / BRANCHING_CHANCE))
+  if (random01() > 1.0 - (1.0 / BRANCHING_CHANCE))
   {
-    const double r = uniform01();
+    const double r = random01();
     if (r < 0.2)
     {
       x--;
@@ -129,10 +129,10 @@ void Tree::generateCanopy()
 
   int32_t t_posx, t_posy, t_posz;
 
-  if (uniform01() > 0.5) // 1/2
+  if (random01() > 0.5) // 1/2
   {
     canopy_type++;
-    if (uniform01() > 0.5) // 1/4
+    if (random01() > 0.5) // 1/4
     {
       canopy_type++;
     }
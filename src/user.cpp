@@ -39,9 +39,34 @@
 #include "mob.h"
 #include "logger.h"
 #include "protocol.h"
+#include "packetcapture.h"
+#include "playerstore.h"
 
 #define LOADBLOCK(x,y,z) ServerInstance->map(pos.map)->getBlock(int(std::floor(double(x))), int(std::floor(double(y))), int(std::floor(double(z))), &type, &meta)
 
+namespace
+{
+
+class DistanceComparator
+{
+private:
+  vec target;
+public:
+  DistanceComparator(vec tgt) : target(tgt)
+  {
+    target.y() = 0;
+  }
+  bool operator()(vec a, vec b) const
+  {
+    a.y() = 0;
+    b.y() = 0;
+    return vec::squareDistance(a, target) <
+           vec::squareDistance(b, target);
+  }
+};
+
+}
+
 
 // Generate "unique" entity ID
 
@@ -51,9 +76,11 @@ User::User(int sock, uint32_t EID)
   this->muted           = false;
   this->dnd             = false;
   this->waitForData     = false;
+  this->readChunk       = 4096;
   this->fd              = sock;
   this->UID             = EID;
   this->logged          = false;
+  this->loginPending    = false;
   this->serverAdmin     = false;
   this->pos.map         = 0;
   this->pos.x           = ServerInstance->map(pos.map)->spawnPos.x();
@@ -69,7 +96,14 @@ User::User(int sock, uint32_t EID)
   this->fallDistance    = -10;
   this->healthtimeout   = time(NULL) - 1;
   this->crypted         = false;
-
+  this->congested       = false;
+  this->overCapSince    = 0;
+  this->staleTime       = false;
+  this->viewDistance    = 0;
+  this->chatTokens      = -1;
+  this->chatTokensTime  = 0;
+  this->wantedViewDistance = ServerInstance->m_viewDistance;
+  updateViewDistance();
 
   this->m_currentItemSlot = 0;
   this->inventoryHolding  = Item(this, -1);
@@ -78,7 +112,7 @@ User::User(int sock, uint32_t EID)
   // Ignore this user if it's the server console
   if (this->UID != SERVER_CONSOLE_UID)
   {
-    ServerInstance->users().insert(this);
+    ServerInstance->addUser(this);
   }
 
   for (int count = 0; count < 45; count ++)
@@ -89,18 +123,27 @@ User::User(int sock, uint32_t EID)
 
 bool User::changeNick(std::string _nick)
 {
-  (static_cast<Hook2<bool, const char*, const char*>*>(ServerInstance->plugin()->getHook("PlayerNickPost")))->doAll(nick.c_str(), _nick.c_str());
+  ServerInstance->plugin()->hook<HOOK_PLAYER_NICK_POST>()->doAll(nick.c_str(), _nick.c_str());
 
-  nick = _nick;
+  ServerInstance->setUserNick(this, _nick);
 
   return true;
 }
 
 User::~User()
 {
-  if (this->UID != SERVER_CONSOLE_UID && event_del(GetEvent()) == -1)
+  if (this->UID != SERVER_CONSOLE_UID)
   {
-    LOG2(WARNING, this->nick + " event del failed!");
+    if (ServerInstance->capture() != NULL)
+    {
+      ServerInstance->capture()->disconnected(UID);
+    }
+
+    const bool readFailed = event_del(GetEvent()) == -1;
+    if (event_del(GetWriteEvent()) == -1 || readFailed)
+    {
+      LOG2(WARNING, this->nick + " event del failed!");
+    }
   }
 
   if (fd != -1)
@@ -113,7 +156,6 @@ User::~User()
   }
 
   this->buffer.reset();
-  this->bufferCrypted.reset();
 
   // Remove all known chunks
   for (uint32_t i = 0; i < mapKnown.size(); i++)
@@ -121,11 +163,8 @@ User::~User()
     delKnown(mapKnown[i].x(), mapKnown[i].z());
   }
 
-  std::set<User*>::iterator user_set_it = ServerInstance->users().find(this);
-  if (user_set_it != ServerInstance->users().end())
-  {
-    ServerInstance->users().erase(user_set_it);
-  }
+  ServerInstance->removeUser(this);
+  ServerInstance->chat()->removeUser(this);
 
   if (logged)
   {
@@ -157,8 +196,7 @@ User::~User()
 
     for (ChunkMap::const_iterator it = ServerInstance->map(pos.map)->chunks.begin(); it != ServerInstance->map(pos.map)->chunks.end(); )
     {
-      if((user_set_it = it->second->users.find(this)) != it->second->users.end())
-        it->second->users.erase(user_set_it);
+      it->second->users.erase(this);
 
       if (it->second->users.empty())
       {
@@ -192,19 +230,23 @@ User::~User()
 
   if (fd != -1 && logged)
   {
-    (static_cast<Hook1<bool, const char*>*>(ServerInstance->plugin()->getHook("PlayerQuitPost")))->doAll(nick.c_str());
+    ServerInstance->plugin()->hook<HOOK_PLAYER_QUIT_POST>()->doAll(nick.c_str());
   }
 }
 
-bool User::sendLoginInfo()
+void User::startLogin()
 {
-  
-  // Load user data
-  loadData();
-  
-  // Login OK package
-  buffer << Protocol::loginResponse(UID);
-  spawnOthers();
+  if (logged || loginPending)
+  {
+    return;
+  }
+  loginPending = true;
+  ServerInstance->loginPipeline()->submitPlayerData(UID, dataFile());
+}
+
+void User::copyLoginChunks(std::vector<LoginPipeline::Chunk>& chunks)
+{
+  Map* map = ServerInstance->map(pos.map);
 
   // Put nearby chunks to queue
   for (int x = -viewDistance; x <= viewDistance; x++)
@@ -214,14 +256,81 @@ bool User::sendLoginInfo()
       addQueue((int32_t)pos.x / 16 + x, (int32_t)pos.z / 16 + z);
     }
   }
-  // Push chunks to user
-  pushMap(true);
+
+  // The nearest ones go with the login, pushMap() sends the rest
+  vec target(static_cast<int>(pos.x / 16),
+             static_cast<int>(pos.y / 16),
+             static_cast<int>(pos.z / 16));
+  sort(mapQueue.begin(), mapQueue.end(), DistanceComparator(target));
+
+  int maxcount = 5;
+  chunks.reserve(maxcount);
+  while (this->mapQueue.size() > 0 && maxcount > 0)
+  {
+    maxcount--;
+    chunks.push_back(LoginPipeline::Chunk());
+    LoginPipeline::Chunk& copy = chunks.back();
+    copy.x = mapQueue[0].x();
+    copy.z = mapQueue[0].z();
+
+    sChunk* chunk = map->copyChunk(copy.x, copy.z, copy.data);
+    if (chunk == NULL)
+    {
+      chunks.pop_back();
+    }
+    else
+    {
+      for (int i = 0; i < 16; i++)
+      {
+        copy.versions[i] = map->sectionVersion(chunk, i);
+      }
+    }
+
+    // Known from now on, which keeps the chunk loaded until it is sent
+    addKnown(mapQueue[0].x(), mapQueue[0].z());
+    mapQueue.erase(mapQueue.begin());
+  }
+}
+
+bool User::sendLoginInfo(std::vector<LoginPipeline::Chunk>& chunks)
+{
+  loginPending = false;
+  Map* map = ServerInstance->map(pos.map);
+
+  // Login OK package
+  buffer << Protocol::loginResponse(UID);
+  spawnOthers();
+
+  // Chunks deflated by the login pipeline, unless they changed since they were copied
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    sChunk* chunk = map->getChunk(chunks[i].x, chunks[i].z);
+    if (chunk == NULL)
+    {
+      continue;
+    }
+
+    bool current = !chunks[i].data.empty();
+    for (int section = 0; current && section < 16; section++)
+    {
+      current = chunks[i].versions[section] == map->sectionVersion(chunk, section);
+    }
+
+    if (current)
+    {
+      map->writeChunk(loginBuffer, chunk, &chunks[i].data[0], chunks[i].data.size());
+    }
+    else
+    {
+      map->sendToUser(this, chunks[i].x, chunks[i].z, true);
+    }
+  }
 
   const std::vector<MobPtr>& mobs = ServerInstance->mobs()->getAll();
 
   for (std::vector<MobPtr>::const_iterator i = mobs.begin(); i != mobs.end(); ++i)
   {
-    if (pos.map == (*i)->map && (*i)->spawned)
+    if (*i && pos.map == (*i)->map && (*i)->spawned)
     {
       loginBuffer << Protocol::mobSpawn(**i);
     }
@@ -261,7 +370,7 @@ bool User::sendLoginInfo()
 bool User::kick(std::string kickMsg)
 {
   buffer << Protocol::kick(kickMsg);
-  (static_cast<Hook2<bool, const char*, const char*>*>(ServerInstance->plugin()->getHook("PlayerKickPost")))->doAll(nick.c_str(), kickMsg.c_str());
+  ServerInstance->plugin()->hook<HOOK_PLAYER_KICK_POST>()->doAll(nick.c_str(), kickMsg.c_str());
 
   LOG2(WARNING, nick + " kicked. Reason: " + kickMsg);
 
@@ -334,181 +443,74 @@ bool User::isAbleToCommunicate(std::string communicateCommand)
   return true;
 }
 
-bool User::loadData()
+std::string User::dataFile() const
 {
-  std::string infile = ServerInstance->map(0)->mapDirectory + "/players/" + this->nick + ".dat";
   // Player data will ALWAYS use the first world in your map
+  return ServerInstance->map(0)->mapDirectory + "/players/" + this->nick + ".dat";
+}
 
-  struct stat stFileInfo;
-  if (stat(infile.c_str(), &stFileInfo) != 0)
+bool User::loadData()
+{
+  LoginPipeline::PlayerData data;
+  if (!ServerInstance->playerStore()->load(dataFile(), data))
   {
     return false;
   }
 
-  NBT_Value*  playerRoot = NBT_Value::LoadFromFile(infile.c_str());
-  NBT_Value& nbtPlayer = *playerRoot;
-  if (playerRoot == NULL)
+  applyData(data);
+  return true;
+}
+
+void User::applyData(const LoginPipeline::PlayerData& data)
+{
+  if (!data.found)
   {
-    LOGLF("Failed to open player file");
-    return false;
+    return;
   }
 
-  std::vector<NBT_Value*>* _pos = nbtPlayer["Pos"]->GetList();
-  pos.x = (double)(*(*_pos)[0]);
-  pos.y = (double)(*(*_pos)[1]);
-  pos.z = (double)(*(*_pos)[2]);
-
-  health = *nbtPlayer["Health"];
+  pos.x     = data.x;
+  pos.y     = data.y;
+  pos.z     = data.z;
+  pos.yaw   = data.yaw;
+  pos.pitch = data.pitch;
+  health    = data.health;
 
-  std::vector<NBT_Value*>* rot = nbtPlayer["Rotation"]->GetList();
-  pos.yaw = (float)(*(*rot)[0]);
-  pos.yaw = (float)(*(*rot)[1]);
-
-  std::vector<NBT_Value*>* _inv = nbtPlayer["Inventory"]->GetList();
-  std::vector<NBT_Value*>::iterator iter = _inv->begin(), end = _inv->end();
-
-  for (; iter != end ; iter++)
+  for (int i = 0; i < 45; i++)
   {
-    int8_t slot, count;
-    int16_t damage, item_id;
-
-    slot    = *(**iter)["Slot"];
-    count   = *(**iter)["Count"];
-    damage  = *(**iter)["Damage"];
-    item_id = *(**iter)["id"];
-    if (item_id == 0 || count < 1)
-    {
-      item_id = -1;
-      count   =  0;
-    }
-
-    // Main inventory slot, converting 0-35 slots to 9-44
-    if (slot >= 0 && slot <= 35)
-    {
-      inv[(uint8_t)slot + 9].setCount(count);
-      inv[(uint8_t)slot + 9].setHealth(damage);
-      inv[(uint8_t)slot + 9].setType(item_id);
-    }
-    // Crafting, converting 80-83 slots to 1-4
-    else if (slot >= 80 && slot <= 83)
-    {
-      inv[(uint8_t)slot - 79].setCount(count);
-      inv[(uint8_t)slot - 79].setHealth(damage);
-      inv[(uint8_t)slot - 79].setType(item_id);
-    }
-    // Equipped, converting 100-103 slots to 8-5 (reverse order!)
-    else if (slot >= 100 && slot <= 103)
+    if (data.inv[i].type != -1)
     {
-      inv[(uint8_t)8 + (100 - slot)].setCount(count);
-      inv[(uint8_t)8 + (100 - slot)].setHealth(damage);
-      inv[(uint8_t)8 + (100 - slot)].setType(item_id);
+      inv[i].setCount(data.inv[i].count);
+      inv[i].setHealth(data.inv[i].health);
+      inv[i].setType(data.inv[i].type);
     }
   }
-  delete playerRoot;
-
-  return true;
 }
 
+// Only copies the state, the player store writes it out
 bool User::saveData()
 {
-  std::string outfile = ServerInstance->map(0)->mapDirectory + "/players/" + this->nick + ".dat";
-  // Try to create parent directories if necessary
-  struct stat stFileInfo;
-  if (stat(outfile.c_str(), &stFileInfo) != 0)
-  {
-    std::string outdir = ServerInstance->map(0)->mapDirectory + "/players";
-
-    if (stat(outdir.c_str(), &stFileInfo) != 0)
-    {
-      if (!makeDirectory(outdir))
-      {
-        return false;
-      }
-    }
-  }
-
-  NBT_Value val(NBT_Value::TAG_COMPOUND);
-  val.Insert("OnGround", new NBT_Value((int8_t)1));
-  val.Insert("Air", new NBT_Value((int16_t)300));
-  val.Insert("AttackTime", new NBT_Value((int16_t)0));
-  val.Insert("DeathTime", new NBT_Value((int16_t)0));
-  val.Insert("Fire", new NBT_Value((int16_t) - 20));
-  val.Insert("Health", new NBT_Value((int16_t)health));
-  val.Insert("HurtTime", new NBT_Value((int16_t)0));
-  val.Insert("FallDistance", new NBT_Value(54.f));
-
-  NBT_Value* nbtInv = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_COMPOUND);
+  LoginPipeline::PlayerData data;
+  collectData(data);
+  ServerInstance->playerStore()->save(dataFile(), data);
+  return true;
+}
 
-  char itemslot = 0;
-  // Start with main items
-  for (int slotid = 9; slotid < 45; slotid++, itemslot++)
-  {
-    if (inv[(uint8_t)slotid].getCount() && inv[(uint8_t)slotid].getType() != 0 && inv[(uint8_t)slotid].getType() != -1)
-    {
-      NBT_Value* val = new NBT_Value(NBT_Value::TAG_COMPOUND);
-      val->Insert("Count", new NBT_Value((int8_t)inv[(uint8_t)slotid].getCount()));
-      val->Insert("Slot", new NBT_Value((int8_t)itemslot));
-      val->Insert("Damage", new NBT_Value((int16_t)inv[(uint8_t)slotid].getHealth()));
-      val->Insert("id", new NBT_Value((int16_t)inv[(uint8_t)slotid].getType()));
-      nbtInv->GetList()->push_back(val);
-    }
-  }
-  // Crafting slots
-  itemslot = 80;
-  for (int slotid = 1; slotid < 6; slotid++, itemslot++)
-  {
-    if (inv[(uint8_t)slotid].getCount() && inv[(uint8_t)slotid].getType() != 0 && inv[(uint8_t)slotid].getType() != -1)
-    {
-      NBT_Value* val = new NBT_Value(NBT_Value::TAG_COMPOUND);
-      val->Insert("Count", new NBT_Value((int8_t)inv[(uint8_t)slotid].getCount()));
-      val->Insert("Slot", new NBT_Value((int8_t)itemslot));
-      val->Insert("Damage", new NBT_Value((int16_t)inv[(uint8_t)slotid].getHealth()));
-      val->Insert("id", new NBT_Value((int16_t)inv[(uint8_t)slotid].getType()));
-      nbtInv->GetList()->push_back(val);
-    }
-  }
+void User::collectData(LoginPipeline::PlayerData& data) const
+{
+  data.found  = true;
+  data.x      = pos.x;
+  data.y      = pos.y;
+  data.z      = pos.z;
+  data.yaw    = pos.yaw;
+  data.pitch  = pos.pitch;
+  data.health = health;
 
-  // Equipped items last
-  itemslot = 103;
-  for (int slotid = 5; slotid < 9; slotid++, itemslot--)
+  for (int i = 0; i < 45; i++)
   {
-    if (inv[(uint8_t)slotid].getCount() && inv[(uint8_t)slotid].getType() != 0 && inv[(uint8_t)slotid].getType() != -1)
-    {
-      NBT_Value* val = new NBT_Value(NBT_Value::TAG_COMPOUND);
-      val->Insert("Count", new NBT_Value((int8_t)inv[(uint8_t)slotid].getCount()));
-      val->Insert("Slot", new NBT_Value((int8_t)itemslot));
-      val->Insert("Damage", new NBT_Value((int16_t)inv[(uint8_t)slotid].getHealth()));
-      val->Insert("id", new NBT_Value((int16_t)inv[(uint8_t)slotid].getType()));
-      nbtInv->GetList()->push_back(val);
-    }
+    data.inv[i].type   = inv[i].getType();
+    data.inv[i].count  = inv[i].getCount();
+    data.inv[i].health = inv[i].getHealth();
   }
-
-
-  val.Insert("Inventory", nbtInv);
-
-  NBT_Value* nbtPos = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_DOUBLE);
-  nbtPos->GetList()->push_back(new NBT_Value((double)pos.x));
-  nbtPos->GetList()->push_back(new NBT_Value((double)pos.y));
-  nbtPos->GetList()->push_back(new NBT_Value((double)pos.z));
-  val.Insert("Pos", nbtPos);
-
-
-  NBT_Value* nbtRot = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_FLOAT);
-  nbtRot->GetList()->push_back(new NBT_Value((float)pos.yaw));
-  nbtRot->GetList()->push_back(new NBT_Value((float)pos.pitch));
-  val.Insert("Rotation", nbtRot);
-
-
-  NBT_Value* nbtMotion = new NBT_Value(NBT_Value::TAG_LIST, NBT_Value::TAG_DOUBLE);
-  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
-  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
-  nbtMotion->GetList()->push_back(new NBT_Value((double)0.0));
-  val.Insert("Motion", nbtMotion);
-
-  val.SaveToFile(outfile);
-
-  return true;
-
 }
 
 
@@ -529,6 +531,9 @@ bool User::updatePosM(double x, double y, double z, size_t map, double stance)
       }
     }
 
+    // Chunks of the old world still waiting to be sent
+    lanes.cancelChunks();
+
     // TODO despawn players who are no longer in view
     // TODO despawn self to players on last world
     pos.map = map;
@@ -719,48 +724,34 @@ bool User::updatePos(double x, double y, double z, double stance)
       end = toTeleport.end();
       for (; iter != end ; iter++)
       {
-        (*iter)->buffer.addToWrite(telePacket);
+        (*iter)->send(telePacket);
       }
     }
 
 
-    if (newChunk->items.size())
+    // Only look at the items close enough to be picked up, no more than 2 blocks away
+    Map* map = ServerInstance->map(pos.map);
+    std::vector<spawnedItem*> nearItems;
+    map->getItemsNear((int32_t)std::floor(x), (int32_t)std::floor(y), (int32_t)std::floor(z), 1, nearItems);
+
+    for (size_t i = 0; i < nearItems.size(); i++)
     {
-      // Loop through items and check if they are close enought to be picked up
-      for (std::vector<spawnedItem*>::iterator iter = newChunk->items.begin(), end = newChunk->items.end(); iter != end; ++iter)
+      spawnedItem* item = nearItems[i];
+
+      // Dont pickup own spawns right away
+      if (item->spawnedBy != this->UID || item->spawnedAt + 2 < time(NULL))
       {
-        // No more than 2 blocks away
-        if (abs((int32_t)x - ((*iter)->pos.x() / 32)) < 2 &&
-            abs((int32_t)y - ((*iter)->pos.y() / 32)) < 2 &&
-            abs((int32_t)z - ((*iter)->pos.z() / 32)) < 2)
+        // Check player inventory for space!
+        if (ServerInstance->inventory()->isSpace(this, item->item, item->count))
         {
-          // Dont pickup own spawns right away
-          if ((*iter)->spawnedBy != this->UID || (*iter)->spawnedAt + 2 < time(NULL))
-          {
-            // Check player inventory for space!
-            if (ServerInstance->inventory()->isSpace(this, (*iter)->item, (*iter)->count))
-            {
-              // Send player collect item packet
-              buffer << Protocol::collectItem((*iter)->EID, UID);
-
-              // Send everyone destroy_entity-packet
-              Packet pkt = Protocol::destroyEntity((*iter)->EID);
-              newChunk->sendPacket(pkt);
+          // Send player collect item packet
+          buffer << Protocol::collectItem(item->EID, UID);
 
-              // Add items to inventory
-              ServerInstance->inventory()->addItems(this, (*iter)->item, (*iter)->count, (*iter)->health);
+          // Add items to inventory
+          ServerInstance->inventory()->addItems(this, item->item, item->count, item->health);
 
-              ServerInstance->map(pos.map)->items.erase((*iter)->EID);
-              delete *iter;
-              iter = newChunk->items.erase(iter);
-              end = newChunk->items.end();
-
-              if (iter == end)
-              {
-                break;
-              }
-            }
-          }
+          // Send everyone destroy_entity-packet and free the item
+          map->removeItem(item);
         }
       }
     }
@@ -853,7 +844,7 @@ bool User::sendOthers(const Packet& packet)
   {
     if ((*it)->fd != this->fd && (*it)->logged && !((*it)->dnd && packet.firstwrite() == PACKET_CHAT_MESSAGE))
     {
-      (*it)->buffer.addToWrite(packet);
+      (*it)->send(packet);
     }
   }
 
@@ -866,7 +857,7 @@ bool User::sendOthers(uint8_t* data, size_t len)
   {
     if ((*it)->fd != this->fd && (*it)->logged && !((*it)->dnd && data[0] == PACKET_CHAT_MESSAGE))
     {
-      (*it)->buffer.addToWrite(data, len);
+      (*it)->send(data, len);
     }
   }
 
@@ -913,7 +904,7 @@ bool User::sendAll(const Packet& packet)
   {
     if ((*it)->fd && (*it)->logged)
     {
-      (*it)->buffer.addToWrite(packet);
+      (*it)->send(packet);
     }
   }
 
@@ -926,7 +917,7 @@ bool User::sendAll(uint8_t* data, size_t len)
   {
     if ((*it)->fd && (*it)->logged)
     {
-      (*it)->buffer.addToWrite(data, len);
+      (*it)->send(data, len);
     }
   }
 
@@ -939,7 +930,7 @@ bool User::sendAdmins(const Packet& packet)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(packet);
+      (*it)->send(packet);
     }
   }
 
@@ -952,7 +943,7 @@ bool User::sendAdmins(uint8_t* data, size_t len)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(data, len);
+      (*it)->send(data, len);
     }
   }
 
@@ -965,7 +956,7 @@ bool User::sendOps(const Packet& packet)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(packet);
+      (*it)->send(packet);
     }
   }
 
@@ -978,7 +969,7 @@ bool User::sendOps(uint8_t* data, size_t len)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(data, len);
+      (*it)->send(data, len);
     }
   }
 
@@ -991,7 +982,7 @@ bool User::sendGuests(const Packet& packet)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(packet);
+      (*it)->send(packet);
     }
   }
 
@@ -1004,13 +995,135 @@ bool User::sendGuests(uint8_t* data, size_t len)
   {
     if ((*it)->fd && (*it)->logged && IS_ADMIN((*it)->permissions))
     {
-      (*it)->buffer.addToWrite(data, len);
+      (*it)->send(data, len);
     }
   }
 
   return true;
 }
 
+void User::send(const Packet& packet)
+{
+  send(packet.writeData(), packet.writeSize());
+}
+
+void User::send(const uint8_t* data, size_t len)
+{
+  if (len == 0 || dropCongested(data, len))
+  {
+    return;
+  }
+
+  const OutputLanes::Lane lane = OutputLanes::classify(data, len);
+  if (lane == OutputLanes::LANE_CONTROL)
+  {
+    buffer.addToWrite(data, len);
+  }
+  else
+  {
+    lanes.push(lane, data, len);
+  }
+}
+
+bool User::dropCongested(const uint8_t* data, size_t len)
+{
+  if (!congested || len == 0)
+  {
+    return false;
+  }
+
+  // Only whole packets of one message, anything else might carry more than a move
+  size_t expected;
+  switch (data[0])
+  {
+  case PACKET_TIME_UPDATE:               expected = 9;  break;
+  case PACKET_ENTITY_VELOCITY:           expected = 11; break;
+  case PACKET_ENTITY_RELATIVE_MOVE:      expected = 8;  break;
+  case PACKET_ENTITY_LOOK:               expected = 7;  break;
+  case PACKET_ENTITY_LOOK_RELATIVE_MOVE: expected = 10; break;
+  case PACKET_ENTITY_TELEPORT:           expected = 19; break;
+  case PACKET_ENTITY_HEAD_LOOK:          expected = 6;  break;
+  default:
+    return false;
+  }
+  if (len != expected)
+  {
+    return false;
+  }
+
+  if (data[0] == PACKET_TIME_UPDATE)
+  {
+    staleTime = true;
+  }
+  else
+  {
+    staleEntities.insert(int32_t((uint32_t(data[1]) << 24) | (uint32_t(data[2]) << 16) |
+                                 (uint32_t(data[3]) << 8)  |  uint32_t(data[4])));
+  }
+  OutputQueue::stats.dropped++;
+  return true;
+}
+
+void User::updateCongestion()
+{
+  const size_t queued = output.size() + lanes.size();
+
+  if (!congested && queued > ServerInstance->m_outputHigh)
+  {
+    congested = true;
+    OutputQueue::stats.congested++;
+  }
+  else if (congested && queued <= ServerInstance->m_outputLow)
+  {
+    congested = false;
+    resync();
+  }
+
+  if (queued > ServerInstance->m_outputCap)
+  {
+    if (overCapSince == 0)
+    {
+      overCapSince = time(NULL);
+    }
+  }
+  else
+  {
+    overCapSince = 0;
+  }
+}
+
+void User::resync()
+{
+  if (staleTime)
+  {
+    send(Protocol::timeUpdate(ServerInstance->map(pos.map)->mapTime));
+    staleTime = false;
+  }
+
+  for (std::set<int32_t>::const_iterator it = staleEntities.begin(); it != staleEntities.end(); ++it)
+  {
+    const User* user = ServerInstance->userByUID(*it);
+    if (user != NULL)
+    {
+      if (user->logged && user->pos.map == pos.map)
+      {
+        send(Protocol::entityTeleport(*it, user->pos.x, user->pos.y, user->pos.z,
+                                      angleToByte(user->pos.yaw), angleToByte(user->pos.pitch)));
+      }
+      continue;
+    }
+
+    // Minecarts are not tracked here, their next move puts them right
+    const size_t mobID = ServerInstance->mobs()->getMobByTarget(*it);
+    MobPtr mob = ServerInstance->mobs()->getMobByID(mobID);
+    if (mob && mob->spawned && mob->map == pos.map)
+    {
+      send(Protocol::entityTeleport(*it, mob->x, mob->y, mob->z, mob->yaw, mob->pitch));
+    }
+  }
+  staleEntities.clear();
+}
+
 bool User::addQueue(int x, int z)
 {
   vec newMap(x, 0, z);
@@ -1084,6 +1197,8 @@ bool User::addKnown(int x, int z)
 
 bool User::delKnown(int x, int z)
 {
+  lanes.cancelChunk(x, z);
+
   sChunk* chunk = ServerInstance->map(pos.map)->getChunk(x, z);
   if (chunk != NULL)
   {
@@ -1124,31 +1239,20 @@ bool User::popMap()
   return false;
 }
 
-namespace
-{
-
-class DistanceComparator
+bool User::pushMap(bool login)
 {
-private:
-  vec target;
-public:
-  DistanceComparator(vec tgt) : target(tgt)
+  //The rest of the view follows the login response, sendLoginInfo() sets logged
+  if (!login && (!logged || loginPending))
   {
-    target.y() = 0;
+    return false;
   }
-  bool operator()(vec a, vec b) const
+
+  //Wait for the client to take what it has been sent
+  if (congested && !login)
   {
-    a.y() = 0;
-    b.y() = 0;
-    return vec::squareDistance(a, target) <
-           vec::squareDistance(b, target);
+    return true;
   }
-};
-
-}
 
-bool User::pushMap(bool login)
-{
   //Dont send all at once
   int maxcount = 5;
   // If map in queue, push it to client
@@ -1173,6 +1277,74 @@ bool User::pushMap(bool login)
   return true;
 }
 
+bool User::setViewDistance(int distance)
+{
+  wantedViewDistance = distance;
+  return updateViewDistance();
+}
+
+bool User::updateViewDistance()
+{
+  const int distance = std::max(ServerInstance->m_viewDistanceMin,
+                                std::min(wantedViewDistance, ServerInstance->viewDistanceCap()));
+  if (distance == viewDistance)
+  {
+    return false;
+  }
+
+  const int oldDistance = viewDistance;
+  viewDistance = distance;
+
+  if (!logged)
+  {
+    return true;
+  }
+
+  const int centerX = blockToChunk((int32_t)pos.x);
+  const int centerZ = blockToChunk((int32_t)pos.z);
+
+  if (distance < oldDistance)
+  {
+    // Forget queued chunks that are now out of view
+    for (std::vector<vec>::iterator it = mapQueue.begin(); it != mapQueue.end();)
+    {
+      if (abs(it->x() - centerX) > distance || abs(it->z() - centerZ) > distance)
+      {
+        it = mapQueue.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    // And unload the known ones from the client
+    for (size_t i = 0; i < mapKnown.size(); i++)
+    {
+      if (abs(mapKnown[i].x() - centerX) > distance || abs(mapKnown[i].z() - centerZ) > distance)
+      {
+        addRemoveQueue(mapKnown[i].x(), mapKnown[i].z());
+      }
+    }
+  }
+  else
+  {
+    // Only the ring outside the old view is new
+    for (int x = -distance; x <= distance; x++)
+    {
+      for (int z = -distance; z <= distance; z++)
+      {
+        if (abs(x) > oldDistance || abs(z) > oldDistance)
+        {
+          addQueue(centerX + x, centerZ + z);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
 bool User::teleport(double x, double y, double z, size_t map)
 {
   if (map == size_t(-1))
@@ -1390,7 +1562,7 @@ bool User::respawn()
     chunk->sendPacket(destroyPkt, this);
   }
 
-  if ((static_cast<Hook1<bool, const char*>*>(ServerInstance->plugin()->getHook("PlayerRespawn")))->doUntilFalse(nick.c_str()))
+  if (ServerInstance->plugin()->hook<HOOK_PLAYER_RESPAWN>()->doUntilFalse(nick.c_str()))
   {
     // In this case, the plugin teleports automatically
   }
@@ -1454,6 +1626,11 @@ struct event* User::GetEvent()
   return &m_event;
 }
 
+struct event* User::GetWriteEvent()
+{
+  return &m_writeEvent;
+}
+
 std::set<User*>& User::all()
 {
   return ServerInstance->users();
@@ -1461,26 +1638,18 @@ std::set<User*>& User::all()
 
 bool User::isUser(int sock)
 {
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
-  {
-    if ((*it)->fd == sock) return true;
-  }
-
-  return false;
+  return ServerInstance->userByFd(sock) != NULL;
 }
 
 // Not case-sensitive search
 User* User::byNick(std::string nick)
 {
-  // Get coordinates
-  for (std::set<User*>::const_iterator it = ServerInstance->users().begin(); it != ServerInstance->users().end(); ++it)
-  {
-    if (strToLower((*it)->nick) == strToLower(nick))
-    {
-      return *it;
-    }
-  }
-  return NULL;
+  return ServerInstance->userByNick(nick);
+}
+
+User* User::byUID(uint32_t uid)
+{
+  return ServerInstance->userByUID(uid);
 }
 
 // Getter/Setter for item currently in hold
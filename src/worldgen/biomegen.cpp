@@ -25,6 +25,8 @@
   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+
 #include "biomegen.h"
 
 #include "mineserver.h"
@@ -43,6 +45,7 @@ BiomeGen::BiomeGen()
 
 void BiomeGen::init(int seed)
 {
+  worldSeed = seed;
   cave.init(seed + 7);
   //###### TREE GEN #####
   treenoise.SetSeed(seed + 404);
@@ -111,6 +114,7 @@ void BiomeGen::init(int seed)
 
 void BiomeGen::re_init(int seed)
 {
+  worldSeed = seed;
   cave.init(seed + 7);
   treenoise.SetSeed(seed + 404);
   BiomeBase.SetSeed(seed - 1);
@@ -172,7 +176,7 @@ void BiomeGen::generateChunk(int x, int z, int map)
   val->Insert("LastUpdate", new NBT_Value((int64_t)time(NULL)));
   val->Insert("xPos", new NBT_Value(x));
   val->Insert("zPos", new NBT_Value(z));
-  val->Insert("TerrainPopulated", new NBT_Value((int8_t)1));
+  val->Insert("TerrainPopulated", new NBT_Value((int8_t)0));
 
   main->Insert("Level", val);
 
@@ -197,6 +201,7 @@ void BiomeGen::generateChunk(int x, int z, int map)
 
   ServerInstance->map(map)->chunks.insert(ChunkMap::value_type(ChunkMap::key_type(x, z), chunk));
 
+  stats.begin(MapGenStats::TERRAIN);
   if (ServerInstance->config()->bData("mapgen.flatgrass"))
   {
     generateFlatgrass(x, z, map);
@@ -205,6 +210,7 @@ void BiomeGen::generateChunk(int x, int z, int map)
   {
     generateWithNoise(x, z, map);
   }
+  stats.end();
 
 
   // Update last used time
@@ -214,7 +220,13 @@ void BiomeGen::generateChunk(int x, int z, int map)
   chunk->changed = ServerInstance->config()->bData("map.save_unchanged_chunks");
 
   //ServerInstance->map()->maps[chunkid].nbt = main;
+}
+
+void BiomeGen::populateChunk(int x, int z, int map)
+{
+  heightmap_pointer = ServerInstance->map(map)->getChunk(x, z)->heightmap;
 
+  stats.begin(MapGenStats::ORE);
   if (addOre)
   {
     AddOre(x, z, map, BLOCK_COAL_ORE);
@@ -226,13 +238,15 @@ void BiomeGen::generateChunk(int x, int z, int map)
   }
 
   AddOre(x, z, map, BLOCK_GRAVEL);
+  stats.end();
 
   // Add trees
   if (addTrees)
   {
+    stats.begin(MapGenStats::TREES);
     AddTrees(x, z, map);  // add trees will make a *kind-of* forest of 16*16 chunks
+    stats.end();
   }
-
 }
 
 //#define PRINT_MAPGEN_TIME
@@ -249,12 +263,14 @@ void BiomeGen::AddTrees(int x, int z, int map)
 
   memset(empty, 1, 256);
 
-  uint8_t trees = uint8_t(uniform01() * 7 + 13);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TREES);
+
+  uint8_t trees = uint8_t(rng.uniform01() * 7 + 13);
   uint8_t i = 0;
   while (i < trees)
   {
-    uint8_t a = uint8_t(uniform01() * 16);
-    uint8_t b = uint8_t(uniform01() * 16);
+    uint8_t a = uint8_t(rng.uniform01() * 16);
+    uint8_t b = uint8_t(rng.uniform01() * 16);
 
     if (empty[a][b])
     {
@@ -273,7 +289,7 @@ void BiomeGen::AddTrees(int x, int z, int map)
       int biome = int(BiomeSelect.GetValue(blockX / 100.0, 0, blockZ / 100.0));
       if (biome == 1 &&
           treenoise.GetValue(blockX, 0, blockZ) > -0.3 &&
-          ((rand() % 16) < 7)) // Dirty haxx!
+          (rng.below(16) < 7)) // Dirty haxx!
       {
         // Desert, make cactus
         int count = 3;
@@ -347,7 +363,7 @@ void BiomeGen::AddTrees(int x, int z, int map)
           {
             if (treenoise.GetValue(blockX, 0, blockZ) > -0.4)
             {
-              Tree tree(blockX, blockY, blockZ, map);
+              Tree tree(blockX, blockY, blockZ, map, rng);
             }
           }
         }
@@ -394,6 +410,7 @@ void BiomeGen::generateWithNoise(int x, int z, int map)
   int32_t currentHeight;
   int32_t ymax;
   uint8_t* curBlock;
+  int32_t stoneTop[16 * 16];
 
   double xBlockpos = x << 4;
   double zBlockpos = z << 4;
@@ -430,6 +447,7 @@ void BiomeGen::generateWithNoise(int x, int z, int map)
       }
 
       int32_t stoneHeight = (int32_t)currentHeight - ((64 - (currentHeight % 64)) / 8) + 1;
+      stoneTop[(bZ << 4) + bX] = std::min(stoneHeight, currentHeight);
       //int32_t bYbX = ((bZ << 7) + (bX << 11));
 
       if (ymax < seaLevel)
@@ -454,11 +472,6 @@ void BiomeGen::generateWithNoise(int x, int z, int map)
           if (bY < stoneHeight)
           {
             *curBlock = BLOCK_STONE;
-            // Add caves
-            if (addCaves)
-            {
-              cave.AddCaves(*curBlock, int(xBlockpos + bX), bY, int(zBlockpos + bZ));
-            }
           }
           else
           {
@@ -529,6 +542,14 @@ void BiomeGen::generateWithNoise(int x, int z, int map)
     }
   }
 
+  // Caves are carved out of the finished stone layer in one pass
+  if (addCaves)
+  {
+    stats.begin(MapGenStats::CAVES);
+    cave.AddCaves(chunk, x, z, stoneTop);
+    stats.end();
+  }
+
 #ifdef PRINT_MAPGEN_TIME
 #ifdef WIN32
   t_end = timeGetTime();
@@ -541,19 +562,10 @@ void BiomeGen::generateWithNoise(int x, int z, int map)
 }
 
 
-MAKE_UNIFORM_DIST(10, 30)
-MAKE_UNIFORM_DIST(20, 30)
-MAKE_UNIFORM_DIST( 1,  3)
-MAKE_UNIFORM_DIST(10, 18)
-MAKE_UNIFORM_DIST( 4,  9)
-MAKE_UNIFORM_DIST( 5, 10)
-MAKE_UNIFORM_DIST( 8, 12)
-MAKE_UNIFORM_DIST( 0,  1)
-
-
 void BiomeGen::AddOre(int x, int z, int map, uint8_t type)
 {
   sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::ORE + type);
 
   int blockX, blockY, blockZ;
   uint8_t block;
@@ -565,43 +577,43 @@ void BiomeGen::AddOre(int x, int z, int map, uint8_t type)
   switch (type)
   {
   case BLOCK_COAL_ORE:
-    count = uniform_20_30(); // 20-30 coal deposits
+    count = rng.between(20, 30); // 20-30 coal deposits
     startHeight = 90;
     minDepoSize = 8;
     maxDepoSize = 20;
     break;
   case BLOCK_IRON_ORE:
-    count = uniform_10_18(); // 10-18 iron deposits
+    count = rng.between(10, 18); // 10-18 iron deposits
     startHeight = 60;
     minDepoSize = 5;
     maxDepoSize = 10;
     break;
   case BLOCK_GOLD_ORE:
-    count = uniform_4_9(); // 4-9 gold deposits
+    count = rng.between(4, 9); // 4-9 gold deposits
     startHeight = 32;
     minDepoSize = 5;
     maxDepoSize = 8;
     break;
   case BLOCK_DIAMOND_ORE:
-    count = uniform_1_3(); // 1-3 diamond deposits
+    count = rng.between(1, 3); // 1-3 diamond deposits
     startHeight = 17;
     minDepoSize = 4;
     maxDepoSize = 7;
     break;
   case BLOCK_REDSTONE_ORE:
-    count = uniform_5_10(); // 5-10 redstone deposits
+    count = rng.between(5, 10); // 5-10 redstone deposits
     startHeight = 25;
     minDepoSize = 5;
     maxDepoSize = 20;
     break;
   case BLOCK_LAPIS_ORE:
-    count = uniform_1_3(); // 1-3 lapis lazuli deposits
+    count = rng.between(1, 3); // 1-3 lapis lazuli deposits
     startHeight = 17;
     minDepoSize = 5;
     maxDepoSize = 20;
     break;
   case BLOCK_GRAVEL:
-    count = uniform_10_30(); // 10-30 gravel deposits
+    count = rng.between(10, 30); // 10-30 gravel deposits
     startHeight = 90;
     minDepoSize = 5;
     maxDepoSize = 50;
@@ -612,8 +624,8 @@ void BiomeGen::AddOre(int x, int z, int map, uint8_t type)
 
   for (unsigned int i = 0; i < count; ++i)
   {
-    blockX = uniform_8_12();
-    blockZ = uniform_8_12();
+    blockX = rng.between(8, 12);
+    blockZ = rng.between(8, 12);
 
     blockY = heightmap_pointer[(blockZ << 4) + blockX];
     blockY -= 5;
@@ -628,7 +640,7 @@ void BiomeGen::AddOre(int x, int z, int map, uint8_t type)
     //blockZ += zBlockpos;
 
     // Calculate Y
-    blockY = uniformUINT(0, blockY);
+    blockY = rng.between(0, std::max(blockY, 0));
 
     
     block = chunk->blocks[blockX + (blockZ << 4) + (blockY << 8)];
@@ -639,13 +651,13 @@ void BiomeGen::AddOre(int x, int z, int map, uint8_t type)
       continue;
     }
 
-    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk);
+    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk, rng);
   }
 }
 
-void BiomeGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk)
+void BiomeGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk, ChunkRNG& rng)
 {
-  int depoSize = uniformUINT(maxDepoSize - minDepoSize, maxDepoSize);
+  int depoSize = rng.between(maxDepoSize - minDepoSize, maxDepoSize);
 
   for (int i = 0; i < depoSize; i++)
   {
@@ -654,9 +666,9 @@ void BiomeGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDe
       chunk->blocks[x + (z << 4) + (y << 8)] = block;
     }
 
-    z = z + int(uniform_0_1()) - 1;
-    x = x + int(uniform_0_1()) - 1;
-    y = y + int(uniform_0_1()) - 1;
+    z = z + rng.between(0, 1) - 1;
+    x = x + rng.between(0, 1) - 1;
+    y = y + rng.between(0, 1) - 1;
 
     // If over chunk borders
     if (z < 0 || z > 15 || x < 0 || x > 15 || y < 1)
@@ -37,6 +37,7 @@ public:
   void init(int seed);
   void re_init(int seed); // Used when generating multiple maps
   void generateChunk(int x, int z, int map);
+  void populateChunk(int x, int z, int map);
 
 private:
   std::vector<uint8_t> blocks;
@@ -65,7 +66,7 @@ private:
   void AddTrees(int x, int z, int map);
 
   void AddOre(int x, int z, int map, uint8_t type);
-  void AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk);
+  void AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk, ChunkRNG& rng);
 
   CaveGen cave;
 
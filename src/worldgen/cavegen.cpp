@@ -28,6 +28,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
 
 #ifdef LIBNOISE
 #include <libnoise/noise.h>
@@ -49,6 +50,10 @@ void CaveGen::init(int seed)
   addCaveLava = ServerInstance->config()->bData("mapgen.caves.lava");
   caveSize = ServerInstance->config()->iData("mapgen.caves.size");
   caveTreshold = ServerInstance->config()->dData("mapgen.caves.treshold");
+  // Off unless asked for, interpolated caves don't line up with the exact ones of existing worlds
+  interpolate = ServerInstance->config()->has("mapgen.caves.interpolate") &&
+                ServerInstance->config()->bData("mapgen.caves.interpolate");
+  gridReady = false;
 
   // Set up us the Perlin-noise module.
   caveNoise.SetSeed(seed + 22);
@@ -56,9 +61,33 @@ void CaveGen::init(int seed)
   caveNoise.SetOctaveCount(4);
 }
 
+void CaveGen::prepareChunk(int x, int z)
+{
+  if (!interpolate)
+  {
+    return;
+  }
+
+  // Caves are 4x wider than tall in noise space, so the lattice is coarser horizontally
+  caveGrid.fill(caveNoise, x << 4, z << 4, 127, 4.0, 1.5, 4.0, 4, 2);
+  gridReady = true;
+  gridX = x;
+  gridZ = z;
+}
+
 void CaveGen::AddCaves(uint8_t& block, int x, int y, int z)
 {
-  if (caveNoise.GetValue(x / 4.0, y / 1.5, z / 4.0) > caveTreshold)
+  double density;
+  if (gridReady && (x >> 4) == gridX && (z >> 4) == gridZ && y >= 0 && y <= caveGrid.height())
+  {
+    density = caveGrid.value(x & 15, y, z & 15);
+  }
+  else
+  {
+    density = caveNoise.GetValue(x / 4.0, y / 1.5, z / 4.0);
+  }
+
+  if (density > caveTreshold)
   {
     if (y < 10 && addCaveLava)
     {
@@ -70,3 +99,26 @@ void CaveGen::AddCaves(uint8_t& block, int x, int y, int z)
     }
   }
 }
+
+void CaveGen::AddCaves(sChunk* chunk, int x, int z, const int32_t* ceiling)
+{
+  prepareChunk(x, z);
+
+  const int xBlockpos = x << 4;
+  const int zBlockpos = z << 4;
+  for (int bX = 0; bX < 16; bX++)
+  {
+    for (int bZ = 0; bZ < 16; bZ++)
+    {
+      const int top = std::min(ceiling[(bZ << 4) + bX], 256);
+      for (int bY = 1; bY < top; bY++)
+      {
+        uint8_t& block = chunk->blocks[bX + (bZ << 4) + (bY << 8)];
+        if (block == BLOCK_STONE)
+        {
+          AddCaves(block, xBlockpos + bX, bY, zBlockpos + bZ);
+        }
+      }
+    }
+  }
+}
@@ -30,17 +30,33 @@
 
 #include <stdint.h>
 
+#include "noisegrid.h"
+
+struct sChunk;
+
 class CaveGen
 {
 public:
   void init(int seed);
+  // Samples the cave noise for chunk (x, z) on a coarse lattice, AddCaves()
+  // then interpolates within that chunk instead of evaluating the noise per block
+  void prepareChunk(int x, int z);
   void AddCaves(uint8_t& block, int x, int y, int z);
+  // Carves caves into the stone of chunk (x, z) from y = 1 up to, not
+  // including, ceiling[(bZ << 4) + bX] in each column
+  void AddCaves(sChunk* chunk, int x, int z, const int32_t* ceiling);
 
 private:
   noise::module::RidgedMulti caveNoise;
   bool addCaveLava;
   int caveSize;
   double caveTreshold;
+
+  bool interpolate;
+  NoiseGrid caveGrid;
+  bool gridReady;
+  int gridX;
+  int gridZ;
 };
 
 #endif
@@ -25,6 +25,8 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+
 #include "eximgen.h"
 
 #include "mineserver.h"
@@ -46,6 +48,7 @@ EximGen::EximGen()
 
 void EximGen::init(int seed)
 {
+  worldSeed = seed;
   cave.init(seed + 7);
 
   mountainTerrain.SetSeed(seed);
@@ -99,6 +102,7 @@ void EximGen::init(int seed)
 
 void EximGen::re_init(int seed)
 {
+  worldSeed = seed;
   cave.init(seed + 7);
 
   mountainTerrain.SetSeed(seed);
@@ -161,7 +165,7 @@ void EximGen::generateChunk(int x, int z, int map)
   val->Insert("LastUpdate", new NBT_Value((int64_t)time(NULL)));
   val->Insert("xPos", new NBT_Value(x));
   val->Insert("zPos", new NBT_Value(z));
-  val->Insert("TerrainPopulated", new NBT_Value((int8_t)1));
+  val->Insert("TerrainPopulated", new NBT_Value((int8_t)0));
 
   main->Insert("Level", val);
 
@@ -182,6 +186,7 @@ void EximGen::generateChunk(int x, int z, int map)
   chunk->z = z;
   ServerInstance->map(map)->chunks.insert(ChunkMap::value_type(ChunkMap::key_type(x, z), chunk));
 
+  stats.begin(MapGenStats::TERRAIN);
   if (ServerInstance->config()->bData("mapgen.flatgrass"))
   {
     generateFlatgrass(x, z, map);
@@ -190,11 +195,22 @@ void EximGen::generateChunk(int x, int z, int map)
   {
     generateWithNoise(x, z, map);
   }
+  stats.end();
 
 
   // Not changed
   chunk->changed = ServerInstance->config()->bData("map.save_unchanged_chunks");
 
+  // Kept for populateChunk(), lighting rebuilds it once the chunk is populated
+  std::copy(this->heightmap.begin(), this->heightmap.end(), chunk->heightmap);
+}
+
+void EximGen::populateChunk(int x, int z, int map)
+{
+  sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  std::copy(chunk->heightmap, chunk->heightmap + 16 * 16, heightmap.begin());
+
+  stats.begin(MapGenStats::ORE);
   if (addOre)
   {
     AddOre(x, z, map, BLOCK_COAL_ORE);
@@ -207,20 +223,24 @@ void EximGen::generateChunk(int x, int z, int map)
 
   AddOre(x, z, map, BLOCK_GRAVEL);
   AddOre(x, z, map, BLOCK_DIRT); // guess what, dirt also exists underground
+  stats.end();
 
   // Add trees
   if (addTrees)
   {
+    stats.begin(MapGenStats::TREES);
     AddTrees(x, z, map);
+    stats.end();
   }
 
   if (expandBeaches)
   {
+    stats.begin(MapGenStats::BEACHES);
     ExpandBeaches(x, z, map);
+    stats.end();
   }
 
   // AddRiver(x, z, map);
-
 }
 #include <iostream>
 using namespace std;
@@ -235,12 +255,14 @@ void EximGen::AddTrees(int x, int z, int map)
 
   memset(empty, 1, 256);
 
-  uint8_t trees = uint8_t(uniform01() * 7 + 13);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TREES);
+
+  uint8_t trees = uint8_t(rng.uniform01() * 7 + 13);
   uint8_t i = 0;
   while (i < trees)
   {
-    uint8_t a = uint8_t(uniform01() * 16);
-    uint8_t b = uint8_t(uniform01() * 16);
+    uint8_t a = uint8_t(rng.uniform01() * 16);
+    uint8_t b = uint8_t(rng.uniform01() * 16);
 
     if (empty[a][b])
     {
@@ -257,7 +279,7 @@ void EximGen::AddTrees(int x, int z, int map)
         {
           if (treenoise.GetValue(blockX, 0, blockZ) > -0.4)
           {
-            Tree tree(blockX, blockY, blockZ, map);
+            Tree tree(blockX, blockY, blockZ, map, rng);
           }
         }
       }
@@ -291,6 +313,7 @@ void EximGen::generateWithNoise(int x, int z, int map)
 #endif
 #endif
   sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TERRAIN);
 
   // Winterland
   Block topBlock = BLOCK_GRASS;
@@ -306,13 +329,19 @@ void EximGen::generateWithNoise(int x, int z, int map)
 
   int32_t xBlockpos = x << 4;
   int32_t zBlockpos = z << 4;
+
+  if (addCaves)
+  {
+    cave.prepareChunk(x, z);
+  }
+
   for (uint8_t bX = 0; bX < 16; bX++) //,xBlockpos++)   // ### optimization that somehow fucks up noise values =b
   {
     for (uint8_t bZ = 0; bZ < 16; bZ++) //,zBlockpos++)
     {
       heightmap[(bZ<<4)+bX]  = ymax = currentHeight = (int32_t)(finalTerrain.GetValue(xBlockpos + bX, 0, zBlockpos + bZ));
 
-      uint8_t stoneHeight = uint8_t(currentHeight - (uniform01() * 3));
+      uint8_t stoneHeight = uint8_t(currentHeight - (rng.uniform01() * 3));
       int32_t bYbX = ((bZ << 7) + (bX << 11));
 
       if (currentHeight < seaLevel)
@@ -353,7 +382,7 @@ void EximGen::generateWithNoise(int x, int z, int map)
           {
             if (bY > 70)
             {
-              if (uniform01() > 0.999)
+              if (rng.uniform01() > 0.999)
               {
                 *curBlock = BLOCK_STATIONARY_WATER; // mountain water spring
                 if (bYbX & 1)
@@ -489,6 +518,7 @@ void EximGen::ExpandBeaches(int x, int z, int map)
 void EximGen::AddOre(int x, int z, int map, uint8_t type)
 {
   sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::ORE + type);
 
   int32_t blockX, blockZ;
   uint8_t block, blockY;
@@ -499,49 +529,49 @@ void EximGen::AddOre(int x, int z, int map, uint8_t type)
   switch (type)
   {
   case BLOCK_COAL_ORE:
-    count = uint8_t(uniform01() * 10 + 20); // 20-30 coal deposits
+    count = uint8_t(rng.uniform01() * 10 + 20); // 20-30 coal deposits
     //startHeight = 90;
     minDepoSize = 3;
     maxDepoSize = 7;
     break;
   case BLOCK_IRON_ORE:
-    count = uint8_t(uniform01() * 8 + 10); // 10-18 iron deposits
+    count = uint8_t(rng.uniform01() * 8 + 10); // 10-18 iron deposits
     startHeight = 90;
     minDepoSize = 2;
     maxDepoSize = 5;
     break;
   case BLOCK_GOLD_ORE:
-    count = uint8_t(uniform01() * 4 + 5); // 4-9 gold deposits
+    count = uint8_t(rng.uniform01() * 4 + 5); // 4-9 gold deposits
     startHeight = 42;
     minDepoSize = 2;
     maxDepoSize = 4;
     break;
   case BLOCK_DIAMOND_ORE:
-    count = uint8_t(uniform01() * 1 + 2); // 1-3 diamond deposits
+    count = uint8_t(rng.uniform01() * 1 + 2); // 1-3 diamond deposits
     startHeight = 17;
     minDepoSize = 1;
     maxDepoSize = 2;
     break;
   case BLOCK_REDSTONE_ORE:
-    count = uint8_t(uniform01() * 5 + 5); // 5-10 redstone deposits
+    count = uint8_t(rng.uniform01() * 5 + 5); // 5-10 redstone deposits
     startHeight = 25;
     minDepoSize = 2;
     maxDepoSize = 4;
     break;
   case BLOCK_LAPIS_ORE:
-    count = uint8_t(uniform01() * 1 + 2); // 1-3 lapis lazuli deposits
+    count = uint8_t(rng.uniform01() * 1 + 2); // 1-3 lapis lazuli deposits
     startHeight = 17;
     minDepoSize = 1;
     maxDepoSize = 2;
     break;
   case BLOCK_GRAVEL:
-    count = uint8_t(uniform01() * 10 + 20); // 20-30 gravel deposits
+    count = uint8_t(rng.uniform01() * 10 + 20); // 20-30 gravel deposits
     //startHeight = 90;
     minDepoSize = 6;
     maxDepoSize = 10;
     break;
   case BLOCK_DIRT:
-    count = uint8_t(uniform01() * 10 + 20); // 20-30 gravel deposits
+    count = uint8_t(rng.uniform01() * 10 + 20); // 20-30 gravel deposits
     //startHeight = 90;
     minDepoSize = 6;
     maxDepoSize = 10;
@@ -553,11 +583,11 @@ void EximGen::AddOre(int x, int z, int map, uint8_t type)
   int i = 0;
   while (i < count)
   {
-    blockX = int32_t(uniform01() * 16);
-    blockZ = int32_t(uniform01() * 16);
+    blockX = int32_t(rng.uniform01() * 16);
+    blockZ = int32_t(rng.uniform01() * 16);
 
     blockY = heightmap[(blockZ<<4)+blockX];
-    blockY -= uint8_t(uniform01() * 5);
+    blockY -= uint8_t(rng.uniform01() * 5);
 
     // Check that startheight is not higher than height at that column
     if (blockY > startHeight)
@@ -566,7 +596,7 @@ void EximGen::AddOre(int x, int z, int map, uint8_t type)
     }
 
     // Calculate Y
-    blockY = uint8_t(uniform01() * (blockY));
+    blockY = uint8_t(rng.uniform01() * (blockY));
 
     i++;
 
@@ -577,14 +607,14 @@ void EximGen::AddOre(int x, int z, int map, uint8_t type)
       continue;
     }
 
-    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk);
+    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk, rng);
 
   }
 }
 
-void EximGen::AddDeposit(int x, int y, int z, int map, uint8_t block, uint8_t minDepoSize, uint8_t maxDepoSize, sChunk* chunk)
+void EximGen::AddDeposit(int x, int y, int z, int map, uint8_t block, uint8_t minDepoSize, uint8_t maxDepoSize, sChunk* chunk, ChunkRNG& rng)
 {
-  uint8_t depoSize = uint8_t((uniform01() * (maxDepoSize - minDepoSize) + minDepoSize) / 2);
+  uint8_t depoSize = uint8_t((rng.uniform01() * (maxDepoSize - minDepoSize) + minDepoSize) / 2);
   int32_t t_posx, t_posy, t_posz;
   for (int8_t xi = (-depoSize); xi <= depoSize; xi++)
   {
@@ -58,23 +58,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools.h"
 #include "random.h"
 
-int heaven_seed;
-
 HeavenGen::HeavenGen()
   : heightmap(16 * 16, 0)
 {
 }
 
-
-static inline int fastrand()
-{
-  heaven_seed = (214013 * heaven_seed + 2531011);
-  return (heaven_seed >> 16) & 0x7FFF;
-}
-
 void HeavenGen::init(int seed)
 {
-  heaven_seed = seed;
+  worldSeed = seed;
 
   Randomgen.SetSeed(seed);
   Randomgen.SetOctaveCount(6);
@@ -95,6 +86,7 @@ void HeavenGen::init(int seed)
 
 void HeavenGen::re_init(int seed)
 {
+  worldSeed = seed;
   Randomgen.SetSeed(seed);
 }
 
@@ -111,7 +103,7 @@ void HeavenGen::generateChunk(int x, int z, int map)
   val->Insert("LastUpdate", new NBT_Value((int64_t)time(NULL)));
   val->Insert("xPos", new NBT_Value(x));
   val->Insert("zPos", new NBT_Value(z));
-  val->Insert("TerrainPopulated", new NBT_Value((char)1));
+  val->Insert("TerrainPopulated", new NBT_Value((int8_t)0));
 
   main->Insert("Level", val);
 
@@ -141,7 +133,9 @@ void HeavenGen::generateChunk(int x, int z, int map)
   memset(chunk->skylight, 0, 16*16*256/2);
   chunk->chunks_present = 0xffff;
 
+  stats.begin(MapGenStats::TERRAIN);
   generateWithNoise(x, z, map);
+  stats.end();
 
   // Update last used time
   //ServerInstance->map()->mapLastused[chunkid] = (int)time(0);
@@ -151,28 +145,42 @@ void HeavenGen::generateChunk(int x, int z, int map)
 
   //ServerInstance->map()->maps[chunkid].nbt = main;
 
+  // Kept for populateChunk(), lighting rebuilds it once the chunk is populated
+  std::copy(heightmap.begin(), heightmap.end(), chunk->heightmap);
+}
+
+void HeavenGen::populateChunk(int x, int z, int map)
+{
+  sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  std::copy(chunk->heightmap, chunk->heightmap + 16 * 16, heightmap.begin());
+
+  stats.begin(MapGenStats::ORE);
   if (addOre)
   {
     AddOre(x, z, map, BLOCK_STATIONARY_WATER);
   }
+  stats.end();
 
   // Add trees
   if (addTrees)
   {
-    AddTrees(x, z, map,  fastrand() % 2 + 3);
+    stats.begin(MapGenStats::TREES);
+    AddTrees(x, z, map);
+    stats.end();
   }
 
   if (expandBeaches)
   {
+    stats.begin(MapGenStats::BEACHES);
     ExpandBeaches(x, z, map);
+    stats.end();
   }
-
 }
 
 //#define PRINT_MAPGEN_TIME
 
 
-void HeavenGen::AddTrees(int x, int z, int map, uint16_t count)
+void HeavenGen::AddTrees(int x, int z, int map)
 {
   int xBlockpos = x << 4;
   int zBlockpos = z << 4;
@@ -181,10 +189,13 @@ void HeavenGen::AddTrees(int x, int z, int map, uint16_t count)
   uint8_t block;
   uint8_t meta;
 
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TREES);
+  const uint16_t count = rng.below(2) + 3;
+
   for (uint16_t i = 0; i < count; i++)
   {
-    blockX = fastrand() % 16;
-    blockZ = fastrand() % 16;
+    blockX = rng.below(16);
+    blockZ = rng.below(16);
 
     blockY = heightmap[(blockZ << 4) + blockX] + 1;
 
@@ -198,7 +209,7 @@ void HeavenGen::AddTrees(int x, int z, int map, uint16_t count)
       continue;
     }
 
-    Tree tree(blockX, blockY, blockZ, map);
+    Tree tree(blockX, blockY, blockZ, map, rng);
   }
 }
 
@@ -215,6 +226,7 @@ void HeavenGen::generateWithNoise(int x, int z, int map)
 #endif
 #endif
   sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TERRAIN);
 
   // Populate blocks in chunk
   int32_t currentHeight = 0;
@@ -243,7 +255,7 @@ void HeavenGen::generateWithNoise(int x, int z, int map)
         if (bY > n - h && bY < n)
         {
           *curBlock = BLOCK_WOOL;
-          *curData = (index & 1) ? col[rand() % 2] : col[rand() % 2] << 4;
+          *curData = (index & 1) ? col[rng.below(2)] : col[rng.below(2)] << 4;
           continue;
         }
         *curBlock = BLOCK_AIR;
@@ -334,6 +346,8 @@ void HeavenGen::ExpandBeaches(int x, int z, int map)
 
 void HeavenGen::AddOre(int x, int z, int map, uint8_t type)
 {
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::ORE + type);
+
   int xBlockpos = x << 4;
   int zBlockpos = z << 4;
 
@@ -346,7 +360,7 @@ void HeavenGen::AddOre(int x, int z, int map, uint8_t type)
   switch (type)
   {
   case BLOCK_STATIONARY_WATER:
-    count = fastrand() % 20 + 20;
+    count = rng.below(20) + 20;
     startHeight = 128;
     break;
   }
@@ -354,8 +368,8 @@ void HeavenGen::AddOre(int x, int z, int map, uint8_t type)
   int i = 0;
   while (i < count)
   {
-    blockX = fastrand() % 8 + 4;
-    blockZ = fastrand() % 8 + 4;
+    blockX = rng.below(8) + 4;
+    blockZ = rng.below(8) + 4;
 
     blockY = heightmap[(blockZ << 4) + blockX];
     blockY -= 5;
@@ -370,7 +384,7 @@ void HeavenGen::AddOre(int x, int z, int map, uint8_t type)
     blockZ += zBlockpos;
 
     // Calculate Y
-    blockY = fastrand() % blockY;
+    blockY = rng.below(std::max(blockY, 1));
 
     i++;
 
@@ -381,12 +395,12 @@ void HeavenGen::AddOre(int x, int z, int map, uint8_t type)
       continue;
     }
 
-    AddDeposit(blockX, blockY, blockZ, map, type, 2);
+    AddDeposit(blockX, blockY, blockZ, map, type, 2, rng);
 
   }
 }
 
-void HeavenGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize)
+void HeavenGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize, ChunkRNG& rng)
 {
   for (int bX = x; bX < x + depotSize; bX++)
   {
@@ -394,7 +408,7 @@ void HeavenGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depo
     {
       for (int bZ = z; bZ < z + depotSize; bZ++)
       {
-        if (uniform01() < 0.5)
+        if (rng.uniform01() < 0.5)
         {
           ServerInstance->map(map)->sendBlockChange(bX, bY, bZ, block, 0);
           ServerInstance->map(map)->setBlock(bX, bY, bZ, block, 0);
@@ -44,6 +44,7 @@ public:
   void init(int seed);
   void re_init(int seed);
   void generateChunk(int x, int z, int map);
+  void populateChunk(int x, int z, int map);
 
 private:
   std::vector<int32_t> heightmap;
@@ -61,10 +62,10 @@ private:
   void generateWithNoise(int x, int z, int map);
 
   void ExpandBeaches(int x, int z, int map);
-  void AddTrees(int x, int z, int map, uint16_t count);
+  void AddTrees(int x, int z, int map);
 
   void AddOre(int x, int z, int map, uint8_t type);
-  void AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize);
+  void AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize, ChunkRNG& rng);
 
 
   CaveGen cave;
@@ -26,6 +26,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 
+#include <algorithm>
+
 // libnoise
 #ifdef LIBNOISE
 #include <libnoise/noise.h>
@@ -41,18 +43,64 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "logger.h"
 #include "map.h"
 #include "tree.h"
+#include "tools.h"
+
+MapGenStats MapGen::stats;
+
+MapGenStats::MapGenStats()
+  : enabled(false),
+    m_mark(0)
+{
+  reset();
+}
+
+void MapGenStats::reset()
+{
+  for (int i = 0; i < STAGE_COUNT; i++)
+  {
+    usec[i] = 0;
+  }
+  m_stack.clear();
+}
+
+void MapGenStats::begin(int stage)
+{
+  if (!enabled)
+  {
+    return;
+  }
+
+  const uint64_t now = microTime();
+  if (!m_stack.empty())
+  {
+    usec[m_stack.back()] += now - m_mark;
+  }
+  m_stack.push_back(stage);
+  m_mark = now;
+}
 
-int g_seed;
-int f_seed;
+void MapGenStats::end()
+{
+  if (!enabled || m_stack.empty())
+  {
+    return;
+  }
+
+  const uint64_t now = microTime();
+  usec[m_stack.back()] += now - m_mark;
+  m_stack.pop_back();
+  m_mark = now;
+}
 
-static inline int fastrand()
+const char* MapGenStats::stageName(int stage)
 {
-  f_seed = (214013 * f_seed + 2531011);
-  return (f_seed >> 16) & 0x7FFF;
+  static const char* names[STAGE_COUNT] = { "terrain", "caves", "ore", "trees", "beaches", "lighting" };
+  return (stage >= 0 && stage < STAGE_COUNT) ? names[stage] : "unknown";
 }
 
 MapGen::MapGen()
-  : blocks(16 * 16 * 256, 0),
+  : worldSeed(0),
+    blocks(16 * 16 * 256, 0),
     addblocks(16 * 16 * 256 / 2, 0),
     blockdata(16 * 16 * 256 / 2, 0),
     skylight(16 * 16 * 256 / 2, 0),
@@ -64,8 +112,7 @@ MapGen::MapGen()
 void MapGen::init(int seed)
 {
   cave.init(seed + 7);
-  f_seed = seed; // used for fastrand and can change
-  g_seed = seed; // used for height map, cannot change
+  worldSeed = seed;
 
   ridgedMultiNoise.SetSeed(seed);
   ridgedMultiNoise.SetOctaveCount(6);
@@ -94,6 +141,7 @@ void MapGen::init(int seed)
 
 void MapGen::re_init(int seed)
 {
+  worldSeed = seed;
   cave.init(seed + 7);
   ridgedMultiNoise.SetSeed(seed);
   treenoise.SetSeed(seed + 2);
@@ -150,7 +198,7 @@ void MapGen::generateChunk(int x, int z, int map)
   val->Insert("LastUpdate", new NBT_Value((int64_t)time(NULL)));
   val->Insert("xPos", new NBT_Value(x));
   val->Insert("zPos", new NBT_Value(z));
-  val->Insert("TerrainPopulated", new NBT_Value((int8_t)1));
+  val->Insert("TerrainPopulated", new NBT_Value((int8_t)0));
 
   main->Insert("Level", val);
 
@@ -173,6 +221,7 @@ void MapGen::generateChunk(int x, int z, int map)
   memset(chunk->skylight, 0, 16*16*256/2);
   chunk->chunks_present = 0xffff;
 
+  stats.begin(MapGenStats::TERRAIN);
   if (ServerInstance->config()->bData("mapgen.flatgrass"))
   {
     generateFlatgrass(x, z, map);
@@ -181,6 +230,7 @@ void MapGen::generateChunk(int x, int z, int map)
   {
     generateWithNoise(x, z, map);
   }
+  stats.end();
 
 
   // Update last used time
@@ -190,7 +240,17 @@ void MapGen::generateChunk(int x, int z, int map)
   chunk->changed = ServerInstance->config()->bData("map.save_unchanged_chunks");
 
   //ServerInstance->map()->maps[chunkid].nbt = main;
-  
+
+  // Kept for populateChunk(), lighting rebuilds it once the chunk is populated
+  std::copy(heightmap.begin(), heightmap.end(), chunk->heightmap);
+}
+
+void MapGen::populateChunk(int x, int z, int map)
+{
+  sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  std::copy(chunk->heightmap, chunk->heightmap + 16 * 16, heightmap.begin());
+
+  stats.begin(MapGenStats::ORE);
   if (addOre)
   {
     AddOre(x, z, map, BLOCK_COAL_ORE);
@@ -202,19 +262,22 @@ void MapGen::generateChunk(int x, int z, int map)
   }
 
   AddOre(x, z, map, BLOCK_GRAVEL);
+  stats.end();
 
   // Add trees
   if (addTrees)
   {
+    stats.begin(MapGenStats::TREES);
     AddTrees(x, z, map);  // add trees will make a *kind-of* forest of 16*16 chunks
+    stats.end();
   }
 
   if (expandBeaches)
   {
+    stats.begin(MapGenStats::BEACHES);
     ExpandBeaches(x, z, map);
+    stats.end();
   }
-  
-
 }
 
 //#define PRINT_MAPGEN_TIME
@@ -231,8 +294,10 @@ void MapGen::AddTrees(int x, int z, int map)
   uint8_t block;
   uint8_t meta;
 
-  uint8_t un = fastrand() % 4 + 2;
-  uint8_t vn = fastrand() % 4 + 2;
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TREES);
+
+  uint8_t un = rng.below(4) + 2;
+  uint8_t vn = rng.below(4) + 2;
 
   float uFactor = (16 / (float)un);   //relational to literal
   float vFactor = (16 / (float)vn);
@@ -255,7 +320,7 @@ void MapGen::AddTrees(int x, int z, int map)
       {
         if (abs(treenoise.GetValue(blockX, 0, blockZ)) >= 0.9)
         {
-          Tree tree(blockX, blockY, blockZ, map);
+          Tree tree(blockX, blockY, blockZ, map, rng);
         }
       }
     }
@@ -283,6 +348,7 @@ void MapGen::generateWithNoise(int x, int z, int map)
   int32_t currentHeight;
   int32_t ymax;
   uint8_t* curBlock;
+  int32_t stoneTop[16 * 16];
 
   double xBlockpos = x << 4;
   double zBlockpos = z << 4;
@@ -292,7 +358,7 @@ void MapGen::generateWithNoise(int x, int z, int map)
     {
       heightmap[(bZ << 4) + bX] = ymax = currentHeight = (uint8_t)((ridgedMultiNoise.GetValue(xBlockpos + bX, 0, zBlockpos + bZ) * 15) + 64);
 
-      int32_t stoneHeight = (int32_t)(currentHeight * 0.94);
+      int32_t stoneHeight = stoneTop[(bZ << 4) + bX] = (int32_t)(currentHeight * 0.94);
       //int32_t bYbX = ((bZ << 7) + (bX << 11));
 
       if (ymax < seaLevel)
@@ -317,11 +383,6 @@ void MapGen::generateWithNoise(int x, int z, int map)
           if (bY < stoneHeight)
           {
             *curBlock = BLOCK_STONE;
-            // Add caves
-            if (addCaves)
-            {
-              cave.AddCaves(*curBlock, int(xBlockpos + bX), bY, int(zBlockpos + bZ));
-            }
           }
           else
           {
@@ -358,6 +419,14 @@ void MapGen::generateWithNoise(int x, int z, int map)
     }
   }
 
+  // Caves are carved out of the finished stone layer in one pass
+  if (addCaves)
+  {
+    stats.begin(MapGenStats::CAVES);
+    cave.AddCaves(chunk, x, z, stoneTop);
+    stats.end();
+  }
+
 #ifdef PRINT_MAPGEN_TIME
 #ifdef WIN32
   t_end = timeGetTime();
@@ -443,6 +512,7 @@ void MapGen::ExpandBeaches(int x, int z, int map)
 void MapGen::AddOre(int x, int z, int map, uint8_t type)
 {
   sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::ORE + type);
 
   int blockX, blockY, blockZ;
   uint8_t block;
@@ -453,43 +523,43 @@ void MapGen::AddOre(int x, int z, int map, uint8_t type)
   switch (type)
   {
   case BLOCK_COAL_ORE:
-    count = fastrand() % 10 + 20; // 20-30 coal deposits
+    count = rng.below(10) + 20; // 20-30 coal deposits
     startHeight = 90;
     minDepoSize = 3;
     maxDepoSize = 7;
     break;
   case BLOCK_IRON_ORE:
-    count = fastrand() % 8 + 10; // 10-18 iron deposits
+    count = rng.below(8) + 10; // 10-18 iron deposits
     startHeight = 60;
     minDepoSize = 2;
     maxDepoSize = 5;
     break;
   case BLOCK_GOLD_ORE:
-    count = fastrand() % 4 + 5; // 4-9 gold deposits
+    count = rng.below(4) + 5; // 4-9 gold deposits
     startHeight = 32;
     minDepoSize = 2;
     maxDepoSize = 4;
     break;
   case BLOCK_DIAMOND_ORE:
-    count = fastrand() % 1 + 2; // 1-3 diamond deposits
+    count = rng.below(1) + 2; // 1-3 diamond deposits
     startHeight = 17;
     minDepoSize = 1;
     maxDepoSize = 2;
     break;
   case BLOCK_REDSTONE_ORE:
-    count = fastrand() % 5 + 5; // 5-10 redstone deposits
+    count = rng.below(5) + 5; // 5-10 redstone deposits
     startHeight = 25;
     minDepoSize = 2;
     maxDepoSize = 4;
     break;
   case BLOCK_LAPIS_ORE:
-    count = fastrand() % 1 + 2; // 1-3 lapis lazuli deposits
+    count = rng.below(1) + 2; // 1-3 lapis lazuli deposits
     startHeight = 17;
     minDepoSize = 1;
     maxDepoSize = 2;
     break;
   case BLOCK_GRAVEL:
-    count = fastrand() % 10 + 20; // 20-30 gravel deposits
+    count = rng.below(10) + 20; // 20-30 gravel deposits
     startHeight = 90;
     minDepoSize = 4;
     maxDepoSize = 10;
@@ -501,8 +571,8 @@ void MapGen::AddOre(int x, int z, int map, uint8_t type)
   int i = 0;
   while (i < count)
   {
-    blockX = fastrand() % 8 + 4;
-    blockZ = fastrand() % 8 + 4;
+    blockX = rng.below(8) + 4;
+    blockZ = rng.below(8) + 4;
 
     blockY = heightmap[(blockZ << 4) + blockX];
     blockY -= 5;
@@ -517,7 +587,7 @@ void MapGen::AddOre(int x, int z, int map, uint8_t type)
     //blockZ += zBlockpos;
 
     // Calculate Y
-    blockY = fastrand() % blockY;
+    blockY = rng.below(std::max(blockY, 1));
 
     i++;
 
@@ -528,14 +598,14 @@ void MapGen::AddOre(int x, int z, int map, uint8_t type)
       continue;
     }
 
-    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk);
+    AddDeposit(blockX, blockY, blockZ, map, type, minDepoSize, maxDepoSize, chunk, rng);
 
   }
 }
 
-void MapGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk)
+void MapGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk, ChunkRNG& rng)
 {
-  int depoSize = fastrand() % (maxDepoSize - minDepoSize) + minDepoSize;
+  int depoSize = rng.below(maxDepoSize - minDepoSize) + minDepoSize;
   for (int i = 0; i < depoSize; i++)
   {
     if (chunk->blocks[x + (z << 4) + (y << 8)] != BLOCK_GRASS ||
@@ -544,9 +614,9 @@ void MapGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepo
       chunk->blocks[x + (z << 4) + (y << 8)] = block;
     }
 
-    z = z + ((fastrand() % 2) - 1);
-    x = x + ((fastrand() % 2) - 1);
-    y = y + ((fastrand() % 2) - 1);
+    z = z + (int(rng.below(2)) - 1);
+    x = x + (int(rng.below(2)) - 1);
+    y = y + (int(rng.below(2)) - 1);
 
     // If over chunk borders
     if (z < 0 || z > 15 || x < 0 || x > 15 || y < 1)
@@ -36,6 +36,57 @@
 
 #include "cavegen.h"
 #include "map.h"
+#include "random.h"
+
+//
+// Time spent in each generation stage, only measured while enabled
+// (worldgenbench does). Stages nest, a stage begun inside another one
+// pauses the outer stage.
+//
+struct MapGenStats
+{
+  enum Stage
+  {
+    TERRAIN,
+    CAVES,
+    ORE,
+    TREES,
+    BEACHES,
+    LIGHTING,
+    STAGE_COUNT
+  };
+
+  MapGenStats();
+
+  bool enabled;
+  uint64_t usec[STAGE_COUNT];
+
+  void reset();
+  void begin(int stage);
+  void end();
+
+  static const char* stageName(int stage);
+
+  // Times the enclosing scope as one stage
+  class Timer
+  {
+  public:
+    Timer(MapGenStats& stats, int stage) : m_stats(stats)
+    {
+      m_stats.begin(stage);
+    }
+    ~Timer()
+    {
+      m_stats.end();
+    }
+  private:
+    MapGenStats& m_stats;
+  };
+
+private:
+  std::vector<int> m_stack;
+  uint64_t m_mark;
+};
 
 class MapGen
 {
@@ -44,7 +95,18 @@ public:
   virtual ~MapGen() { }
   virtual void init(int seed);
   virtual void re_init(int seed); // Used when generating multiple maps
+  // Terrain and caves only, the chunk is left unpopulated
   virtual void generateChunk(int x, int z, int map);
+  // Ore, trees and beaches. Map calls this once all eight neighbours exist,
+  // features crossing the chunk edge are written into them
+  virtual void populateChunk(int x, int z, int map);
+
+  // Shared by all generators, generation is single threaded
+  static MapGenStats stats;
+
+protected:
+  // Seed of the last init(), the ChunkRNG streams of decoration derive from it
+  int worldSeed;
 
 private:
   std::vector<uint8_t> blocks;
@@ -73,7 +135,7 @@ private:
   virtual void AddTrees(int x, int z, int map);
 
   virtual void AddOre(int x, int z, int map, uint8_t type);
-  virtual void AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk);
+  virtual void AddDeposit(int x, int y, int z, int map, uint8_t block, int minDepoSize, int maxDepoSize, sChunk* chunk, ChunkRNG& rng);
 
   CaveGen cave;
 
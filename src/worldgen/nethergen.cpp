@@ -58,8 +58,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools.h"
 #include "random.h"
 
-int neth_seed;
-
 NetherGen::NetherGen()
   : netherblocks(16 * 16 * 128, 0),
     blockdata(16 * 16 * 128 / 2, 0),
@@ -69,15 +67,10 @@ NetherGen::NetherGen()
 {
 }
 
-inline int fastrand()
-{
-  neth_seed = (214013 * neth_seed + 2531011);
-  return (neth_seed >> 16) & 0x7FFF;
-}
 
 void NetherGen::init(int seed)
 {
-  neth_seed = seed;
+  worldSeed = seed;
 
   Randomgen.SetSeed(seed);
   Randomgen.SetFrequency(0.1);
@@ -97,6 +90,7 @@ void NetherGen::init(int seed)
 
 void NetherGen::re_init(int seed)
 {
+  worldSeed = seed;
   Randomgen.SetSeed(seed);
 }
 
@@ -105,7 +99,9 @@ void NetherGen::generateChunk(int x, int z, int map)
   NBT_Value* main = new NBT_Value(NBT_Value::TAG_COMPOUND);
   NBT_Value* val = new NBT_Value(NBT_Value::TAG_COMPOUND);
 
+  stats.begin(MapGenStats::TERRAIN);
   generateWithNoise(x, z, map);
+  stats.end();
 
   val->Insert("Blocks", new NBT_Value(netherblocks));
   val->Insert("Data", new NBT_Value(blockdata));
@@ -117,7 +113,7 @@ void NetherGen::generateChunk(int x, int z, int map)
   val->Insert("LastUpdate", new NBT_Value((int64_t)time(NULL)));
   val->Insert("xPos", new NBT_Value(x));
   val->Insert("zPos", new NBT_Value(z));
-  val->Insert("TerrainPopulated", new NBT_Value((char)1));
+  val->Insert("TerrainPopulated", new NBT_Value((int8_t)0));
 
   main->Insert("Level", val);
 
@@ -152,30 +148,41 @@ void NetherGen::generateChunk(int x, int z, int map)
   //ServerInstance->map()->mapChanged[chunkid] = ServerInstance->config()->bData("save_unchanged_chunks");
 
   //ServerInstance->map()->maps[chunkid].nbt = main;
+}
 
+void NetherGen::populateChunk(int x, int z, int map)
+{
+  sChunk* chunk = ServerInstance->map(map)->getChunk(x, z);
+  std::copy(chunk->heightmap, chunk->heightmap + 16 * 16, heightmap.begin());
+
+  stats.begin(MapGenStats::ORE);
   if (addOre)
   {
     AddOre(x, z, map, BLOCK_GLOWSTONE);
     AddOre(x, z, map, BLOCK_STATIONARY_LAVA);
   }
+  stats.end();
 
   // Add trees
   if (addTrees)
   {
-    AddTrees(x, z, map,  fastrand() % 2 + 3);
+    stats.begin(MapGenStats::TREES);
+    AddTrees(x, z, map);
+    stats.end();
   }
 
   if (expandBeaches)
   {
+    stats.begin(MapGenStats::BEACHES);
     ExpandBeaches(x, z, map);
+    stats.end();
   }
-
 }
 
 //#define PRINT_MAPGEN_TIME
 
 
-void NetherGen::AddTrees(int x, int z, int map, uint16_t count)
+void NetherGen::AddTrees(int x, int z, int map)
 {
   int xBlockpos = x << 4;
   int zBlockpos = z << 4;
@@ -184,10 +191,13 @@ void NetherGen::AddTrees(int x, int z, int map, uint16_t count)
   uint8_t block;
   uint8_t meta;
 
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::TREES);
+  const uint16_t count = rng.below(2) + 3;
+
   for (uint16_t i = 0; i < count; i++)
   {
-    blockX = fastrand() % 16;
-    blockZ = fastrand() % 16;
+    blockX = rng.below(16);
+    blockZ = rng.below(16);
 
     blockY = heightmap[(blockZ << 4) + blockX] + 1;
 
@@ -201,7 +211,7 @@ void NetherGen::AddTrees(int x, int z, int map, uint16_t count)
       continue;
     }
 
-    Tree tree(blockX, blockY, blockZ, map);
+    Tree tree(blockX, blockY, blockZ, map, rng);
   }
 }
 
@@ -389,6 +399,8 @@ void NetherGen::ExpandBeaches(int x, int z, int map)
 
 void NetherGen::AddOre(int x, int z, int map, uint8_t type)
 {
+  ChunkRNG rng(worldSeed, x, z, ChunkRNG::ORE + type);
+
   int xBlockpos = x << 4;
   int zBlockpos = z << 4;
 
@@ -401,11 +413,11 @@ void NetherGen::AddOre(int x, int z, int map, uint8_t type)
   switch (type)
   {
   case BLOCK_GLOWSTONE:
-    count = fastrand() % 4 + 15;
+    count = rng.below(4) + 15;
     startHeight = 128;
     break;
   case BLOCK_STATIONARY_LAVA:
-    count = fastrand() % 20 + 20;
+    count = rng.below(20) + 20;
     startHeight = 128;
     break;
   }
@@ -413,8 +425,8 @@ void NetherGen::AddOre(int x, int z, int map, uint8_t type)
   int i = 0;
   while (i < count)
   {
-    blockX = fastrand() % 8 + 4;
-    blockZ = fastrand() % 8 + 4;
+    blockX = rng.below(8) + 4;
+    blockZ = rng.below(8) + 4;
 
     blockY = heightmap[(blockZ << 4) + blockX];
     blockY -= 5;
@@ -429,7 +441,7 @@ void NetherGen::AddOre(int x, int z, int map, uint8_t type)
     blockZ += zBlockpos;
 
     // Calculate Y
-    blockY = fastrand() % blockY;
+    blockY = rng.below(std::max(blockY, 1));
 
     i++;
 
@@ -440,12 +452,12 @@ void NetherGen::AddOre(int x, int z, int map, uint8_t type)
       continue;
     }
 
-    AddDeposit(blockX, blockY, blockZ, map, type, 2);
+    AddDeposit(blockX, blockY, blockZ, map, type, 2, rng);
 
   }
 }
 
-void NetherGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize)
+void NetherGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depotSize, ChunkRNG& rng)
 {
   for (int bX = x; bX < x + depotSize; bX++)
   {
@@ -453,7 +465,7 @@ void NetherGen::AddDeposit(int x, int y, int z, int map, uint8_t block, int depo
     {
       for (int bZ = z; bZ < z + depotSize; bZ++)
       {
-        if (uniform01() < 0.5)
+        if (rng.uniform01() < 0.5)
         {
           ServerInstance->map(map)->sendBlockChange(bX, bY, bZ, block, 0);
           ServerInstance->map(map)->setBlock(bX, bY, bZ, block, 0);
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef LIBNOISE
+#include <libnoise/noise.h>
+#else
+#include <noise/noise.h>
+#endif
+
+#include "noisegrid.h"
+
+NoiseGrid::NoiseGrid()
+  : m_stepXZ(4),
+    m_stepY(2),
+    m_sizeXZ(0),
+    m_sizeY(0),
+    m_height(-1)
+{
+}
+
+void NoiseGrid::fill(const noise::module::Module& module, int blockX, int blockZ, int height,
+                     double spreadX, double spreadY, double spreadZ,
+                     int stepXZ, int stepY)
+{
+  if (stepXZ <= 0 || 16 % stepXZ != 0)
+  {
+    stepXZ = 4;
+  }
+  if (stepY <= 0)
+  {
+    stepY = 2;
+  }
+
+  m_stepXZ = stepXZ;
+  m_stepY  = stepY;
+  m_height = height;
+  m_sizeXZ = 16 / stepXZ + 1;
+  // One node above height, so value() can always read iy + 1
+  m_sizeY  = height / stepY + 2;
+  m_samples.resize(m_sizeXZ * m_sizeXZ * m_sizeY);
+
+  double* sample = &m_samples[0];
+  for (int ix = 0; ix < m_sizeXZ; ix++)
+  {
+    const double nx = (blockX + ix * stepXZ) / spreadX;
+    for (int iz = 0; iz < m_sizeXZ; iz++)
+    {
+      const double nz = (blockZ + iz * stepXZ) / spreadZ;
+      for (int iy = 0; iy < m_sizeY; iy++)
+      {
+        *sample++ = module.GetValue(nx, (iy * stepY) / spreadY, nz);
+      }
+    }
+  }
+}
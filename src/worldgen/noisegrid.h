@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2012, The Mineserver Project
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _NOISEGRID_H
+#define _NOISEGRID_H
+
+#include <vector>
+
+namespace noise
+{
+  namespace module
+  {
+    class Module;
+  }
+}
+
+//
+// Noise for a whole chunk, sampled once on a coarse lattice and trilinearly
+// interpolated per block. Lattice nodes hold the exact noise value, blocks in
+// between are within the interpolation error of the reference.
+//
+class NoiseGrid
+{
+public:
+  NoiseGrid();
+
+  // Samples module at ((blockX + x) / spreadX, y / spreadY, (blockZ + z) / spreadZ)
+  // for x, z in [0, 16] and y in [0, height], every stepXZ / stepY blocks.
+  // A lattice column is evaluated in one go. stepXZ must divide 16.
+  void fill(const noise::module::Module& module, int blockX, int blockZ, int height,
+            double spreadX, double spreadY, double spreadZ,
+            int stepXZ = 4, int stepY = 2);
+
+  // Chunk local block coordinates, y <= height()
+  double value(int x, int y, int z) const
+  {
+    const int ix = x / m_stepXZ;
+    const int iy = y / m_stepY;
+    const int iz = z / m_stepXZ;
+    const double fx = double(x - ix * m_stepXZ) / m_stepXZ;
+    const double fy = double(y - iy * m_stepY) / m_stepY;
+    const double fz = double(z - iz * m_stepXZ) / m_stepXZ;
+
+    const double* c00 = &m_samples[(ix * m_sizeXZ + iz) * m_sizeY + iy];
+    const double* c01 = c00 + m_sizeY;
+    const double* c10 = c00 + m_sizeXZ * m_sizeY;
+    const double* c11 = c10 + m_sizeY;
+
+    const double v00 = c00[0] + (c00[1] - c00[0]) * fy;
+    const double v01 = c01[0] + (c01[1] - c01[0]) * fy;
+    const double v10 = c10[0] + (c10[1] - c10[0]) * fy;
+    const double v11 = c11[0] + (c11[1] - c11[0]) * fy;
+
+    const double v0 = v00 + (v01 - v00) * fz;
+    const double v1 = v10 + (v11 - v10) * fz;
+
+    return v0 + (v1 - v0) * fx;
+  }
+
+  int height() const
+  {
+    return m_height;
+  }
+
+  // Number of noise evaluations the last fill() made
+  int samples() const
+  {
+    return int(m_samples.size());
+  }
+
+private:
+  int m_stepXZ;
+  int m_stepY;
+  int m_sizeXZ;
+  int m_sizeY;
+  int m_height;
+  // [(x * m_sizeXZ + z) * m_sizeY + y], so a lattice column is contiguous
+  std::vector<double> m_samples;
+};
+
+#endif